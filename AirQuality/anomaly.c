@@ -0,0 +1,161 @@
+/***************************************************************************//**
+* @file    anomaly.c
+* @version 1.0.0
+*
+* @brief Streaming anomaly detection over the sample stream.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <string.h>
+
+#include "anomaly.h"
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+// Samples arrive about once per second
+const anomaly_config_t anomaly_configs[ANOMALY_METRIC_COUNT] = {
+    [ANOMALY_METRIC_ECO2] = {
+        .name = "eco2", .b_is_centi = false,
+        .level = 1500, .hysteresis = 100,           // [ppm]
+        .rise_per_min = 300,
+        .shift_slack = 50, .shift_limit = 1000,
+        .ewma_shift = 5
+    },
+    [ANOMALY_METRIC_TVOC] = {
+        .name = "tvoc", .b_is_centi = false,
+        .level = 660, .hysteresis = 60,             // [ppb]
+        .rise_per_min = 200,
+        .shift_slack = 30, .shift_limit = 600,
+        .ewma_shift = 5
+    },
+    [ANOMALY_METRIC_TEMPERATURE] = {
+        .name = "temperature", .b_is_centi = true,
+        .level = 3500, .hysteresis = 100,           // [0.01 degC]
+        .rise_per_min = 100,
+        .shift_slack = 20, .shift_limit = 500,
+        .ewma_shift = 5
+    },
+    [ANOMALY_METRIC_HUMIDITY] = {
+        .name = "humidity", .b_is_centi = true,
+        .level = 8000, .hysteresis = 300,           // [0.01 %RH]
+        .rise_per_min = 500,
+        .shift_slack = 100, .shift_limit = 2500,
+        .ewma_shift = 5
+    },
+};
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+void
+anomaly_init(anomaly_t *p_anomaly, const anomaly_config_t *p_config)
+{
+    memset(p_anomaly, 0, sizeof(*p_anomaly));
+    p_anomaly->p_config = p_config;
+}
+
+uint32_t
+anomaly_update(anomaly_t *p_anomaly, int32_t value, uint64_t now_us)
+{
+    const anomaly_config_t *p_config = p_anomaly->p_config;
+    const int32_t weight = 1 << p_config->ewma_shift;
+    uint32_t detected = 0;
+
+    if (p_anomaly->samples == 0)
+    {
+        p_anomaly->mean = value * (1 << ANOMALY_MEAN_FRAC_BITS);
+    }
+    else
+    {
+        // CUSUM against the mean before this sample
+        int32_t deviation = value - anomaly_get_mean(p_anomaly);
+        p_anomaly->cusum_high += deviation - p_config->shift_slack;
+        p_anomaly->cusum_low += -deviation - p_config->shift_slack;
+        if (p_anomaly->cusum_high < 0)
+        {
+            p_anomaly->cusum_high = 0;
+        }
+        if (p_anomaly->cusum_low < 0)
+        {
+            p_anomaly->cusum_low = 0;
+        }
+
+        int32_t mean_step = (value * (1 << ANOMALY_MEAN_FRAC_BITS) -
+            p_anomaly->mean) / weight;
+        p_anomaly->mean += mean_step;
+
+        // Rate is the slope of the mean, smoothed again, so that a single
+        // outlier sample does not look like a rise
+        uint64_t interval_us = now_us - p_anomaly->last_us;
+        if (interval_us > 0)
+        {
+            int32_t rate = (int32_t)((int64_t)mean_step * 60000000 /
+                (int64_t)interval_us / (1 << ANOMALY_MEAN_FRAC_BITS));
+            p_anomaly->rate_per_min += (rate - p_anomaly->rate_per_min) /
+                weight;
+        }
+    }
+    p_anomaly->samples++;
+    p_anomaly->last_value = value;
+    p_anomaly->last_us = now_us;
+
+    // Level, immediately
+    if (value >= p_config->level)
+    {
+        detected |= ANOMALY_LEVEL;
+    }
+    else if ((p_anomaly->active & ANOMALY_LEVEL) &&
+        (value >= p_config->level - p_config->hysteresis))
+    {
+        detected |= ANOMALY_LEVEL;
+    }
+
+    if (p_anomaly->samples > ANOMALY_WARMUP_SAMPLES)
+    {
+        // Rise, cleared at half the limit
+        if ((p_config->rise_per_min > 0) &&
+            ((p_anomaly->rate_per_min >= p_config->rise_per_min) ||
+            ((p_anomaly->active & ANOMALY_RISE) &&
+            (p_anomaly->rate_per_min >= p_config->rise_per_min / 2))))
+        {
+            detected |= ANOMALY_RISE;
+        }
+
+        // Shift, cleared when the mean is within the slack of the value
+        int32_t deviation = value - anomaly_get_mean(p_anomaly);
+        if ((p_config->shift_limit > 0) &&
+            ((p_anomaly->cusum_high > p_config->shift_limit) ||
+            (p_anomaly->cusum_low > p_config->shift_limit)))
+        {
+            detected |= ANOMALY_SHIFT;
+            p_anomaly->cusum_high = 0;
+            p_anomaly->cusum_low = 0;
+        }
+        else if ((p_anomaly->active & ANOMALY_SHIFT) &&
+            ((deviation > p_config->shift_slack) ||
+            (deviation < -p_config->shift_slack)))
+        {
+            detected |= ANOMALY_SHIFT;
+        }
+    }
+
+    uint32_t raised = detected & ~p_anomaly->active;
+    p_anomaly->active = detected;
+
+    return raised;
+}
+
+int32_t
+anomaly_get_mean(const anomaly_t *p_anomaly)
+{
+    return p_anomaly->mean / (1 << ANOMALY_MEAN_FRAC_BITS);
+}
+
+/* [] END OF FILE */
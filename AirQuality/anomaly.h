@@ -0,0 +1,128 @@
+/***************************************************************************//**
+* @file    anomaly.h
+* @version 1.0.0
+*
+* @brief Streaming anomaly detection over the sample stream.
+*
+* Each metric is watched by three detectors, updated in O(1) time and
+* memory per sample, all in integer arithmetic:
+*
+*   level   value above an absolute threshold, cleared with hysteresis
+*   rise    exponentially weighted rate of change above a limit, e.g. CO2
+*           building up in an occupied room
+*   shift   two sided CUSUM of the deviation from the exponentially weighted
+*           moving average (EWMA): a sustained change of the level by more
+*           than the slack, accumulated up to the limit, even if neither the
+*           threshold nor the rate limit is reached
+*
+* Rise and shift detection starts after ANOMALY_WARMUP_SAMPLES, once the
+* averages have settled. The shift alert clears when the average has caught
+* up with the new level.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef ANOMALY_H
+#define ANOMALY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+// Alert kinds
+#define ANOMALY_LEVEL           (1u << 0)
+#define ANOMALY_RISE            (1u << 1)
+#define ANOMALY_SHIFT           (1u << 2)
+
+#define ANOMALY_WARMUP_SAMPLES  (8)
+#define ANOMALY_MEAN_FRAC_BITS  (8)     // Fraction bits of the EWMA
+
+/*******************************************************************************
+*   Data types
+*******************************************************************************/
+
+typedef enum
+{
+    ANOMALY_METRIC_ECO2,
+    ANOMALY_METRIC_TVOC,
+    ANOMALY_METRIC_TEMPERATURE,
+    ANOMALY_METRIC_HUMIDITY,
+    ANOMALY_METRIC_COUNT
+} anomaly_metric_t;
+
+typedef struct
+{
+    const char *name;
+    bool b_is_centi;            // Values in 0.01 units
+    int32_t level;              // Absolute threshold
+    int32_t hysteresis;         // Level alert clears below level - hysteresis
+    int32_t rise_per_min;       // Rate of rise limit, 0 disables
+    int32_t shift_slack;        // CUSUM allowance per sample
+    int32_t shift_limit;        // CUSUM decision interval, 0 disables
+    uint8_t ewma_shift;         // EWMA weight 2^-ewma_shift
+} anomaly_config_t;
+
+typedef struct
+{
+    const anomaly_config_t *p_config;
+    uint32_t samples;
+    int32_t mean;               // EWMA, ANOMALY_MEAN_FRAC_BITS fraction bits
+    int32_t rate_per_min;       // EWMA of the rate of change
+    int32_t cusum_high;
+    int32_t cusum_low;
+    int32_t last_value;
+    uint64_t last_us;
+    uint32_t active;            // Raised and not cleared ANOMALY_* kinds
+} anomaly_t;
+
+/*******************************************************************************
+*   Global variables
+*******************************************************************************/
+
+// Thresholds of the Air Quality Monitor metrics
+extern const anomaly_config_t anomaly_configs[ANOMALY_METRIC_COUNT];
+
+/*******************************************************************************
+*   Function declarations
+*******************************************************************************/
+
+/**
+ * @brief Reset detector state.
+ */
+void
+anomaly_init(anomaly_t *p_anomaly, const anomaly_config_t *p_config);
+
+/**
+ * @brief Feed one sample.
+ *
+ * @param value Sample in metric units.
+ * @param now_us Sample time [us], monotonic.
+ *
+ * @return ANOMALY_* kinds raised by this sample, not active before.
+ */
+uint32_t
+anomaly_update(anomaly_t *p_anomaly, int32_t value, uint64_t now_us);
+
+/**
+ * @brief Get the EWMA of the metric in metric units.
+ */
+int32_t
+anomaly_get_mean(const anomaly_t *p_anomaly);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // ANOMALY_H
+
+/* [] END OF FILE */
@@ -30,9 +30,5 @@
 // This is required when connecting to Azure using connection string method
 #define AZURE_CONNECTION_STRING ""
 
-// Defines how quickly the accelerator data is read and reported
-#define ACCEL_READ_PERIOD_SECONDS 1
-#define ACCEL_READ_PERIOD_NANO_SECONDS 0
-
 // Enables I2C read/write debug
 //#define ENABLE_READ_WRITE_DEBUG
\ No newline at end of file
@@ -0,0 +1,69 @@
+/// \file azure_iot_transport.h
+/// \brief This header defines the transport interface used by azure_iot_utilities.c to talk
+/// to an IoT Hub. The default transport wraps the IoTHubClient LL library, the fake hub
+/// transport (see fake_hub.h) emulates the IoT Hub in process for offline testing.
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <azureiot/iothub_device_client_ll.h>
+
+/// <summary>
+///     Callbacks invoked by a transport from within its DoWork function.
+/// </summary>
+typedef struct {
+    /// <summary>Delivery confirmation of a message handed over by SendEvent.</summary>
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK sendConfirmation;
+    /// <summary>Cloud to device message, the payload is not zero terminated.</summary>
+    IOTHUBMESSAGE_DISPOSITION_RESULT (*messageReceived)(const unsigned char *payload,
+                                                        size_t size);
+    /// <summary>Device Twin document or desired properties patch.</summary>
+    IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK twinUpdate;
+    /// <summary>Direct Method call, the response must be allocated by malloc().</summary>
+    IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC directMethod;
+    /// <summary>Status code of a reported properties update.</summary>
+    IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reportedStateConfirmation;
+    /// <summary>Connection status change.</summary>
+    IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK connectionStatus;
+} AzureIoT_TransportCallbacks;
+
+/// <summary>
+///     IoT Hub transport. A transport holds at most one client at a time.
+/// </summary>
+typedef struct {
+    /// <summary>Name of the transport used in log messages.</summary>
+    const char *name;
+    /// <summary>Creates the client. Returns 'false' on a fatal error.</summary>
+    bool (*create)(const AzureIoT_TransportCallbacks *callbacks);
+    /// <summary>Destroys the client, pending messages are confirmed with
+    /// IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY.</summary>
+    void (*destroy)(void);
+    /// <summary>Queues a device to cloud message. The context is passed back to
+    /// sendConfirmation.</summary>
+    bool (*sendEvent)(const char *payload, const char *messageId, void *context);
+    /// <summary>Queues a reported properties update. The context is passed back to
+    /// reportedStateConfirmation.</summary>
+    bool (*sendReportedState)(const unsigned char *json, size_t size, void *context);
+    /// <summary>Exchanges data with the hub and invokes the callbacks.</summary>
+    void (*doWork)(void);
+    /// <summary>While held, doWork invokes the callbacks of completed operations but does
+    /// not connect. May be NULL if doWork always connects, it is then not called while the
+    /// connection should be held.</summary>
+    void (*holdConnection)(bool hold);
+} AzureIoT_Transport;
+
+/// <summary>
+///     Transport based on the IoTHubClient LL library and MQTT.
+/// </summary>
+extern const AzureIoT_Transport AzureIoT_SdkTransport;
+
+/// <summary>
+///     In process IoT Hub emulation, see fake_hub.h. Built only with AZURE_IOT_FAKE_HUB.
+/// </summary>
+extern const AzureIoT_Transport AzureIoT_FakeHubTransport;
+
+/// <summary>
+///     Selects the transport used by the next AzureIoT_SetupClient() call.
+/// </summary>
+/// <returns>'false' if the client is already set up, the transport is not changed then.</returns>
+bool AzureIoT_SetTransport(const AzureIoT_Transport *transport);
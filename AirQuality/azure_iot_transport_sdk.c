@@ -0,0 +1,280 @@
+/// \file azure_iot_transport_sdk.c
+/// \brief IoT Hub transport based on the IoTHubClient LL library included in the Azure IoT
+/// Device SDK for C.
+#include <azureiot/iothub_device_client_ll.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <azureiot/iothub_client_core_common.h>
+#include <azureiot/iothub_client_options.h>
+#include <azureiot/iothubtransportmqtt.h>
+#include <applibs/log.h>
+#include "azure_iot_transport.h"
+#include "build_options.h"
+
+// Refer to https://docs.microsoft.com/en-us/azure/iot-hub/iot-hub-device-sdk-c-intro for more
+// information on Azure IoT SDK for C
+
+//
+// String containing Hostname, Device Id & Device Key in the format:
+// "HostName=<host_name>;DeviceId=<device_id>;SharedAccessKey=<device_key>"
+
+// see information on iothub-explorer at http://aka.ms/iothubgetstartedVSCS
+//
+
+#include "connection_strings.h"
+
+static const char connectionString[] = MY_CONNECTION_STRING;
+
+/// <summary>
+///     Maximum amount of time to attempt reconnection when the connection to the IoT Hub drops.
+/// </summary>
+/// <remarks>Time expressed in seconds. A value of 0 means to retry forever.</remarks>
+static const size_t retryTimeoutSeconds = 0;
+
+/// <summary>
+///     Used to set the keepalive period over MQTT to 20 seconds.
+/// </summary>
+static int keepalivePeriodSeconds = 20;
+
+/// <summary>
+///     The handle to the IoT Hub client used for communication with the hub.
+/// </summary>
+static IOTHUB_DEVICE_CLIENT_LL_HANDLE iothubClientHandle = NULL;
+
+/// <summary>
+///     Callbacks of the utilities layer.
+/// </summary>
+static const AzureIoT_TransportCallbacks *transportCallbacks = NULL;
+
+/// <summary>
+///     Set of bundle of root certificate authorities.
+/// </summary>
+static const char azureIoTCertificatesX[] =
+    /* DigiCert Baltimore Root */
+    "-----BEGIN CERTIFICATE-----\r\n"
+    "MIIDdzCCAl+gAwIBAgIEAgAAuTANBgkqhkiG9w0BAQUFADBaMQswCQYDVQQGEwJJ\r\n"
+    "RTESMBAGA1UEChMJQmFsdGltb3JlMRMwEQYDVQQLEwpDeWJlclRydXN0MSIwIAYD\r\n"
+    "VQQDExlCYWx0aW1vcmUgQ3liZXJUcnVzdCBSb290MB4XDTAwMDUxMjE4NDYwMFoX\r\n"
+    "DTI1MDUxMjIzNTkwMFowWjELMAkGA1UEBhMCSUUxEjAQBgNVBAoTCUJhbHRpbW9y\r\n"
+    "ZTETMBEGA1UECxMKQ3liZXJUcnVzdDEiMCAGA1UEAxMZQmFsdGltb3JlIEN5YmVy\r\n"
+    "VHJ1c3QgUm9vdDCCASIwDQYJKoZIhvcNAQEBBQADggEPADCCAQoCggEBAKMEuyKr\r\n"
+    "mD1X6CZymrV51Cni4eiVgLGw41uOKymaZN+hXe2wCQVt2yguzmKiYv60iNoS6zjr\r\n"
+    "IZ3AQSsBUnuId9Mcj8e6uYi1agnnc+gRQKfRzMpijS3ljwumUNKoUMMo6vWrJYeK\r\n"
+    "mpYcqWe4PwzV9/lSEy/CG9VwcPCPwBLKBsua4dnKM3p31vjsufFoREJIE9LAwqSu\r\n"
+    "XmD+tqYF/LTdB1kC1FkYmGP1pWPgkAx9XbIGevOF6uvUA65ehD5f/xXtabz5OTZy\r\n"
+    "dc93Uk3zyZAsuT3lySNTPx8kmCFcB5kpvcY67Oduhjprl3RjM71oGDHweI12v/ye\r\n"
+    "jl0qhqdNkNwnGjkCAwEAAaNFMEMwHQYDVR0OBBYEFOWdWTCCR1jMrPoIVDaGezq1\r\n"
+    "BE3wMBIGA1UdEwEB/wQIMAYBAf8CAQMwDgYDVR0PAQH/BAQDAgEGMA0GCSqGSIb3\r\n"
+    "DQEBBQUAA4IBAQCFDF2O5G9RaEIFoN27TyclhAO992T9Ldcw46QQF+vaKSm2eT92\r\n"
+    "9hkTI7gQCvlYpNRhcL0EYWoSihfVCr3FvDB81ukMJY2GQE/szKN+OMY3EU/t3Wgx\r\n"
+    "jkzSswF07r51XgdIGn9w/xZchMB5hbgF/X++ZRGjD8ACtPhSNzkE1akxehi/oCr0\r\n"
+    "Epn3o0WC4zxe9Z2etciefC7IpJ5OCBRLbf1wbWsaY71k5h+3zvDyny67G7fyUIhz\r\n"
+    "ksLi4xaNmjICq44Y3ekQEe5+NauQrz4wlHrQMz2nZQ/1/I6eYs9HRCwBXbsdtTLS\r\n"
+    "R9I4LtD+gdwyah617jzV/OeBHRnDJELqYzmp\r\n"
+    "-----END CERTIFICATE-----\r\n"
+    /* DigiCert Global Root CA */
+    "-----BEGIN CERTIFICATE-----\r\n"
+    "MIIDrzCCApegAwIBAgIQCDvgVpBCRrGhdWrJWZHHSjANBgkqhkiG9w0BAQUFADBh\r\n"
+    "MQswCQYDVQQGEwJVUzEVMBMGA1UEChMMRGlnaUNlcnQgSW5jMRkwFwYDVQQLExB3\r\n"
+    "d3cuZGlnaWNlcnQuY29tMSAwHgYDVQQDExdEaWdpQ2VydCBHbG9iYWwgUm9vdCBD\r\n"
+    "QTAeFw0wNjExMTAwMDAwMDBaFw0zMTExMTAwMDAwMDBaMGExCzAJBgNVBAYTAlVT\r\n"
+    "MRUwEwYDVQQKEwxEaWdpQ2VydCBJbmMxGTAXBgNVBAsTEHd3dy5kaWdpY2VydC5j\r\n"
+    "b20xIDAeBgNVBAMTF0RpZ2lDZXJ0IEdsb2JhbCBSb290IENBMIIBIjANBgkqhkiG\r\n"
+    "9w0BAQEFAAOCAQ8AMIIBCgKCAQEA4jvhEXLeqKTTo1eqUKKPC3eQyaKl7hLOllsB\r\n"
+    "CSDMAZOnTjC3U/dDxGkAV53ijSLdhwZAAIEJzs4bg7/fzTtxRuLWZscFs3YnFo97\r\n"
+    "nh6Vfe63SKMI2tavegw5BmV/Sl0fvBf4q77uKNd0f3p4mVmFaG5cIzJLv07A6Fpt\r\n"
+    "43C/dxC//AH2hdmoRBBYMql1GNXRor5H4idq9Joz+EkIYIvUX7Q6hL+hqkpMfT7P\r\n"
+    "T19sdl6gSzeRntwi5m3OFBqOasv+zbMUZBfHWymeMr/y7vrTC0LUq7dBMtoM1O/4\r\n"
+    "gdW7jVg/tRvoSSiicNoxBN33shbyTApOB6jtSj1etX+jkMOvJwIDAQABo2MwYTAO\r\n"
+    "BgNVHQ8BAf8EBAMCAYYwDwYDVR0TAQH/BAUwAwEB/zAdBgNVHQ4EFgQUA95QNVbR\r\n"
+    "TLtm8KPiGxvDl7I90VUwHwYDVR0jBBgwFoAUA95QNVbRTLtm8KPiGxvDl7I90VUw\r\n"
+    "DQYJKoZIhvcNAQEFBQADggEBAMucN6pIExIK+t1EnE9SsPTfrgT1eXkIoyQY/Esr\r\n"
+    "hMAtudXH/vTBH1jLuG2cenTnmCmrEbXjcKChzUyImZOMkXDiqw8cvpOp/2PV5Adg\r\n"
+    "06O/nVsJ8dWO41P0jmP6P6fbtGbfYmbW0W5BjfIttep3Sp+dWOIrWcBAI+0tKIJF\r\n"
+    "PnlUkiaY4IBIqDfv8NZ5YBberOgOzW6sRBc4L0na4UU+Krk2U886UAb3LujEV0ls\r\n"
+    "YSEY1QSteDwsOoBrp+uvFRTp2InBuThs4pFsiv9kuXclVzDAGySj4dzp30d8tbQk\r\n"
+    "CAUw7C29C79Fv1C5qfPrmAESrciIxpg0X40KPMbp1ZWVbd4=\r\n"
+    "-----END CERTIFICATE-----\r\n"
+    /* D-TRUST Root Class 3 CA 2 2009 */
+    "-----BEGIN CERTIFICATE-----\r\n"
+    "MIIEMzCCAxugAwIBAgIDCYPzMA0GCSqGSIb3DQEBCwUAME0xCzAJBgNVBAYTAkRF\r\n"
+    "MRUwEwYDVQQKDAxELVRydXN0IEdtYkgxJzAlBgNVBAMMHkQtVFJVU1QgUm9vdCBD\r\n"
+    "bGFzcyAzIENBIDIgMjAwOTAeFw0wOTExMDUwODM1NThaFw0yOTExMDUwODM1NTha\r\n"
+    "ME0xCzAJBgNVBAYTAkRFMRUwEwYDVQQKDAxELVRydXN0IEdtYkgxJzAlBgNVBAMM\r\n"
+    "HkQtVFJVU1QgUm9vdCBDbGFzcyAzIENBIDIgMjAwOTCCASIwDQYJKoZIhvcNAQEB\r\n"
+    "BQADggEPADCCAQoCggEBANOySs96R+91myP6Oi/WUEWJNTrGa9v+2wBoqOADER03\r\n"
+    "UAifTUpolDWzU9GUY6cgVq/eUXjsKj3zSEhQPgrfRlWLJ23DEE0NkVJD2IfgXU42\r\n"
+    "tSHKXzlABF9bfsyjxiupQB7ZNoTWSPOSHjRGICTBpFGOShrvUD9pXRl/RcPHAY9R\r\n"
+    "ySPocq60vFYJfxLLHLGvKZAKyVXMD9O0Gu1HNVpK7ZxzBCHQqr0ME7UAyiZsxGsM\r\n"
+    "lFqVlNpQmvH/pStmMaTJOKDfHR+4CS7zp+hnUquVH+BGPtikw8paxTGA6Eian5Rp\r\n"
+    "/hnd2HN8gcqW3o7tszIFZYQ05ub9VxC1X3a/L7AQDcUCAwEAAaOCARowggEWMA8G\r\n"
+    "A1UdEwEB/wQFMAMBAf8wHQYDVR0OBBYEFP3aFMSfMN4hvR5COfyrYyNJ4PGEMA4G\r\n"
+    "A1UdDwEB/wQEAwIBBjCB0wYDVR0fBIHLMIHIMIGAoH6gfIZ6bGRhcDovL2RpcmVj\r\n"
+    "dG9yeS5kLXRydXN0Lm5ldC9DTj1ELVRSVVNUJTIwUm9vdCUyMENsYXNzJTIwMyUy\r\n"
+    "MENBJTIwMiUyMDIwMDksTz1ELVRydXN0JTIwR21iSCxDPURFP2NlcnRpZmljYXRl\r\n"
+    "cmV2b2NhdGlvbmxpc3QwQ6BBoD+GPWh0dHA6Ly93d3cuZC10cnVzdC5uZXQvY3Js\r\n"
+    "L2QtdHJ1c3Rfcm9vdF9jbGFzc18zX2NhXzJfMjAwOS5jcmwwDQYJKoZIhvcNAQEL\r\n"
+    "BQADggEBAH+X2zDI36ScfSF6gHDOFBJpiBSVYEQBrLLpME+bUMJm2H6NMLVwMeni\r\n"
+    "acfzcNsgFYbQDfC+rAF1hM5+n02/t2A7nPPKHeJeaNijnZflQGDSNiH+0LS4F9p0\r\n"
+    "o3/U37CYAqxva2ssJSRyoWXuJVrl5jLn8t+rSfrzkGkj2wTZ51xY/GXUl77M/C4K\r\n"
+    "zCUqNQT4YJEVdT1B/yMfGchs64JTBKbkTCJNjYy6zltz7GRUUG3RnFX7acM2w4y8\r\n"
+    "PIWmawomDeCTmGCufsYkl4phX5GOZpIJhzbNi5stPvZR1FDUWSi9g/LMKHtThm3Y\r\n"
+    "Johw1+qRzT65ysCQblrGXnRl11z+o+I=\r\n"
+    "-----END CERTIFICATE-----\r\n";
+
+#if (defined(IOT_CENTRAL_APPLICATION) || defined(IOT_HUB_APPLICATION)) && \
+    !defined(AZURE_IOT_FAKE_HUB)
+#define MAXS_SIZE 512
+// Verify that the connection string is not too long
+_Static_assert(sizeof(connectionString) <= MAXS_SIZE, "Connection string too long");
+// Verify tthat the connection string is defined
+_Static_assert(sizeof(connectionString) > 1, "Connection string not defined! Define MY_CONNECTION_STRING in connection_strings.h");
+#endif
+
+/// <summary>
+///     Converts the SDK message to the transport independent message callback.
+/// </summary>
+static IOTHUBMESSAGE_DISPOSITION_RESULT receiveMessageCallback(IOTHUB_MESSAGE_HANDLE message,
+                                                               void *context)
+{
+    const unsigned char *buffer = NULL;
+    size_t size = 0;
+    if (IoTHubMessage_GetByteArray(message, &buffer, &size) != IOTHUB_MESSAGE_OK) {
+        Log_Debug("[Azure IoT Hub client] WARNING: failure performing IoTHubMessage_GetByteArray\n");
+        return IOTHUBMESSAGE_REJECTED;
+    }
+    return transportCallbacks->messageReceived(buffer, size);
+}
+
+/// <summary>
+///     Creates the IoT Hub client. The client is setup with the following options:
+///     - IOTHUB_CLIENT_RETRY_IMMEDIATE retry policy, the SDK reconnects whenever DoWork is
+///       called while disconnected; the connection cannot be held, so the caller paces
+///       reconnection by not calling DoWork during its backoff delay. The client is kept
+///       across reconnections, yet each one is a full TLS handshake and authentication, the
+///       SDK offers no TLS session resumption;
+///     - MQTT procotol 'keepalive' value of 20 seconds;
+///     - trusted root certificates.
+/// </summary>
+static bool sdkCreate(const AzureIoT_TransportCallbacks *callbacks)
+{
+    transportCallbacks = callbacks;
+    iothubClientHandle =
+        IoTHubDeviceClient_LL_CreateFromConnectionString(connectionString, MQTT_Protocol);
+
+    if (iothubClientHandle == NULL) {
+        return false;
+    }
+
+    if (IoTHubDeviceClient_LL_SetOption(iothubClientHandle, "TrustedCerts",
+                                        azureIoTCertificatesX) != IOTHUB_CLIENT_OK) {
+        Log_Debug("[Azure IoT Hub client] ERROR: failure to set option \"TrustedCerts\"\n");
+        return false;
+    }
+
+    if (IoTHubDeviceClient_LL_SetOption(iothubClientHandle, OPTION_KEEP_ALIVE,
+                                        &keepalivePeriodSeconds) != IOTHUB_CLIENT_OK) {
+        Log_Debug("[Azure IoT Hub client] ERROR: failure setting option \"%s\"\n",
+                  OPTION_KEEP_ALIVE);
+        return false;
+    }
+
+    // Set callbacks for Message, MethodCall and Device Twin features.
+    IoTHubDeviceClient_LL_SetMessageCallback(iothubClientHandle, receiveMessageCallback, NULL);
+    IoTHubDeviceClient_LL_SetDeviceMethodCallback(iothubClientHandle, callbacks->directMethod,
+                                                  NULL);
+    IoTHubDeviceClient_LL_SetDeviceTwinCallback(iothubClientHandle, callbacks->twinUpdate, NULL);
+
+    // Set callbacks for connection status related events.
+    if (IoTHubDeviceClient_LL_SetConnectionStatusCallback(
+            iothubClientHandle, callbacks->connectionStatus, NULL) != IOTHUB_CLIENT_OK) {
+        Log_Debug("[Azure IoT Hub client] ERROR: failure setting callback\n");
+        return false;
+    }
+
+    // Set retry policy for the connection to the IoT Hub.
+    if (IoTHubDeviceClient_LL_SetRetryPolicy(iothubClientHandle, IOTHUB_CLIENT_RETRY_IMMEDIATE,
+                                             retryTimeoutSeconds) != IOTHUB_CLIENT_OK) {
+        Log_Debug("[Azure IoT Hub client] ERROR: failure setting retry policy\n");
+        return false;
+    }
+
+    return true;
+}
+
+/// <summary>
+///     Destroys the IoT Hub client.
+/// </summary>
+static void sdkDestroy(void)
+{
+    if (iothubClientHandle != NULL) {
+        IoTHubDeviceClient_LL_Destroy(iothubClientHandle);
+        iothubClientHandle = NULL;
+    }
+}
+
+/// <summary>
+///     Creates an IoTHubMessage and hands it over to the client.
+/// </summary>
+static bool sdkSendEvent(const char *payload, const char *messageId, void *context)
+{
+    if (iothubClientHandle == NULL) {
+        return false;
+    }
+
+    IOTHUB_MESSAGE_HANDLE messageHandle = IoTHubMessage_CreateFromString(payload);
+    if (messageHandle == 0) {
+        Log_Debug("[Azure IoT Hub client] WARNING: unable to create a new IoTHubMessage\n");
+        return false;
+    }
+
+    // The message id lets the cloud side correlate messages and drop duplicates caused
+    // by retries.
+    if (IoTHubMessage_SetMessageId(messageHandle, messageId) != IOTHUB_MESSAGE_OK ||
+        IoTHubMessage_SetProperty(messageHandle, "seq", messageId) != IOTHUB_MESSAGE_OK) {
+        Log_Debug("[Azure IoT Hub client] WARNING: unable to set id of message %s\n", messageId);
+    }
+
+    bool accepted =
+        (IoTHubDeviceClient_LL_SendEventAsync(iothubClientHandle, messageHandle,
+                                              transportCallbacks->sendConfirmation,
+                                              context) == IOTHUB_CLIENT_OK);
+
+    IoTHubMessage_Destroy(messageHandle);
+    return accepted;
+}
+
+/// <summary>
+///     Hands a reported properties update over to the client.
+/// </summary>
+static bool sdkSendReportedState(const unsigned char *json, size_t size, void *context)
+{
+    if (iothubClientHandle == NULL) {
+        return false;
+    }
+
+    return IoTHubDeviceClient_LL_SendReportedState(
+               iothubClientHandle, json, size, transportCallbacks->reportedStateConfirmation,
+               context) == IOTHUB_CLIENT_OK;
+}
+
+/// <summary>
+///     Sends some of the buffered events to the IoT Hub, and receives some of the buffered
+///     events from the IoT Hub.
+/// </summary>
+static void sdkDoWork(void)
+{
+    if (iothubClientHandle != NULL) {
+        IoTHubDeviceClient_LL_DoWork(iothubClientHandle);
+    }
+}
+
+const AzureIoT_Transport AzureIoT_SdkTransport = {
+    .name = "IoTHubClient",
+    .create = sdkCreate,
+    .destroy = sdkDestroy,
+    .sendEvent = sdkSendEvent,
+    .sendReportedState = sdkSendReportedState,
+    .doWork = sdkDoWork,
+    .holdConnection = NULL,
+};
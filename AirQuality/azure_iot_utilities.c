@@ -2,36 +2,17 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
 #include <time.h>
 #include <azureiot/iothub_client_core_common.h>
-#include <azureiot/iothub_client_options.h>
-#include <azureiot/iothubtransportmqtt.h>
 #include <azureiot/iothub.h>
 #include <applibs/log.h>
 #include "azure_iot_utilities.h"
+#include "azure_iot_transport.h"
+#include "backoff.h"
 #include "build_options.h"
-#include "connection_strings.h"
-
-
-// Refer to https://docs.microsoft.com/en-us/azure/iot-hub/iot-hub-device-sdk-c-intro for more
-// information on Azure IoT SDK for C
-
-//
-// String containing Hostname, Device Id & Device Key in the format:
-// "HostName=<host_name>;DeviceId=<device_id>;SharedAccessKey=<device_key>"
-
-// see information on iothub-explorer at http://aka.ms/iothubgetstartedVSCS
-//
-
-#include "connection_strings.h"
-
-static const char connectionString[] = MY_CONNECTION_STRING;
-
-/// <summary>
-///     Maximum amount of time to attempt reconnection when the connection to the IoT Hub drops.
-/// </summary>
-/// <remarks>Time expressed in seconds. A value of 0 means to retry forever.</remarks>
-static const size_t retryTimeoutSeconds = 0;
+#include "log_ring.h"
+#include "scratch_buffer.h"
 
 /// <summary>
 ///     Function invoked to provide the result of the Device Twin reported properties
@@ -49,6 +30,11 @@ static DirectMethodCallFnType directMethodCallCb = 0;
 /// </summary>
 static TwinUpdateFnType twinUpdateCb = 0;
 
+/// <summary>
+///     Function invoked with the payload of every Device Twin update, without copying it.
+/// </summary>
+static TwinUpdateBufferFnType twinUpdateBufferCb = 0;
+
 /// <summary>
 ///     Function invoked whenever the connection status to the IoT Hub changes.
 /// </summary>
@@ -59,6 +45,12 @@ static ConnectionStatusFnType hubConnectionStatusCb = 0;
 /// </summary>
 static MessageReceivedFnType messageReceivedCb = 0;
 
+/// <summary>
+///     Function invoked with the payload of every message received from the IoT Hub, without
+///     copying it.
+/// </summary>
+static MessageReceivedBufferFnType messageReceivedBufferCb = 0;
+
 /// <summary>
 ///     Function invoked to report the delivery confirmation of a message sent to the IoT
 ///     Hub.
@@ -66,95 +58,220 @@ static MessageReceivedFnType messageReceivedCb = 0;
 static MessageDeliveryConfirmationFnType messageDeliveryConfirmationCb = 0;
 
 /// <summary>
-///     The handle to the IoT Hub client used for communication with the hub.
-/// </summary>
-IOTHUB_DEVICE_CLIENT_LL_HANDLE iothubClientHandle = NULL;
-
-/// <summary>
-///     Used to set the keepalive period over MQTT to 20 seconds.
-/// </summary>
-static int keepalivePeriodSeconds = 20;
-
-/// <summary>
-///     Set of bundle of root certificate authorities.
-/// </summary>
-static const char azureIoTCertificatesX[] =
-    /* DigiCert Baltimore Root */
-    "-----BEGIN CERTIFICATE-----\r\n"
-    "MIIDdzCCAl+gAwIBAgIEAgAAuTANBgkqhkiG9w0BAQUFADBaMQswCQYDVQQGEwJJ\r\n"
-    "RTESMBAGA1UEChMJQmFsdGltb3JlMRMwEQYDVQQLEwpDeWJlclRydXN0MSIwIAYD\r\n"
-    "VQQDExlCYWx0aW1vcmUgQ3liZXJUcnVzdCBSb290MB4XDTAwMDUxMjE4NDYwMFoX\r\n"
-    "DTI1MDUxMjIzNTkwMFowWjELMAkGA1UEBhMCSUUxEjAQBgNVBAoTCUJhbHRpbW9y\r\n"
-    "ZTETMBEGA1UECxMKQ3liZXJUcnVzdDEiMCAGA1UEAxMZQmFsdGltb3JlIEN5YmVy\r\n"
-    "VHJ1c3QgUm9vdDCCASIwDQYJKoZIhvcNAQEBBQADggEPADCCAQoCggEBAKMEuyKr\r\n"
-    "mD1X6CZymrV51Cni4eiVgLGw41uOKymaZN+hXe2wCQVt2yguzmKiYv60iNoS6zjr\r\n"
-    "IZ3AQSsBUnuId9Mcj8e6uYi1agnnc+gRQKfRzMpijS3ljwumUNKoUMMo6vWrJYeK\r\n"
-    "mpYcqWe4PwzV9/lSEy/CG9VwcPCPwBLKBsua4dnKM3p31vjsufFoREJIE9LAwqSu\r\n"
-    "XmD+tqYF/LTdB1kC1FkYmGP1pWPgkAx9XbIGevOF6uvUA65ehD5f/xXtabz5OTZy\r\n"
-    "dc93Uk3zyZAsuT3lySNTPx8kmCFcB5kpvcY67Oduhjprl3RjM71oGDHweI12v/ye\r\n"
-    "jl0qhqdNkNwnGjkCAwEAAaNFMEMwHQYDVR0OBBYEFOWdWTCCR1jMrPoIVDaGezq1\r\n"
-    "BE3wMBIGA1UdEwEB/wQIMAYBAf8CAQMwDgYDVR0PAQH/BAQDAgEGMA0GCSqGSIb3\r\n"
-    "DQEBBQUAA4IBAQCFDF2O5G9RaEIFoN27TyclhAO992T9Ldcw46QQF+vaKSm2eT92\r\n"
-    "9hkTI7gQCvlYpNRhcL0EYWoSihfVCr3FvDB81ukMJY2GQE/szKN+OMY3EU/t3Wgx\r\n"
-    "jkzSswF07r51XgdIGn9w/xZchMB5hbgF/X++ZRGjD8ACtPhSNzkE1akxehi/oCr0\r\n"
-    "Epn3o0WC4zxe9Z2etciefC7IpJ5OCBRLbf1wbWsaY71k5h+3zvDyny67G7fyUIhz\r\n"
-    "ksLi4xaNmjICq44Y3ekQEe5+NauQrz4wlHrQMz2nZQ/1/I6eYs9HRCwBXbsdtTLS\r\n"
-    "R9I4LtD+gdwyah617jzV/OeBHRnDJELqYzmp\r\n"
-    "-----END CERTIFICATE-----\r\n"
-    /* DigiCert Global Root CA */
-    "-----BEGIN CERTIFICATE-----\r\n"
-    "MIIDrzCCApegAwIBAgIQCDvgVpBCRrGhdWrJWZHHSjANBgkqhkiG9w0BAQUFADBh\r\n"
-    "MQswCQYDVQQGEwJVUzEVMBMGA1UEChMMRGlnaUNlcnQgSW5jMRkwFwYDVQQLExB3\r\n"
-    "d3cuZGlnaWNlcnQuY29tMSAwHgYDVQQDExdEaWdpQ2VydCBHbG9iYWwgUm9vdCBD\r\n"
-    "QTAeFw0wNjExMTAwMDAwMDBaFw0zMTExMTAwMDAwMDBaMGExCzAJBgNVBAYTAlVT\r\n"
-    "MRUwEwYDVQQKEwxEaWdpQ2VydCBJbmMxGTAXBgNVBAsTEHd3dy5kaWdpY2VydC5j\r\n"
-    "b20xIDAeBgNVBAMTF0RpZ2lDZXJ0IEdsb2JhbCBSb290IENBMIIBIjANBgkqhkiG\r\n"
-    "9w0BAQEFAAOCAQ8AMIIBCgKCAQEA4jvhEXLeqKTTo1eqUKKPC3eQyaKl7hLOllsB\r\n"
-    "CSDMAZOnTjC3U/dDxGkAV53ijSLdhwZAAIEJzs4bg7/fzTtxRuLWZscFs3YnFo97\r\n"
-    "nh6Vfe63SKMI2tavegw5BmV/Sl0fvBf4q77uKNd0f3p4mVmFaG5cIzJLv07A6Fpt\r\n"
-    "43C/dxC//AH2hdmoRBBYMql1GNXRor5H4idq9Joz+EkIYIvUX7Q6hL+hqkpMfT7P\r\n"
-    "T19sdl6gSzeRntwi5m3OFBqOasv+zbMUZBfHWymeMr/y7vrTC0LUq7dBMtoM1O/4\r\n"
-    "gdW7jVg/tRvoSSiicNoxBN33shbyTApOB6jtSj1etX+jkMOvJwIDAQABo2MwYTAO\r\n"
-    "BgNVHQ8BAf8EBAMCAYYwDwYDVR0TAQH/BAUwAwEB/zAdBgNVHQ4EFgQUA95QNVbR\r\n"
-    "TLtm8KPiGxvDl7I90VUwHwYDVR0jBBgwFoAUA95QNVbRTLtm8KPiGxvDl7I90VUw\r\n"
-    "DQYJKoZIhvcNAQEFBQADggEBAMucN6pIExIK+t1EnE9SsPTfrgT1eXkIoyQY/Esr\r\n"
-    "hMAtudXH/vTBH1jLuG2cenTnmCmrEbXjcKChzUyImZOMkXDiqw8cvpOp/2PV5Adg\r\n"
-    "06O/nVsJ8dWO41P0jmP6P6fbtGbfYmbW0W5BjfIttep3Sp+dWOIrWcBAI+0tKIJF\r\n"
-    "PnlUkiaY4IBIqDfv8NZ5YBberOgOzW6sRBc4L0na4UU+Krk2U886UAb3LujEV0ls\r\n"
-    "YSEY1QSteDwsOoBrp+uvFRTp2InBuThs4pFsiv9kuXclVzDAGySj4dzp30d8tbQk\r\n"
-    "CAUw7C29C79Fv1C5qfPrmAESrciIxpg0X40KPMbp1ZWVbd4=\r\n"
-    "-----END CERTIFICATE-----\r\n"
-    /* D-TRUST Root Class 3 CA 2 2009 */
-    "-----BEGIN CERTIFICATE-----\r\n"
-    "MIIEMzCCAxugAwIBAgIDCYPzMA0GCSqGSIb3DQEBCwUAME0xCzAJBgNVBAYTAkRF\r\n"
-    "MRUwEwYDVQQKDAxELVRydXN0IEdtYkgxJzAlBgNVBAMMHkQtVFJVU1QgUm9vdCBD\r\n"
-    "bGFzcyAzIENBIDIgMjAwOTAeFw0wOTExMDUwODM1NThaFw0yOTExMDUwODM1NTha\r\n"
-    "ME0xCzAJBgNVBAYTAkRFMRUwEwYDVQQKDAxELVRydXN0IEdtYkgxJzAlBgNVBAMM\r\n"
-    "HkQtVFJVU1QgUm9vdCBDbGFzcyAzIENBIDIgMjAwOTCCASIwDQYJKoZIhvcNAQEB\r\n"
-    "BQADggEPADCCAQoCggEBANOySs96R+91myP6Oi/WUEWJNTrGa9v+2wBoqOADER03\r\n"
-    "UAifTUpolDWzU9GUY6cgVq/eUXjsKj3zSEhQPgrfRlWLJ23DEE0NkVJD2IfgXU42\r\n"
-    "tSHKXzlABF9bfsyjxiupQB7ZNoTWSPOSHjRGICTBpFGOShrvUD9pXRl/RcPHAY9R\r\n"
-    "ySPocq60vFYJfxLLHLGvKZAKyVXMD9O0Gu1HNVpK7ZxzBCHQqr0ME7UAyiZsxGsM\r\n"
-    "lFqVlNpQmvH/pStmMaTJOKDfHR+4CS7zp+hnUquVH+BGPtikw8paxTGA6Eian5Rp\r\n"
-    "/hnd2HN8gcqW3o7tszIFZYQ05ub9VxC1X3a/L7AQDcUCAwEAAaOCARowggEWMA8G\r\n"
-    "A1UdEwEB/wQFMAMBAf8wHQYDVR0OBBYEFP3aFMSfMN4hvR5COfyrYyNJ4PGEMA4G\r\n"
-    "A1UdDwEB/wQEAwIBBjCB0wYDVR0fBIHLMIHIMIGAoH6gfIZ6bGRhcDovL2RpcmVj\r\n"
-    "dG9yeS5kLXRydXN0Lm5ldC9DTj1ELVRSVVNUJTIwUm9vdCUyMENsYXNzJTIwMyUy\r\n"
-    "MENBJTIwMiUyMDIwMDksTz1ELVRydXN0JTIwR21iSCxDPURFP2NlcnRpZmljYXRl\r\n"
-    "cmV2b2NhdGlvbmxpc3QwQ6BBoD+GPWh0dHA6Ly93d3cuZC10cnVzdC5uZXQvY3Js\r\n"
-    "L2QtdHJ1c3Rfcm9vdF9jbGFzc18zX2NhXzJfMjAwOS5jcmwwDQYJKoZIhvcNAQEL\r\n"
-    "BQADggEBAH+X2zDI36ScfSF6gHDOFBJpiBSVYEQBrLLpME+bUMJm2H6NMLVwMeni\r\n"
-    "acfzcNsgFYbQDfC+rAF1hM5+n02/t2A7nPPKHeJeaNijnZflQGDSNiH+0LS4F9p0\r\n"
-    "o3/U37CYAqxva2ssJSRyoWXuJVrl5jLn8t+rSfrzkGkj2wTZ51xY/GXUl77M/C4K\r\n"
-    "zCUqNQT4YJEVdT1B/yMfGchs64JTBKbkTCJNjYy6zltz7GRUUG3RnFX7acM2w4y8\r\n"
-    "PIWmawomDeCTmGCufsYkl4phX5GOZpIJhzbNi5stPvZR1FDUWSi9g/LMKHtThm3Y\r\n"
-    "Johw1+qRzT65ysCQblrGXnRl11z+o+I=\r\n"
-    "-----END CERTIFICATE-----\r\n";
+///     Size of the message slot table, the upper limit of messages in flight.
+/// </summary>
+#define MESSAGE_SLOT_COUNT 16
+
+/// <summary>
+///     Tracked message. The slot address is the confirmation context passed to the SDK.
+/// </summary>
+typedef struct {
+    bool inUse;
+    bool awaitingConfirmation;
+    bool priority;
+    uint8_t attempts;
+    uint32_t sequence;
+    struct timespec queuedTime;
+    struct timespec lastAttemptTime;
+    char *payload;
+} MessageSlot;
+
+/// <summary>
+///     Number of hand overs of a message before it is dropped.
+/// </summary>
+static const unsigned int maxDeliveryAttempts = 3;
+
+/// <summary>
+///     Minimum delay between two hand overs of the same message.
+/// </summary>
+static const long messageRetryDelayMs = 2000;
+
+/// <summary>
+///     Reconnection delay, drawn from [0, min(5 min, 1 s * 2^failures)].
+/// </summary>
+static const uint32_t reconnectBackoffBaseMs = 1000;
+static const uint32_t reconnectBackoffCapMs = 5 * 60 * 1000;
+
+/// <summary>
+///     DoWork period during backoff, the transport holds the connection meanwhile.
+/// </summary>
+static const uint32_t backoffDoWorkPeriodMs = 1000;
+
+/// <summary>
+///     Upper bound of the random delay before the first connection attempt.
+/// </summary>
+static const uint32_t startupJitterMs = 5000;
+
+/// <summary>
+///     A connection attempt not completed in this time is treated as failed.
+/// </summary>
+static const uint32_t connectTimeoutMs = 30000;
+
+/// <summary>
+///     Minimum interval between hand overs of buffered messages after reconnection, limits
+///     the load on the IoT Hub when a whole fleet comes back at once.
+/// </summary>
+static const uint32_t drainIntervalMs = 250;
+
+/// <summary>
+///     Maximum number of distinct reported properties held in the reported properties cache.
+/// </summary>
+#define REPORTED_PROPERTY_MAX_COUNT 16
+#define REPORTED_PROPERTY_NAME_SIZE 32
+/// <summary>
+///     Longest value, e.g. the start up milestones object of up to 99 characters.
+/// </summary>
+#define REPORTED_PROPERTY_VALUE_SIZE 128
+#define REPORTED_BATCH_SIZE 1024
+
+/// <summary>
+///     Reported properties cache entry. Tracks the value last acknowledged by the IoT Hub,
+///     the value being delivered and the newest value waiting to be sent.
+/// </summary>
+typedef struct {
+    char name[REPORTED_PROPERTY_NAME_SIZE];
+    char ackedValue[REPORTED_PROPERTY_VALUE_SIZE];
+    char inFlightValue[REPORTED_PROPERTY_VALUE_SIZE];
+    char pendingValue[REPORTED_PROPERTY_VALUE_SIZE];
+    bool acked;
+    bool inFlight;
+    bool pending;
+} ReportedProperty;
+
+/// <summary>
+///     Pending changes are coalesced for this long before being sent in one update.
+/// </summary>
+static const unsigned int reportedCoalesceWindowMs = 2000;
+
+/// <summary>
+///     Retry delay after a rejected reported properties update, doubled on each failure.
+/// </summary>
+static const unsigned int reportedRetryDelayMinMs = 5000;
+static const unsigned int reportedRetryDelayMaxMs = 5 * 60 * 1000;
+
+/// <summary>
+///     State of one client, see AzureIoT_SelectClientState().
+/// </summary>
+struct AzureIoT_ClientState {
+    /// <summary>
+    ///     Zero terminated copies of received payloads for the MessageReceivedFnType and
+    ///     TwinUpdateFnType callbacks. The buffer is kept between payloads and freed with the
+    ///     client. The limit matches the maximum size of the desired properties of a Device
+    ///     Twin.
+    /// </summary>
+    scratch_buffer_t receiveScratch;
+
+    /// <summary>
+    ///     Transport used to communicate with the hub, see azure_iot_transport.h.
+    /// </summary>
+    const AzureIoT_Transport *transport;
+
+    /// <summary>
+    ///     'true' while the transport holds a client.
+    /// </summary>
+    bool clientCreated;
+
+    MessageSlot messageSlots[MESSAGE_SLOT_COUNT];
+
+    /// <summary>
+    ///     Maximum number of messages buffered and not yet confirmed.
+    /// </summary>
+    unsigned int maxInFlightMessages;
+
+    /// <summary>
+    ///     Sequence number of the next message, monotonic for the lifetime of the application.
+    /// </summary>
+    uint32_t nextMessageSequence;
+
+    /// <summary>
+    ///     Message delivery counters and latency histogram.
+    /// </summary>
+    AzureIoT_MessageStats messageStats;
+
+    /// <summary>
+    ///     Connection state machine, see AzureIoT_ConnectionState.
+    /// </summary>
+    AzureIoT_ConnectionState connectionState;
+    struct timespec connectionStateTime;
+
+    /// <summary>
+    ///     Delay of the current backoff state.
+    /// </summary>
+    uint32_t backoffDelayMs;
+
+    /// <summary>
+    ///     Time of the last DoWork during backoff.
+    /// </summary>
+    struct timespec backoffDoWorkTime;
+
+    backoff_t reconnectBackoff;
+
+    /// <summary>
+    ///     Time the established connection was lost, valid while wasConnected is 'true'.
+    /// </summary>
+    struct timespec disconnectedTime;
+    bool wasConnected;
+
+    /// <summary>
+    ///     Messages up to this sequence number were buffered while offline.
+    /// </summary>
+    uint32_t drainLastSequence;
+    struct timespec lastDrainHandOverTime;
+
+    AzureIoT_ConnectionStats connectionStats;
+
+    ReportedProperty reportedProperties[REPORTED_PROPERTY_MAX_COUNT];
+    size_t reportedPropertyCount;
+
+    /// <summary>
+    ///     'true' while a reported properties batch awaits confirmation from the IoT Hub.
+    /// </summary>
+    bool reportedBatchInFlight;
+
+    /// <summary>
+    ///     Time the oldest pending reported property change has been queued.
+    /// </summary>
+    struct timespec reportedPendingSince;
+
+    /// <summary>
+    ///     Current retry delay of reported properties updates, 0 after an accepted one.
+    /// </summary>
+    unsigned int reportedRetryDelayMs;
+};
+
+/// <summary>
+///     Transport of a new client state, selected at build time.
+/// </summary>
+#ifdef AZURE_IOT_FAKE_HUB
+#define DEFAULT_TRANSPORT (&AzureIoT_FakeHubTransport)
+#else
+#define DEFAULT_TRANSPORT (&AzureIoT_SdkTransport)
+#endif
+
+#define CLIENT_STATE_INIT                                                                      \
+    {                                                                                          \
+        .receiveScratch = SCRATCH_BUFFER_INIT(32 * 1024 + 1), .transport = DEFAULT_TRANSPORT,  \
+        .maxInFlightMessages = 8, .nextMessageSequence = 1,                                    \
+        .messageStats = {.latencyMs = {.min = UINT32_MAX}},                                    \
+        .connectionState = AzureIoT_ConnectionState_Idle,                                      \
+        .connectionStats = {.reconnectMs = {.min = UINT32_MAX},                                \
+                            .drainMs = {.min = UINT32_MAX}},                                   \
+    }
+
+/// <summary>
+///     State of the application client.
+/// </summary>
+static AzureIoT_ClientState defaultClient = CLIENT_STATE_INIT;
+
+/// <summary>
+///     State the functions of this module act upon in the calling thread.
+/// </summary>
+static _Thread_local AzureIoT_ClientState *client = &defaultClient;
 
 // Forward declarations.
 static void sendMessageCallback(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void *context);
-static IOTHUBMESSAGE_DISPOSITION_RESULT receiveMessageCallback(IOTHUB_MESSAGE_HANDLE message,
-                                                               void *context);
+static IOTHUBMESSAGE_DISPOSITION_RESULT receiveMessageCallback(const unsigned char *payload,
+                                                               size_t size);
 static void twinCallback(DEVICE_TWIN_UPDATE_STATE updateState, const unsigned char *payLoad,
                          size_t size, void *userContextCallback);
 static int directMethodCallback(const char *methodName, const unsigned char *payload, size_t size,
@@ -163,21 +280,81 @@ static int directMethodCallback(const char *methodName, const unsigned char *pay
 static void hubConnectionStatusCallback(IOTHUB_CLIENT_CONNECTION_STATUS result,
                                         IOTHUB_CLIENT_CONNECTION_STATUS_REASON reason,
                                         void *userContextCallback);
+static void reportStatusCallback(int result, void *context);
+static void flushReportedProperties(void);
+static void retryPendingMessages(void);
 
-#if (defined(IOT_CENTRAL_APPLICATION) || defined(IOT_HUB_APPLICATION))
-#define MAXS_SIZE 512
-// Verify that the connection string is not too long
-_Static_assert(sizeof(connectionString) <= MAXS_SIZE, "Connection string too long");
-// Verify tthat the connection string is defined
-_Static_assert(sizeof(connectionString) > 1, "Connection string not defined! Define MY_CONNECTION_STRING in connection_strings.h");
-#endif
+/// <summary>
+///     Callbacks handed to the transport.
+/// </summary>
+static const AzureIoT_TransportCallbacks transportCallbacks = {
+    .sendConfirmation = sendMessageCallback,
+    .messageReceived = receiveMessageCallback,
+    .twinUpdate = twinCallback,
+    .directMethod = directMethodCallback,
+    .reportedStateConfirmation = reportStatusCallback,
+    .connectionStatus = hubConnectionStatusCallback,
+};
+
+/// <summary>
+///     Reads the monotonic clock used for all relative timing in this module.
+/// </summary>
+static void getMonotonicTime(struct timespec *ts)
+{
+    clock_gettime(CLOCK_MONOTONIC, ts);
+}
+
+/// <summary>
+///     Returns milliseconds elapsed since the given monotonic time.
+/// </summary>
+static uint32_t elapsedMsSince(const struct timespec *since)
+{
+    struct timespec now;
+    getMonotonicTime(&now);
+    int64_t elapsedMs = (int64_t)(now.tv_sec - since->tv_sec) * 1000 +
+                        (now.tv_nsec - since->tv_nsec) / 1000000;
+    return (elapsedMs < 0) ? 0 : (elapsedMs > UINT32_MAX) ? UINT32_MAX : (uint32_t)elapsedMs;
+}
+
+/// <summary>
+///     Returns 'true' if any reported property is waiting to be sent.
+/// </summary>
+static bool reportedPendingAny(void)
+{
+    for (size_t i = 0; i < client->reportedPropertyCount; i++) {
+        if (client->reportedProperties[i].pending) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// <summary>
+///     Queues the reported property values in flight again, for a batch that has not been sent
+///     or will not be confirmed. Newer values queued meanwhile are kept.
+/// </summary>
+static void requeueReportedInFlight(void)
+{
+    for (size_t i = 0; i < client->reportedPropertyCount; i++) {
+        ReportedProperty *property = &client->reportedProperties[i];
+        if (property->inFlight) {
+            property->inFlight = false;
+            if (!property->pending) {
+                strcpy(property->pendingValue, property->inFlightValue);
+                property->pending = true;
+            }
+        }
+    }
+    client->reportedBatchInFlight = false;
+    getMonotonicTime(&client->reportedPendingSince);
+}
 
 /// <summary>
 ///     Converts the IoT Hub connection status reason to a string.
 /// </summary>
 static const char *getReasonString(IOTHUB_CLIENT_CONNECTION_STATUS_REASON reason)
 {
-    static char *reasonString = "unknown reason";
+    const char *reasonString = "unknown reason";
     switch (reason) {
     case IOTHUB_CLIENT_CONNECTION_EXPIRED_SAS_TOKEN:
         reasonString = "IOTHUB_CLIENT_CONNECTION_EXPIRED_SAS_TOKEN";
@@ -220,104 +397,270 @@ void LogMessage(char *message, ...)
     va_end(args);
 }
 
+/// <summary>
+///     Returns the name of a connection state for log messages.
+/// </summary>
+static const char *getConnectionStateString(AzureIoT_ConnectionState state)
+{
+    switch (state) {
+    case AzureIoT_ConnectionState_Idle:
+        return "idle";
+    case AzureIoT_ConnectionState_Backoff:
+        return "backoff";
+    case AzureIoT_ConnectionState_Connecting:
+        return "connecting";
+    case AzureIoT_ConnectionState_Draining:
+        return "draining";
+    case AzureIoT_ConnectionState_Live:
+        return "live";
+    }
+    return "unknown";
+}
+
+static void setConnectionState(AzureIoT_ConnectionState state)
+{
+    LogMessage("INFO: connection state %s -> %s\n",
+               getConnectionStateString(client->connectionState),
+               getConnectionStateString(state));
+    client->connectionState = state;
+    getMonotonicTime(&client->connectionStateTime);
+}
+
+/// <summary>
+///     Returns 'true' while messages can be handed over to the IoT Hub.
+/// </summary>
+static bool isConnected(void)
+{
+    return client->connectionState == AzureIoT_ConnectionState_Draining ||
+           client->connectionState == AzureIoT_ConnectionState_Live;
+}
+
+/// <summary>
+///     Waits a random delay before the next connection attempt. The transport holds the
+///     connection meanwhile, a transport that cannot hold it does not get DoWork, so it does
+///     not reconnect on its own.
+/// </summary>
+static void enterBackoff(uint32_t delayMs)
+{
+    client->backoffDelayMs = delayMs;
+    LogMessage("INFO: next connection attempt in %lu ms\n", (unsigned long)delayMs);
+    setConnectionState(AzureIoT_ConnectionState_Backoff);
+    getMonotonicTime(&client->backoffDoWorkTime);
+    if (client->transport->holdConnection != NULL) {
+        client->transport->holdConnection(true);
+    }
+}
+
+/// <summary>
+///     Returns 'true' once all messages buffered while offline have left the local buffer.
+/// </summary>
+static bool isDrainComplete(void)
+{
+    for (size_t i = 0; i < MESSAGE_SLOT_COUNT; i++) {
+        if (client->messageSlots[i].inUse &&
+            (int32_t)(client->messageSlots[i].sequence - client->drainLastSequence) <= 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// <summary>
+///     Enters the connected state, draining the local buffer first if it holds messages.
+/// </summary>
+static void onConnected(void)
+{
+    if (client->wasConnected) {
+        uint32_t reconnectMs = elapsedMsSince(&client->disconnectedTime);
+        latency_hist_record(&client->connectionStats.reconnectMs, reconnectMs);
+        LogMessage("INFO: reconnected after %lu ms\n", (unsigned long)reconnectMs);
+    }
+    client->wasConnected = false;
+    backoff_reset(&client->reconnectBackoff);
+
+    client->drainLastSequence = client->nextMessageSequence - 1;
+    if (isDrainComplete()) {
+        setConnectionState(AzureIoT_ConnectionState_Live);
+    } else {
+        LogMessage("INFO: draining %u buffered messages\n", AzureIoT_GetInFlightMessageCount());
+        memset(&client->lastDrainHandOverTime, 0, sizeof(client->lastDrainHandOverTime));
+        setConnectionState(AzureIoT_ConnectionState_Draining);
+    }
+}
+
+/// <summary>
+///     Advances the time driven transitions of the connection state machine.
+/// </summary>
+static void updateConnectionState(void)
+{
+    switch (client->connectionState) {
+    case AzureIoT_ConnectionState_Backoff:
+        if (elapsedMsSince(&client->connectionStateTime) >= client->backoffDelayMs) {
+            client->connectionStats.attempts++;
+            if (client->transport->holdConnection != NULL) {
+                client->transport->holdConnection(false);
+            }
+            setConnectionState(AzureIoT_ConnectionState_Connecting);
+        }
+        break;
+
+    case AzureIoT_ConnectionState_Connecting:
+        if (elapsedMsSince(&client->connectionStateTime) >= connectTimeoutMs) {
+            LogMessage("WARNING: connection attempt timed out\n");
+            client->connectionStats.failures++;
+            enterBackoff(backoff_next(&client->reconnectBackoff));
+        }
+        break;
+
+    case AzureIoT_ConnectionState_Draining:
+        if (isDrainComplete()) {
+            uint32_t drainMs = elapsedMsSince(&client->connectionStateTime);
+            latency_hist_record(&client->connectionStats.drainMs, drainMs);
+            LogMessage("INFO: buffered messages drained in %lu ms\n", (unsigned long)drainMs);
+            setConnectionState(AzureIoT_ConnectionState_Live);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
 /// <summary>
 ///     Sets up the client in order to establish the communication channel to Azure IoT Hub.
 ///
 ///     The client is created by using the IoT Hub connection string that is provisioned
 ///     on the device or hardcoded into the source. The client is setup with the following
 ///     options:
-///     - IOTHUB_CLIENT_RETRY_INTERVAL retry policy which, when the network connection
-///       to the IoT Hub drops, attempts a reconnection each 5 seconds for a period of time
-///       of 5000 seconds before giving up;
+///     - IOTHUB_CLIENT_RETRY_IMMEDIATE retry policy; the timing of connection attempts is
+///       controlled by AzureIoT_DoPeriodicTasks(), which waits a random, exponentially
+///       growing delay after each failure and after losing the connection;
 ///     - MQTT procotol 'keepalive' value of 20 seconds; when no PINGRESP is received after
-///       20 seconds, the connection is believed to be down and the retry policy kicks in;
+///       20 seconds, the connection is believed to be down and the backoff kicks in;
+///
+///     The first connection attempt is delayed by a random time of up to 5 seconds, so that
+///     devices powered up together do not connect at the same moment.
 /// </summary>
 /// <returns>'true' if the client has been properly set up. 'false' when a fatal error occurred
 /// while setting up the client.</returns>
 /// <remarks>This function is a no-op when the client has already been set up, i.e. this
-/// function has already completed successfully.</remarks>
+/// function has already completed successfully. The client is created by the transport
+/// selected at build time or by AzureIoT_SetTransport().</remarks>
 bool AzureIoT_SetupClient(void)
 {
-    if (iothubClientHandle != NULL) {
+    if (client->clientCreated) {
         return true;
     }
 
-    iothubClientHandle =
-        IoTHubDeviceClient_LL_CreateFromConnectionString(connectionString, MQTT_Protocol);
-
-    if (iothubClientHandle == NULL) {
+    if (!client->transport->create(&transportCallbacks)) {
+        LogMessage("ERROR: failure creating %s client\n", client->transport->name);
+        client->transport->destroy();
         return false;
     }
 
-    if (IoTHubDeviceClient_LL_SetOption(iothubClientHandle, "TrustedCerts",
-                                        azureIoTCertificatesX) != IOTHUB_CLIENT_OK) {
-        LogMessage("ERROR: failure to set option \"TrustedCerts\"\n");
-        return false;
-    }
+    client->clientCreated = true;
+
+    // Devices differ in the nanoseconds at which they get here even when powered up at once.
+    struct timespec realTime;
+    struct timespec monotonicTime;
+    clock_gettime(CLOCK_REALTIME, &realTime);
+    getMonotonicTime(&monotonicTime);
+    backoff_init(&client->reconnectBackoff, reconnectBackoffBaseMs, reconnectBackoffCapMs,
+                 (uint32_t)realTime.tv_nsec ^ ((uint32_t)monotonicTime.tv_nsec << 7) ^
+                     (uint32_t)realTime.tv_sec);
+    client->wasConnected = false;
+    enterBackoff(backoff_random(&client->reconnectBackoff, startupJitterMs));
+    return true;
+}
 
-    if (IoTHubDeviceClient_LL_SetOption(iothubClientHandle, OPTION_KEEP_ALIVE,
-                                        &keepalivePeriodSeconds) != IOTHUB_CLIENT_OK) {
-        LogMessage("ERROR: failure setting option \"%s\"\n", OPTION_KEEP_ALIVE);
-        return false;
+/// <summary>
+///     Destroys the Azure IoT Hub client.
+/// </summary>
+void AzureIoT_DestroyClient(void)
+{
+    if (client->clientCreated) {
+        client->transport->destroy();
+        client->clientCreated = false;
+        // The confirmation of a batch in flight will not arrive, send it again from the
+        // next client.
+        requeueReportedInFlight();
+        setConnectionState(AzureIoT_ConnectionState_Idle);
+        scratch_buffer_release(&client->receiveScratch);
     }
+}
 
-    // Set callbacks for Message, MethodCall and Device Twin features.
-    IoTHubDeviceClient_LL_SetMessageCallback(iothubClientHandle, receiveMessageCallback, NULL);
-    IoTHubDeviceClient_LL_SetDeviceMethodCallback(iothubClientHandle, directMethodCallback, NULL);
-    IoTHubDeviceClient_LL_SetDeviceTwinCallback(iothubClientHandle, twinCallback, NULL);
+/// <summary>
+///     Returns the current connection state.
+/// </summary>
+AzureIoT_ConnectionState AzureIoT_GetConnectionState(void)
+{
+    return client->connectionState;
+}
 
-    // Set callbacks for connection status related events.
-    if (IoTHubDeviceClient_LL_SetConnectionStatusCallback(
-            iothubClientHandle, hubConnectionStatusCallback, NULL) != IOTHUB_CLIENT_OK) {
-        LogMessage("ERROR: failure setting callback\n");
-        return false;
+/// <summary>
+///     Copies connection statistics, optionally resetting them.
+/// </summary>
+void AzureIoT_GetConnectionStats(AzureIoT_ConnectionStats *stats, bool reset)
+{
+    memcpy(stats, &client->connectionStats, sizeof(*stats));
+    if (reset) {
+        memset(&client->connectionStats, 0, sizeof(client->connectionStats));
+        latency_hist_reset(&client->connectionStats.reconnectMs);
+        latency_hist_reset(&client->connectionStats.drainMs);
     }
+}
 
-    // Set retry policy for the connection to the IoT Hub.
-    if (IoTHubDeviceClient_LL_SetRetryPolicy(iothubClientHandle, IOTHUB_CLIENT_RETRY_INTERVAL,
-                                             retryTimeoutSeconds) != IOTHUB_CLIENT_OK) {
-        LogMessage("ERROR: failure setting retry policy\n");
+/// <summary>
+///     Selects the transport used by the next AzureIoT_SetupClient() call.
+/// </summary>
+bool AzureIoT_SetTransport(const AzureIoT_Transport *newTransport)
+{
+    if (client->clientCreated) {
         return false;
     }
-
+    client->transport = newTransport;
     return true;
 }
 
 /// <summary>
-///     Destroys the Azure IoT Hub client.
+///     Creates the state of a further client, see AzureIoT_SelectClientState().
 /// </summary>
-void AzureIoT_DestroyClient(void)
+AzureIoT_ClientState *AzureIoT_CreateClientState(void)
 {
-    if (iothubClientHandle != NULL) {
-        IoTHubDeviceClient_LL_Destroy(iothubClientHandle);
-        iothubClientHandle = NULL;
+    AzureIoT_ClientState *state = (AzureIoT_ClientState *)malloc(sizeof(*state));
+    if (state != NULL) {
+        *state = (AzureIoT_ClientState)CLIENT_STATE_INIT;
     }
+    return state;
 }
 
 /// <summary>
-///     Periodically outputs a provided format string with a variable number of arguments.
+///     Destroys the client of a state created by AzureIoT_CreateClientState(), drops its
+///     buffered messages and frees the state.
 /// </summary>
-/// <param name="lastInvokedTime">Pointer where to store the 'last time this function has been
-/// invoked' information</param>
-/// <param name="periodInSeconds">The desired period of the output</param>
-/// <param name="format">The format string</param>
-static void PeriodicLogVarArgs(time_t *lastInvokedTime, time_t periodInSeconds, const char *format,
-                               ...)
+void AzureIoT_DestroyClientState(AzureIoT_ClientState *state)
 {
-    struct timespec ts;
-    int timeOk = timespec_get(&ts, TIME_UTC);
-    if (!timeOk) {
+    if (state == NULL || state == &defaultClient) {
         return;
     }
 
-    if (ts.tv_sec > *lastInvokedTime + periodInSeconds) {
-        va_list args;
-        va_start(args, format);
-        Log_Debug("[Azure IoT Hub client] ");
-        Log_DebugVarArgs(format, args);
-        va_end(args);
-        *lastInvokedTime = ts.tv_sec;
+    AzureIoT_ClientState *selected = client;
+    client = state;
+    AzureIoT_DestroyClient();
+    for (size_t i = 0; i < MESSAGE_SLOT_COUNT; i++) {
+        free(state->messageSlots[i].payload);
     }
+    scratch_buffer_release(&state->receiveScratch);
+    client = (selected == state) ? &defaultClient : selected;
+    free(state);
+}
+
+/// <summary>
+///     Selects the client state the functions of this module act upon in the calling thread.
+/// </summary>
+void AzureIoT_SelectClientState(AzureIoT_ClientState *state)
+{
+    client = (state != NULL) ? state : &defaultClient;
 }
 
 /// <summary>
@@ -330,41 +673,261 @@ static void PeriodicLogVarArgs(time_t *lastInvokedTime, time_t periodInSeconds,
 /// </remarks>
 void AzureIoT_DoPeriodicTasks(void)
 {
-    static time_t lastTimeLogged = 0;
-    PeriodicLogVarArgs(&lastTimeLogged, 5, "INFO: %s calls in progress...\n", __func__);
+    // Dropped by the module level unless debugging, then rate limited
+    LOG_RING(LOG_DOWORK);
+
+    updateConnectionState();
 
     // DoWork - send some of the buffered events to the IoT Hub, and receive some of the buffered
-    // events from the IoT Hub.
-    IoTHubDeviceClient_LL_DoWork(iothubClientHandle);
+    // events from the IoT Hub. During backoff only at a low rate for the callbacks still
+    // queued, and not at all if the transport would reconnect.
+    if (client->clientCreated && client->connectionState != AzureIoT_ConnectionState_Backoff) {
+        client->transport->doWork();
+    } else if (client->clientCreated && client->transport->holdConnection != NULL &&
+               elapsedMsSince(&client->backoffDoWorkTime) >= backoffDoWorkPeriodMs) {
+        getMonotonicTime(&client->backoffDoWorkTime);
+        client->transport->doWork();
+    }
+
+    if (isConnected()) {
+        // Hand over buffered messages, those queued while offline or whose delivery failed.
+        retryPendingMessages();
+
+        // Send reported properties changes collected during the coalescing window.
+        flushReportedProperties();
+    }
 }
 
 /// <summary>
-///     Creates and enqueues a message to be delivered the IoT Hub. The message is not actually sent
-///     immediately, but it is sent on the next invocation of AzureIoT_DoPeriodicTasks().
+///     Hands a tracked message over to the IoT Hub client. The message slot is passed as the
+///     confirmation context, so that sendMessageCallback can identify the message.
 /// </summary>
-/// <param name="messagePayload">The payload of the message to send.</param>
-void AzureIoT_SendMessage(const char *messagePayload)
+/// <returns>'true' if the IoT Hub client accepted the message.</returns>
+static bool handOverMessage(MessageSlot *slot)
 {
-    if (iothubClientHandle == NULL) {
-        LogMessage("WARNING: IoT Hub client not initialized\n");
-        return;
+    if (!client->clientCreated) {
+        return false;
     }
 
-    IOTHUB_MESSAGE_HANDLE messageHandle = IoTHubMessage_CreateFromString(messagePayload);
+    // The sequence number is the message id and the "seq" property, it lets the cloud side
+    // correlate messages and drop duplicates caused by retries.
+    char sequenceString[12];
+    snprintf(sequenceString, sizeof(sequenceString), "%lu", (unsigned long)slot->sequence);
 
-    if (messageHandle == 0) {
-        LogMessage("WARNING: unable to create a new IoTHubMessage\n");
-        return;
+    getMonotonicTime(&slot->lastAttemptTime);
+    bool accepted = client->transport->sendEvent(slot->payload, sequenceString, slot);
+    if (!accepted) {
+        LOG_RING(LOG_MESSAGE_HANDOVER_FAILED, slot->sequence);
+    } else {
+        slot->attempts++;
+        slot->awaitingConfirmation = true;
+        LOG_RING(LOG_MESSAGE_ACCEPTED, slot->sequence);
     }
 
-    if (IoTHubDeviceClient_LL_SendEventAsync(iothubClientHandle, messageHandle, sendMessageCallback,
-                                             /*&callback_param*/ 0) != IOTHUB_CLIENT_OK) {
-        LogMessage("WARNING: failed to hand over the message to IoTHubClient\n");
-    } else {
-        LogMessage("INFO: IoTHubClient accepted the message for delivery\n");
+    return accepted;
+}
+
+/// <summary>
+///     Releases a message slot and its local payload copy.
+/// </summary>
+static void releaseMessageSlot(MessageSlot *slot)
+{
+    free(slot->payload);
+    memset(slot, 0, sizeof(*slot));
+}
+
+/// <summary>
+///     Hands over messages whose delivery failed, or which could not be handed over before,
+///     from the local buffer.
+/// </summary>
+static void retryPendingMessages(void)
+{
+    struct timespec now;
+    getMonotonicTime(&now);
+
+    // Priority messages first, then oldest first, so that the cloud side receives buffered
+    // messages in order.
+    while (client->clientCreated && isConnected()) {
+        MessageSlot *next = NULL;
+        for (size_t i = 0; i < MESSAGE_SLOT_COUNT; i++) {
+            MessageSlot *slot = &client->messageSlots[i];
+            long sinceLastAttemptMs = (long)(now.tv_sec - slot->lastAttemptTime.tv_sec) * 1000 +
+                                      (now.tv_nsec - slot->lastAttemptTime.tv_nsec) / 1000000;
+            if (slot->inUse && !slot->awaitingConfirmation &&
+                (slot->lastAttemptTime.tv_sec == 0 || sinceLastAttemptMs >= messageRetryDelayMs) &&
+                (next == NULL || (slot->priority && !next->priority) ||
+                 (slot->priority == next->priority &&
+                  (int32_t)(slot->sequence - next->sequence) < 0))) {
+                next = slot;
+            }
+        }
+        if (next == NULL) {
+            break;
+        }
+
+        if (client->connectionState == AzureIoT_ConnectionState_Draining && !next->priority) {
+            // Rate cap while catching up after an outage.
+            if (client->lastDrainHandOverTime.tv_sec != 0 &&
+                elapsedMsSince(&client->lastDrainHandOverTime) < drainIntervalMs) {
+                break;
+            }
+            client->lastDrainHandOverTime = now;
+        }
+
+        if (next->attempts > 0) {
+            client->messageStats.retried++;
+        }
+        if (!handOverMessage(next)) {
+            break;
+        }
+    }
+}
+
+/// <summary>
+///     Returns the number of messages held in the local buffer, i.e. accepted by
+///     AzureIoT_SendMessage() and not yet confirmed or dropped.
+/// </summary>
+unsigned int AzureIoT_GetInFlightMessageCount(void)
+{
+    unsigned int count = 0;
+    for (size_t i = 0; i < MESSAGE_SLOT_COUNT; i++) {
+        if (client->messageSlots[i].inUse) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/// <summary>
+///     Returns 'true' while messages or reported properties wait for delivery.
+/// </summary>
+bool AzureIoT_HasPendingDeliveries(void)
+{
+    return (AzureIoT_GetInFlightMessageCount() > 0) || client->reportedBatchInFlight ||
+           reportedPendingAny();
+}
+
+/// <summary>
+///     Returns 'true' if the in-flight window has room for another message.
+/// </summary>
+bool AzureIoT_CanSendMessage(void)
+{
+    return AzureIoT_GetInFlightMessageCount() < client->maxInFlightMessages;
+}
+
+/// <summary>
+///     Sets the maximum number of messages in flight.
+/// </summary>
+void AzureIoT_SetMaxInFlightMessages(unsigned int count)
+{
+    if (count < 1) {
+        count = 1;
+    } else if (count > MESSAGE_SLOT_COUNT) {
+        count = MESSAGE_SLOT_COUNT;
+    }
+    client->maxInFlightMessages = count;
+}
+
+/// <summary>
+///     Copies message delivery statistics, optionally resetting them.
+/// </summary>
+void AzureIoT_GetMessageStats(AzureIoT_MessageStats *stats, bool reset)
+{
+    client->messageStats.inFlight = AzureIoT_GetInFlightMessageCount();
+    memcpy(stats, &client->messageStats, sizeof(*stats));
+    if (reset) {
+        memset(&client->messageStats, 0, sizeof(client->messageStats));
+        latency_hist_reset(&client->messageStats.latencyMs);
+    }
+}
+
+/// <summary>
+///     Finds a free message slot. For a priority message with the slot table full, the oldest
+///     regular message not handed over is dropped to make room.
+/// </summary>
+static MessageSlot *acquireMessageSlot(bool priority)
+{
+    MessageSlot *victim = NULL;
+    for (size_t i = 0; i < MESSAGE_SLOT_COUNT; i++) {
+        MessageSlot *slot = &client->messageSlots[i];
+        if (!slot->inUse) {
+            return slot;
+        }
+        if (priority && !slot->priority && !slot->awaitingConfirmation &&
+            (victim == NULL || (int32_t)(slot->sequence - victim->sequence) < 0)) {
+            victim = slot;
+        }
     }
 
-    IoTHubMessage_Destroy(messageHandle);
+    if (victim != NULL) {
+        LogMessage("WARNING: message %lu dropped for a priority message\n",
+                   (unsigned long)victim->sequence);
+        client->messageStats.failed++;
+        releaseMessageSlot(victim);
+    }
+    return victim;
+}
+
+/// <summary>
+///     Buffers a message and hands it over if the connection allows.
+/// </summary>
+static bool queueMessage(const char *messagePayload, bool priority)
+{
+    MessageSlot *slot = acquireMessageSlot(priority);
+
+    // Keep a local copy, the message is resent from it if delivery fails.
+    char *payload = (slot != NULL) ? strdup(messagePayload) : NULL;
+    if (payload == NULL) {
+        client->messageStats.rejected++;
+        LogMessage("WARNING: unable to buffer message\n");
+        return false;
+    }
+
+    memset(slot, 0, sizeof(*slot));
+    slot->inUse = true;
+    slot->priority = priority;
+    slot->payload = payload;
+    slot->sequence = client->nextMessageSequence++;
+    getMonotonicTime(&slot->queuedTime);
+    client->messageStats.sent++;
+
+    // While offline or draining older messages, or if the hand over fails, the message
+    // stays buffered and is handed over by AzureIoT_DoPeriodicTasks(). Priority messages
+    // overtake the drain.
+    if (client->connectionState == AzureIoT_ConnectionState_Live ||
+        (priority && client->connectionState == AzureIoT_ConnectionState_Draining)) {
+        handOverMessage(slot);
+    }
+    return true;
+}
+
+/// <summary>
+///     Creates and enqueues a message to be delivered the IoT Hub. The message is not actually sent
+///     immediately, but it is sent on the next invocation of AzureIoT_DoPeriodicTasks().
+/// </summary>
+/// <param name="messagePayload">The payload of the message to send.</param>
+/// <returns>'true' if the message has been queued. 'false' when the in-flight window is full
+/// or the message could not be buffered.</returns>
+bool AzureIoT_SendMessage(const char *messagePayload)
+{
+    if (!AzureIoT_CanSendMessage()) {
+        // Backpressure, producer has to retry later or drop the message.
+        client->messageStats.rejected++;
+        LogMessage("WARNING: %u messages in flight, message rejected\n",
+                   client->maxInFlightMessages);
+        return false;
+    }
+
+    return queueMessage(messagePayload, false);
+}
+
+/// <summary>
+///     Enqueues a message ahead of regular telemetry, see AzureIoT_SendPriorityMessage() in
+///     azure_iot_utilities.h.
+/// </summary>
+bool AzureIoT_SendPriorityMessage(const char *messagePayload)
+{
+    return queueMessage(messagePayload, true);
 }
 
 /// <summary>
@@ -381,10 +944,46 @@ void AzureIoT_SetDeviceTwinDeliveryConfirmationCallback(
 /// <summary>
 ///     Callback invoked when the Device Twin reported properties are accepted by IoT Hub.
 /// </summary>
+/// <remarks>The batch of reported properties in flight is marked as acknowledged on a 2xx
+/// status code. Any other status code puts the batch back to the pending state so that it
+/// is retried after a backoff delay.</remarks>
 static void reportStatusCallback(int result, void *context)
 {
     LogMessage("INFO: Device Twin reported properties update result: HTTP status code %d\n",
                result);
+
+    bool accepted = (result >= 200 && result < 300);
+    for (size_t i = 0; i < client->reportedPropertyCount; i++) {
+        ReportedProperty *property = &client->reportedProperties[i];
+        if (!property->inFlight) {
+            continue;
+        }
+        property->inFlight = false;
+        if (accepted) {
+            strcpy(property->ackedValue, property->inFlightValue);
+            property->acked = true;
+        } else if (!property->pending) {
+            // No newer value was queued meanwhile, retry the one which failed.
+            strcpy(property->pendingValue, property->inFlightValue);
+            property->pending = true;
+        }
+    }
+    client->reportedBatchInFlight = false;
+
+    if (accepted) {
+        client->reportedRetryDelayMs = 0;
+    } else {
+        client->reportedRetryDelayMs = (client->reportedRetryDelayMs == 0)
+                                           ? reportedRetryDelayMinMs
+                                           : client->reportedRetryDelayMs * 2;
+        if (client->reportedRetryDelayMs > reportedRetryDelayMaxMs) {
+            client->reportedRetryDelayMs = reportedRetryDelayMaxMs;
+        }
+        LogMessage("WARNING: reported properties rejected, retrying in %u ms\n",
+                   client->reportedRetryDelayMs);
+        getMonotonicTime(&client->reportedPendingSince);
+    }
+
     if (deviceTwinConfirmationCb)
         deviceTwinConfirmationCb(result);
 }
@@ -397,53 +996,163 @@ static void reportStatusCallback(int result, void *context)
 /// </summary>
 void AzureIoT_TwinReportState(const char *propertyName, size_t propertyValue)
 {
-    if (iothubClientHandle == NULL) {
-        LogMessage("ERROR: client not initialized\n");
+    char valueString[24];
+    snprintf(valueString, sizeof(valueString), "%zu", propertyValue);
+    AzureIoT_TwinReportProperty(propertyName, valueString);
+}
+
+/// <summary>
+///     Queues a Device Twin reported property in the reported properties cache.
+/// </summary>
+/// <param name="propertyName">The name of the property to report.</param>
+/// <param name="jsonValue">The value of the property serialized as JSON.</param>
+/// <returns>'true' if the value is queued or already reported, 'false' when it does not fit
+/// into the cache.</returns>
+bool AzureIoT_TwinReportProperty(const char *propertyName, const char *jsonValue)
+{
+    if (strlen(propertyName) >= REPORTED_PROPERTY_NAME_SIZE ||
+        strlen(jsonValue) >= REPORTED_PROPERTY_VALUE_SIZE) {
+        LogMessage("ERROR: reported property '%s' too long for cache\n", propertyName);
+        return false;
+    }
+
+    ReportedProperty *property = NULL;
+    for (size_t i = 0; i < client->reportedPropertyCount; i++) {
+        if (strcmp(client->reportedProperties[i].name, propertyName) == 0) {
+            property = &client->reportedProperties[i];
+            break;
+        }
+    }
+
+    if (property == NULL) {
+        if (client->reportedPropertyCount >= REPORTED_PROPERTY_MAX_COUNT) {
+            LogMessage("ERROR: reported properties cache full, dropping '%s'\n", propertyName);
+            return false;
+        }
+        property = &client->reportedProperties[client->reportedPropertyCount++];
+        memset(property, 0, sizeof(*property));
+        strcpy(property->name, propertyName);
+    }
+
+    // The latest value the hub is going to have once everything in flight is acknowledged.
+    const char *expectedValue = property->inFlight ? property->inFlightValue
+                                                   : (property->acked ? property->ackedValue : NULL);
+
+    if (expectedValue != NULL && strcmp(expectedValue, jsonValue) == 0) {
+        // Nothing new to report, drop any older pending value.
+        property->pending = false;
+        return true;
+    }
+
+    if (!property->pending && !reportedPendingAny()) {
+        // First change opens the coalescing window.
+        getMonotonicTime(&client->reportedPendingSince);
+    }
+    strcpy(property->pendingValue, jsonValue);
+    property->pending = true;
+
+    return true;
+}
+
+/// <summary>
+///     Sends all pending reported properties as a single JSON diff once the coalescing
+///     window has elapsed.
+/// </summary>
+static void flushReportedProperties(void)
+{
+    if (!client->clientCreated || client->reportedBatchInFlight || !reportedPendingAny()) {
         return;
     }
 
-    char *reportedPropertiesString = NULL;
-    JSON_Value *reportedPropertiesRootJson = json_value_init_object();
-    if (reportedPropertiesRootJson == NULL) {
-        LogMessage("ERROR: could not create the JSON_Value for Device Twin reporting.\n");
+    struct timespec now;
+    getMonotonicTime(&now);
+    long elapsedMs = (long)(now.tv_sec - client->reportedPendingSince.tv_sec) * 1000 +
+                     (now.tv_nsec - client->reportedPendingSince.tv_nsec) / 1000000;
+    unsigned int waitMs = reportedCoalesceWindowMs + client->reportedRetryDelayMs;
+    if (elapsedMs < (long)waitMs) {
         return;
     }
 
-    JSON_Object *reportedPropertiesJson = json_value_get_object(reportedPropertiesRootJson);
-    if (reportedPropertiesJson == NULL) {
-        LogMessage("ERROR: could not get the JSON_Object for Device Twin reporting.\n");
-        goto cleanup;
+    // Build {"name":value,...} of pending properties only
+    static _Thread_local char batch[REPORTED_BATCH_SIZE];
+    size_t length = 0;
+    batch[length++] = '{';
+    for (size_t i = 0; i < client->reportedPropertyCount; i++) {
+        ReportedProperty *property = &client->reportedProperties[i];
+        if (!property->pending) {
+            continue;
+        }
+        int written = snprintf(batch + length, sizeof(batch) - length, "%s\"%s\":%s",
+                               (length > 1) ? "," : "", property->name, property->pendingValue);
+        if (written < 0 || (size_t)written >= sizeof(batch) - length - 1) {
+            // Leave the rest for the next batch.
+            batch[length] = '\0';
+            break;
+        }
+        length += (size_t)written;
+        strcpy(property->inFlightValue, property->pendingValue);
+        property->pending = false;
+        property->inFlight = true;
     }
+    batch[length++] = '}';
+    batch[length] = '\0';
 
-    if (JSONSuccess !=
-        json_object_set_number(reportedPropertiesJson, propertyName, propertyValue)) {
-        LogMessage("ERROR: could not set the property value for Device Twin reporting.\n");
-        goto cleanup;
+    if (!client->transport->sendReportedState((const unsigned char *)batch, length, 0)) {
+        LogMessage("ERROR: failed to send reported state '%s'.\n", batch);
+        // Restore pending values so they are retried.
+        requeueReportedInFlight();
+        return;
     }
 
-    reportedPropertiesString = json_serialize_to_string(reportedPropertiesRootJson);
+    client->reportedBatchInFlight = true;
+    LogMessage("INFO: Reported state as '%s'.\n", batch);
+}
+
+/// <summary>
+///     Creates and enqueues reported properties state using a prepared json string.
+///     The report is not actually sent immediately, but it is sent on the next 
+///     invocation of AzureIoT_DoPeriodicTasks().
+/// </summary>
+/// <remarks>Each top level member of the JSON object is queued in the reported properties
+/// cache, so that only changed values are sent.</remarks>
+void AzureIoT_TwinReportStateJson(
+	char *reportedPropertiesString,
+	size_t reportedPropertiesSize)
+{
     if (reportedPropertiesString == NULL) {
-        LogMessage(
-            "ERROR: could not serialize the JSON payload to string for Device "
-            "Twin reporting.\n");
-        goto cleanup;
+        LogMessage("ERROR: no JSON string for Device Twin reporting.\n");
+        return;
     }
 
-    if (IoTHubDeviceClient_LL_SendReportedState(
-            iothubClientHandle, (unsigned char *)reportedPropertiesString,
-            strlen(reportedPropertiesString), reportStatusCallback, 0) != IOTHUB_CLIENT_OK) {
-        LogMessage("ERROR: failed to set reported property '%s'.\n", propertyName);
-    } else {
-        LogMessage("INFO: Set reported property '%s' to value %d.\n", propertyName, propertyValue);
+    // Input is not required to be zero terminated.
+    char *jsonString = (char *)malloc(reportedPropertiesSize + 1);
+    if (jsonString == NULL) {
+        LogMessage("ERROR: could not allocate buffer for Device Twin reporting.\n");
+        return;
     }
+    memcpy(jsonString, reportedPropertiesString, reportedPropertiesSize);
+    jsonString[reportedPropertiesSize] = '\0';
 
-cleanup:
-    if (reportedPropertiesRootJson != NULL) {
-        json_value_free(reportedPropertiesRootJson);
+    JSON_Value *rootValue = json_parse_string(jsonString);
+    JSON_Object *rootObject = json_value_get_object(rootValue);
+    if (rootObject == NULL) {
+        LogMessage("ERROR: reported state is not a JSON object: '%s'.\n", jsonString);
+        goto cleanup;
     }
-    if (reportedPropertiesString != NULL) {
-        json_free_serialized_string(reportedPropertiesString);
+
+    for (size_t i = 0; i < json_object_get_count(rootObject); i++) {
+        char *valueString = json_serialize_to_string(json_object_get_value_at(rootObject, i));
+        if (valueString == NULL) {
+            LogMessage("ERROR: could not serialize reported property value.\n");
+            continue;
+        }
+        AzureIoT_TwinReportProperty(json_object_get_name(rootObject, i), valueString);
+        json_free_serialized_string(valueString);
     }
+
+cleanup:
+    json_value_free(rootValue);
+    free(jsonString);
 }
 
 /// <summary>
@@ -455,6 +1164,15 @@ void AzureIoT_SetMessageReceivedCallback(MessageReceivedFnType callback)
     messageReceivedCb = callback;
 }
 
+/// <summary>
+///     Sets a callback function invoked with the payload of every message received from IoT
+///     Hub, without copying it.
+/// </summary>
+void AzureIoT_SetMessageReceivedBufferCallback(MessageReceivedBufferFnType callback)
+{
+    messageReceivedBufferCb = callback;
+}
+
 /// <summary>
 ///     Sets the function to be invoked whenever the message to the Iot Hub has been delivered.
 /// </summary>
@@ -468,51 +1186,79 @@ void AzureIoT_SetMessageConfirmationCallback(MessageDeliveryConfirmationFnType c
 ///     Function invoked when the message delivery confirmation is being reported.
 /// </summary>
 /// <param name="result">Message delivery status</param>
-/// <param name="context">User specified context</param>
+/// <param name="context">Message slot of the confirmed message</param>
 static void sendMessageCallback(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void *context)
 {
-    LogMessage("INFO: Message received by IoT Hub. Result is: %d\n", result);
+    MessageSlot *slot = (MessageSlot *)context;
+    if (slot < &client->messageSlots[0] || slot >= &client->messageSlots[MESSAGE_SLOT_COUNT] ||
+        !slot->inUse) {
+        LogMessage("WARNING: confirmation for unknown message. Result is: %d\n", result);
+        return;
+    }
+
+    slot->awaitingConfirmation = false;
+    bool delivered = (result == IOTHUB_CLIENT_CONFIRMATION_OK);
+
+    if (delivered) {
+        struct timespec now;
+        getMonotonicTime(&now);
+        int64_t latencyMs = (int64_t)(now.tv_sec - slot->queuedTime.tv_sec) * 1000 +
+                            (now.tv_nsec - slot->queuedTime.tv_nsec) / 1000000;
+        latency_hist_record(&client->messageStats.latencyMs,
+                            (latencyMs > 0) ? (uint32_t)latencyMs : 0);
+        client->messageStats.delivered++;
+        LOG_RING(LOG_MESSAGE_DELIVERED, slot->sequence, latencyMs);
+        releaseMessageSlot(slot);
+    } else if (result == IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY) {
+        // Client is being destroyed, keep the message for the next client.
+        slot->attempts = 0;
+        return;
+    } else if (slot->attempts < maxDeliveryAttempts) {
+        LOG_RING(LOG_MESSAGE_RETRY, slot->sequence, result);
+        return;
+    } else {
+        client->messageStats.failed++;
+        LOG_RING(LOG_MESSAGE_DROPPED, slot->sequence, slot->attempts, result);
+        releaseMessageSlot(slot);
+    }
+
     if (messageDeliveryConfirmationCb) {
-        messageDeliveryConfirmationCb(result == IOTHUB_CLIENT_CONFIRMATION_OK);
+        messageDeliveryConfirmationCb(delivered);
     }
 }
 
 /// <summary>
 ///     Callback function invoked when a message is received from IoT Hub.
 /// </summary>
-/// <param name="message">The handle of the received message</param>
-/// <param name="context">The user context specified at IoTHubDeviceClient_LL_SetMessageCallback()
-/// invocation time</param>
+/// <param name="buffer">The payload of the received message</param>
+/// <param name="size">The size of the payload</param>
 /// <returns>Return value to indicates the message procession status (i.e. accepted, rejected,
 /// abandoned)</returns>
-static IOTHUBMESSAGE_DISPOSITION_RESULT receiveMessageCallback(IOTHUB_MESSAGE_HANDLE message,
-                                                               void *context)
+static IOTHUBMESSAGE_DISPOSITION_RESULT receiveMessageCallback(const unsigned char *buffer,
+                                                               size_t size)
 {
-    const unsigned char *buffer = NULL;
-    size_t size = 0;
-    if (IoTHubMessage_GetByteArray(message, &buffer, &size) != IOTHUB_MESSAGE_OK) {
-        LogMessage("WARNING: failure performing IoTHubMessage_GetByteArray\n");
-        return IOTHUBMESSAGE_REJECTED;
-    }
-
     // 'buffer' is not zero terminated.
-    unsigned char *str_msg = (unsigned char *)malloc(size + 1);
-    if (str_msg == NULL) {
-        LogMessage("ERROR: could not allocate buffer for incoming message\n");
-        abort();
+    LogMessage("INFO: Received message '%.*s' from IoT Hub\n", (int)size, buffer);
+
+    if (messageReceivedBufferCb != 0) {
+        messageReceivedBufferCb(buffer, size);
     }
-    memcpy(str_msg, buffer, size);
-    str_msg[size] = '\0';
 
     if (messageReceivedCb != 0) {
+        const char *str_msg = scratch_buffer_terminate(&client->receiveScratch, buffer, size);
+        if (str_msg == NULL) {
+            if (size >= client->receiveScratch.max_size) {
+                LogMessage("WARNING: message of %zu bytes is too large, rejected\n", size);
+                return IOTHUBMESSAGE_REJECTED;
+            }
+            LogMessage("WARNING: no memory for incoming message, abandoned\n");
+            return IOTHUBMESSAGE_ABANDONED;
+        }
         messageReceivedCb(str_msg);
-    } else {
+    } else if (messageReceivedBufferCb == 0) {
         LogMessage("WARNING: no user callback set up for event 'message received from IoT Hub'\n");
     }
 
-    LogMessage("INFO: Received message '%s' from IoT Hub\n", str_msg);
-    free(str_msg);
-
     return IOTHUBMESSAGE_ACCEPTED;
 }
 
@@ -537,6 +1283,15 @@ void AzureIoT_SetDeviceTwinUpdateCallback(TwinUpdateFnType callback)
     twinUpdateCb = callback;
 }
 
+/// <summary>
+///     Sets the function callback invoked with the payload of every Device Twin update,
+///     without copying it.
+/// </summary>
+void AzureIoT_SetDeviceTwinUpdateBufferCallback(TwinUpdateBufferFnType callback)
+{
+    twinUpdateBufferCb = callback;
+}
+
 /// <summary>
 ///     Callback when direct method is called.
 /// </summary>
@@ -547,25 +1302,30 @@ static int directMethodCallback(const char *methodName, const unsigned char *pay
     LogMessage("INFO: Trying to invoke method %s\n", methodName);
 
     int result = 404;
+    *response = NULL;
+    *responseSize = 0;
 
     if (directMethodCallCb != NULL) {
         char *responseFromCallback = NULL;
         size_t responseFromCallbackSize = 0;
 
-        result = directMethodCallCb(methodName, payload, size, &responseFromCallback,
-                                    &responseFromCallbackSize);
+        result = directMethodCallCb(methodName, (const char *)payload, size,
+                                    &responseFromCallback, &responseFromCallbackSize);
         *responseSize = responseFromCallbackSize;
-        *response = responseFromCallback;
-    } else {
+        *response = (unsigned char *)responseFromCallback;
+    }
+
+    // Methods the application does not know are answered with a body as well
+    if (result == 404 && *response == NULL) {
         LogMessage("INFO: No method '%s' found, HttpStatus=%d\n", methodName, result);
         static const char methodNotFound[] = "\"No method found\"";
         *responseSize = strlen(methodNotFound);
         *response = (unsigned char *)malloc(*responseSize);
         if (*response != NULL) {
-            strncpy((char *)(*response), methodNotFound, *responseSize);
+            memcpy(*response, methodNotFound, *responseSize);
         } else {
             LogMessage("ERROR: Cannot create response message for method call.\n");
-            abort();
+            *responseSize = 0;
         }
     }
 
@@ -578,17 +1338,22 @@ static int directMethodCallback(const char *methodName, const unsigned char *pay
 static void twinCallback(DEVICE_TWIN_UPDATE_STATE updateState, const unsigned char *payLoad,
                          size_t payLoadSize, void *userContextCallback)
 {
-    size_t nullTerminatedJsonSize = payLoadSize + 1;
-    char *nullTerminatedJsonString = (char *)malloc(nullTerminatedJsonSize);
-    if (nullTerminatedJsonString == NULL) {
-        LogMessage("ERROR: Could not allocate buffer for twin update payload.\n");
-        abort();
+    if (twinUpdateBufferCb != NULL) {
+        twinUpdateBufferCb(updateState == DEVICE_TWIN_UPDATE_COMPLETE, payLoad, payLoadSize);
+    }
+
+    if (twinUpdateCb == NULL) {
+        return;
     }
 
     // Copy the provided buffer to a null terminated buffer.
-    memcpy(nullTerminatedJsonString, payLoad, payLoadSize);
-    // Add the null terminator at the end.
-    nullTerminatedJsonString[nullTerminatedJsonSize - 1] = 0;
+    const char *nullTerminatedJsonString =
+        scratch_buffer_terminate(&client->receiveScratch, payLoad, payLoadSize);
+    if (nullTerminatedJsonString == NULL) {
+        LogMessage("WARNING: Cannot copy twin update payload of %zu bytes, skipped.\n",
+                   payLoadSize);
+        return;
+    }
 
     JSON_Value *rootProperties = NULL;
     rootProperties = json_parse_string(nullTerminatedJsonString);
@@ -602,15 +1367,12 @@ static void twinCallback(DEVICE_TWIN_UPDATE_STATE updateState, const unsigned ch
     if (desiredProperties == NULL) {
         desiredProperties = rootObject;
     }
-    // Call the provided Twin Device callback if any.
-    if (twinUpdateCb != NULL) {
-        twinUpdateCb(desiredProperties);
-    }
+    // Call the provided Twin Device callback.
+    twinUpdateCb(desiredProperties);
 
 cleanup:
     // Release the allocated memory.
     json_value_free(rootProperties);
-    free(nullTerminatedJsonString);
 }
 
 /// <summary>
@@ -634,15 +1396,27 @@ static void hubConnectionStatusCallback(IOTHUB_CLIENT_CONNECTION_STATUS result,
                                         void *userContextCallback)
 {
     bool authenticated = (result == IOTHUB_CLIENT_CONNECTION_AUTHENTICATED);
-    if (hubConnectionStatusCb) {
-        hubConnectionStatusCb(result == IOTHUB_CLIENT_CONNECTION_AUTHENTICATED);
-    }
     const char *reasonString = getReasonString(reason);
     if (!authenticated) {
-        LogMessage("INFO: IoT Hub connection is down (%s), retrying connection in 5 seconds...\n",
-                   reasonString);
+        LogMessage("INFO: IoT Hub connection is down (%s).\n", reasonString);
+        if (isConnected()) {
+            client->connectionStats.disconnects++;
+            getMonotonicTime(&client->disconnectedTime);
+            client->wasConnected = true;
+            enterBackoff(backoff_next(&client->reconnectBackoff));
+        } else if (client->connectionState == AzureIoT_ConnectionState_Connecting) {
+            client->connectionStats.failures++;
+            enterBackoff(backoff_next(&client->reconnectBackoff));
+        }
     } else {
         LogMessage("INFO: connection to the IoT Hub has been established (%s).\n", reasonString);
+        if (!isConnected()) {
+            onConnected();
+        }
+    }
+
+    if (hubConnectionStatusCb) {
+        hubConnectionStatusCb(authenticated);
     }
 }
 
@@ -666,33 +1440,3 @@ void AzureIoT_Deinitialize(void)
 {
     IoTHub_Deinit();
 }
-/// <summary>
-///     Creates and enqueues reported properties state using a prepared json string.
-///     The report is not actually sent immediately, but it is sent on the next 
-///     invocation of AzureIoT_DoPeriodicTasks().
-/// </summary>
-void AzureIoT_TwinReportStateJson(
-	char *reportedPropertiesString,
-	size_t reportedPropertiesSize)
-{
-
-	if (iothubClientHandle == NULL) {
-		LogMessage("ERROR: client not initialized\n");
-	}
-	else {
-		if (reportedPropertiesString != NULL) {
-			if (IoTHubDeviceClient_LL_SendReportedState(iothubClientHandle,
-				(unsigned char *)reportedPropertiesString, reportedPropertiesSize,
-				reportStatusCallback, 0) != IOTHUB_CLIENT_OK) {
-				LogMessage("ERROR: failed to set reported state as '%s'.\n",
-					reportedPropertiesString);
-			}
-			else {
-				LogMessage("INFO: Reported state as '%s'.\n", reportedPropertiesString);
-			}
-		}
-		else {
-			LogMessage("ERROR: no JSON string for Device Twin reporting.\n");
-		}
-	}
-}
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include <azureiot/iothubtransportmqtt.h>
 #include <applibs/networking.h>
 #include "parson.h"
+#include "latency_histogram.h"
 
 /// <summary>
 ///     Sets up the client in order to establish the communication channel to Azure IoT Hub.
@@ -14,16 +15,20 @@
 ///     The client is created by using the IoT Hub connection string that is provisioned
 ///     on the device or hardcoded into the source. The client is setup with the following
 ///     options:
-///     - IOTHUB_CLIENT_RETRY_INTERVAL retry policy which, when the network connection
-///       to the IoT Hub drops, attempts a reconnection each 5 seconds for a period of time
-///       of 5000 seconds before giving up;
+///     - IOTHUB_CLIENT_RETRY_IMMEDIATE retry policy; the timing of connection attempts is
+///       controlled by AzureIoT_DoPeriodicTasks(), which waits a random, exponentially
+///       growing delay after each failure and after losing the connection;
 ///     - MQTT procotol 'keepalive' value of 20 seconds; when no PINGRESP is received after
-///       20 seconds, the connection is believed to be down and the retry policy kicks in;
+///       20 seconds, the connection is believed to be down and the backoff kicks in;
+///
+///     The first connection attempt is delayed by a random time of up to 5 seconds, so that
+///     devices powered up together do not connect at the same moment.
 /// </summary>
 /// <returns>'true' if the client has been properly set up. 'false' when a fatal error occurred
 /// while setting up the client.</returns>
 /// <remarks>This function is a no-op when the client has already been set up, i.e. this
-/// function has already completed successfully.</remarks>
+/// function has already completed successfully. The client is created by the transport
+/// selected at build time or by AzureIoT_SetTransport().</remarks>
 bool AzureIoT_SetupClient(void);
 
 /// <summary>
@@ -36,10 +41,27 @@ void AzureIoT_DestroyClient(void);
 ///     The report is not actually sent immediately, but it is sent on the next 
 ///     invocation of AzureIoT_DoPeriodicTasks().
 /// </summary>
+/// <remarks>Each top level member is queued separately in the reported properties cache,
+/// see AzureIoT_TwinReportProperty().</remarks>
 void AzureIoT_TwinReportStateJson(
 	char *reportedPropertiesString,
 	size_t reportedPropertiesSize);
 
+/// <summary>
+///     Queues a Device Twin reported property in the reported properties cache.
+///
+///     The cache remembers the value last acknowledged by the IoT Hub for each property.
+///     Changes queued within a short coalescing window are sent together as a single JSON
+///     diff, values equal to the acknowledged ones are not sent at all. Updates rejected by
+///     the IoT Hub are retried with an increasing delay.
+/// </summary>
+/// <param name="propertyName">The name of the property to report.</param>
+/// <param name="jsonValue">The value of the property serialized as JSON, e.g. "42" or
+/// "\"text\"".</param>
+/// <returns>'true' if the value is queued or already reported, 'false' when it does not fit
+/// into the cache.</returns>
+bool AzureIoT_TwinReportProperty(const char *propertyName, const char *jsonValue);
+
 /// <summary>
 ///     Creates and enqueues a report containing the name and value pair of a Device Twin reported
 ///     property.
@@ -53,9 +75,104 @@ void AzureIoT_TwinReportState(const char *propertyName, size_t propertyValue);
 /// <summary>
 ///     Creates and enqueues a message to be delivered the IoT Hub. The message is not actually sent
 ///     immediately, but it is sent on the next invocation of AzureIoT_DoPeriodicTasks().
+///
+///     Every message gets a monotonic sequence number, set as its message id and as the "seq"
+///     property. A copy of the payload is kept until the IoT Hub confirms the delivery, failed
+///     deliveries are retried from it. Messages queued before the client is set up are sent
+///     once it is.
+/// </summary>
+/// <param name="messagePayload">The payload of the message to send.</param>
+/// <returns>'true' if the message has been queued. 'false' when the in-flight window is full
+/// or the message could not be buffered.</returns>
+bool AzureIoT_SendMessage(const char *messagePayload);
+
+/// <summary>
+///     Enqueues a high priority message, e.g. an alert. It is not subject to the in-flight
+///     window, is handed over before buffered regular messages and is not rate capped while
+///     the buffer drains after an outage. With the local buffer full, the oldest regular
+///     message not yet handed over is dropped to make room.
 /// </summary>
 /// <param name="messagePayload">The payload of the message to send.</param>
-void AzureIoT_SendMessage(const char *messagePayload);
+/// <returns>'true' if the message has been queued.</returns>
+bool AzureIoT_SendPriorityMessage(const char *messagePayload);
+
+/// <summary>
+///     Returns 'true' if the in-flight window has room for another message. Producers should
+///     check this before building a message payload.
+/// </summary>
+bool AzureIoT_CanSendMessage(void);
+
+/// <summary>
+///     Sets the maximum number of messages accepted by AzureIoT_SendMessage() and not yet
+///     confirmed by the IoT Hub.
+/// </summary>
+/// <param name="count">Window size, limited to 1..16. Default is 8.</param>
+void AzureIoT_SetMaxInFlightMessages(unsigned int count);
+
+/// <summary>
+///     Returns the number of messages waiting for delivery confirmation.
+/// </summary>
+unsigned int AzureIoT_GetInFlightMessageCount(void);
+
+/// <summary>
+///     Returns 'true' while messages or reported properties wait for delivery, e.g. to keep
+///     the client until they are sent before destroying it.
+/// </summary>
+bool AzureIoT_HasPendingDeliveries(void);
+
+/// <summary>
+///     Message delivery statistics.
+/// </summary>
+typedef struct {
+    uint32_t sent;              // Messages accepted by AzureIoT_SendMessage()
+    uint32_t delivered;         // Messages confirmed by the IoT Hub
+    uint32_t failed;            // Messages dropped after all retries
+    uint32_t retried;           // Retried hand overs
+    uint32_t rejected;          // Messages refused because of backpressure
+    uint32_t inFlight;          // Messages currently waiting for confirmation
+    latency_hist_t latencyMs;   // Time from AzureIoT_SendMessage() to confirmation
+} AzureIoT_MessageStats;
+
+/// <summary>
+///     Copies message delivery statistics.
+/// </summary>
+/// <param name="stats">Output statistics.</param>
+/// <param name="reset">'true' to start a new statistics period.</param>
+void AzureIoT_GetMessageStats(AzureIoT_MessageStats *stats, bool reset);
+
+/// <summary>
+///     State of the connection to the IoT Hub.
+/// </summary>
+typedef enum {
+    AzureIoT_ConnectionState_Idle,       // No client
+    AzureIoT_ConnectionState_Backoff,    // Waiting before the next connection attempt
+    AzureIoT_ConnectionState_Connecting, // Connection attempt in progress
+    AzureIoT_ConnectionState_Draining,   // Connected, sending messages buffered while offline
+    AzureIoT_ConnectionState_Live        // Connected, sending new messages right away
+} AzureIoT_ConnectionState;
+
+/// <summary>
+///     Connection statistics.
+/// </summary>
+typedef struct {
+    uint32_t attempts;          // Connection attempts
+    uint32_t failures;          // Failed or timed out connection attempts
+    uint32_t disconnects;       // Established connections lost
+    latency_hist_t reconnectMs; // Time from losing the connection to being connected again
+    latency_hist_t drainMs;     // Time to send the messages buffered while offline
+} AzureIoT_ConnectionStats;
+
+/// <summary>
+///     Returns the current connection state.
+/// </summary>
+AzureIoT_ConnectionState AzureIoT_GetConnectionState(void);
+
+/// <summary>
+///     Copies connection statistics.
+/// </summary>
+/// <param name="stats">Output statistics.</param>
+/// <param name="reset">'true' to start a new statistics period.</param>
+void AzureIoT_GetConnectionStats(AzureIoT_ConnectionStats *stats, bool reset);
 
 /// <summary>
 ///     Keeps IoT Hub Client alive by exchanging data with the Azure IoT Hub.
@@ -70,6 +187,12 @@ void AzureIoT_DoPeriodicTasks(void);
 /// <summary>
 ///     Type of the function callback invoked whenever a message is received from IoT Hub.
 /// </summary>
+/// <remarks>
+///     The payload is a zero terminated copy of the message. Messages that cannot be copied
+///     because they are larger than the scratch buffer limit, or because memory is low, are
+///     not passed to this callback; they are abandoned and the IoT Hub delivers them again
+///     later.
+/// </remarks>
 typedef void (*MessageReceivedFnType)(const char *payload);
 
 /// <summary>
@@ -78,11 +201,31 @@ typedef void (*MessageReceivedFnType)(const char *payload);
 /// <param name="callback">The callback function invoked when a message is received</param>
 void AzureIoT_SetMessageReceivedCallback(MessageReceivedFnType callback);
 
+/// <summary>
+///     Type of the function callback invoked with the payload of every message received from
+///     IoT Hub, as provided by the SDK.
+/// </summary>
+/// <param name="payload">Message payload, not zero terminated, valid only during the
+/// call.</param>
+/// <param name="size">Size of the payload in bytes.</param>
+typedef void (*MessageReceivedBufferFnType)(const unsigned char *payload, size_t size);
+
+/// <summary>
+///     Sets a callback function invoked whenever a message is received from IoT Hub. It is
+///     invoked without copying the payload, before the MessageReceivedFnType callback.
+/// </summary>
+void AzureIoT_SetMessageReceivedBufferCallback(MessageReceivedBufferFnType callback);
+
 /// <summary>
 ///     Type of the function callback invoked whenever a Device Twin update from the IoT Hub is
 ///     received.
 /// </summary>
 /// <param name="handle">The JSON object containing the Device Twin desired properties.</handle>
+/// <remarks>
+///     The payload is parsed from a zero terminated copy. Updates that cannot be copied or
+///     parsed because they are too large or memory is low are skipped with a warning; the
+///     complete Device Twin is received again after the next reconnection.
+/// </remarks>
 typedef void (*TwinUpdateFnType)(JSON_Object *desiredProperties);
 
 /// <summary>
@@ -93,6 +236,25 @@ typedef void (*TwinUpdateFnType)(JSON_Object *desiredProperties);
 /// received</param>
 void AzureIoT_SetDeviceTwinUpdateCallback(TwinUpdateFnType callback);
 
+/// <summary>
+///     Type of the function callback invoked with the Device Twin payload as provided by the
+///     SDK.
+/// </summary>
+/// <param name="isCompleteDocument">'true' for the complete Device Twin document received
+/// after (re)connecting, 'false' for a desired properties patch.</param>
+/// <param name="payload">JSON payload, not zero terminated, valid only during the call.</param>
+/// <param name="size">Size of the payload in bytes.</param>
+typedef void (*TwinUpdateBufferFnType)(bool isCompleteDocument, const unsigned char *payload,
+                                       size_t size);
+
+/// <summary>
+///     Sets the function callback invoked whenever a Device Twin update from the IoT Hub is
+///     received. It is invoked without copying the payload, before the TwinUpdateFnType
+///     callback. When only this callback is set, no copy of the payload is made and the
+///     payload is not parsed.
+/// </summary>
+void AzureIoT_SetDeviceTwinUpdateBufferCallback(TwinUpdateBufferFnType callback);
+
 /// <summary>
 ///     Type of the function callback invoked when a Direct Method call from the IoT Hub is
 ///     received.
@@ -156,6 +318,36 @@ typedef void (*DeviceTwinDeliveryConfirmationFnType)(int httpStatusCode);
 void AzureIoT_SetDeviceTwinDeliveryConfirmationCallback(
     DeviceTwinDeliveryConfirmationFnType callback);
 
+/// <summary>
+///     State of one client: its message buffer, connection state machine, reported properties
+///     cache and statistics. The callbacks set by the AzureIoT_Set...Callback() functions are
+///     shared by all client states.
+/// </summary>
+typedef struct AzureIoT_ClientState AzureIoT_ClientState;
+
+/// <summary>
+///     Creates the state of a further client, e.g. to run a fleet of clients in one host
+///     process. The application uses the default client state only.
+/// </summary>
+/// <returns>The new state, NULL if out of memory.</returns>
+AzureIoT_ClientState *AzureIoT_CreateClientState(void);
+
+/// <summary>
+///     Destroys the client of a state created by AzureIoT_CreateClientState(), drops its
+///     buffered messages and frees the state. The calling thread falls back to the default
+///     client state if it had this one selected.
+/// </summary>
+void AzureIoT_DestroyClientState(AzureIoT_ClientState *state);
+
+/// <summary>
+///     Selects the client state the AzureIoT_ functions act upon in the calling thread, until
+///     the next call. The transport keeps a state of its own, e.g. see
+///     FakeHub_SelectState(). A state must be used by one thread at a time.
+/// </summary>
+/// <param name="state">State created by AzureIoT_CreateClientState(), NULL for the default
+/// client state.</param>
+void AzureIoT_SelectClientState(AzureIoT_ClientState *state);
+
 /// <summary>
 ///     Initializes the Azure IoT Hub SDK.
 /// </summary>
@@ -0,0 +1,67 @@
+/***************************************************************************//**
+* @file    backoff.c
+* @version 1.0.0
+*
+* @brief Exponential backoff with full jitter.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include "backoff.h"
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+void
+backoff_init(backoff_t *p_backoff, uint32_t base_ms, uint32_t cap_ms,
+    uint32_t seed)
+{
+    p_backoff->base_ms = base_ms;
+    p_backoff->cap_ms = cap_ms;
+    p_backoff->attempt = 0;
+    p_backoff->rng = (seed != 0) ? seed : 0x9E3779B9u;
+}
+
+uint32_t
+backoff_next(backoff_t *p_backoff)
+{
+    uint32_t ceiling = p_backoff->cap_ms;
+
+    // base * 2^attempt, without overflowing
+    if ((p_backoff->attempt < 32) &&
+        (p_backoff->base_ms <= (p_backoff->cap_ms >> p_backoff->attempt)))
+    {
+        ceiling = p_backoff->base_ms << p_backoff->attempt;
+    }
+
+    if (p_backoff->attempt < UINT32_MAX)
+    {
+        p_backoff->attempt++;
+    }
+
+    return backoff_random(p_backoff, ceiling);
+}
+
+uint32_t
+backoff_random(backoff_t *p_backoff, uint32_t max_ms)
+{
+    uint32_t x = p_backoff->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    p_backoff->rng = x;
+
+    return (max_ms == UINT32_MAX) ? x : x % (max_ms + 1);
+}
+
+void
+backoff_reset(backoff_t *p_backoff)
+{
+    p_backoff->attempt = 0;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,81 @@
+/***************************************************************************//**
+* @file    backoff.h
+* @version 1.0.0
+*
+* @brief Exponential backoff with full jitter.
+*
+* The delay before retry n is drawn uniformly from [0, min(cap, base * 2^n)].
+* Randomizing the whole interval spreads the retries of devices which lost
+* the connection at the same moment, e.g. after a power outage, instead of
+* having them all retry in lockstep.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef BACKOFF_H
+#define BACKOFF_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+*   Data types
+*******************************************************************************/
+
+typedef struct
+{
+    uint32_t base_ms;           // Upper bound of the first delay
+    uint32_t cap_ms;            // Upper bound of any delay
+    uint32_t attempt;           // Retries since last reset
+    uint32_t rng;               // xorshift32 state, never 0
+} backoff_t;
+
+/*******************************************************************************
+*   Function declarations
+*******************************************************************************/
+
+/**
+ * @brief Initialize backoff.
+ *
+ * @param p_backoff Pointer to backoff state.
+ * @param base_ms Upper bound of the first delay.
+ * @param cap_ms Upper bound of any delay.
+ * @param seed Random seed, should differ between devices.
+ */
+void
+backoff_init(backoff_t *p_backoff, uint32_t base_ms, uint32_t cap_ms,
+    uint32_t seed);
+
+/**
+ * @brief Get delay before the next retry and advance the attempt counter.
+ *
+ * @return Delay in milliseconds.
+ */
+uint32_t
+backoff_next(backoff_t *p_backoff);
+
+/**
+ * @brief Get random delay in range [0, max_ms].
+ */
+uint32_t
+backoff_random(backoff_t *p_backoff, uint32_t max_ms);
+
+/**
+ * @brief Start over with the base delay after a successful attempt.
+ */
+void
+backoff_reset(backoff_t *p_backoff);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // BACKOFF_H
+
+/* [] END OF FILE */
@@ -8,6 +8,14 @@ extern "C" {
 // If your application is going to connect straight to a IoT Hub, then enable this define.
 //#define IOT_HUB_APPLICATION
 
+// Replace the IoT Hub by the in process emulation of fake_hub.c, for offline testing of
+// telemetry, Device Twin and Direct Method paths. Use together with IOT_HUB_APPLICATION.
+//#define AZURE_IOT_FAKE_HUB
+
+// Format log ring records to the debug output as they are written, as Log_Debug() did. Costs
+// the formatting on the logging paths again, for debugging only.
+//#define LOG_RING_ECHO
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,118 @@
+/***************************************************************************//**
+* @file    ccs811_baseline.c
+* @version 1.0.0
+*
+* @brief CCS811 baseline persistence.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <string.h>
+
+#include <applibs/log.h>
+
+#include "ccs811_baseline.h"
+#include "ccs811_regs.h"
+#include "i2c_bus.h"
+#include "persist.h"
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+static uint64_t g_start_ms;             // Sensor started measuring
+static uint64_t g_saved_ms;             // Last save, valid with gb_is_saved
+static bool gb_is_saved = false;
+static bool gb_is_restored = false;
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+bool
+ccs811_baseline_restore(int fd_i2c, I2C_DeviceAddress addr, uint64_t uptime_ms,
+    time_t wall_time)
+{
+    ccs811_baseline_record_t record;
+
+    g_start_ms = uptime_ms;
+    gb_is_saved = false;
+    gb_is_restored = false;
+
+    if (!persist_load(PERSIST_REGION_CCS811_BASELINE, &record, sizeof(record)))
+    {
+        Log_Debug("CCS811 baseline: none saved\n");
+        return false;
+    }
+
+    // Unset clock, or saved in the future by a clock set wrong before
+    int64_t age_s = (int64_t)wall_time - record.saved_time;
+    if ((wall_time < CCS811_BASELINE_MIN_TIME) || (age_s < 0) ||
+        (age_s > CCS811_BASELINE_MAX_AGE_S))
+    {
+        Log_Debug("CCS811 baseline: saved %lld s ago, not restored\n",
+            (long long)age_s);
+        return false;
+    }
+
+    uint8_t data[1 + CCS811_BASELINE_SIZE] = { CCS811_REG_BASELINE };
+    memcpy(&data[1], record.baseline, CCS811_BASELINE_SIZE);
+    if (i2c_bus_write(fd_i2c, addr, data, sizeof(data)) != sizeof(data))
+    {
+        Log_Debug("ERROR: Could not write CCS811 baseline.\n");
+        return false;
+    }
+
+    Log_Debug("CCS811 baseline: restored, saved %lld s ago\n",
+        (long long)age_s);
+    gb_is_restored = true;
+
+    return true;
+}
+
+void
+ccs811_baseline_service(int fd_i2c, I2C_DeviceAddress addr, uint64_t uptime_ms,
+    time_t wall_time)
+{
+    // Only the baseline of a conditioned sensor is worth saving
+    if ((uptime_ms - g_start_ms < CCS811_BASELINE_SETTLE_MS) ||
+        (gb_is_saved &&
+        (uptime_ms - g_saved_ms < CCS811_BASELINE_SAVE_PERIOD_MS)) ||
+        (wall_time < CCS811_BASELINE_MIN_TIME))
+    {
+        return;
+    }
+
+    // Retried with the next results on failure
+    const uint8_t reg = CCS811_REG_BASELINE;
+    ccs811_baseline_record_t record;
+    memset(&record, 0, sizeof(record));
+    if (i2c_bus_write_then_read(fd_i2c, addr, &reg, 1, record.baseline,
+        CCS811_BASELINE_SIZE) != (1 + CCS811_BASELINE_SIZE))
+    {
+        Log_Debug("ERROR: Could not read CCS811 baseline.\n");
+        return;
+    }
+
+    // A failed store is retried after the save period
+    record.saved_time = (int64_t)wall_time;
+    if (persist_store(PERSIST_REGION_CCS811_BASELINE, &record, sizeof(record)))
+    {
+        Log_Debug("CCS811 baseline: saved 0x%02X%02X\n", record.baseline[0],
+            record.baseline[1]);
+    }
+    g_saved_ms = uptime_ms;
+    gb_is_saved = true;
+}
+
+bool
+ccs811_baseline_is_settled(uint64_t uptime_ms)
+{
+    return gb_is_restored ||
+        (uptime_ms - g_start_ms >= CCS811_BASELINE_SETTLE_MS);
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,104 @@
+/***************************************************************************//**
+* @file    ccs811_baseline.h
+* @version 1.0.0
+*
+* @brief CCS811 baseline persistence.
+*
+* Without its baseline the CCS811 algorithm needs about 20 minutes after
+* power up before eCO2 and TVOC stop drifting. Once the sensor has run that
+* long, its BASELINE register is saved with the wall clock time to mutable
+* storage (persist.c), then every save period. On the next start a saved
+* baseline not older than CCS811_BASELINE_MAX_AGE_S is written back, so
+* that readings are accurate within seconds.
+*
+* Timestamps need a set wall clock, a baseline is neither saved nor
+* restored before the clock passes CCS811_BASELINE_MIN_TIME.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef CCS811_BASELINE_H
+#define CCS811_BASELINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "applibs_versions.h"
+#ifndef I2C_STRUCTS_VERSION
+#define I2C_STRUCTS_VERSION 1
+#endif
+#include <applibs/i2c.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+#define CCS811_BASELINE_SIZE            (2)
+#define CCS811_BASELINE_SETTLE_MS       (20u * 60u * 1000u)
+#define CCS811_BASELINE_SAVE_PERIOD_MS  (60u * 60u * 1000u)
+#define CCS811_BASELINE_MAX_AGE_S       (72 * 60 * 60)
+#define CCS811_BASELINE_MIN_TIME        ((time_t)1546300800)    // 2019-01-01
+
+/*******************************************************************************
+*   Data types
+*******************************************************************************/
+
+// Persisted record, the baseline is kept as read from the register
+typedef struct
+{
+    uint8_t baseline[CCS811_BASELINE_SIZE];
+    uint8_t reserved[2];
+    int64_t saved_time;         // Wall clock [s]
+} ccs811_baseline_record_t;
+
+/*******************************************************************************
+*   Function declarations
+*******************************************************************************/
+
+/**
+ * @brief Start of sensor operation, restore saved baseline if fresh.
+ *
+ * Call after the sensor has been put into a measurement mode.
+ *
+ * @param fd_i2c I2C interface descriptor.
+ * @param addr CCS811 address.
+ * @param uptime_ms Monotonic time [ms].
+ * @param wall_time Wall clock time.
+ *
+ * @return true if the baseline was restored.
+ */
+bool
+ccs811_baseline_restore(int fd_i2c, I2C_DeviceAddress addr, uint64_t uptime_ms,
+    time_t wall_time);
+
+/**
+ * @brief Save baseline when due, call after reading results.
+ */
+void
+ccs811_baseline_service(int fd_i2c, I2C_DeviceAddress addr, uint64_t uptime_ms,
+    time_t wall_time);
+
+/**
+ * @brief Check whether readings are past the warm-up drift.
+ *
+ * @return true once the baseline was restored or the sensor has run for
+ *         CCS811_BASELINE_SETTLE_MS.
+ */
+bool
+ccs811_baseline_is_settled(uint64_t uptime_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // CCS811_BASELINE_H
+
+/* [] END OF FILE */
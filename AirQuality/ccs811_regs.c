@@ -0,0 +1,92 @@
+/***************************************************************************//**
+* @file    ccs811_regs.c
+* @version 1.0.0
+*
+* @brief CCS811 register map and fixed point register encoding.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <stddef.h>
+
+#include "ccs811_regs.h"
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+void
+ccs811_regs_encode_env_data(int16_t temperature, uint16_t humidity,
+    uint8_t *p_env)
+{
+    int32_t temp = temperature;
+
+    if (temp < CCS811_ENV_TEMPERATURE_MIN)
+    {
+        temp = CCS811_ENV_TEMPERATURE_MIN;
+    }
+    else if (temp > CCS811_ENV_TEMPERATURE_MAX)
+    {
+        temp = CCS811_ENV_TEMPERATURE_MAX;
+    }
+
+    if (humidity > CCS811_ENV_HUMIDITY_MAX)
+    {
+        humidity = CCS811_ENV_HUMIDITY_MAX;
+    }
+
+    // Hundredths to 1/512 units, rounded
+    uint16_t humi_reg = (uint16_t)(((uint32_t)humidity * 512u + 50u) / 100u);
+    uint16_t temp_reg = (uint16_t)(((uint32_t)(temp - CCS811_ENV_TEMPERATURE_MIN) *
+        512u + 50u) / 100u);
+
+    p_env[0] = (uint8_t)(humi_reg >> 8);
+    p_env[1] = (uint8_t)humi_reg;
+    p_env[2] = (uint8_t)(temp_reg >> 8);
+    p_env[3] = (uint8_t)temp_reg;
+}
+
+void
+ccs811_regs_decode_alg_result(const uint8_t *p_data,
+    ccs811_alg_result_t *p_result)
+{
+    p_result->eco2 = (uint16_t)((p_data[0] << 8) | p_data[1]);
+    p_result->tvoc = (uint16_t)((p_data[2] << 8) | p_data[3]);
+    p_result->status = p_data[4];
+
+    // ERROR_ID is only meaningful while STATUS reports an error
+    p_result->error_id = (p_data[4] & CCS811_STATUS_ERROR) ? p_data[5] : 0;
+}
+
+const char *
+ccs811_regs_get_error_name(uint8_t error_id)
+{
+    // Most severe first
+    static const struct
+    {
+        uint8_t bit;
+        const char *p_name;
+    } errors[] = {
+        { CCS811_ERROR_HEATER_SUPPLY, "HEATER_SUPPLY" },
+        { CCS811_ERROR_HEATER_FAULT, "HEATER_FAULT" },
+        { CCS811_ERROR_MAX_RESISTANCE, "MAX_RESISTANCE" },
+        { CCS811_ERROR_MEASMODE_INVALID, "MEASMODE_INVALID" },
+        { CCS811_ERROR_READ_REG_INVALID, "READ_REG_INVALID" },
+        { CCS811_ERROR_WRITE_REG_INVALID, "WRITE_REG_INVALID" }
+    };
+
+    for (size_t idx = 0; idx < sizeof(errors) / sizeof(errors[0]); idx++)
+    {
+        if (error_id & errors[idx].bit)
+        {
+            return errors[idx].p_name;
+        }
+    }
+
+    return "UNKNOWN";
+}
+
+/* [] END OF FILE */
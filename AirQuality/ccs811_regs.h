@@ -0,0 +1,116 @@
+/***************************************************************************//**
+* @file    ccs811_regs.h
+* @version 1.0.0
+*
+* @brief CCS811 register map and fixed point register encoding.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef CCS811_REGS_H
+#define CCS811_REGS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+#define CCS811_REG_STATUS           (0x00)
+#define CCS811_REG_MEAS_MODE        (0x01)
+#define CCS811_REG_ALG_RESULT_DATA  (0x02)
+#define CCS811_REG_RAW_DATA         (0x03)
+#define CCS811_REG_ENV_DATA         (0x05)
+#define CCS811_REG_THRESHOLDS       (0x10)
+#define CCS811_REG_BASELINE         (0x11)
+#define CCS811_REG_HW_ID            (0x20)
+#define CCS811_REG_ERROR_ID         (0xE0)
+#define CCS811_REG_APP_START        (0xF4)
+#define CCS811_REG_SW_RESET         (0xFF)
+
+#define CCS811_HW_ID_VALUE          (0x81)
+
+#define CCS811_ENV_DATA_SIZE        (4)
+
+// ALG_RESULT_DATA up to ERROR_ID: eCO2, TVOC, STATUS, ERROR_ID
+#define CCS811_ALG_RESULT_SIZE      (6)
+
+// STATUS bits
+#define CCS811_STATUS_ERROR         (0x01)
+#define CCS811_STATUS_DATA_READY    (0x08)
+#define CCS811_STATUS_APP_VALID     (0x10)
+#define CCS811_STATUS_FW_MODE       (0x80)
+
+// ERROR_ID bits
+#define CCS811_ERROR_WRITE_REG_INVALID  (0x01)
+#define CCS811_ERROR_READ_REG_INVALID   (0x02)
+#define CCS811_ERROR_MEASMODE_INVALID   (0x04)
+#define CCS811_ERROR_MAX_RESISTANCE     (0x08)
+#define CCS811_ERROR_HEATER_FAULT       (0x10)
+#define CCS811_ERROR_HEATER_SUPPLY      (0x20)
+
+// ENV_DATA limits, temperature is stored with +25 degC offset
+#define CCS811_ENV_TEMPERATURE_MIN  (-2500)     // [0.01 degC]
+#define CCS811_ENV_TEMPERATURE_MAX  (10299)     // [0.01 degC]
+#define CCS811_ENV_HUMIDITY_MAX     (10000)     // [0.01 %RH]
+
+/*******************************************************************************
+*   Data types
+*******************************************************************************/
+
+typedef struct
+{
+    uint16_t eco2;              // [ppm]
+    uint16_t tvoc;              // [ppb]
+    uint8_t status;             // CCS811_STATUS_* bits
+    uint8_t error_id;           // CCS811_ERROR_* bits, with CCS811_STATUS_ERROR
+} ccs811_alg_result_t;
+
+/*******************************************************************************
+*   Function declarations
+*******************************************************************************/
+
+/**
+ * @brief Encode ENV_DATA register contents.
+ *
+ * Humidity and temperature + 25 degC are stored as unsigned big endian
+ * values in 1/512 units. Values are clamped to the register range.
+ *
+ * @param temperature Temperature [0.01 degC].
+ * @param humidity Relative humidity [0.01 %RH].
+ * @param p_env ENV_DATA output, CCS811_ENV_DATA_SIZE bytes.
+ */
+void
+ccs811_regs_encode_env_data(int16_t temperature, uint16_t humidity,
+    uint8_t *p_env);
+
+/**
+ * @brief Decode ALG_RESULT_DATA register contents.
+ *
+ * @param p_data CCS811_ALG_RESULT_SIZE bytes read from ALG_RESULT_DATA.
+ * @param p_result Decoded results.
+ */
+void
+ccs811_regs_decode_alg_result(const uint8_t *p_data,
+    ccs811_alg_result_t *p_result);
+
+/**
+ * @brief Get name of the most severe error in ERROR_ID, e.g. "HEATER_FAULT".
+ */
+const char *
+ccs811_regs_get_error_name(uint8_t error_id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // CCS811_REGS_H
+
+/* [] END OF FILE */
@@ -0,0 +1,320 @@
+/***************************************************************************//**
+* @file    device_config.c
+* @version 1.0.0
+*
+* @brief Runtime device configuration controlled by Device Twin.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "device_config.h"
+
+// This application Azure IoT configuration
+#include "azure_iot_settings.h"
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+// Device Twin names of CCS811 drive modes
+static const struct
+{
+    ccs811_mode_t mode;
+    const char *name;
+} CCS811_MODE_NAMES[] = {
+    { CCS811_MODE_1S,       "1s" },
+    { CCS811_MODE_10S,      "10s" },
+    { CCS811_MODE_60S,      "60s" },
+    { CCS811_MODE_250MS,    "250ms" },
+};
+
+#define CCS811_MODE_COUNT   (sizeof(CCS811_MODE_NAMES) / sizeof(CCS811_MODE_NAMES[0]))
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+/**
+ * @brief Read whole number property value in given range.
+ *
+ * @return 1 if value was read, -1 if it is not a whole number in range.
+ */
+static int
+get_uint_property(const json_scan_value_t *p_value, uint32_t min,
+    uint32_t max, uint32_t *p_number);
+
+/**
+ * @brief Append one reported property to JSON buffer.
+ *
+ * @param b_is_rejected The desired value has been refused, p_value is the
+ *                      value still in use.
+ *
+ * @return 0 on success, -1 if it does not fit.
+ */
+static int
+append_property(char *p_buffer, size_t buffer_size, size_t *p_len,
+    const char *p_name, const char *p_value, int desired_version,
+    bool b_is_rejected);
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+void
+device_config_init(device_config_t *p_config)
+{
+    p_config->upload_period_sec = CONFIG_UPLOAD_PERIOD_DEFAULT;
+    p_config->ccs811_mode = CONFIG_CCS811_MODE_DEFAULT;
+    p_config->display_refresh_sec = CONFIG_DISPLAY_REFRESH_DEFAULT;
+    p_config->power_mode = CONFIG_POWER_MODE_DEFAULT;
+    p_config->desired_version = 0;
+}
+
+uint32_t
+device_config_apply_desired(device_config_t *p_config,
+    const json_scan_value_t *p_desired, uint32_t *p_present,
+    uint32_t *p_rejected)
+{
+    uint32_t changed = 0;
+    uint32_t present = 0;
+    uint32_t rejected = 0;
+    json_scan_value_t name;
+    json_scan_value_t value;
+    size_t pos = 0;
+
+    // One pass over the members, nested values are skipped
+    while (json_scan_next_member(p_desired, &pos, &name, &value))
+    {
+        uint32_t item = 0;
+        uint32_t number;
+        int res = 0;
+
+        if (json_scan_string_equals(&name, "$version"))
+        {
+            double version;
+            if (json_scan_get_number(&value, &version))
+            {
+                p_config->desired_version = (int)version;
+            }
+        }
+        else if (json_scan_string_equals(&name, CONFIG_PROP_UPLOAD_PERIOD))
+        {
+            // Upload period
+            item = CONFIG_ITEM_UPLOAD_PERIOD;
+            res = get_uint_property(&value, CONFIG_UPLOAD_PERIOD_MIN,
+                CONFIG_UPLOAD_PERIOD_MAX, &number);
+            if ((res > 0) && (number != p_config->upload_period_sec))
+            {
+                p_config->upload_period_sec = number;
+                changed |= item;
+            }
+        }
+        else if (json_scan_string_equals(&name, CONFIG_PROP_CCS811_MODE))
+        {
+            // CCS811 drive mode
+            size_t idx;
+
+            item = CONFIG_ITEM_CCS811_MODE;
+            for (idx = 0; idx < CCS811_MODE_COUNT; idx++)
+            {
+                if (json_scan_string_equals(&value,
+                    CCS811_MODE_NAMES[idx].name))
+                {
+                    break;
+                }
+            }
+
+            if (idx == CCS811_MODE_COUNT)
+            {
+                res = -1;
+            }
+            else if (CCS811_MODE_NAMES[idx].mode != p_config->ccs811_mode)
+            {
+                p_config->ccs811_mode = CCS811_MODE_NAMES[idx].mode;
+                changed |= item;
+            }
+        }
+        else if (json_scan_string_equals(&name, CONFIG_PROP_DISPLAY_REFRESH))
+        {
+            // Display refresh cap
+            item = CONFIG_ITEM_DISPLAY_REFRESH;
+            res = get_uint_property(&value, 0, CONFIG_DISPLAY_REFRESH_MAX,
+                &number);
+            if ((res > 0) && (number != p_config->display_refresh_sec))
+            {
+                p_config->display_refresh_sec = number;
+                changed |= item;
+            }
+        }
+        else if (json_scan_string_equals(&name, CONFIG_PROP_POWER_MODE))
+        {
+            // Operating mode, names are short
+            char power_name[16];
+            power_mode_t power_mode;
+
+            item = CONFIG_ITEM_POWER_MODE;
+            if (!json_scan_get_string(&value, power_name, sizeof(power_name)) ||
+                !power_mode_from_name(power_name, &power_mode))
+            {
+                res = -1;
+            }
+            else if (power_mode != p_config->power_mode)
+            {
+                p_config->power_mode = power_mode;
+                changed |= item;
+            }
+        }
+
+        present |= item;
+        if (res < 0)
+        {
+            rejected |= item;
+        }
+    }
+
+    if (p_present)
+    {
+        *p_present = present;
+    }
+    if (p_rejected)
+    {
+        *p_rejected = rejected;
+    }
+
+    return changed;
+}
+
+int
+device_config_to_json(const device_config_t *p_config, uint32_t item_mask,
+    uint32_t rejected_mask, char *p_buffer, size_t buffer_size)
+{
+    char value[24];
+    size_t len = 0;
+    int result = 0;
+
+    if (buffer_size < 3)
+    {
+        return -1;
+    }
+    p_buffer[len++] = '{';
+
+    if ((result == 0) && (item_mask & CONFIG_ITEM_UPLOAD_PERIOD))
+    {
+        snprintf(value, sizeof(value), "%lu",
+            (unsigned long)p_config->upload_period_sec);
+        result = append_property(p_buffer, buffer_size, &len,
+            CONFIG_PROP_UPLOAD_PERIOD, value, p_config->desired_version,
+            (rejected_mask & CONFIG_ITEM_UPLOAD_PERIOD) != 0);
+    }
+
+    if ((result == 0) && (item_mask & CONFIG_ITEM_CCS811_MODE))
+    {
+        snprintf(value, sizeof(value), "\"%s\"",
+            device_config_ccs811_mode_name(p_config->ccs811_mode));
+        result = append_property(p_buffer, buffer_size, &len,
+            CONFIG_PROP_CCS811_MODE, value, p_config->desired_version,
+            (rejected_mask & CONFIG_ITEM_CCS811_MODE) != 0);
+    }
+
+    if ((result == 0) && (item_mask & CONFIG_ITEM_DISPLAY_REFRESH))
+    {
+        snprintf(value, sizeof(value), "%lu",
+            (unsigned long)p_config->display_refresh_sec);
+        result = append_property(p_buffer, buffer_size, &len,
+            CONFIG_PROP_DISPLAY_REFRESH, value, p_config->desired_version,
+            (rejected_mask & CONFIG_ITEM_DISPLAY_REFRESH) != 0);
+    }
+
+    if ((result == 0) && (item_mask & CONFIG_ITEM_POWER_MODE))
+    {
+        snprintf(value, sizeof(value), "\"%s\"",
+            power_mode_get_profile(p_config->power_mode)->name);
+        result = append_property(p_buffer, buffer_size, &len,
+            CONFIG_PROP_POWER_MODE, value, p_config->desired_version,
+            (rejected_mask & CONFIG_ITEM_POWER_MODE) != 0);
+    }
+
+    if ((result != 0) || (len + 2 > buffer_size))
+    {
+        return -1;
+    }
+    p_buffer[len++] = '}';
+    p_buffer[len] = '\0';
+
+    return (int)len;
+}
+
+const char *
+device_config_ccs811_mode_name(ccs811_mode_t mode)
+{
+    for (size_t idx = 0; idx < CCS811_MODE_COUNT; idx++)
+    {
+        if (CCS811_MODE_NAMES[idx].mode == mode)
+        {
+            return CCS811_MODE_NAMES[idx].name;
+        }
+    }
+    return "idle";
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+static int
+get_uint_property(const json_scan_value_t *p_value, uint32_t min,
+    uint32_t max, uint32_t *p_number)
+{
+    double number;
+
+    if (!json_scan_get_number(p_value, &number) ||
+        (number < min) || (number > max) ||
+        ((double)(uint32_t)number != number))
+    {
+        return -1;
+    }
+
+    *p_number = (uint32_t)number;
+    return 1;
+}
+
+static int
+append_property(char *p_buffer, size_t buffer_size, size_t *p_len,
+    const char *p_name, const char *p_value, int desired_version,
+    bool b_is_rejected)
+{
+    size_t remaining = buffer_size - *p_len;
+    const char *p_separator = (*p_len > 1) ? "," : "";
+    int written;
+
+#   ifdef IOT_CENTRAL_APPLICATION
+    // Writable property acknowledgement, a refused value is reported with
+    // the value still in use
+    written = snprintf(p_buffer + *p_len, remaining,
+        "%s\"%s\":{\"value\":%s,\"ac\":%d,\"ad\":\"%s\",\"av\":%d}",
+        p_separator, p_name, p_value,
+        b_is_rejected ? CONFIG_ACK_REJECTED : CONFIG_ACK_COMPLETED,
+        b_is_rejected ? "rejected" : "completed", desired_version);
+#   else
+    (void)desired_version;
+    (void)b_is_rejected;
+    written = snprintf(p_buffer + *p_len, remaining, "%s\"%s\":%s",
+        p_separator, p_name, p_value);
+#   endif
+
+    if ((written < 0) || ((size_t)written >= remaining))
+    {
+        return -1;
+    }
+
+    *p_len += (size_t)written;
+    return 0;
+}
+
+/* [] END OF FILE */
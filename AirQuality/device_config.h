@@ -0,0 +1,159 @@
+/***************************************************************************//**
+* @file    device_config.h
+* @version 1.0.0
+*
+* @brief Runtime device configuration controlled by Device Twin.
+*
+* Configuration values are received as Device Twin desired properties,
+* validated and stored here. Caller is responsible for applying changed
+* values to timers and peripherals and for acknowledging them back
+* to the cloud as reported properties.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef DEVICE_CONFIG_H
+#define DEVICE_CONFIG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "json_scan.h"
+#include "lib_ccs811.h"
+#include "power_mode.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+// Device Twin desired property names
+#define CONFIG_PROP_UPLOAD_PERIOD       "uploadPeriodSec"
+#define CONFIG_PROP_CCS811_MODE         "ccs811Mode"
+#define CONFIG_PROP_DISPLAY_REFRESH     "displayMinRefreshSec"
+#define CONFIG_PROP_POWER_MODE          "powerMode"
+
+// Azure upload period limits [seconds]
+#define CONFIG_UPLOAD_PERIOD_DEFAULT    (60)
+#define CONFIG_UPLOAD_PERIOD_MIN        (10)
+#define CONFIG_UPLOAD_PERIOD_MAX        (24 * 60 * 60)
+
+// CCS811 measurement mode used until Device Twin says otherwise
+#define CONFIG_CCS811_MODE_DEFAULT      CCS811_MODE_10S
+
+// Minimal time between two display refreshes [seconds], 0 = no limit
+#define CONFIG_DISPLAY_REFRESH_DEFAULT  (0)
+#define CONFIG_DISPLAY_REFRESH_MAX      (60 * 60)
+
+// Operating mode, "normal" or "low"
+#ifndef CONFIG_POWER_MODE_DEFAULT
+#define CONFIG_POWER_MODE_DEFAULT       POWER_MODE_NORMAL
+#endif
+
+// Bits identifying configuration items in change masks
+#define CONFIG_ITEM_UPLOAD_PERIOD       (1u << 0)
+#define CONFIG_ITEM_CCS811_MODE         (1u << 1)
+#define CONFIG_ITEM_DISPLAY_REFRESH     (1u << 2)
+#define CONFIG_ITEM_POWER_MODE          (1u << 3)
+
+#define CONFIG_ITEM_ALL                 (CONFIG_ITEM_UPLOAD_PERIOD | \
+                                         CONFIG_ITEM_CCS811_MODE | \
+                                         CONFIG_ITEM_DISPLAY_REFRESH | \
+                                         CONFIG_ITEM_POWER_MODE)
+
+// Acknowledgement codes of desired values
+#define CONFIG_ACK_COMPLETED            (200)
+#define CONFIG_ACK_REJECTED             (400)
+
+/*******************************************************************************
+*   Data types
+*******************************************************************************/
+
+typedef struct
+{
+    uint32_t upload_period_sec;     // Azure upload period
+    ccs811_mode_t ccs811_mode;      // CCS811 drive mode
+    uint32_t display_refresh_sec;   // Minimal display refresh interval
+    power_mode_t power_mode;        // Operating mode profile
+    int desired_version;            // Last seen desired properties $version
+} device_config_t;
+
+/*******************************************************************************
+*   Function declarations
+*******************************************************************************/
+
+/**
+ * @brief Fill configuration with default values.
+ *
+ * @param p_config Pointer to configuration storage.
+ */
+void
+device_config_init(device_config_t *p_config);
+
+/**
+ * @brief Apply Device Twin desired properties to configuration.
+ *
+ * Only known properties carrying valid values are applied, properties
+ * not present in desired properties are left untouched. Invalid values,
+ * out of range or not whole numbers, keep the last accepted value.
+ *
+ * @param p_config Pointer to configuration storage.
+ * @param p_desired Desired properties object of a document validated by
+ *                  json_scan_parse().
+ * @param p_present Optional output mask of present items, valid or not.
+ * @param p_rejected Optional output mask of present but invalid items.
+ *
+ * @return Mask of CONFIG_ITEM_* bits whose values have been changed.
+ */
+uint32_t
+device_config_apply_desired(device_config_t *p_config,
+    const json_scan_value_t *p_desired, uint32_t *p_present,
+    uint32_t *p_rejected);
+
+/**
+ * @brief Serialize selected configuration items as reported properties.
+ *
+ * When IOT_CENTRAL_APPLICATION is defined, each value is wrapped into
+ * the writable property acknowledgement IoT Central expects:
+ *
+ *   {"value":v,"ac":code,"ad":"completed"|"rejected","av":desiredVersion}
+ *
+ * Rejected items carry the value still in use and CONFIG_ACK_REJECTED.
+ *
+ * @param p_config Pointer to configuration storage.
+ * @param item_mask Mask of CONFIG_ITEM_* bits to serialize.
+ * @param rejected_mask Mask of CONFIG_ITEM_* bits whose desired value has
+ *                      been refused.
+ * @param p_buffer Output buffer.
+ * @param buffer_size Output buffer size.
+ *
+ * @return Length of JSON string written, -1 if it does not fit.
+ */
+int
+device_config_to_json(const device_config_t *p_config, uint32_t item_mask,
+    uint32_t rejected_mask, char *p_buffer, size_t buffer_size);
+
+/**
+ * @brief Get Device Twin string for CCS811 drive mode.
+ *
+ * @param mode CCS811 drive mode.
+ *
+ * @return Mode name, e.g. "10s".
+ */
+const char *
+device_config_ccs811_mode_name(ccs811_mode_t mode);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // DEVICE_CONFIG_H
+
+/* [] END OF FILE */
@@ -0,0 +1,492 @@
+/***************************************************************************//**
+* @file    display_manager.c
+* @version 1.0.0
+*
+* @brief OLED refresh scheduling and panel power management.
+*
+* A single timer is armed for the earliest of the pending frame, the dim
+* and power off deadlines and the next pixel shift. The pixel shift moves
+* the physical frame buffer by one column and/or one row just for the
+* transfer, so drawing code and in place scrolling are not affected.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include <applibs/log.h>
+
+#include "epoll_timerfd_utilities.h"
+#include "event_loop_stats.h"
+#include "display_manager.h"
+#include "log_ring.h"
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+
+// Largest frame buffer that can be shifted, SSD1306 128x64
+#define DISPLAY_SHADOW_SIZE         (128u * 64u / 8u)
+
+// Shift pattern steps, offsets in physical columns and rows
+#define DISPLAY_SHIFT_STEPS         (4u)
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+static void
+display_event_handler(EventData *p_event_data);
+
+static void
+frame_send(uint64_t now_ms);
+
+static void
+buffer_shift(uint8_t *p_buffer, uint16_t width, uint16_t pages, uint8_t dx,
+    uint8_t dy);
+
+static void
+power_set(display_power_t power, uint64_t now_ms);
+
+static void
+on_time_update(uint64_t now_ms);
+
+static void
+schedule_next(uint64_t now_ms);
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+static const uint8_t g_shift_dx[DISPLAY_SHIFT_STEPS] = { 0, 1, 1, 0 };
+static const uint8_t g_shift_dy[DISPLAY_SHIFT_STEPS] = { 0, 0, 1, 1 };
+
+static u8g2_t *gp_u8g2 = NULL;
+static display_render_fn_t gp_render = NULL;
+static latency_hist_t *gp_hist_push = NULL;
+
+static int g_fd_timer = -1;
+
+static EventData g_event_data_display = {
+    .eventHandler = &display_event_handler,
+    .name = "display"
+};
+
+static display_power_t g_power = DISPLAY_POWER_ON;
+static uint32_t g_refresh_ms = 0;
+static uint32_t g_dim_ms = DISPLAY_DIM_AFTER_MS;
+static uint32_t g_off_ms = DISPLAY_OFF_AFTER_MS;
+
+// Frame waiting for the refresh interval, composed before sending
+static bool gb_is_pending = false;
+static bool gb_needs_render = false;
+
+static uint64_t g_sent_ms = 0;          // Last frame, 0 = none yet
+static uint64_t g_activity_ms = 0;      // Last user activity
+static uint64_t g_shift_ms = 0;         // Last pixel shift
+static uint64_t g_on_since_ms = 0;      // Start of on time not yet counted
+static uint32_t g_shift_step = 0;
+
+static display_manager_stats_t g_stats;
+
+// Frame buffer saved while the shifted frame is sent
+static uint8_t g_shadow[DISPLAY_SHADOW_SIZE];
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+int
+display_manager_init(int fd_epoll, u8g2_t *p_u8g2,
+    display_render_fn_t p_render, latency_hist_t *p_hist_push)
+{
+    static const struct timespec disarmed = { 0, 0 };
+    uint64_t now_ms = loop_stats_now_us() / 1000u;
+
+    gp_u8g2 = p_u8g2;
+    gp_render = p_render;
+    gp_hist_push = p_hist_push;
+
+    g_power = DISPLAY_POWER_ON;
+    gb_is_pending = false;
+    gb_needs_render = false;
+    g_sent_ms = 0;
+    g_activity_ms = now_ms;
+    g_shift_ms = now_ms;
+    g_on_since_ms = now_ms;
+    g_shift_step = 0;
+
+    // Bytes of the panel initialization stay counted
+    uint64_t i2c_bytes = g_stats.i2c_bytes;
+    memset(&g_stats, 0, sizeof(g_stats));
+    g_stats.i2c_bytes = i2c_bytes;
+
+    u8g2_SetContrast(gp_u8g2, DISPLAY_CONTRAST);
+
+    g_fd_timer = CreateTimerFdAndAddToEpoll(fd_epoll, &disarmed,
+        &g_event_data_display, EPOLLIN);
+    if (g_fd_timer < 0)
+    {
+        return -1;
+    }
+
+    schedule_next(now_ms);
+    return 0;
+}
+
+void
+display_manager_set_refresh(uint32_t refresh_ms)
+{
+    g_refresh_ms = refresh_ms;
+
+    if (g_fd_timer >= 0)
+    {
+        schedule_next(loop_stats_now_us() / 1000u);
+    }
+}
+
+void
+display_manager_set_timeouts(uint32_t dim_ms, uint32_t off_ms)
+{
+    g_dim_ms = dim_ms;
+    g_off_ms = off_ms;
+
+    if (g_fd_timer >= 0)
+    {
+        schedule_next(loop_stats_now_us() / 1000u);
+    }
+}
+
+void
+display_manager_update(display_update_t update)
+{
+    uint64_t now_ms = loop_stats_now_us() / 1000u;
+
+    if (update != DISPLAY_UPDATE_FLUSH)
+    {
+        gb_needs_render = true;
+    }
+
+    if (g_power == DISPLAY_POWER_OFF)
+    {
+        // Composed from scratch on wake, in place changes are lost
+        gb_needs_render = true;
+        g_stats.suppressed++;
+        return;
+    }
+
+    if (update == DISPLAY_UPDATE_IMMEDIATE)
+    {
+        frame_send(now_ms);
+    }
+    else if (gb_is_pending)
+    {
+        g_stats.coalesced++;
+        return;
+    }
+    else if ((g_refresh_ms == 0) || (g_sent_ms == 0) ||
+        (now_ms - g_sent_ms >= g_refresh_ms))
+    {
+        frame_send(now_ms);
+    }
+    else
+    {
+        gb_is_pending = true;
+    }
+
+    schedule_next(now_ms);
+}
+
+bool
+display_manager_wake(void)
+{
+    uint64_t now_ms = loop_stats_now_us() / 1000u;
+    display_power_t power = g_power;
+
+    g_activity_ms = now_ms;
+
+    if (power != DISPLAY_POWER_ON)
+    {
+        g_stats.wakeups++;
+        power_set(DISPLAY_POWER_ON, now_ms);
+
+        // Content may have changed while the panel was off
+        if (power == DISPLAY_POWER_OFF)
+        {
+            frame_send(now_ms);
+        }
+    }
+
+    schedule_next(now_ms);
+    return (power != DISPLAY_POWER_ON);
+}
+
+display_power_t
+display_manager_get_power(void)
+{
+    return g_power;
+}
+
+uint8_t
+display_manager_byte_i2c(u8x8_t *p_u8x8, uint8_t msg, uint8_t arg_int,
+    void *p_arg)
+{
+    if (msg == U8X8_MSG_BYTE_SEND)
+    {
+        g_stats.i2c_bytes += arg_int;
+    }
+
+    return lib_u8g2_byte_i2c(p_u8x8, msg, arg_int, p_arg);
+}
+
+void
+display_manager_get_stats(display_manager_stats_t *p_stats, bool b_reset)
+{
+    on_time_update(loop_stats_now_us() / 1000u);
+    *p_stats = g_stats;
+
+    if (b_reset)
+    {
+        memset(&g_stats, 0, sizeof(g_stats));
+    }
+}
+
+int
+display_manager_stats_to_json(const display_manager_stats_t *p_stats,
+    char *p_buffer, size_t buffer_size)
+{
+    int written = snprintf(p_buffer, buffer_size, "[%lu,%lu,%lu,%lu,%llu,%lu]",
+        (unsigned long)p_stats->frames,
+        (unsigned long)p_stats->coalesced,
+        (unsigned long)p_stats->suppressed,
+        (unsigned long)p_stats->wakeups,
+        (unsigned long long)p_stats->i2c_bytes,
+        (unsigned long)(p_stats->on_ms / 1000u));
+
+    if ((written < 0) || ((size_t)written >= buffer_size))
+    {
+        return -1;
+    }
+
+    return written;
+}
+
+void
+display_manager_close(void)
+{
+    CloseFdAndPrintError(g_fd_timer, "Display timer");
+    g_fd_timer = -1;
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+static void
+display_event_handler(EventData *p_event_data)
+{
+    if (ConsumeTimerFdEvent(g_fd_timer) != 0)
+    {
+        return;
+    }
+
+    uint64_t now_ms = loop_stats_now_us() / 1000u;
+
+    if ((g_off_ms > 0) && (g_power != DISPLAY_POWER_OFF) &&
+        (now_ms - g_activity_ms >= g_off_ms))
+    {
+        power_set(DISPLAY_POWER_OFF, now_ms);
+    }
+    else if ((g_dim_ms > 0) && (g_power == DISPLAY_POWER_ON) &&
+        (now_ms - g_activity_ms >= g_dim_ms))
+    {
+        power_set(DISPLAY_POWER_DIM, now_ms);
+    }
+
+    if (g_power != DISPLAY_POWER_OFF)
+    {
+        if ((DISPLAY_SHIFT_PERIOD_MS > 0) &&
+            (now_ms - g_shift_ms >= DISPLAY_SHIFT_PERIOD_MS))
+        {
+            // Resend the unchanged frame at the next offset
+            g_shift_step = (g_shift_step + 1u) % DISPLAY_SHIFT_STEPS;
+            g_shift_ms = now_ms;
+            gb_is_pending = true;
+        }
+
+        if (gb_is_pending && ((g_refresh_ms == 0) ||
+            (now_ms - g_sent_ms >= g_refresh_ms)))
+        {
+            frame_send(now_ms);
+        }
+    }
+
+    schedule_next(now_ms);
+}
+
+/**
+ * @brief Compose frame if needed and transfer it at the current offset.
+ */
+static void
+frame_send(uint64_t now_ms)
+{
+    uint8_t *p_buffer = u8g2_GetBufferPtr(gp_u8g2);
+    uint16_t width = (uint16_t)(u8g2_GetBufferTileWidth(gp_u8g2) * 8u);
+    uint16_t pages = u8g2_GetBufferTileHeight(gp_u8g2);
+    size_t size = (size_t)width * pages;
+    uint8_t dx = g_shift_dx[g_shift_step];
+    uint8_t dy = g_shift_dy[g_shift_step];
+    bool b_is_shifted = ((dx | dy) != 0) && (size <= sizeof(g_shadow));
+
+    if (gb_needs_render && (gp_render != NULL))
+    {
+        gp_render();
+    }
+    gb_needs_render = false;
+    gb_is_pending = false;
+
+    if (b_is_shifted)
+    {
+        memcpy(g_shadow, p_buffer, size);
+        buffer_shift(p_buffer, width, pages, dx, dy);
+    }
+
+    uint64_t start_us = loop_stats_now_us();
+    u8g2_SendBuffer(gp_u8g2);
+    if (gp_hist_push != NULL)
+    {
+        latency_hist_record(gp_hist_push,
+            (uint32_t)(loop_stats_now_us() - start_us));
+    }
+
+    if (b_is_shifted)
+    {
+        memcpy(p_buffer, g_shadow, size);
+    }
+
+    g_sent_ms = now_ms;
+    g_stats.frames++;
+}
+
+/**
+ * @brief Move the physical frame right by dx columns and down by dy rows,
+ *        pixels moved out are dropped.
+ */
+static void
+buffer_shift(uint8_t *p_buffer, uint16_t width, uint16_t pages, uint8_t dx,
+    uint8_t dy)
+{
+    for (uint16_t page = 0; (dx > 0) && (page < pages); page++)
+    {
+        uint8_t *p_page = &p_buffer[page * width];
+        memmove(p_page + dx, p_page, (size_t)(width - dx));
+        memset(p_page, 0, dx);
+    }
+
+    // Bits leaving the bottom of a page enter the top of the next one
+    for (uint16_t page = pages; (dy > 0) && (page-- > 0); )
+    {
+        uint8_t *p_page = &p_buffer[page * width];
+        for (uint16_t x = 0; x < width; x++)
+        {
+            uint8_t carry = (page > 0) ?
+                (uint8_t)(p_page[x - width] >> (8u - dy)) : 0u;
+            p_page[x] = (uint8_t)((p_page[x] << dy) | carry);
+        }
+    }
+}
+
+static void
+power_set(display_power_t power, uint64_t now_ms)
+{
+    if (power == g_power)
+    {
+        return;
+    }
+
+    if (power == DISPLAY_POWER_OFF)
+    {
+        on_time_update(now_ms);
+        u8g2_SetPowerSave(gp_u8g2, 1);
+        gb_is_pending = false;
+        LOG_RING(LOG_DISPLAY_OFF);
+    }
+    else
+    {
+        if (g_power == DISPLAY_POWER_OFF)
+        {
+            u8g2_SetPowerSave(gp_u8g2, 0);
+            g_on_since_ms = now_ms;
+        }
+        u8g2_SetContrast(gp_u8g2, (power == DISPLAY_POWER_DIM) ?
+            DISPLAY_DIM_CONTRAST : DISPLAY_CONTRAST);
+    }
+
+    g_power = power;
+}
+
+/**
+ * @brief Add time the panel has been on since the last update.
+ */
+static void
+on_time_update(uint64_t now_ms)
+{
+    if (g_power != DISPLAY_POWER_OFF)
+    {
+        g_stats.on_ms += now_ms - g_on_since_ms;
+    }
+    g_on_since_ms = now_ms;
+}
+
+/**
+ * @brief Arm the timer for the earliest of the pending frame, the power
+ *        state change and the pixel shift.
+ */
+static void
+schedule_next(uint64_t now_ms)
+{
+    uint64_t due_ms = UINT64_MAX;
+
+    if (g_power != DISPLAY_POWER_OFF)
+    {
+        if (gb_is_pending)
+        {
+            due_ms = g_sent_ms + g_refresh_ms;
+        }
+        if (g_off_ms > 0)
+        {
+            uint64_t off_ms = g_activity_ms + g_off_ms;
+            due_ms = (off_ms < due_ms) ? off_ms : due_ms;
+        }
+        if ((g_dim_ms > 0) && (g_power == DISPLAY_POWER_ON))
+        {
+            uint64_t dim_ms = g_activity_ms + g_dim_ms;
+            due_ms = (dim_ms < due_ms) ? dim_ms : due_ms;
+        }
+        if (DISPLAY_SHIFT_PERIOD_MS > 0)
+        {
+            uint64_t shift_ms = g_shift_ms + DISPLAY_SHIFT_PERIOD_MS;
+            due_ms = (shift_ms < due_ms) ? shift_ms : due_ms;
+        }
+    }
+
+    // Zero disarms the timer, nothing is due while the panel is off
+    uint64_t delay_ms = (due_ms == UINT64_MAX) ? 0 :
+        (due_ms > now_ms) ? due_ms - now_ms : 0;
+    struct timespec expiry = {
+        (time_t)(delay_ms / 1000u),
+        (delay_ms > 0) ? (long)(delay_ms % 1000u) * 1000000L :
+            (due_ms == UINT64_MAX) ? 0 : 1
+    };
+
+    if (SetTimerFdToSingleExpiry(g_fd_timer, &expiry) != 0)
+    {
+        Log_Debug("ERROR: Could not schedule display update.\n");
+    }
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,178 @@
+/***************************************************************************//**
+* @file    display_manager.h
+* @version 1.0.0
+*
+* @brief OLED refresh scheduling and panel power management.
+*
+* Frames are sent at most once per refresh interval. Updates requested
+* while a frame is pending are merged into it, so the panel shows the
+* latest content at the end of the interval instead of dropping it. The
+* frame is composed by the render callback right before it is sent.
+*
+* After the dim timeout without user activity the panel contrast is
+* lowered, after the off timeout the panel is put into power save and
+* no frames are sent. wake() restores it on a button press. Every
+* DISPLAY_SHIFT_PERIOD_MS the frame is moved by one pixel on the panel to
+* spread the wear of static labels (burn-in).
+*
+* Bytes sent to the panel are counted in the u8x8 byte callback, the panel
+* on time is accumulated for the statistics.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef DISPLAY_MANAGER_H
+#define DISPLAY_MANAGER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lib_u8g2.h"
+#include "latency_histogram.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+// Default inactivity until the panel is dimmed and powered down, 0 = never
+// [ms]
+#ifndef DISPLAY_DIM_AFTER_MS
+#define DISPLAY_DIM_AFTER_MS        (2u * 60u * 1000u)
+#endif
+#ifndef DISPLAY_OFF_AFTER_MS
+#define DISPLAY_OFF_AFTER_MS        (15u * 60u * 1000u)
+#endif
+
+// Period of the burn-in pixel shift, 0 = no shift [ms]
+#ifndef DISPLAY_SHIFT_PERIOD_MS
+#define DISPLAY_SHIFT_PERIOD_MS     (5u * 60u * 1000u)
+#endif
+
+// SSD1306 contrast, normal is the controller reset value
+#define DISPLAY_CONTRAST            (0xCF)
+#define DISPLAY_DIM_CONTRAST        (0x08)
+
+/*******************************************************************************
+*   Data types
+*******************************************************************************/
+
+typedef enum
+{
+    DISPLAY_UPDATE_FLUSH,       // Frame buffer changed in place, send it
+    DISPLAY_UPDATE_RENDER,      // Content changed, compose frame and send it
+    DISPLAY_UPDATE_IMMEDIATE    // User action, compose and send right away
+} display_update_t;
+
+typedef enum
+{
+    DISPLAY_POWER_ON,
+    DISPLAY_POWER_DIM,
+    DISPLAY_POWER_OFF
+} display_power_t;
+
+// Composes the frame into the u8g2 frame buffer
+typedef void (*display_render_fn_t)(void);
+
+typedef struct
+{
+    uint32_t frames;            // Frames sent
+    uint32_t coalesced;         // Updates merged into a pending frame
+    uint32_t suppressed;        // Updates while the panel is off
+    uint32_t wakeups;           // Wakes from dimmed or off
+    uint64_t i2c_bytes;         // Bytes sent to the panel
+    uint64_t on_ms;             // Time the panel has been on
+} display_manager_stats_t;
+
+/*******************************************************************************
+*   Function declarations
+*******************************************************************************/
+
+/**
+ * @brief Start managing the initialized display, the panel is on.
+ *
+ * @param p_hist_push Histogram of frame transfer times [us], may be NULL.
+ *
+ * @return 0 on success, -1 if the timer could not be created.
+ */
+int
+display_manager_init(int fd_epoll, u8g2_t *p_u8g2,
+    display_render_fn_t p_render, latency_hist_t *p_hist_push);
+
+/**
+ * @brief Set minimal interval between two frames, 0 = no limit.
+ */
+void
+display_manager_set_refresh(uint32_t refresh_ms);
+
+/**
+ * @brief Set inactivity until the panel is dimmed and powered down, 0 =
+ *        never.
+ */
+void
+display_manager_set_timeouts(uint32_t dim_ms, uint32_t off_ms);
+
+/**
+ * @brief Request a frame.
+ */
+void
+display_manager_update(display_update_t update);
+
+/**
+ * @brief User activity, restore the panel and restart the inactivity time.
+ *
+ * @return true if the panel was dimmed or off.
+ */
+bool
+display_manager_wake(void);
+
+/**
+ * @brief Get the panel power state.
+ */
+display_power_t
+display_manager_get_power(void);
+
+/**
+ * @brief u8x8 byte callback counting bytes sent, wraps lib_u8g2_byte_i2c().
+ */
+uint8_t
+display_manager_byte_i2c(u8x8_t *p_u8x8, uint8_t msg, uint8_t arg_int,
+    void *p_arg);
+
+/**
+ * @brief Copy statistics, optionally resetting them.
+ */
+void
+display_manager_get_stats(display_manager_stats_t *p_stats, bool b_reset);
+
+/**
+ * @brief Write statistics as JSON.
+ *
+ * Format: [frames,coalesced,suppressed,wakeups,i2cBytes,onSec]
+ *
+ * @return Length of the JSON text, -1 if the buffer is too small.
+ */
+int
+display_manager_stats_to_json(const display_manager_stats_t *p_stats,
+    char *p_buffer, size_t buffer_size);
+
+/**
+ * @brief Close the timer.
+ */
+void
+display_manager_close(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // DISPLAY_MANAGER_H
+
+/* [] END OF FILE */
@@ -7,6 +7,23 @@
 #include <sys/timerfd.h>
 #include <applibs/log.h>
 #include "epoll_timerfd_utilities.h"
+#include "event_loop_stats.h"
+
+/// <summary>
+///     Timer file descriptors below this have their one-shot deadline tracked.
+/// </summary>
+#define DEADLINE_FD_COUNT 64
+
+/// <summary>
+///     CLOCK_MONOTONIC deadline of the expiry armed by SetTimerFdToSingleExpiry, indexed by
+///     timer file descriptor, 0 if none [us].
+/// </summary>
+static uint64_t singleExpiryDeadlineUs[DEADLINE_FD_COUNT];
+
+/// <summary>
+///     Time the handler being run has been dispatched by WaitForEventAndCallHandler [us].
+/// </summary>
+static uint64_t dispatchUs;
 
 int CreateEpollFd(void)
 {
@@ -67,18 +84,28 @@ int SetTimerFdToPeriod(int timerFd, const struct timespec *period)
         return -1;
     }
 
+    if (timerFd >= 0 && timerFd < DEADLINE_FD_COUNT) {
+        singleExpiryDeadlineUs[timerFd] = 0;
+    }
+
     return 0;
 }
 
 int SetTimerFdToSingleExpiry(int timerFd, const struct timespec *expiry)
 {
     struct itimerspec newValue = {.it_value = *expiry, .it_interval = {}};
+    uint64_t nowUs = loop_stats_now_us();
 
     if (timerfd_settime(timerFd, 0, &newValue, NULL) < 0) {
         Log_Debug("ERROR: Could not set timerfd interval: %s (%d).\n", strerror(errno), errno);
         return -1;
     }
 
+    if (timerFd >= 0 && timerFd < DEADLINE_FD_COUNT) {
+        singleExpiryDeadlineUs[timerFd] = nowUs + (uint64_t)expiry->tv_sec * 1000000u +
+                                          (uint64_t)expiry->tv_nsec / 1000u;
+    }
+
     return 0;
 }
 
@@ -91,6 +118,27 @@ int ConsumeTimerFdEvent(int timerFd)
         return -1;
     }
 
+    // For periodic timers the time elapsed since the last expiration is the period
+    // minus the time remaining to the next one.
+    struct itimerspec current;
+    if (timerfd_gettime(timerFd, &current) == 0 &&
+        (current.it_interval.tv_sec != 0 || current.it_interval.tv_nsec != 0)) {
+        int64_t lateNs =
+            ((int64_t)current.it_interval.tv_sec - current.it_value.tv_sec) * 1000000000 +
+            (current.it_interval.tv_nsec - current.it_value.tv_nsec);
+        loop_stats_record_timer(timerData, (lateNs > 0) ? (uint32_t)(lateNs / 1000) : 0);
+    } else if (timerFd >= 0 && timerFd < DEADLINE_FD_COUNT &&
+               singleExpiryDeadlineUs[timerFd] != 0) {
+        // One-shot timers are late by the time from the armed deadline to the dispatch
+        uint64_t deadlineUs = singleExpiryDeadlineUs[timerFd];
+        uint64_t servedUs = (dispatchUs != 0) ? dispatchUs : loop_stats_now_us();
+        uint64_t lateUs = (servedUs > deadlineUs) ? servedUs - deadlineUs : 0;
+        singleExpiryDeadlineUs[timerFd] = 0;
+        loop_stats_record_timer(timerData, (lateUs > UINT32_MAX) ? UINT32_MAX : (uint32_t)lateUs);
+    } else {
+        loop_stats_record_timer(timerData, 0);
+    }
+
     return 0;
 }
 
@@ -135,7 +183,11 @@ int WaitForEventAndCallHandler(int epollFd)
 
     if (numEventsOccurred == 1 && event.data.ptr != NULL) {
         EventData *eventData = event.data.ptr;
+        uint64_t startUs = loop_stats_begin(eventData->name, &eventData->statsSlot);
+        dispatchUs = startUs;
         eventData->eventHandler(eventData);
+        dispatchUs = 0;
+        loop_stats_end(startUs);
     }
 
     return 0;
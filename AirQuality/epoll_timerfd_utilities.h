@@ -31,6 +31,14 @@ typedef struct EventData {
     /// The file descriptor that generated the event.
     /// </summary>
     int fd;
+    /// <summary>
+    /// Handler name reported by event loop statistics. May be NULL.
+    /// </summary>
+    const char *name;
+    /// <summary>
+    /// Event loop statistics slot, assigned on the first invocation. Initialize to 0.
+    /// </summary>
+    int statsSlot;
 } EventData;
 
 /// <summary>
@@ -79,6 +87,9 @@ int SetTimerFdToSingleExpiry(int timerFd, const struct timespec *expiry);
 /// <summary>
 ///     Consumes an event by reading from the timer file descriptor.
 ///     If the event is not consumed, then it will immediately recur.
+///     The expiration count and timer lateness are recorded in event loop statistics:
+///     for periodic timers from the last expiration, for expiries armed by
+///     SetTimerFdToSingleExpiry from the armed deadline to the dispatch of the handler.
 /// </summary>
 /// <param name="timerFd">Timer file descriptor</param>
 /// <returns>0 on success, or -1 on failure</returns>
@@ -98,6 +109,7 @@ int CreateTimerFdAndAddToEpoll(int epollFd, const struct timespec *period,
 
 /// <summary>
 ///     Waits for an event on an epoll instance and triggers the handler.
+///     Handler run time is recorded in event loop statistics.
 /// </summary>
 /// <param name="epollFd">
 ///     Epoll file descriptor which was created with <see cref="CreateEpollFd" />.
@@ -0,0 +1,169 @@
+/***************************************************************************//**
+* @file    event_loop_stats.c
+* @version 1.0.0
+*
+* @brief Event loop instrumentation.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <stdio.h>
+#include <time.h>
+
+#include <applibs/log.h>
+
+#include "event_loop_stats.h"
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+static loop_stats_entry_t g_entries[LOOP_STATS_MAX_ENTRIES];
+static size_t g_entry_count = 0;
+
+// Entry of handler being executed, NULL outside of handlers
+static loop_stats_entry_t *gp_current = NULL;
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+uint64_t
+loop_stats_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+uint64_t
+loop_stats_begin(const char *p_name, int *p_slot)
+{
+    if ((*p_slot == 0) && (g_entry_count >= LOOP_STATS_MAX_ENTRIES))
+    {
+        // Logged once, the slot then marks the handler as not recorded
+        Log_Debug("ERROR: No event loop statistics entry left for %s, "
+            "LOOP_STATS_MAX_ENTRIES is %d.\n", p_name ? p_name : "?",
+            (int)LOOP_STATS_MAX_ENTRIES);
+        *p_slot = -1;
+    }
+
+    if (*p_slot < 0)
+    {
+        gp_current = NULL;
+        return loop_stats_now_us();
+    }
+
+    if (*p_slot == 0)
+    {
+        // First invocation, register handler
+        loop_stats_entry_t *p_entry = &g_entries[g_entry_count];
+        p_entry->name = p_name ? p_name : "?";
+        p_entry->missed = 0;
+        latency_hist_reset(&p_entry->run_us);
+        latency_hist_reset(&p_entry->late_us);
+        *p_slot = (int)(++g_entry_count);
+    }
+
+    gp_current = &g_entries[*p_slot - 1];
+    return loop_stats_now_us();
+}
+
+void
+loop_stats_end(uint64_t start_us)
+{
+    if (gp_current)
+    {
+        uint64_t elapsed = loop_stats_now_us() - start_us;
+
+        latency_hist_record(&gp_current->run_us,
+            (elapsed > UINT32_MAX) ? UINT32_MAX : (uint32_t)elapsed);
+        gp_current = NULL;
+    }
+}
+
+void
+loop_stats_record_timer(uint64_t expirations, uint32_t late_us)
+{
+    if (gp_current)
+    {
+        if (expirations > 1)
+        {
+            gp_current->missed += (uint32_t)(expirations - 1);
+        }
+        latency_hist_record(&gp_current->late_us, late_us);
+    }
+}
+
+int
+loop_stats_to_json(char *p_buffer, size_t buffer_size)
+{
+    size_t len = 0;
+    int written;
+
+    if (buffer_size < 3)
+    {
+        return -1;
+    }
+    p_buffer[len++] = '{';
+
+    for (size_t idx = 0; idx < g_entry_count; idx++)
+    {
+        const loop_stats_entry_t *p_entry = &g_entries[idx];
+        latency_summary_t run;
+        latency_summary_t late;
+
+        latency_hist_summarize(&p_entry->run_us, &run);
+        latency_hist_summarize(&p_entry->late_us, &late);
+
+        written = snprintf(p_buffer + len, buffer_size - len,
+            "%s\"%s\":[%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu]",
+            (idx > 0) ? "," : "",
+            p_entry->name,
+            (unsigned long)run.count,
+            (unsigned long)run.mean,
+            (unsigned long)run.p50,
+            (unsigned long)run.p99,
+            (unsigned long)run.max,
+            (unsigned long)late.p99,
+            (unsigned long)late.max,
+            (unsigned long)p_entry->missed);
+
+        if ((written < 0) || ((size_t)written >= buffer_size - len))
+        {
+            return -1;
+        }
+        len += (size_t)written;
+    }
+
+    if (len + 2 > buffer_size)
+    {
+        return -1;
+    }
+    p_buffer[len++] = '}';
+    p_buffer[len] = '\0';
+
+    return (int)len;
+}
+
+void
+loop_stats_reset(void)
+{
+    for (size_t idx = 0; idx < g_entry_count; idx++)
+    {
+        g_entries[idx].missed = 0;
+        latency_hist_reset(&g_entries[idx].run_us);
+        latency_hist_reset(&g_entries[idx].late_us);
+    }
+}
+
+const loop_stats_entry_t *
+loop_stats_get_entry(size_t index)
+{
+    return (index < g_entry_count) ? &g_entries[index] : NULL;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,129 @@
+/***************************************************************************//**
+* @file    event_loop_stats.h
+* @version 1.0.0
+*
+* @brief Event loop instrumentation.
+*
+* Collects per event handler invocation counts, handler run time and timer
+* lateness histograms. All storage is static, recording an event costs two
+* CLOCK_MONOTONIC reads and two histogram updates so it can stay enabled
+* in production builds.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef EVENT_LOOP_STATS_H
+#define EVENT_LOOP_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "latency_histogram.h"
+#include "sensor_registry.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+// Handlers outside of the sensor registry: button, upload, stats, dowork,
+// startup and display
+#define LOOP_STATS_APP_ENTRIES      (6)
+
+// Maximum number of distinct instrumented handlers
+#define LOOP_STATS_MAX_ENTRIES      \
+    (LOOP_STATS_APP_ENTRIES + SENSOR_REGISTRY_HANDLER_COUNT)
+
+/*******************************************************************************
+*   Data types
+*******************************************************************************/
+
+typedef struct
+{
+    const char *name;           // Handler name
+    uint32_t missed;            // Missed timer expirations
+    latency_hist_t run_us;      // Run time histogram, count = invocations
+    latency_hist_t late_us;     // Timer lateness histogram
+} loop_stats_entry_t;
+
+/*******************************************************************************
+*   Function declarations
+*******************************************************************************/
+
+/**
+ * @brief Get monotonic time in microseconds.
+ */
+uint64_t
+loop_stats_now_us(void);
+
+/**
+ * @brief Mark start of an instrumented handler.
+ *
+ * @param p_name Handler name, must be a static string.
+ * @param p_slot Pointer to slot cache owned by the caller, initialize to 0.
+ *
+ * @return Start timestamp to be passed to loop_stats_end().
+ */
+uint64_t
+loop_stats_begin(const char *p_name, int *p_slot);
+
+/**
+ * @brief Mark end of the handler started by loop_stats_begin().
+ *
+ * @param start_us Timestamp returned by loop_stats_begin().
+ */
+void
+loop_stats_end(uint64_t start_us);
+
+/**
+ * @brief Record timer expiration of the currently running handler.
+ *
+ * @param expirations Expiration count read from timerfd.
+ * @param late_us How long after the scheduled expiration the timer
+ *                has been serviced.
+ */
+void
+loop_stats_record_timer(uint64_t expirations, uint32_t late_us);
+
+/**
+ * @brief Serialize statistics as compact JSON object.
+ *
+ * Each handler is written as
+ * "name":[calls,avg_us,p50_us,p99_us,max_us,late_p99_us,late_max_us,missed]
+ *
+ * @param p_buffer Output buffer.
+ * @param buffer_size Output buffer size.
+ *
+ * @return Length of JSON string written, -1 if it does not fit.
+ */
+int
+loop_stats_to_json(char *p_buffer, size_t buffer_size);
+
+/**
+ * @brief Clear collected statistics, keeping registered handlers.
+ */
+void
+loop_stats_reset(void);
+
+/**
+ * @brief Get statistics entry by index.
+ *
+ * @return Pointer to entry or NULL if index is out of range.
+ */
+const loop_stats_entry_t *
+loop_stats_get_entry(size_t index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // EVENT_LOOP_STATS_H
+
+/* [] END OF FILE */
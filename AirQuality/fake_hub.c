@@ -0,0 +1,603 @@
+/// \file fake_hub.c
+/// \brief In process IoT Hub emulation, see fake_hub.h.
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <applibs/log.h>
+#include "build_options.h"
+
+#ifdef AZURE_IOT_FAKE_HUB
+
+#include "fake_hub.h"
+#include "parson.h"
+
+/// <summary>
+///     Maximum number of operations in progress, messages beyond it are refused like by a
+///     client whose outgoing queue is full.
+/// </summary>
+#define FAKE_HUB_QUEUE_SIZE 32
+
+typedef enum {
+    FakeHubOp_Event,
+    FakeHubOp_ReportedState,
+    FakeHubOp_TwinUpdate,
+    FakeHubOp_CloudMessage,
+    FakeHubOp_DirectMethod
+} FakeHubOpType;
+
+/// <summary>
+///     Operation completing at dueMs, ordered by dueMs and then by sequence.
+/// </summary>
+typedef struct {
+    bool inUse;
+    bool drop;
+    FakeHubOpType type;
+    DEVICE_TWIN_UPDATE_STATE twinState;
+    uint64_t dueMs;
+    uint32_t sequence;
+    void *context;
+    char *payload;
+    char *methodName;
+} FakeHubOp;
+
+/// <summary>
+///     Duration of a failed connection attempt, at most one failure is reported per period.
+/// </summary>
+#define FAKE_HUB_CONNECT_ATTEMPT_MS 1000
+
+/// <summary>
+///     State of one emulated hub and client, see FakeHub_SelectState().
+/// </summary>
+struct FakeHub_State {
+    FakeHubOp operations[FAKE_HUB_QUEUE_SIZE];
+    uint32_t nextOpSequence;
+
+    /// <summary>
+    ///     Due time of the last queued device to cloud operation, keeps them in order like a
+    ///     single MQTT connection does.
+    /// </summary>
+    uint64_t lastUpstreamDueMs;
+
+    FakeHub_Config config;
+    FakeHub_Stats stats;
+
+    const AzureIoT_TransportCallbacks *hubCallbacks;
+    bool clientCreated;
+
+    /// <summary>
+    ///     'true' while the client holds the connection, doWork does not connect then.
+    /// </summary>
+    bool held;
+    uint64_t reconnectAtMs;
+    uint64_t nextDisconnectMs;
+
+    /// <summary>
+    ///     'true' while the hub is unreachable, connection attempts fail then.
+    /// </summary>
+    bool outage;
+    uint64_t lastFailedAttemptMs;
+
+    /// <summary>
+    ///     Device Twin documents kept by the fake hub.
+    /// </summary>
+    JSON_Value *desiredDocument;
+    JSON_Value *reportedDocument;
+
+    uint32_t randomState;
+};
+
+#define FAKE_HUB_STATE_INIT                                                                    \
+    {                                                                                          \
+        .config = {.latencyMs = 50,                                                            \
+                   .jitterMs = 50,                                                             \
+                   .dropPerMille = 0,                                                          \
+                   .dropTimeoutMs = 5000,                                                      \
+                   .disconnectPeriodMs = 0,                                                    \
+                   .disconnectDurationMs = 10000,                                              \
+                   .reportedStatusCode = 204,                                                  \
+                   .seed = 0},                                                                 \
+        .randomState = 2463534242u,                                                            \
+    }
+
+static FakeHub_State defaultHub = FAKE_HUB_STATE_INIT;
+
+/// <summary>
+///     State the functions of this module act upon in the calling thread.
+/// </summary>
+static _Thread_local FakeHub_State *hub = &defaultHub;
+
+/// <summary>
+///     xorshift32 pseudo random generator, reproducible with FakeHub_Config::seed.
+/// </summary>
+static uint32_t nextRandom(void)
+{
+    hub->randomState ^= hub->randomState << 13;
+    hub->randomState ^= hub->randomState >> 17;
+    hub->randomState ^= hub->randomState << 5;
+    return hub->randomState;
+}
+
+static uint64_t nowMs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+static uint32_t randomLatencyMs(void)
+{
+    return hub->config.latencyMs +
+           ((hub->config.jitterMs > 0) ? nextRandom() % (hub->config.jitterMs + 1) : 0);
+}
+
+static bool randomDrop(void)
+{
+    return hub->config.dropPerMille > 0 && (nextRandom() % 1000) < hub->config.dropPerMille;
+}
+
+/// <summary>
+///     Creates the Device Twin documents on first use.
+/// </summary>
+static void ensureDocuments(void)
+{
+    if (hub->desiredDocument == NULL) {
+        hub->desiredDocument = json_value_init_object();
+        json_object_set_number(json_value_get_object(hub->desiredDocument), "$version", 1);
+    }
+    if (hub->reportedDocument == NULL) {
+        hub->reportedDocument = json_value_init_object();
+    }
+}
+
+/// <summary>
+///     Applies a JSON merge patch, null members remove properties.
+/// </summary>
+static void mergePatch(JSON_Object *target, const JSON_Object *patch)
+{
+    for (size_t i = 0; i < json_object_get_count(patch); i++) {
+        const char *name = json_object_get_name(patch, i);
+        JSON_Value *value = json_object_get_value_at(patch, i);
+        JSON_Object *targetMember = json_object_get_object(target, name);
+
+        if (json_value_get_type(value) == JSONNull) {
+            json_object_remove(target, name);
+        } else if (json_value_get_type(value) == JSONObject && targetMember != NULL) {
+            mergePatch(targetMember, json_value_get_object(value));
+        } else {
+            json_object_set_value(target, name, json_value_deep_copy(value));
+        }
+    }
+}
+
+/// <summary>
+///     Queues an operation. The strings are copied.
+/// </summary>
+/// <returns>The queued operation, NULL if the queue is full.</returns>
+static FakeHubOp *queueOperation(FakeHubOpType type, const char *payload,
+                                 const char *methodName, void *context, uint32_t delayMs,
+                                 bool drop)
+{
+    FakeHubOp *op = NULL;
+    for (size_t i = 0; i < FAKE_HUB_QUEUE_SIZE; i++) {
+        if (!hub->operations[i].inUse) {
+            op = &hub->operations[i];
+            break;
+        }
+    }
+    if (op == NULL) {
+        return NULL;
+    }
+
+    memset(op, 0, sizeof(*op));
+    op->payload = (payload != NULL) ? strdup(payload) : NULL;
+    op->methodName = (methodName != NULL) ? strdup(methodName) : NULL;
+    if ((payload != NULL && op->payload == NULL) ||
+        (methodName != NULL && op->methodName == NULL)) {
+        free(op->payload);
+        free(op->methodName);
+        memset(op, 0, sizeof(*op));
+        return NULL;
+    }
+
+    op->inUse = true;
+    op->type = type;
+    op->twinState = DEVICE_TWIN_UPDATE_PARTIAL;
+    op->drop = drop;
+    op->context = context;
+    op->sequence = hub->nextOpSequence++;
+    op->dueMs = nowMs() + delayMs;
+
+    // Dropped operations are not acknowledged at all, they must not hold the others back.
+    if ((type == FakeHubOp_Event || type == FakeHubOp_ReportedState) && !drop) {
+        if (op->dueMs < hub->lastUpstreamDueMs) {
+            op->dueMs = hub->lastUpstreamDueMs;
+        }
+        hub->lastUpstreamDueMs = op->dueMs;
+    }
+    return op;
+}
+
+/// <summary>
+///     Queues delivery of the complete Device Twin, as done by the IoT Hub on connection.
+/// </summary>
+static void queueCompleteTwin(void)
+{
+    ensureDocuments();
+
+    JSON_Value *twin = json_value_init_object();
+    JSON_Object *twinObject = json_value_get_object(twin);
+    json_object_set_value(twinObject, "desired", json_value_deep_copy(hub->desiredDocument));
+    json_object_set_value(twinObject, "reported", json_value_deep_copy(hub->reportedDocument));
+
+    char *twinString = json_serialize_to_string(twin);
+    FakeHubOp *op = (twinString != NULL) ? queueOperation(FakeHubOp_TwinUpdate, twinString, NULL,
+                                                          NULL, randomLatencyMs(), false)
+                                         : NULL;
+    if (op != NULL) {
+        op->twinState = DEVICE_TWIN_UPDATE_COMPLETE;
+    }
+    json_free_serialized_string(twinString);
+    json_value_free(twin);
+}
+
+/// <summary>
+///     Drops the connection, the hub is unreachable for the given time.
+/// </summary>
+static void takeDown(uint64_t now, uint32_t durationMs)
+{
+    bool wasConnected = hub->stats.connected;
+
+    hub->outage = true;
+    hub->stats.connected = false;
+    hub->reconnectAtMs = now + durationMs;
+    hub->lastFailedAttemptMs = now;
+    if (wasConnected) {
+        hub->stats.disconnects++;
+        hub->hubCallbacks->connectionStatus(IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED,
+                                            IOTHUB_CLIENT_CONNECTION_NO_NETWORK, NULL);
+    }
+}
+
+/// <summary>
+///     Takes the connection down and up again according to the configuration.
+/// </summary>
+static void updateConnection(uint64_t now)
+{
+    if (!hub->stats.connected && now < hub->reconnectAtMs) {
+        if (hub->outage && now - hub->lastFailedAttemptMs >= FAKE_HUB_CONNECT_ATTEMPT_MS) {
+            hub->lastFailedAttemptMs = now;
+            hub->stats.connectAttempts++;
+            hub->stats.connectFailures++;
+            hub->hubCallbacks->connectionStatus(IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED,
+                                                IOTHUB_CLIENT_CONNECTION_NO_NETWORK, NULL);
+        }
+    } else if (!hub->stats.connected) {
+        hub->outage = false;
+        hub->stats.connected = true;
+        hub->stats.connectAttempts++;
+        hub->nextDisconnectMs =
+            (hub->config.disconnectPeriodMs > 0) ? now + hub->config.disconnectPeriodMs : 0;
+        hub->hubCallbacks->connectionStatus(IOTHUB_CLIENT_CONNECTION_AUTHENTICATED,
+                                            IOTHUB_CLIENT_CONNECTION_OK, NULL);
+        queueCompleteTwin();
+    } else if (hub->stats.connected && hub->nextDisconnectMs != 0 && now >= hub->nextDisconnectMs) {
+        takeDown(now, hub->config.disconnectDurationMs);
+    }
+}
+
+/// <summary>
+///     Invokes the device callback of a completed operation.
+/// </summary>
+static void completeOperation(const FakeHubOp *op)
+{
+    size_t size = (op->payload != NULL) ? strlen(op->payload) : 0;
+
+    switch (op->type) {
+    case FakeHubOp_Event:
+        if (op->drop) {
+            hub->stats.eventsDropped++;
+            hub->hubCallbacks->sendConfirmation(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT,
+                                                op->context);
+        } else {
+            hub->stats.eventsConfirmed++;
+            hub->hubCallbacks->sendConfirmation(IOTHUB_CLIENT_CONFIRMATION_OK, op->context);
+        }
+        break;
+
+    case FakeHubOp_ReportedState:
+        if (op->drop) {
+            hub->stats.reportedDropped++;
+            hub->hubCallbacks->reportedStateConfirmation(408, op->context);
+            break;
+        }
+        if (hub->config.reportedStatusCode >= 200 && hub->config.reportedStatusCode < 300) {
+            JSON_Value *patch = json_parse_string(op->payload);
+            if (json_value_get_object(patch) != NULL) {
+                ensureDocuments();
+                mergePatch(json_value_get_object(hub->reportedDocument),
+                           json_value_get_object(patch));
+            }
+            json_value_free(patch);
+        }
+        hub->stats.reportedConfirmed++;
+        hub->hubCallbacks->reportedStateConfirmation(hub->config.reportedStatusCode, op->context);
+        break;
+
+    case FakeHubOp_TwinUpdate:
+        hub->stats.twinUpdatesSent++;
+        hub->hubCallbacks->twinUpdate(op->twinState, (const unsigned char *)op->payload, size,
+                                      NULL);
+        break;
+
+    case FakeHubOp_CloudMessage:
+        hub->stats.cloudMessagesSent++;
+        hub->hubCallbacks->messageReceived((const unsigned char *)op->payload, size);
+        break;
+
+    case FakeHubOp_DirectMethod: {
+        unsigned char *response = NULL;
+        size_t responseSize = 0;
+        hub->stats.methodsInvoked++;
+        hub->stats.lastMethodStatus =
+            hub->hubCallbacks->directMethod(op->methodName, (const unsigned char *)op->payload,
+                                            size, &response, &responseSize, NULL);
+        Log_Debug("[Fake IoT Hub] Method '%s' returned %d, %zu bytes of response\n",
+                  op->methodName, hub->stats.lastMethodStatus, responseSize);
+        free(response);
+        break;
+    }
+    }
+}
+
+static bool fakeHubCreate(const AzureIoT_TransportCallbacks *callbacks)
+{
+    if (hub->config.seed != 0) {
+        hub->randomState = hub->config.seed;
+    }
+    ensureDocuments();
+
+    hub->hubCallbacks = callbacks;
+    hub->clientCreated = true;
+    hub->held = false;
+    hub->stats.connected = false;
+    if (!hub->outage) {
+        hub->reconnectAtMs = nowMs() + randomLatencyMs();
+    }
+    Log_Debug("[Fake IoT Hub] Client created\n");
+    return true;
+}
+
+static void fakeHubDestroy(void)
+{
+    if (!hub->clientCreated) {
+        return;
+    }
+
+    // Like the SDK, confirm everything pending so that the owners release the contexts.
+    for (size_t i = 0; i < FAKE_HUB_QUEUE_SIZE; i++) {
+        FakeHubOp op = hub->operations[i];
+        if (!op.inUse) {
+            continue;
+        }
+        memset(&hub->operations[i], 0, sizeof(hub->operations[i]));
+        if (op.type == FakeHubOp_Event) {
+            hub->hubCallbacks->sendConfirmation(IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY,
+                                                op.context);
+        } else if (op.type == FakeHubOp_ReportedState) {
+            hub->hubCallbacks->reportedStateConfirmation(0, op.context);
+        }
+        free(op.payload);
+        free(op.methodName);
+    }
+
+    hub->clientCreated = false;
+    hub->stats.connected = false;
+    hub->lastUpstreamDueMs = 0;
+}
+
+static bool fakeHubSendEvent(const char *payload, const char *messageId, void *context)
+{
+    (void)messageId;
+    bool drop = randomDrop();
+    uint32_t delayMs = drop ? hub->config.dropTimeoutMs : randomLatencyMs();
+    if (!hub->clientCreated ||
+        queueOperation(FakeHubOp_Event, payload, NULL, context, delayMs, drop) == NULL) {
+        hub->stats.eventsRejected++;
+        return false;
+    }
+
+    hub->stats.eventsReceived++;
+    hub->stats.eventBytes += strlen(payload);
+    return true;
+}
+
+static bool fakeHubSendReportedState(const unsigned char *json, size_t size, void *context)
+{
+    if (!hub->clientCreated) {
+        return false;
+    }
+
+    char *jsonString = (char *)malloc(size + 1);
+    if (jsonString == NULL) {
+        return false;
+    }
+    memcpy(jsonString, json, size);
+    jsonString[size] = '\0';
+
+    bool drop = randomDrop();
+    bool queued =
+        queueOperation(FakeHubOp_ReportedState, jsonString, NULL, context,
+                       drop ? hub->config.dropTimeoutMs : randomLatencyMs(), drop) != NULL;
+    free(jsonString);
+
+    if (queued) {
+        hub->stats.reportedReceived++;
+    }
+    return queued;
+}
+
+static void fakeHubDoWork(void)
+{
+    if (!hub->clientCreated) {
+        return;
+    }
+
+    uint64_t now = nowMs();
+    if (!hub->held) {
+        updateConnection(now);
+    }
+    if (!hub->stats.connected) {
+        return;
+    }
+
+    // Bounded, callbacks may queue further operations due immediately.
+    for (size_t round = 0; round < FAKE_HUB_QUEUE_SIZE; round++) {
+        FakeHubOp *next = NULL;
+        for (size_t i = 0; i < FAKE_HUB_QUEUE_SIZE; i++) {
+            FakeHubOp *op = &hub->operations[i];
+            if (op->inUse && op->dueMs <= now &&
+                (next == NULL || op->dueMs < next->dueMs ||
+                 (op->dueMs == next->dueMs && op->sequence < next->sequence))) {
+                next = op;
+            }
+        }
+        if (next == NULL) {
+            break;
+        }
+
+        // Release the slot before the callback, which may queue another operation.
+        FakeHubOp op = *next;
+        memset(next, 0, sizeof(*next));
+        completeOperation(&op);
+        free(op.payload);
+        free(op.methodName);
+    }
+}
+
+static void fakeHubHoldConnection(bool hold)
+{
+    hub->held = hold;
+}
+
+const AzureIoT_Transport AzureIoT_FakeHubTransport = {
+    .name = "fake hub",
+    .create = fakeHubCreate,
+    .destroy = fakeHubDestroy,
+    .sendEvent = fakeHubSendEvent,
+    .sendReportedState = fakeHubSendReportedState,
+    .doWork = fakeHubDoWork,
+    .holdConnection = fakeHubHoldConnection,
+};
+
+void FakeHub_GetDefaultConfig(FakeHub_Config *defaults)
+{
+    memset(defaults, 0, sizeof(*defaults));
+    defaults->latencyMs = 50;
+    defaults->jitterMs = 50;
+    defaults->dropTimeoutMs = 5000;
+    defaults->disconnectDurationMs = 10000;
+    defaults->reportedStatusCode = 204;
+}
+
+void FakeHub_Configure(const FakeHub_Config *newConfig)
+{
+    hub->config = *newConfig;
+    if (hub->config.seed != 0) {
+        hub->randomState = hub->config.seed;
+    }
+    if (hub->stats.connected) {
+        hub->nextDisconnectMs =
+            (hub->config.disconnectPeriodMs > 0) ? nowMs() + hub->config.disconnectPeriodMs : 0;
+    }
+}
+
+bool FakeHub_InjectDesiredProperties(const char *patchJson)
+{
+    JSON_Value *patch = json_parse_string(patchJson);
+    JSON_Object *patchObject = json_value_get_object(patch);
+    bool queued = false;
+
+    if (patchObject != NULL) {
+        ensureDocuments();
+        JSON_Object *desired = json_value_get_object(hub->desiredDocument);
+        int version = (int)json_object_get_number(desired, "$version") + 1;
+
+        json_object_remove(patchObject, "$version");
+        mergePatch(desired, patchObject);
+        json_object_set_number(desired, "$version", version);
+        json_object_set_number(patchObject, "$version", version);
+
+        char *patchString = json_serialize_to_string(patch);
+        queued = (patchString != NULL) && queueOperation(FakeHubOp_TwinUpdate, patchString, NULL,
+                                                         NULL, randomLatencyMs(), false) != NULL;
+        json_free_serialized_string(patchString);
+    }
+
+    json_value_free(patch);
+    return queued;
+}
+
+void FakeHub_SimulateOutage(uint32_t durationMs)
+{
+    uint64_t now = nowMs();
+    if (hub->clientCreated) {
+        takeDown(now, durationMs);
+    } else {
+        hub->outage = true;
+        hub->reconnectAtMs = now + durationMs;
+    }
+}
+
+bool FakeHub_InjectCloudMessage(const char *payload)
+{
+    return queueOperation(FakeHubOp_CloudMessage, payload, NULL, NULL, randomLatencyMs(),
+                          false) != NULL;
+}
+
+bool FakeHub_InvokeDirectMethod(const char *methodName, const char *payloadJson)
+{
+    return queueOperation(FakeHubOp_DirectMethod, (payloadJson != NULL) ? payloadJson : "null",
+                          methodName, NULL, randomLatencyMs(), false) != NULL;
+}
+
+void FakeHub_GetStats(FakeHub_Stats *copy, bool reset)
+{
+    *copy = hub->stats;
+    if (reset) {
+        bool connected = hub->stats.connected;
+        memset(&hub->stats, 0, sizeof(hub->stats));
+        hub->stats.connected = connected;
+    }
+}
+
+FakeHub_State *FakeHub_CreateState(void)
+{
+    FakeHub_State *state = (FakeHub_State *)malloc(sizeof(*state));
+    if (state != NULL) {
+        *state = (FakeHub_State)FAKE_HUB_STATE_INIT;
+    }
+    return state;
+}
+
+void FakeHub_DestroyState(FakeHub_State *state)
+{
+    if (state == NULL || state == &defaultHub) {
+        return;
+    }
+
+    FakeHub_State *selected = hub;
+    hub = state;
+    fakeHubDestroy();
+    json_value_free(state->desiredDocument);
+    json_value_free(state->reportedDocument);
+    hub = (selected == state) ? &defaultHub : selected;
+    free(state);
+}
+
+void FakeHub_SelectState(FakeHub_State *state)
+{
+    hub = (state != NULL) ? state : &defaultHub;
+}
+
+#endif  // AZURE_IOT_FAKE_HUB
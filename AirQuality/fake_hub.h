@@ -0,0 +1,127 @@
+/// \file fake_hub.h
+/// \brief In process IoT Hub emulation for offline testing of the telemetry, Device Twin and
+/// Direct Method paths of azure_iot_utilities.c.
+///
+/// The fake hub is built and selected as the transport only when AZURE_IOT_FAKE_HUB is
+/// defined in build_options.h or on the compiler command line, e.g. by the host tools; the
+/// device image leaves it out.
+/// Every operation completes after a configurable latency with random jitter, messages and
+/// reported properties updates can be dropped and the connection can be taken down
+/// periodically, so that throughput and backlog draining can be measured without a network.
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "azure_iot_transport.h"
+
+/// <summary>
+///     Fake hub behaviour.
+/// </summary>
+typedef struct {
+    /// <summary>Minimum latency of every operation, in milliseconds.</summary>
+    uint32_t latencyMs;
+    /// <summary>Random latency added on top of latencyMs, in milliseconds.</summary>
+    uint32_t jitterMs;
+    /// <summary>Probability of dropping a message or reported properties update, in
+    /// tenths of percent.</summary>
+    uint32_t dropPerMille;
+    /// <summary>Time until a dropped operation is reported as failed, in
+    /// milliseconds.</summary>
+    uint32_t dropTimeoutMs;
+    /// <summary>Period of connection drops in milliseconds, 0 to stay connected.</summary>
+    uint32_t disconnectPeriodMs;
+    /// <summary>How long the connection stays down, in milliseconds.</summary>
+    uint32_t disconnectDurationMs;
+    /// <summary>Status code of accepted reported properties updates.</summary>
+    int reportedStatusCode;
+    /// <summary>Seed of the pseudo random generator, 0 keeps the current state.</summary>
+    uint32_t seed;
+} FakeHub_Config;
+
+/// <summary>
+///     Fake hub counters.
+/// </summary>
+typedef struct {
+    uint32_t eventsReceived;
+    uint32_t eventsConfirmed;
+    uint32_t eventsDropped;
+    uint32_t eventsRejected;
+    uint64_t eventBytes;
+    uint32_t reportedReceived;
+    uint32_t reportedConfirmed;
+    uint32_t reportedDropped;
+    uint32_t twinUpdatesSent;
+    uint32_t cloudMessagesSent;
+    uint32_t methodsInvoked;
+    int lastMethodStatus;
+    uint32_t disconnects;
+    uint32_t connectAttempts;
+    uint32_t connectFailures;
+    bool connected;
+} FakeHub_Stats;
+
+/// <summary>
+///     State of one emulated hub with its client: configuration, operations in progress,
+///     Device Twin documents and counters.
+/// </summary>
+typedef struct FakeHub_State FakeHub_State;
+
+/// <summary>
+///     Fills the configuration with defaults: 50 + 0..50 ms latency, no drops, no
+///     disconnects, reported properties accepted with status 204.
+/// </summary>
+void FakeHub_GetDefaultConfig(FakeHub_Config *config);
+
+/// <summary>
+///     Changes the fake hub behaviour, takes effect for the next operations.
+/// </summary>
+void FakeHub_Configure(const FakeHub_Config *config);
+
+/// <summary>
+///     Merges a desired properties patch into the Device Twin and sends it to the device.
+/// </summary>
+/// <param name="patchJson">JSON object, null members remove properties.</param>
+/// <returns>'false' if the patch is not a JSON object or the queue is full.</returns>
+bool FakeHub_InjectDesiredProperties(const char *patchJson);
+
+/// <summary>
+///     Makes the hub unreachable for the given time, starting now. Connection attempts during
+///     the outage fail after one second.
+/// </summary>
+void FakeHub_SimulateOutage(uint32_t durationMs);
+
+/// <summary>
+///     Sends a cloud to device message.
+/// </summary>
+bool FakeHub_InjectCloudMessage(const char *payload);
+
+/// <summary>
+///     Invokes a Direct Method, the status is available in FakeHub_Stats::lastMethodStatus.
+/// </summary>
+bool FakeHub_InvokeDirectMethod(const char *methodName, const char *payloadJson);
+
+/// <summary>
+///     Copies the fake hub counters, optionally resetting them.
+/// </summary>
+void FakeHub_GetStats(FakeHub_Stats *stats, bool reset);
+
+
+/// <summary>
+///     Creates a further hub state, e.g. to emulate a hub per client of a fleet run in one
+///     host process. The state starts with the default configuration.
+/// </summary>
+/// <returns>The new state, NULL if out of memory.</returns>
+FakeHub_State *FakeHub_CreateState(void);
+
+/// <summary>
+///     Destroys the client of a state created by FakeHub_CreateState(), confirming its pending
+///     messages with IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, and frees the state.
+/// </summary>
+void FakeHub_DestroyState(FakeHub_State *state);
+
+/// <summary>
+///     Selects the state the fake hub transport and the FakeHub_ functions act upon in the
+///     calling thread, NULL for the default state. Select the matching client state with
+///     AzureIoT_SelectClientState() too.
+/// </summary>
+void FakeHub_SelectState(FakeHub_State *state);
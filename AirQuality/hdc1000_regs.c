@@ -0,0 +1,70 @@
+/***************************************************************************//**
+* @file    hdc1000_regs.c
+* @version 1.0.0
+*
+* @brief HDC1000 register access returning raw register values.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include "hdc1000_regs.h"
+#include "i2c_bus.h"
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+bool
+hdc1000_regs_write(int fd_i2c, I2C_DeviceAddress addr, uint8_t reg,
+    uint16_t value)
+{
+    const uint8_t data[3] = { reg, (uint8_t)(value >> 8), (uint8_t)value };
+
+    return i2c_bus_write(fd_i2c, addr, data, sizeof(data)) == sizeof(data);
+}
+
+bool
+hdc1000_regs_read(int fd_i2c, I2C_DeviceAddress addr, uint8_t reg,
+    uint16_t *p_value)
+{
+    uint8_t data[2];
+
+    if (i2c_bus_write_then_read(fd_i2c, addr, &reg, 1, data, sizeof(data)) !=
+        (1 + sizeof(data)))
+    {
+        return false;
+    }
+
+    *p_value = (uint16_t)((data[0] << 8) | data[1]);
+    return true;
+}
+
+bool
+hdc1000_regs_start_conversion(int fd_i2c, I2C_DeviceAddress addr)
+{
+    const uint8_t reg = HDC1000_REG_TEMPERATURE;
+
+    // Setting register pointer to temperature starts the conversion
+    return i2c_bus_write(fd_i2c, addr, &reg, 1) == 1;
+}
+
+bool
+hdc1000_regs_read_conversion(int fd_i2c, I2C_DeviceAddress addr,
+    uint16_t *p_raw_temperature, uint16_t *p_raw_humidity)
+{
+    uint8_t data[4];
+
+    if (i2c_bus_read(fd_i2c, addr, data, sizeof(data)) != sizeof(data))
+    {
+        return false;
+    }
+
+    *p_raw_temperature = (uint16_t)((data[0] << 8) | data[1]);
+    *p_raw_humidity = (uint16_t)((data[2] << 8) | data[3]);
+    return true;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,111 @@
+/***************************************************************************//**
+* @file    hdc1000_regs.h
+* @version 1.0.0
+*
+* @brief HDC1000 register access returning raw register values.
+*
+* Complements lib_hdc1000, whose measurement functions return converted
+* floating point values, so that measurements can stay in fixed point (see
+* measurement.h).
+*
+* With HDC1000_CONFIG_MODE set, one trigger converts temperature and then
+* humidity and both are read in one 4 byte transfer. The conversion is split
+* in start and read so that the caller can wait for it without blocking, e.g.
+* on a one shot timer.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef HDC1000_REGS_H
+#define HDC1000_REGS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "applibs_versions.h"
+#ifndef I2C_STRUCTS_VERSION
+#define I2C_STRUCTS_VERSION 1
+#endif
+#include <applibs/i2c.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+#define HDC1000_REG_TEMPERATURE     (0x00)
+#define HDC1000_REG_HUMIDITY        (0x01)
+#define HDC1000_REG_CONFIGURATION   (0x02)
+#define HDC1000_REG_MANUFACTURER_ID (0xFE)
+#define HDC1000_REG_DEVICE_ID       (0xFF)
+
+// Configuration register bits
+#define HDC1000_CONFIG_RST          (1u << 15)  // Software reset
+#define HDC1000_CONFIG_HEAT         (1u << 13)  // Heater enable
+#define HDC1000_CONFIG_MODE         (1u << 12)  // Temperature and humidity in sequence
+#define HDC1000_CONFIG_TRES_11BIT   (1u << 10)
+#define HDC1000_CONFIG_HRES_11BIT   (1u << 8)
+#define HDC1000_CONFIG_HRES_8BIT    (2u << 8)
+
+// Conversion time of 14 bit temperature and humidity in sequence,
+// 6.35 + 6.5 ms max, rounded up
+#define HDC1000_CONVERSION_TIME_MS  (14)
+
+/*******************************************************************************
+*   Function declarations
+*******************************************************************************/
+
+/**
+ * @brief Write 16 bit register.
+ *
+ * @return true on success.
+ */
+bool
+hdc1000_regs_write(int fd_i2c, I2C_DeviceAddress addr, uint8_t reg,
+    uint16_t value);
+
+/**
+ * @brief Read 16 bit register.
+ *
+ * @return true on success.
+ */
+bool
+hdc1000_regs_read(int fd_i2c, I2C_DeviceAddress addr, uint8_t reg,
+    uint16_t *p_value);
+
+/**
+ * @brief Trigger temperature and humidity conversion.
+ *
+ * The device must be configured with HDC1000_CONFIG_MODE set. Results can be
+ * read after HDC1000_CONVERSION_TIME_MS, earlier reads are NACKed.
+ *
+ * @return true on success.
+ */
+bool
+hdc1000_regs_start_conversion(int fd_i2c, I2C_DeviceAddress addr);
+
+/**
+ * @brief Read raw temperature and humidity of completed conversion.
+ *
+ * @param p_raw_temperature Raw temperature output.
+ * @param p_raw_humidity Raw humidity output.
+ *
+ * @return true on success.
+ */
+bool
+hdc1000_regs_read_conversion(int fd_i2c, I2C_DeviceAddress addr,
+    uint16_t *p_raw_temperature, uint16_t *p_raw_humidity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // HDC1000_REGS_H
+
+/* [] END OF FILE */
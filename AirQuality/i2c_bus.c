@@ -0,0 +1,119 @@
+/***************************************************************************//**
+* @file    i2c_bus.c
+* @version 1.0.0
+*
+* @brief I2C bus recovery and traffic accounting.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <errno.h>
+#include <string.h>
+
+#include <applibs/log.h>
+
+#include "i2c_bus.h"
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+static uint64_t g_bytes = 0;            // Bytes transferred
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+bool
+i2c_bus_recover(int fd_i2c, I2C_DeviceAddress address)
+{
+    uint8_t data;
+    uint32_t reads = 0;
+    bool b_is_released = false;
+
+    if (fd_i2c < 0)
+    {
+        return false;
+    }
+
+    // A slave holding SDA shifts out one bit per clock, its byte garbles
+    // the address of the first read
+    while (!b_is_released && (reads < I2C_BUS_RECOVERY_READS))
+    {
+        b_is_released = (i2c_bus_read(fd_i2c, address, &data, 1) == 1);
+        reads++;
+    }
+
+    if (b_is_released)
+    {
+        Log_Debug("I2C bus recovery: released after %lu reads\n",
+            (unsigned long)reads);
+    }
+    else
+    {
+        Log_Debug("I2C bus recovery: still busy: %s (%d)\n", strerror(errno),
+            errno);
+    }
+
+    return b_is_released;
+}
+
+ssize_t
+i2c_bus_write(int fd_i2c, I2C_DeviceAddress address, const uint8_t *p_data,
+    size_t length)
+{
+    ssize_t result = I2CMaster_Write(fd_i2c, address, p_data, length);
+    if (result > 0)
+    {
+        g_bytes += (uint64_t)result;
+    }
+    return result;
+}
+
+ssize_t
+i2c_bus_read(int fd_i2c, I2C_DeviceAddress address, uint8_t *p_buffer,
+    size_t length)
+{
+    ssize_t result = I2CMaster_Read(fd_i2c, address, p_buffer, length);
+    if (result > 0)
+    {
+        g_bytes += (uint64_t)result;
+    }
+    return result;
+}
+
+ssize_t
+i2c_bus_write_then_read(int fd_i2c, I2C_DeviceAddress address,
+    const uint8_t *p_write, size_t write_length, uint8_t *p_read,
+    size_t read_length)
+{
+    ssize_t result = I2CMaster_WriteThenRead(fd_i2c, address, p_write,
+        write_length, p_read, read_length);
+    if (result > 0)
+    {
+        g_bytes += (uint64_t)result;
+    }
+    return result;
+}
+
+void
+i2c_bus_add_bytes(size_t bytes)
+{
+    g_bytes += bytes;
+}
+
+uint64_t
+i2c_bus_get_bytes(bool b_reset)
+{
+    uint64_t bytes = g_bytes;
+    if (b_reset)
+    {
+        g_bytes = 0;
+    }
+    return bytes;
+}
+
+/* [] END OF FILE */
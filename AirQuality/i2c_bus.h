@@ -0,0 +1,114 @@
+/***************************************************************************//**
+* @file    i2c_bus.h
+* @version 1.0.0
+*
+* @brief I2C bus recovery and traffic accounting.
+*
+* Sensor transfers go through i2c_bus_write(), i2c_bus_read() and
+* i2c_bus_write_then_read(), which count the bytes transferred for the
+* energy estimate of power_mode.h. Transfers done inside libraries are
+* added with i2c_bus_add_bytes().
+*
+* A device reset or a glitch in the middle of a read can leave a slave
+* driving SDA low while it waits for the clocks of the byte it was sending.
+* The master then sees the bus busy and every transfer fails. The recovery
+* clocks SCL until the slave releases SDA, at most the 9 clocks of one byte
+* and its ACK, and then generates a STOP condition (I2C specification,
+* section 3.1.16).
+*
+* The MT3620 muxes the SCL and SDA pins per ISU block, they cannot be
+* claimed as GPIO while the ISU is used as I2C master. The clocks are
+* therefore generated by the master itself: the caller resets the master,
+* i.e. closes and opens it again, and each one byte read of the recovery
+* clocks SCL 18 times, address and data byte with their ACK, and ends with
+* a STOP. Whether the master starts a transfer while SDA is held low is up
+* to its controller, if it does not, the reads fail and so does the
+* recovery.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "applibs_versions.h"
+#include <applibs/i2c.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+// Reads until the bus answers, the first one may only release SDA
+#define I2C_BUS_RECOVERY_READS      (2)
+
+/*******************************************************************************
+*   Function declarations
+*******************************************************************************/
+
+/**
+ * @brief Clock the bus with one byte reads of a device until one succeeds.
+ *
+ * @param fd_i2c Freshly opened I2C master descriptor.
+ * @param address Device on the bus that can be read without side effects,
+ *                e.g. the display returning its status byte.
+ *
+ * @return true if a read succeeded, the bus is free again.
+ */
+bool
+i2c_bus_recover(int fd_i2c, I2C_DeviceAddress address);
+
+/**
+ * @brief I2CMaster_Write() counting the bytes transferred.
+ */
+ssize_t
+i2c_bus_write(int fd_i2c, I2C_DeviceAddress address, const uint8_t *p_data,
+    size_t length);
+
+/**
+ * @brief I2CMaster_Read() counting the bytes transferred.
+ */
+ssize_t
+i2c_bus_read(int fd_i2c, I2C_DeviceAddress address, uint8_t *p_buffer,
+    size_t length);
+
+/**
+ * @brief I2CMaster_WriteThenRead() counting the bytes transferred.
+ */
+ssize_t
+i2c_bus_write_then_read(int fd_i2c, I2C_DeviceAddress address,
+    const uint8_t *p_write, size_t write_length, uint8_t *p_read,
+    size_t read_length);
+
+/**
+ * @brief Count bytes of a transfer done outside of this module, e.g. by
+ *        lib_ccs811.
+ */
+void
+i2c_bus_add_bytes(size_t bytes);
+
+/**
+ * @brief Get bytes transferred, display traffic excluded.
+ *
+ * @param b_reset Restart counting.
+ */
+uint64_t
+i2c_bus_get_bytes(bool b_reset);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // I2C_BUS_H
+
+/* [] END OF FILE */
@@ -0,0 +1,88 @@
+/***************************************************************************//**
+* @file    i2c_scan.c
+* @version 1.0.0
+*
+* @brief I2C bus scan.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include "i2c_scan.h"
+#include "i2c_bus.h"
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+bool
+i2c_scan_probe(int fd_i2c, uint8_t addr)
+{
+    uint8_t data;
+
+    return i2c_bus_read(fd_i2c, addr, &data, 1) == 1;
+}
+
+uint32_t
+i2c_scan_range(int fd_i2c, uint8_t first, uint8_t last,
+    i2c_scan_map_t *p_map, const i2c_scan_map_t *p_skip)
+{
+    uint32_t found = 0;
+
+    for (uint32_t addr = first; addr <= last; addr++)
+    {
+        if ((p_skip == NULL) || !i2c_scan_is_present(p_skip, (uint8_t)addr))
+        {
+            i2c_scan_set(p_map, (uint8_t)addr,
+                i2c_scan_probe(fd_i2c, (uint8_t)addr));
+        }
+
+        if (i2c_scan_is_present(p_map, (uint8_t)addr))
+        {
+            found++;
+        }
+    }
+
+    return found;
+}
+
+bool
+i2c_scan_is_present(const i2c_scan_map_t *p_map, uint8_t addr)
+{
+    return (addr < 128) &&
+        ((p_map->present[addr / 32] & (1u << (addr % 32))) != 0);
+}
+
+void
+i2c_scan_set(i2c_scan_map_t *p_map, uint8_t addr, bool b_is_present)
+{
+    if (addr < 128)
+    {
+        if (b_is_present)
+        {
+            p_map->present[addr / 32] |= 1u << (addr % 32);
+        }
+        else
+        {
+            p_map->present[addr / 32] &= ~(1u << (addr % 32));
+        }
+    }
+}
+
+uint8_t
+i2c_scan_find(const i2c_scan_map_t *p_map, uint8_t first, uint8_t last)
+{
+    for (uint32_t addr = first; addr <= last; addr++)
+    {
+        if (i2c_scan_is_present(p_map, (uint8_t)addr))
+        {
+            return (uint8_t)addr;
+        }
+    }
+
+    return 0;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,103 @@
+/***************************************************************************//**
+* @file    i2c_scan.h
+* @version 1.0.0
+*
+* @brief I2C bus scan.
+*
+* Every address is probed with a one byte read, the shortest transaction
+* a device must acknowledge: 20 bit times when a device answers, 11 when the
+* address is NACKed. A read has no side effects on the sensors in use, unlike
+* a write, which would e.g. start an HDC1000 conversion. The whole 7 bit range of an empty bus
+* takes about 12 ms at 100 kHz.
+*
+* Devices busy with a conversion NACK as if absent, so addresses of bound
+* devices are left out of rescans.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef I2C_SCAN_H
+#define I2C_SCAN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "applibs_versions.h"
+#ifndef I2C_STRUCTS_VERSION
+#define I2C_STRUCTS_VERSION 1
+#endif
+#include <applibs/i2c.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+// 7 bit addresses not reserved by the I2C specification
+#define I2C_SCAN_ADDR_FIRST     (0x08)
+#define I2C_SCAN_ADDR_LAST      (0x77)
+
+/*******************************************************************************
+*   Data types
+*******************************************************************************/
+
+typedef struct
+{
+    uint32_t present[4];        // Bit per 7 bit address
+} i2c_scan_map_t;
+
+/*******************************************************************************
+*   Function declarations
+*******************************************************************************/
+
+/**
+ * @brief Check whether a device acknowledges its address.
+ */
+bool
+i2c_scan_probe(int fd_i2c, uint8_t addr);
+
+/**
+ * @brief Probe a range of addresses and record the results.
+ *
+ * @param p_map Map to update, addresses outside the range are kept.
+ * @param p_skip Addresses not to probe, their bits are kept. May be NULL.
+ *
+ * @return Number of devices found in the range.
+ */
+uint32_t
+i2c_scan_range(int fd_i2c, uint8_t first, uint8_t last,
+    i2c_scan_map_t *p_map, const i2c_scan_map_t *p_skip);
+
+/**
+ * @brief Check whether an address is marked present.
+ */
+bool
+i2c_scan_is_present(const i2c_scan_map_t *p_map, uint8_t addr);
+
+/**
+ * @brief Mark an address present or absent.
+ */
+void
+i2c_scan_set(i2c_scan_map_t *p_map, uint8_t addr, bool b_is_present);
+
+/**
+ * @brief Find the lowest present address of a range.
+ *
+ * @return Address, 0 if none is present.
+ */
+uint8_t
+i2c_scan_find(const i2c_scan_map_t *p_map, uint8_t first, uint8_t last);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // I2C_SCAN_H
+
+/* [] END OF FILE */
@@ -0,0 +1,220 @@
+/***************************************************************************//**
+* @file    iaq.c
+* @version 1.0.0
+*
+* @brief Indoor air quality index.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <string.h>
+
+#include "iaq.h"
+
+/*******************************************************************************
+* Data types
+*******************************************************************************/
+
+// Breakpoint, index interpolated linearly between breakpoints
+typedef struct
+{
+    int32_t value;
+    uint16_t index;
+} iaq_point_t;
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+// eCO2 [ppm], outdoor air is about 400 ppm
+static const iaq_point_t g_eco2_table[] = {
+    { 400, 0 }, { 600, 50 }, { 800, 100 }, { 1000, 150 }, { 1500, 200 },
+    { 2000, 300 }, { 5000, IAQ_INDEX_MAX }
+};
+
+// TVOC [ppb], levels of the German Federal Environment Agency guideline
+static const iaq_point_t g_tvoc_table[] = {
+    { 0, 0 }, { 65, 50 }, { 220, 100 }, { 660, 150 }, { 2200, 200 },
+    { 5500, 300 }, { 11000, IAQ_INDEX_MAX }
+};
+
+// Temperature penalty [0.01 degC], comfortable from 18 to 26 degC
+static const iaq_point_t g_temperature_table[] = {
+    { 1200, 50 }, { 1600, 20 }, { 1800, 0 }, { 2600, 0 }, { 2800, 20 },
+    { 3200, 50 }
+};
+
+// Humidity penalty [0.01 %RH], comfortable from 30 to 60 %RH
+static const iaq_point_t g_humidity_table[] = {
+    { 1000, 50 }, { 2000, 20 }, { 3000, 0 }, { 6000, 0 }, { 7000, 20 },
+    { 8500, 50 }
+};
+
+static const char *gp_band_names[IAQ_BAND_COUNT] = {
+    "excellent", "good", "moderate", "poor", "unhealthy", "hazardous"
+};
+
+// Upper index of each band
+static const uint16_t g_band_limits[IAQ_BAND_COUNT] = {
+    50, 100, 150, 200, 300, IAQ_INDEX_MAX
+};
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+static uint16_t
+table_lookup(const iaq_point_t *p_table, size_t size, int32_t value);
+
+static void
+window_add(iaq_window_t *p_window, uint16_t value);
+
+static uint16_t
+window_average(const iaq_window_t *p_window);
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+void
+iaq_init(iaq_t *p_iaq)
+{
+    memset(p_iaq, 0, sizeof(*p_iaq));
+    p_iaq->temperature = IAQ_NEUTRAL_TEMPERATURE;
+    p_iaq->humidity = IAQ_NEUTRAL_HUMIDITY;
+}
+
+void
+iaq_add_gas(iaq_t *p_iaq, uint16_t eco2, uint16_t tvoc)
+{
+    window_add(&p_iaq->eco2, eco2);
+    window_add(&p_iaq->tvoc, tvoc);
+}
+
+void
+iaq_set_comfort(iaq_t *p_iaq, int16_t temperature, uint16_t humidity)
+{
+    p_iaq->temperature = temperature;
+    p_iaq->humidity = humidity;
+}
+
+bool
+iaq_get(const iaq_t *p_iaq, iaq_result_t *p_result)
+{
+    if (p_iaq->eco2.count == 0)
+    {
+        return false;
+    }
+
+    iaq_compute(window_average(&p_iaq->eco2), window_average(&p_iaq->tvoc),
+        p_iaq->temperature, p_iaq->humidity, p_result);
+
+    return true;
+}
+
+void
+iaq_compute(uint16_t eco2, uint16_t tvoc, int16_t temperature,
+    uint16_t humidity, iaq_result_t *p_result)
+{
+    p_result->eco2_average = eco2;
+    p_result->tvoc_average = tvoc;
+    p_result->eco2_index = table_lookup(g_eco2_table,
+        sizeof(g_eco2_table) / sizeof(g_eco2_table[0]), eco2);
+    p_result->tvoc_index = table_lookup(g_tvoc_table,
+        sizeof(g_tvoc_table) / sizeof(g_tvoc_table[0]), tvoc);
+    p_result->penalty = (uint16_t)(
+        table_lookup(g_temperature_table, sizeof(g_temperature_table) /
+            sizeof(g_temperature_table[0]), temperature) +
+        table_lookup(g_humidity_table, sizeof(g_humidity_table) /
+            sizeof(g_humidity_table[0]), humidity));
+
+    uint32_t index = (p_result->eco2_index > p_result->tvoc_index) ?
+        p_result->eco2_index : p_result->tvoc_index;
+    index += p_result->penalty;
+
+    p_result->index = (uint16_t)((index > IAQ_INDEX_MAX) ? IAQ_INDEX_MAX : index);
+    p_result->band = iaq_get_band(p_result->index);
+}
+
+iaq_band_t
+iaq_get_band(uint16_t index)
+{
+    iaq_band_t band = IAQ_BAND_EXCELLENT;
+
+    while ((band < IAQ_BAND_HAZARDOUS) && (index > g_band_limits[band]))
+    {
+        band++;
+    }
+
+    return band;
+}
+
+const char *
+iaq_get_band_name(iaq_band_t band)
+{
+    return (band < IAQ_BAND_COUNT) ? gp_band_names[band] : "unknown";
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+static uint16_t
+table_lookup(const iaq_point_t *p_table, size_t size, int32_t value)
+{
+    if (value <= p_table[0].value)
+    {
+        return p_table[0].index;
+    }
+
+    for (size_t idx = 1; idx < size; idx++)
+    {
+        if (value < p_table[idx].value)
+        {
+            const iaq_point_t *p_low = &p_table[idx - 1];
+            const iaq_point_t *p_high = &p_table[idx];
+            int32_t span = p_high->value - p_low->value;
+            int32_t delta = (int32_t)p_high->index - (int32_t)p_low->index;
+
+            // Rounded to nearest
+            int32_t offset = (delta * (value - p_low->value) * 2 + span) /
+                (2 * span);
+            if (delta < 0)
+            {
+                offset = -((-delta * (value - p_low->value) * 2 + span) /
+                    (2 * span));
+            }
+            return (uint16_t)((int32_t)p_low->index + offset);
+        }
+    }
+
+    return p_table[size - 1].index;
+}
+
+static void
+window_add(iaq_window_t *p_window, uint16_t value)
+{
+    if (p_window->count == IAQ_WINDOW_SAMPLES)
+    {
+        p_window->sum -= p_window->values[p_window->next];
+    }
+    else
+    {
+        p_window->count++;
+    }
+
+    p_window->values[p_window->next] = value;
+    p_window->sum += value;
+    p_window->next = (uint16_t)((p_window->next + 1) % IAQ_WINDOW_SAMPLES);
+}
+
+static uint16_t
+window_average(const iaq_window_t *p_window)
+{
+    return (uint16_t)((p_window->sum + p_window->count / 2) / p_window->count);
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,141 @@
+/***************************************************************************//**
+* @file    iaq.h
+* @version 1.0.0
+*
+* @brief Indoor air quality index.
+*
+* The index runs from 0 (excellent) to IAQ_INDEX_MAX. The worse of the eCO2
+* and TVOC sub-indices, each interpolated from a breakpoint table over the
+* rolling average of the last IAQ_WINDOW_SAMPLES readings, is raised by
+* comfort penalties for temperature and humidity outside the comfort range.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef IAQ_H
+#define IAQ_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+// Readings in the rolling gas averages, one minute at 1 s drive mode
+#ifndef IAQ_WINDOW_SAMPLES
+#define IAQ_WINDOW_SAMPLES      (60)
+#endif
+
+#define IAQ_INDEX_MAX           (500)
+
+// Comfort assumed until the first temperature and humidity reading
+#define IAQ_NEUTRAL_TEMPERATURE (2200)      // [0.01 degC]
+#define IAQ_NEUTRAL_HUMIDITY    (4500)      // [0.01 %RH]
+
+/*******************************************************************************
+*   Data types
+*******************************************************************************/
+
+typedef enum
+{
+    IAQ_BAND_EXCELLENT,         // 0 - 50
+    IAQ_BAND_GOOD,              // 51 - 100
+    IAQ_BAND_MODERATE,          // 101 - 150
+    IAQ_BAND_POOR,              // 151 - 200
+    IAQ_BAND_UNHEALTHY,         // 201 - 300
+    IAQ_BAND_HAZARDOUS,         // 301 - IAQ_INDEX_MAX
+    IAQ_BAND_COUNT
+} iaq_band_t;
+
+// Rolling average with running sum, O(1) per reading
+typedef struct
+{
+    uint16_t values[IAQ_WINDOW_SAMPLES];
+    uint32_t sum;
+    uint16_t count;
+    uint16_t next;
+} iaq_window_t;
+
+typedef struct
+{
+    iaq_window_t eco2;
+    iaq_window_t tvoc;
+    int16_t temperature;        // [0.01 degC]
+    uint16_t humidity;          // [0.01 %RH]
+} iaq_t;
+
+typedef struct
+{
+    uint16_t index;
+    iaq_band_t band;
+    uint16_t eco2_index;        // Sub-index of the eCO2 average
+    uint16_t tvoc_index;        // Sub-index of the TVOC average
+    uint16_t penalty;           // Temperature and humidity penalty
+    uint16_t eco2_average;      // [ppm]
+    uint16_t tvoc_average;      // [ppb]
+} iaq_result_t;
+
+/*******************************************************************************
+*   Function declarations
+*******************************************************************************/
+
+/**
+ * @brief Clear averages, comfort values neutral.
+ */
+void
+iaq_init(iaq_t *p_iaq);
+
+/**
+ * @brief Add CCS811 reading to the rolling averages.
+ */
+void
+iaq_add_gas(iaq_t *p_iaq, uint16_t eco2, uint16_t tvoc);
+
+/**
+ * @brief Set latest temperature and humidity.
+ */
+void
+iaq_set_comfort(iaq_t *p_iaq, int16_t temperature, uint16_t humidity);
+
+/**
+ * @brief Get index over the current averages.
+ *
+ * @return false until the first gas reading.
+ */
+bool
+iaq_get(const iaq_t *p_iaq, iaq_result_t *p_result);
+
+/**
+ * @brief Compute index of given averages and comfort values.
+ */
+void
+iaq_compute(uint16_t eco2, uint16_t tvoc, int16_t temperature,
+    uint16_t humidity, iaq_result_t *p_result);
+
+/**
+ * @brief Get band of index.
+ */
+iaq_band_t
+iaq_get_band(uint16_t index);
+
+/**
+ * @brief Get band name, e.g. "moderate".
+ */
+const char *
+iaq_get_band_name(iaq_band_t band);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // IAQ_H
+
+/* [] END OF FILE */
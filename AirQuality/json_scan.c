@@ -0,0 +1,651 @@
+/***************************************************************************//**
+* @file    json_scan.c
+* @version 1.0.0
+*
+* @brief Bounded in place JSON tokenizer.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <math.h>
+#include <string.h>
+
+#include "json_scan.h"
+
+/*******************************************************************************
+* Macros and #define Constants
+*******************************************************************************/
+
+// Decimal exponents beyond it overflow or underflow a double anyway
+#define JSON_SCAN_EXPONENT_MAX  (400)
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+static size_t
+skip_space(const char *p_data, size_t size, size_t pos);
+
+/**
+ * @brief Validate one value starting at *p_pos and move past it.
+ */
+static bool
+validate_value(const char *p_data, size_t size, size_t *p_pos,
+    unsigned depth);
+
+static bool
+validate_string(const char *p_data, size_t size, size_t *p_pos);
+
+static bool
+validate_number(const char *p_data, size_t size, size_t *p_pos);
+
+static bool
+validate_literal(const char *p_data, size_t size, size_t *p_pos,
+    const char *p_literal);
+
+/**
+ * @brief Move past one value of a validated document.
+ */
+static size_t
+skip_value(const char *p_data, size_t size, size_t pos);
+
+static size_t
+skip_string(const char *p_data, size_t size, size_t pos);
+
+/**
+ * @brief Decode one character of a validated string.
+ *
+ * @return Code point, \u escapes decoded, other bytes as they are.
+ */
+static uint32_t
+decode_char(const char *p_data, size_t *p_pos);
+
+static int
+hex_digit(char digit);
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+bool
+json_scan_parse(const void *p_data, size_t size, json_scan_value_t *p_root)
+{
+    const char *p_text = p_data;
+    size_t pos = skip_space(p_text, size, 0);
+    size_t start = pos;
+
+    if (!validate_value(p_text, size, &pos, 0))
+    {
+        return false;
+    }
+
+    p_root->p_data = p_text + start;
+    p_root->size = pos - start;
+
+    return skip_space(p_text, size, pos) == size;
+}
+
+json_scan_type_t
+json_scan_type(const json_scan_value_t *p_value)
+{
+    if (p_value->size == 0)
+    {
+        return JSON_SCAN_INVALID;
+    }
+
+    switch (p_value->p_data[0])
+    {
+        case '{':
+            return JSON_SCAN_OBJECT;
+
+        case '[':
+            return JSON_SCAN_ARRAY;
+
+        case '"':
+            return JSON_SCAN_STRING;
+
+        case 't':
+            return JSON_SCAN_TRUE;
+
+        case 'f':
+            return JSON_SCAN_FALSE;
+
+        case 'n':
+            return JSON_SCAN_NULL;
+
+        default:
+            return JSON_SCAN_NUMBER;
+    }
+}
+
+bool
+json_scan_next_member(const json_scan_value_t *p_object, size_t *p_pos,
+    json_scan_value_t *p_name, json_scan_value_t *p_value)
+{
+    const char *p_data = p_object->p_data;
+    size_t size = p_object->size;
+    size_t pos = (*p_pos == 0) ? 1 : *p_pos;
+
+    if (json_scan_type(p_object) != JSON_SCAN_OBJECT)
+    {
+        return false;
+    }
+
+    pos = skip_space(p_data, size, pos);
+    if (p_data[pos] == ',')
+    {
+        pos = skip_space(p_data, size, pos + 1);
+    }
+    if (p_data[pos] == '}')
+    {
+        *p_pos = pos;
+        return false;
+    }
+
+    p_name->p_data = p_data + pos;
+    pos = skip_string(p_data, size, pos);
+    p_name->size = (size_t)(p_data + pos - p_name->p_data);
+
+    // Colon between name and value
+    pos = skip_space(p_data, size, pos);
+    pos = skip_space(p_data, size, pos + 1);
+
+    p_value->p_data = p_data + pos;
+    pos = skip_value(p_data, size, pos);
+    p_value->size = (size_t)(p_data + pos - p_value->p_data);
+
+    *p_pos = pos;
+    return true;
+}
+
+bool
+json_scan_get_member(const json_scan_value_t *p_object, const char *p_name,
+    json_scan_value_t *p_value)
+{
+    json_scan_value_t name;
+    size_t pos = 0;
+
+    while (json_scan_next_member(p_object, &pos, &name, p_value))
+    {
+        if (json_scan_string_equals(&name, p_name))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool
+json_scan_string_equals(const json_scan_value_t *p_value, const char *p_text)
+{
+    if (json_scan_type(p_value) != JSON_SCAN_STRING)
+    {
+        return false;
+    }
+
+    // Between the quotes
+    size_t end = p_value->size - 1;
+    size_t pos = 1;
+
+    while (pos < end)
+    {
+        if ((*p_text == '\0') ||
+            (decode_char(p_value->p_data, &pos) != (uint8_t)*p_text))
+        {
+            return false;
+        }
+        p_text++;
+    }
+
+    return *p_text == '\0';
+}
+
+bool
+json_scan_get_string(const json_scan_value_t *p_value, char *p_buffer,
+    size_t buffer_size)
+{
+    size_t len = 0;
+
+    if ((json_scan_type(p_value) != JSON_SCAN_STRING) || (buffer_size == 0))
+    {
+        return false;
+    }
+
+    size_t end = p_value->size - 1;
+    size_t pos = 1;
+
+    while (pos < end)
+    {
+        bool b_is_escaped = (p_value->p_data[pos] == '\\');
+        uint32_t code = decode_char(p_value->p_data, &pos);
+
+        if ((len + 1 >= buffer_size) || (b_is_escaped && (code >= 0x80u)))
+        {
+            return false;
+        }
+        p_buffer[len++] = (char)code;
+    }
+    p_buffer[len] = '\0';
+
+    return true;
+}
+
+bool
+json_scan_get_number(const json_scan_value_t *p_value, double *p_number)
+{
+    const char *p_data = p_value->p_data;
+    size_t size = p_value->size;
+    size_t pos = 0;
+    double mantissa = 0.0;
+    int exponent = 0;
+    int exponent_part = 0;
+    bool b_is_negative = false;
+
+    if (json_scan_type(p_value) != JSON_SCAN_NUMBER)
+    {
+        return false;
+    }
+
+    if (p_data[pos] == '-')
+    {
+        b_is_negative = true;
+        pos++;
+    }
+
+    for (; (pos < size) && (p_data[pos] >= '0') && (p_data[pos] <= '9'); pos++)
+    {
+        mantissa = mantissa * 10.0 + (p_data[pos] - '0');
+    }
+
+    if ((pos < size) && (p_data[pos] == '.'))
+    {
+        for (pos++; (pos < size) && (p_data[pos] >= '0') &&
+            (p_data[pos] <= '9'); pos++)
+        {
+            mantissa = mantissa * 10.0 + (p_data[pos] - '0');
+            exponent--;
+        }
+    }
+
+    if ((pos < size) && ((p_data[pos] == 'e') || (p_data[pos] == 'E')))
+    {
+        bool b_is_exponent_negative = false;
+
+        pos++;
+        if ((pos < size) && ((p_data[pos] == '+') || (p_data[pos] == '-')))
+        {
+            b_is_exponent_negative = (p_data[pos] == '-');
+            pos++;
+        }
+        for (; (pos < size) && (p_data[pos] >= '0') && (p_data[pos] <= '9');
+            pos++)
+        {
+            if (exponent_part < JSON_SCAN_EXPONENT_MAX)
+            {
+                exponent_part = exponent_part * 10 + (p_data[pos] - '0');
+            }
+        }
+        exponent += b_is_exponent_negative ? -exponent_part : exponent_part;
+    }
+
+    // Whole numbers, as the configuration values, are exact
+    if ((mantissa != 0.0) && (exponent > JSON_SCAN_EXPONENT_MAX))
+    {
+        mantissa = HUGE_VAL;
+    }
+    else if (exponent < -JSON_SCAN_EXPONENT_MAX)
+    {
+        mantissa = 0.0;
+    }
+    for (; (exponent > 0) && isfinite(mantissa); exponent--)
+    {
+        mantissa *= 10.0;
+    }
+    for (; (exponent < 0) && (mantissa != 0.0); exponent++)
+    {
+        mantissa /= 10.0;
+    }
+
+    *p_number = b_is_negative ? -mantissa : mantissa;
+    return true;
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+static size_t
+skip_space(const char *p_data, size_t size, size_t pos)
+{
+    while ((pos < size) && ((p_data[pos] == ' ') || (p_data[pos] == '\t') ||
+        (p_data[pos] == '\n') || (p_data[pos] == '\r')))
+    {
+        pos++;
+    }
+
+    return pos;
+}
+
+static bool
+validate_value(const char *p_data, size_t size, size_t *p_pos,
+    unsigned depth)
+{
+    size_t pos = *p_pos;
+
+    if (pos >= size)
+    {
+        return false;
+    }
+
+    switch (p_data[pos])
+    {
+        case '"':
+            return validate_string(p_data, size, p_pos);
+
+        case 't':
+            return validate_literal(p_data, size, p_pos, "true");
+
+        case 'f':
+            return validate_literal(p_data, size, p_pos, "false");
+
+        case 'n':
+            return validate_literal(p_data, size, p_pos, "null");
+
+        case '{':
+        case '[':
+            break;
+
+        default:
+            return validate_number(p_data, size, p_pos);
+    }
+
+    char close = (p_data[pos] == '{') ? '}' : ']';
+    bool b_is_object = (close == '}');
+
+    if (depth >= JSON_SCAN_DEPTH_MAX)
+    {
+        return false;
+    }
+
+    pos = skip_space(p_data, size, pos + 1);
+    if ((pos < size) && (p_data[pos] == close))
+    {
+        *p_pos = pos + 1;
+        return true;
+    }
+
+    while (pos < size)
+    {
+        if (b_is_object)
+        {
+            if ((p_data[pos] != '"') || !validate_string(p_data, size, &pos))
+            {
+                return false;
+            }
+            pos = skip_space(p_data, size, pos);
+            if ((pos >= size) || (p_data[pos] != ':'))
+            {
+                return false;
+            }
+            pos = skip_space(p_data, size, pos + 1);
+        }
+
+        if (!validate_value(p_data, size, &pos, depth + 1))
+        {
+            return false;
+        }
+
+        pos = skip_space(p_data, size, pos);
+        if ((pos < size) && (p_data[pos] == close))
+        {
+            *p_pos = pos + 1;
+            return true;
+        }
+        if ((pos >= size) || (p_data[pos] != ','))
+        {
+            return false;
+        }
+        pos = skip_space(p_data, size, pos + 1);
+    }
+
+    return false;
+}
+
+static bool
+validate_string(const char *p_data, size_t size, size_t *p_pos)
+{
+    // Past the opening quote
+    for (size_t pos = *p_pos + 1; pos < size; pos++)
+    {
+        uint8_t byte = (uint8_t)p_data[pos];
+
+        if (byte == '"')
+        {
+            *p_pos = pos + 1;
+            return true;
+        }
+
+        if (byte < 0x20u)
+        {
+            return false;
+        }
+
+        if (byte == '\\')
+        {
+            pos++;
+            if ((pos >= size) || (strchr("\"\\/bfnrtu", p_data[pos]) == NULL))
+            {
+                return false;
+            }
+            if (p_data[pos] == 'u')
+            {
+                for (int idx = 0; idx < 4; idx++)
+                {
+                    pos++;
+                    if ((pos >= size) || (hex_digit(p_data[pos]) < 0))
+                    {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+static bool
+validate_number(const char *p_data, size_t size, size_t *p_pos)
+{
+    size_t pos = *p_pos;
+    size_t digits;
+
+    if ((pos < size) && (p_data[pos] == '-'))
+    {
+        pos++;
+    }
+
+    // No leading zeros
+    for (digits = 0; (pos < size) && (p_data[pos] >= '0') &&
+        (p_data[pos] <= '9'); digits++)
+    {
+        pos++;
+    }
+    if ((digits == 0) || ((digits > 1) && (p_data[pos - digits] == '0')))
+    {
+        return false;
+    }
+
+    if ((pos < size) && (p_data[pos] == '.'))
+    {
+        for (pos++, digits = 0; (pos < size) && (p_data[pos] >= '0') &&
+            (p_data[pos] <= '9'); digits++)
+        {
+            pos++;
+        }
+        if (digits == 0)
+        {
+            return false;
+        }
+    }
+
+    if ((pos < size) && ((p_data[pos] == 'e') || (p_data[pos] == 'E')))
+    {
+        pos++;
+        if ((pos < size) && ((p_data[pos] == '+') || (p_data[pos] == '-')))
+        {
+            pos++;
+        }
+        for (digits = 0; (pos < size) && (p_data[pos] >= '0') &&
+            (p_data[pos] <= '9'); digits++)
+        {
+            pos++;
+        }
+        if (digits == 0)
+        {
+            return false;
+        }
+    }
+
+    *p_pos = pos;
+    return true;
+}
+
+static bool
+validate_literal(const char *p_data, size_t size, size_t *p_pos,
+    const char *p_literal)
+{
+    size_t len = strlen(p_literal);
+
+    if ((size - *p_pos < len) || (memcmp(p_data + *p_pos, p_literal, len) != 0))
+    {
+        return false;
+    }
+
+    *p_pos += len;
+    return true;
+}
+
+static size_t
+skip_value(const char *p_data, size_t size, size_t pos)
+{
+    unsigned depth = 0;
+
+    if (p_data[pos] == '"')
+    {
+        return skip_string(p_data, size, pos);
+    }
+
+    if ((p_data[pos] != '{') && (p_data[pos] != '['))
+    {
+        // Number or literal, up to the next separator or space
+        while ((pos < size) && (strchr(",}] \t\n\r", p_data[pos]) == NULL))
+        {
+            pos++;
+        }
+        return pos;
+    }
+
+    // Brackets within strings do not count
+    do
+    {
+        if (p_data[pos] == '"')
+        {
+            pos = skip_string(p_data, size, pos);
+            continue;
+        }
+
+        if ((p_data[pos] == '{') || (p_data[pos] == '['))
+        {
+            depth++;
+        }
+        else if ((p_data[pos] == '}') || (p_data[pos] == ']'))
+        {
+            depth--;
+        }
+        pos++;
+    } while ((depth > 0) && (pos < size));
+
+    return pos;
+}
+
+static size_t
+skip_string(const char *p_data, size_t size, size_t pos)
+{
+    // Past the opening quote
+    for (pos++; pos < size; pos++)
+    {
+        if (p_data[pos] == '\\')
+        {
+            pos++;
+        }
+        else if (p_data[pos] == '"')
+        {
+            return pos + 1;
+        }
+    }
+
+    return size;
+}
+
+static uint32_t
+decode_char(const char *p_data, size_t *p_pos)
+{
+    size_t pos = *p_pos;
+    uint32_t code = (uint8_t)p_data[pos];
+
+    if (code == '\\')
+    {
+        pos++;
+        switch (p_data[pos])
+        {
+            case 'b': code = '\b'; break;
+            case 'f': code = '\f'; break;
+            case 'n': code = '\n'; break;
+            case 'r': code = '\r'; break;
+            case 't': code = '\t'; break;
+
+            case 'u':
+                code = 0;
+                for (int idx = 0; idx < 4; idx++)
+                {
+                    pos++;
+                    code = (code << 4) | (uint32_t)hex_digit(p_data[pos]);
+                }
+                break;
+
+            default:
+                // Quote, backslash and slash stand for themselves
+                code = (uint8_t)p_data[pos];
+                break;
+        }
+    }
+
+    *p_pos = pos + 1;
+    return code;
+}
+
+static int
+hex_digit(char digit)
+{
+    if ((digit >= '0') && (digit <= '9'))
+    {
+        return digit - '0';
+    }
+    if ((digit >= 'a') && (digit <= 'f'))
+    {
+        return digit - 'a' + 10;
+    }
+    if ((digit >= 'A') && (digit <= 'F'))
+    {
+        return digit - 'A' + 10;
+    }
+
+    return -1;
+}
+
+/* [] END OF FILE */
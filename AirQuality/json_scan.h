@@ -0,0 +1,140 @@
+/***************************************************************************//**
+* @file    json_scan.h
+* @version 1.0.0
+*
+* @brief Bounded in place JSON tokenizer.
+*
+* Reads JSON from a buffer given as pointer and size, e.g. a payload of the
+* IoT Hub SDK that is not zero terminated, without copying it or building
+* a tree. json_scan_parse() validates the whole document once, values are
+* then handed out as spans of the buffer and read on demand. Nesting is
+* limited to JSON_SCAN_DEPTH_MAX, no memory is allocated.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef JSON_SCAN_H
+#define JSON_SCAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+// Deepest nesting of objects and arrays accepted by json_scan_parse()
+#define JSON_SCAN_DEPTH_MAX     (32)
+
+/*******************************************************************************
+*   Data types
+*******************************************************************************/
+
+typedef enum
+{
+    JSON_SCAN_INVALID = 0,
+    JSON_SCAN_OBJECT,
+    JSON_SCAN_ARRAY,
+    JSON_SCAN_STRING,
+    JSON_SCAN_NUMBER,
+    JSON_SCAN_TRUE,
+    JSON_SCAN_FALSE,
+    JSON_SCAN_NULL
+} json_scan_type_t;
+
+// One value of a validated document, strings with their quotes
+typedef struct
+{
+    const char *p_data;
+    size_t size;
+} json_scan_value_t;
+
+/*******************************************************************************
+*   Function declarations
+*******************************************************************************/
+
+/**
+ * @brief Validate a document and get its root value.
+ *
+ * @param p_data Document, need not be zero terminated.
+ * @param size Size of document in bytes.
+ * @param p_root Output root value, spanning the buffer.
+ *
+ * @return true if the buffer holds exactly one valid JSON value.
+ */
+bool
+json_scan_parse(const void *p_data, size_t size, json_scan_value_t *p_root);
+
+/**
+ * @brief Get type of a value.
+ */
+json_scan_type_t
+json_scan_type(const json_scan_value_t *p_value);
+
+/**
+ * @brief Get next member of an object.
+ *
+ * @param p_object Object value.
+ * @param p_pos Position within the object, 0 before the first call.
+ * @param p_name Output member name, a string value.
+ * @param p_value Output member value.
+ *
+ * @return false after the last member or if p_object is not an object.
+ */
+bool
+json_scan_next_member(const json_scan_value_t *p_object, size_t *p_pos,
+    json_scan_value_t *p_name, json_scan_value_t *p_value);
+
+/**
+ * @brief Find first member of an object by name.
+ *
+ * @return false if there is no such member or p_object is not an object.
+ */
+bool
+json_scan_get_member(const json_scan_value_t *p_object, const char *p_name,
+    json_scan_value_t *p_value);
+
+/**
+ * @brief Compare a string value with a zero terminated text.
+ *
+ * Escape sequences of the value are decoded for the comparison.
+ *
+ * @return false if they differ or p_value is not a string.
+ */
+bool
+json_scan_string_equals(const json_scan_value_t *p_value, const char *p_text);
+
+/**
+ * @brief Copy a string value into a zero terminated buffer.
+ *
+ * Escape sequences are decoded, \u escapes outside ASCII are refused.
+ *
+ * @return false if p_value is not a string or it does not fit.
+ */
+bool
+json_scan_get_string(const json_scan_value_t *p_value, char *p_buffer,
+    size_t buffer_size);
+
+/**
+ * @brief Read a number value.
+ *
+ * @return false if p_value is not a number.
+ */
+bool
+json_scan_get_number(const json_scan_value_t *p_value, double *p_number);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // JSON_SCAN_H
+
+/* [] END OF FILE */
@@ -0,0 +1,208 @@
+/***************************************************************************//**
+* @file    latency_histogram.c
+* @version 1.0.0
+*
+* @brief Fixed memory log-linear latency histogram.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "latency_histogram.h"
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+void
+latency_hist_reset(latency_hist_t *p_hist)
+{
+    memset(p_hist, 0, sizeof(latency_hist_t));
+    p_hist->min = UINT32_MAX;
+}
+
+void
+latency_hist_record(latency_hist_t *p_hist, uint32_t value)
+{
+    if (value > LATENCY_HIST_VALUE_MAX)
+    {
+        value = LATENCY_HIST_VALUE_MAX;
+    }
+
+    p_hist->buckets[latency_hist_bucket_index(value)]++;
+    p_hist->count++;
+    p_hist->sum += value;
+    if (value < p_hist->min)
+    {
+        p_hist->min = value;
+    }
+    if (value > p_hist->max)
+    {
+        p_hist->max = value;
+    }
+}
+
+void
+latency_hist_merge(latency_hist_t *p_dest, const latency_hist_t *p_src)
+{
+    if (p_src->count == 0)
+    {
+        return;
+    }
+
+    for (unsigned idx = 0; idx < LATENCY_HIST_BUCKETS; idx++)
+    {
+        p_dest->buckets[idx] += p_src->buckets[idx];
+    }
+    p_dest->count += p_src->count;
+    p_dest->sum += p_src->sum;
+    if (p_src->min < p_dest->min)
+    {
+        p_dest->min = p_src->min;
+    }
+    if (p_src->max > p_dest->max)
+    {
+        p_dest->max = p_src->max;
+    }
+}
+
+uint32_t
+latency_hist_percentile(const latency_hist_t *p_hist, unsigned per_mille)
+{
+    if (p_hist->count == 0)
+    {
+        return 0;
+    }
+
+    // Rank of requested value, 1-based, rounded up
+    uint64_t rank = ((uint64_t)p_hist->count * per_mille + 999) / 1000;
+    if (rank == 0)
+    {
+        rank = 1;
+    }
+
+    uint64_t seen = 0;
+    for (unsigned idx = 0; idx < LATENCY_HIST_BUCKETS; idx++)
+    {
+        seen += p_hist->buckets[idx];
+        if (seen >= rank)
+        {
+            uint32_t value = latency_hist_bucket_upper(idx);
+            return (value > p_hist->max) ? p_hist->max : value;
+        }
+    }
+
+    return p_hist->max;
+}
+
+void
+latency_hist_summarize(const latency_hist_t *p_hist,
+    latency_summary_t *p_summary)
+{
+    p_summary->count = p_hist->count;
+    p_summary->min = p_hist->count ? p_hist->min : 0;
+    p_summary->mean = p_hist->count ? (uint32_t)(p_hist->sum / p_hist->count) : 0;
+    p_summary->p50 = latency_hist_percentile(p_hist, 500);
+    p_summary->p90 = latency_hist_percentile(p_hist, 900);
+    p_summary->p99 = latency_hist_percentile(p_hist, 990);
+    p_summary->max = p_hist->max;
+}
+
+int
+latency_hist_to_json(const latency_hist_t *p_hist, char *p_buffer,
+    size_t buffer_size)
+{
+    latency_summary_t summary;
+    latency_hist_summarize(p_hist, &summary);
+
+    int written = snprintf(p_buffer, buffer_size, "[%lu,%lu,%lu,%lu,%lu]",
+        (unsigned long)summary.count, (unsigned long)summary.p50,
+        (unsigned long)summary.p90, (unsigned long)summary.p99,
+        (unsigned long)summary.max);
+
+    return ((written < 0) || ((size_t)written >= buffer_size)) ? -1 : written;
+}
+
+int
+latency_hist_to_json_sparse(const latency_hist_t *p_hist, char *p_buffer,
+    size_t buffer_size)
+{
+    size_t len = 0;
+
+    if (buffer_size < 3)
+    {
+        return -1;
+    }
+    p_buffer[len++] = '[';
+
+    for (unsigned idx = 0; idx < LATENCY_HIST_BUCKETS; idx++)
+    {
+        if (p_hist->buckets[idx] == 0)
+        {
+            continue;
+        }
+
+        int written = snprintf(p_buffer + len, buffer_size - len, "%s[%u,%lu]",
+            (len > 1) ? "," : "", idx, (unsigned long)p_hist->buckets[idx]);
+        if ((written < 0) || ((size_t)written >= buffer_size - len))
+        {
+            return -1;
+        }
+        len += (size_t)written;
+    }
+
+    if (len + 2 > buffer_size)
+    {
+        return -1;
+    }
+    p_buffer[len++] = ']';
+    p_buffer[len] = '\0';
+
+    return (int)len;
+}
+
+unsigned
+latency_hist_bucket_index(uint32_t value)
+{
+    if (value < LATENCY_HIST_LINEAR)
+    {
+        return value;
+    }
+
+    if (value > LATENCY_HIST_VALUE_MAX)
+    {
+        value = LATENCY_HIST_VALUE_MAX;
+    }
+
+    // Position of the most significant bit, at least SUB_BITS + 1 here
+    unsigned msb = 31u - (unsigned)__builtin_clz(value);
+    unsigned group = msb - (LATENCY_HIST_SUB_BITS + 1);
+    unsigned sub = (value >> (msb - LATENCY_HIST_SUB_BITS)) &
+        (LATENCY_HIST_SUB_COUNT - 1);
+
+    return LATENCY_HIST_LINEAR + group * LATENCY_HIST_SUB_COUNT + sub;
+}
+
+uint32_t
+latency_hist_bucket_upper(unsigned index)
+{
+    if (index < LATENCY_HIST_LINEAR)
+    {
+        return index;
+    }
+
+    unsigned group = (index - LATENCY_HIST_LINEAR) / LATENCY_HIST_SUB_COUNT;
+    unsigned sub = (index - LATENCY_HIST_LINEAR) % LATENCY_HIST_SUB_COUNT;
+    unsigned msb = group + LATENCY_HIST_SUB_BITS + 1;
+    unsigned shift = msb - LATENCY_HIST_SUB_BITS;
+
+    uint32_t lower = (1u << msb) + ((uint32_t)sub << shift);
+    return lower + ((1u << shift) - 1);
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,167 @@
+/***************************************************************************//**
+* @file    latency_histogram.h
+* @version 1.0.0
+*
+* @brief Fixed memory log-linear latency histogram.
+*
+* HDR style histogram of 32-bit values (typically microseconds). Values
+* below 2^(SUB_BITS+1) are counted exactly, every following power of two
+* range is split into 2^SUB_BITS linear sub-buckets, giving relative error
+* of at most 1/2^SUB_BITS. Recording is O(1) without allocations,
+* histograms of the same geometry can be merged by adding bucket counts.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+// Sub-bucket resolution, 3 bits = 12.5 % worst case relative error
+#ifndef LATENCY_HIST_SUB_BITS
+#define LATENCY_HIST_SUB_BITS   (3)
+#endif
+
+// Highest tracked magnitude, larger values are clamped to 2^MAX_BITS - 1
+#ifndef LATENCY_HIST_MAX_BITS
+#define LATENCY_HIST_MAX_BITS   (24)
+#endif
+
+#define LATENCY_HIST_SUB_COUNT  (1u << LATENCY_HIST_SUB_BITS)
+#define LATENCY_HIST_LINEAR     (1u << (LATENCY_HIST_SUB_BITS + 1))
+#define LATENCY_HIST_BUCKETS    (LATENCY_HIST_LINEAR + \
+    (LATENCY_HIST_MAX_BITS - LATENCY_HIST_SUB_BITS - 1) * LATENCY_HIST_SUB_COUNT)
+
+#define LATENCY_HIST_VALUE_MAX  ((1u << LATENCY_HIST_MAX_BITS) - 1)
+
+/*******************************************************************************
+*   Data types
+*******************************************************************************/
+
+typedef struct
+{
+    uint32_t count;                             // Number of recorded values
+    uint32_t min;                               // Exact minimum
+    uint32_t max;                               // Exact maximum
+    uint64_t sum;                               // Sum for mean calculation
+    uint32_t buckets[LATENCY_HIST_BUCKETS];     // Bucket counters
+} latency_hist_t;
+
+typedef struct
+{
+    uint32_t count;
+    uint32_t min;
+    uint32_t mean;
+    uint32_t p50;
+    uint32_t p90;
+    uint32_t p99;
+    uint32_t max;
+} latency_summary_t;
+
+/*******************************************************************************
+*   Function declarations
+*******************************************************************************/
+
+/**
+ * @brief Clear histogram.
+ *
+ * @param p_hist Pointer to histogram.
+ */
+void
+latency_hist_reset(latency_hist_t *p_hist);
+
+/**
+ * @brief Record one value.
+ *
+ * @param p_hist Pointer to histogram.
+ * @param value Value to record.
+ */
+void
+latency_hist_record(latency_hist_t *p_hist, uint32_t value);
+
+/**
+ * @brief Add all values of source histogram to destination histogram.
+ *
+ * @param p_dest Pointer to destination histogram.
+ * @param p_src Pointer to source histogram, e.g. a snapshot.
+ */
+void
+latency_hist_merge(latency_hist_t *p_dest, const latency_hist_t *p_src);
+
+/**
+ * @brief Get value at given percentile.
+ *
+ * Result is the highest value equivalent to the bucket containing the
+ * requested rank, limited by the recorded maximum.
+ *
+ * @param p_hist Pointer to histogram.
+ * @param per_mille Percentile in tenths of percent, e.g. 990 for p99.
+ *
+ * @return Value at percentile, 0 for empty histogram.
+ */
+uint32_t
+latency_hist_percentile(const latency_hist_t *p_hist, unsigned per_mille);
+
+/**
+ * @brief Compute summary statistics.
+ *
+ * @param p_hist Pointer to histogram.
+ * @param p_summary Output summary.
+ */
+void
+latency_hist_summarize(const latency_hist_t *p_hist,
+    latency_summary_t *p_summary);
+
+/**
+ * @brief Serialize summary as compact JSON array [count,p50,p90,p99,max].
+ *
+ * @return Length of string written, -1 if it does not fit.
+ */
+int
+latency_hist_to_json(const latency_hist_t *p_hist, char *p_buffer,
+    size_t buffer_size);
+
+/**
+ * @brief Serialize non-empty buckets as JSON array of [index,count] pairs.
+ *
+ * Allows exact merging of device histograms on the cloud side.
+ *
+ * @return Length of string written, -1 if it does not fit.
+ */
+int
+latency_hist_to_json_sparse(const latency_hist_t *p_hist, char *p_buffer,
+    size_t buffer_size);
+
+/**
+ * @brief Get bucket index for value.
+ */
+unsigned
+latency_hist_bucket_index(uint32_t value);
+
+/**
+ * @brief Get highest value counted in bucket.
+ */
+uint32_t
+latency_hist_bucket_upper(unsigned index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LATENCY_HISTOGRAM_H
+
+/* [] END OF FILE */
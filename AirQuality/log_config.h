@@ -0,0 +1,74 @@
+/***************************************************************************//**
+* @file    log_config.h
+* @version 1.0.0
+*
+* @brief Modules and messages of the structured log.
+*
+* Each module is an X() entry of LOG_MODULES:
+*
+*   X(id, name)
+*
+*   id          log_module_t suffix, e.g. LOG_MODULE_SENSOR
+*   name        module name in formatted lines and in the setLogLevel
+*               direct method
+*
+* Each message is an X() entry of LOG_MESSAGES:
+*
+*   X(id, module, level, format)
+*
+*   id          log_id_t suffix, e.g. LOG_SAMPLE_GAS
+*   module      LOG_MODULES id the level and rate limit are taken from
+*   level       LOG_LEVEL_ suffix
+*   format      printf() format of up to LOG_RING_ARGS integer arguments,
+*               converted with %ld, %lu or %lX only
+*
+* The ring records the message id and the arguments, the format is applied
+* when the record is read. Adding a message takes an entry here and a
+* LOG_RING() call at the place it is logged.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef LOG_CONFIG_H
+#define LOG_CONFIG_H
+
+#define LOG_MODULES(X)                                                        \
+    X(MAIN, "main")                                                           \
+    X(SENSOR, "sensor")                                                       \
+    X(AZURE, "azure")                                                         \
+    X(DISPLAY, "display")
+
+#define LOG_MESSAGES(X)                                                       \
+    X(SAMPLE_ENV, SENSOR, DEBUG,                                              \
+        "Temperature %ld, humidity %ld [0.01 degC, 0.01 %%RH], flags 0x%06lX") \
+    X(SAMPLE_GAS, SENSOR, DEBUG,                                              \
+        "TVOC %ld ppb, eCO2 %ld ppm, flags 0x%06lX")                          \
+    X(UPLOAD, MAIN, INFO,                                                     \
+        "Uploading to Azure: eCO2 %ld ppm, TVOC %ld ppb, IAQ %ld, valid 0x%lX") \
+    X(MESSAGE_ACCEPTED, AZURE, INFO,                                          \
+        "IoTHubClient accepted message %lu for delivery")                     \
+    X(MESSAGE_HANDOVER_FAILED, AZURE, WARNING,                                \
+        "Failed to hand over message %lu to IoTHubClient")                    \
+    X(MESSAGE_DELIVERED, AZURE, INFO,                                         \
+        "Message %lu received by IoT Hub in %ld ms")                          \
+    X(MESSAGE_RETRY, AZURE, WARNING,                                          \
+        "Message %lu not delivered (result %ld), will retry")                 \
+    X(MESSAGE_DROPPED, AZURE, ERROR,                                          \
+        "Message %lu dropped after %lu attempts (result %ld)")                \
+    X(DOWORK, AZURE, DEBUG,                                                   \
+        "AzureIoT_DoPeriodicTasks calls in progress")                         \
+    X(DISPLAY_OFF, DISPLAY, INFO,                                             \
+        "Display off")
+
+// Default level and rate limit of every module, records per second with
+// bursts of LOG_RATE_BURST
+#define LOG_LEVEL_DEFAULT           LOG_LEVEL_INFO
+#define LOG_RATE_PER_SEC            (10)
+#define LOG_RATE_BURST              (20)
+
+#endif  // LOG_CONFIG_H
+
+/* [] END OF FILE */
@@ -0,0 +1,510 @@
+/***************************************************************************//**
+* @file    log_ring.c
+* @version 1.0.0
+*
+* @brief Binary structured log in a lock-free in-memory ring.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "log_ring.h"
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+
+#define LOG_RING_MASK       (LOG_RING_SIZE - 1u)
+#define LOG_CRASH_MAGIC     (0x41514C31u)   // "AQL1"
+
+_Static_assert((LOG_RING_SIZE & LOG_RING_MASK) == 0,
+    "LOG_RING_SIZE must be a power of two");
+
+/*******************************************************************************
+* Data types
+*******************************************************************************/
+
+typedef struct
+{
+    uint8_t module;
+    uint8_t level;
+    const char *p_format;
+} log_message_t;
+
+typedef struct
+{
+    uint8_t level;
+    uint32_t per_sec;           // 0 = unlimited
+    uint32_t burst;
+    uint32_t tokens_milli;      // Token bucket, 1000 per record
+    uint32_t refill_ms;         // Time of the last refill
+} log_module_state_t;
+
+typedef struct
+{
+    uint32_t magic;
+    int32_t reason;
+    uint32_t count;
+    uint32_t record_size;
+} log_crash_header_t;
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+static uint32_t
+now_ms(void);
+
+static bool
+rate_take(log_module_state_t *p_state, uint32_t time_ms);
+
+static void
+entry_from_record(log_entry_t *p_entry, const log_record_t *p_record,
+    uint32_t seq);
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+#define LOG_MESSAGE_ENTRY(id, module, level, format)                          \
+    { LOG_MODULE_##module, LOG_LEVEL_##level, format },
+static const log_message_t g_messages[LOG_ID_COUNT] = {
+    LOG_MESSAGES(LOG_MESSAGE_ENTRY)
+};
+#undef LOG_MESSAGE_ENTRY
+
+#define LOG_MODULE_NAME(id, name)   name,
+static const char *gp_module_names[LOG_MODULE_COUNT] = {
+    LOG_MODULES(LOG_MODULE_NAME)
+};
+#undef LOG_MODULE_NAME
+
+static const char *gp_level_names[LOG_LEVEL_COUNT] = {
+    "error", "warning", "info", "debug"
+};
+
+static log_record_t g_records[LOG_RING_SIZE];
+static _Atomic uint32_t g_head = 0;         // Sequence number of the next
+
+static log_module_state_t g_modules[LOG_MODULE_COUNT];
+static uint32_t g_filtered = 0;
+static uint32_t g_rate_dropped = 0;
+
+static log_ring_echo_fn_t gp_echo_fn = NULL;
+
+static int g_crash_fd = -1;
+static long g_crash_offset = 0;
+static size_t g_crash_size = 0;
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+void
+log_ring_init(void)
+{
+    for (uint32_t idx = 0; idx < LOG_RING_SIZE; idx++)
+    {
+        atomic_store_explicit(&g_records[idx].seq, 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&g_head, 0, memory_order_release);
+
+    for (int module = 0; module < LOG_MODULE_COUNT; module++)
+    {
+        g_modules[module].level = LOG_LEVEL_DEFAULT;
+        log_ring_set_rate((log_module_t)module, LOG_RATE_PER_SEC,
+            LOG_RATE_BURST);
+    }
+
+    g_filtered = 0;
+    g_rate_dropped = 0;
+}
+
+void
+log_ring_set_level(log_module_t module, log_level_t level)
+{
+    if ((module < LOG_MODULE_COUNT) && (level < LOG_LEVEL_COUNT))
+    {
+        g_modules[module].level = (uint8_t)level;
+    }
+}
+
+void
+log_ring_set_rate(log_module_t module, uint32_t per_sec, uint32_t burst)
+{
+    if (module < LOG_MODULE_COUNT)
+    {
+        log_module_state_t *p_state = &g_modules[module];
+
+        p_state->per_sec = per_sec;
+        p_state->burst = (burst > 0) ? burst : 1;
+        p_state->tokens_milli = p_state->burst * 1000u;
+        p_state->refill_ms = now_ms();
+    }
+}
+
+log_module_t
+log_ring_module_from_name(const char *p_name)
+{
+    int module = 0;
+
+    while ((module < LOG_MODULE_COUNT) &&
+        (strcasecmp(p_name, gp_module_names[module]) != 0))
+    {
+        module++;
+    }
+
+    return (log_module_t)module;
+}
+
+log_level_t
+log_ring_level_from_name(const char *p_name)
+{
+    int level = 0;
+
+    while ((level < LOG_LEVEL_COUNT) &&
+        (strcasecmp(p_name, gp_level_names[level]) != 0))
+    {
+        level++;
+    }
+
+    return (log_level_t)level;
+}
+
+void
+log_ring_set_echo(log_ring_echo_fn_t echo_fn)
+{
+    gp_echo_fn = echo_fn;
+}
+
+bool
+log_ring_write(log_id_t id, long a0, long a1, long a2, long a3)
+{
+    if (id >= LOG_ID_COUNT)
+    {
+        return false;
+    }
+
+    const log_message_t *p_message = &g_messages[id];
+    log_module_state_t *p_state = &g_modules[p_message->module];
+
+    if (p_message->level > p_state->level)
+    {
+        g_filtered++;
+        return false;
+    }
+
+    uint32_t time_ms = now_ms();
+    if (!rate_take(p_state, time_ms))
+    {
+        g_rate_dropped++;
+        return false;
+    }
+
+    // Claim a slot, mark it as written until the record is complete
+    uint32_t seq = atomic_fetch_add_explicit(&g_head, 1, memory_order_relaxed);
+    log_record_t *p_record = &g_records[seq & LOG_RING_MASK];
+
+    atomic_store_explicit(&p_record->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    p_record->time_ms = time_ms;
+    p_record->id = (uint32_t)id;
+    p_record->args[0] = a0;
+    p_record->args[1] = a1;
+    p_record->args[2] = a2;
+    p_record->args[3] = a3;
+
+    atomic_store_explicit(&p_record->seq, seq + 1, memory_order_release);
+
+    if (gp_echo_fn != NULL)
+    {
+        log_entry_t entry;
+        entry_from_record(&entry, p_record, seq);
+        gp_echo_fn(&entry);
+    }
+
+    return true;
+}
+
+uint32_t
+log_ring_oldest(void)
+{
+    uint32_t head = atomic_load_explicit(&g_head, memory_order_acquire);
+
+    return (head > LOG_RING_SIZE) ? head - LOG_RING_SIZE : 0;
+}
+
+size_t
+log_ring_read(uint32_t *p_cursor, log_entry_t *p_entries, size_t max_entries,
+    uint32_t *p_lost)
+{
+    uint32_t head = atomic_load_explicit(&g_head, memory_order_acquire);
+    uint32_t cursor = *p_cursor;
+    uint32_t lost = 0;
+    size_t count = 0;
+
+    if (head - cursor > LOG_RING_SIZE)
+    {
+        lost += head - LOG_RING_SIZE - cursor;
+        cursor = head - LOG_RING_SIZE;
+    }
+
+    while ((count < max_entries) && (cursor != head))
+    {
+        const log_record_t *p_record = &g_records[cursor & LOG_RING_MASK];
+        uint32_t seq = atomic_load_explicit(&p_record->seq,
+            memory_order_acquire);
+
+        if (seq == cursor + 1)
+        {
+            entry_from_record(&p_entries[count], p_record, cursor);
+
+            // Record is valid if it was not claimed again while copied
+            atomic_thread_fence(memory_order_acquire);
+            seq = atomic_load_explicit(&p_record->seq, memory_order_relaxed);
+        }
+
+        if (seq == cursor + 1)
+        {
+            count++;
+        }
+        else if (atomic_load_explicit(&g_head, memory_order_acquire) - cursor >
+            LOG_RING_SIZE)
+        {
+            // Overwritten by a newer record
+            lost++;
+        }
+        else
+        {
+            // Still being written, read from here next time
+            break;
+        }
+        cursor++;
+    }
+
+    *p_cursor = cursor;
+    if (p_lost != NULL)
+    {
+        *p_lost = lost;
+    }
+
+    return count;
+}
+
+int
+log_ring_format(const log_entry_t *p_entry, char *p_buffer,
+    size_t buffer_size)
+{
+    static const char level_chars[LOG_LEVEL_COUNT] = { 'E', 'W', 'I', 'D' };
+
+    if (p_entry->id >= LOG_ID_COUNT)
+    {
+        return snprintf(p_buffer, buffer_size, "[%6lu.%03lu] ? unknown id %lu",
+            (unsigned long)(p_entry->time_ms / 1000u),
+            (unsigned long)(p_entry->time_ms % 1000u),
+            (unsigned long)p_entry->id);
+    }
+
+    const log_message_t *p_message = &g_messages[p_entry->id];
+    int len = snprintf(p_buffer, buffer_size, "[%6lu.%03lu] %c %s: ",
+        (unsigned long)(p_entry->time_ms / 1000u),
+        (unsigned long)(p_entry->time_ms % 1000u),
+        level_chars[p_message->level], gp_module_names[p_message->module]);
+
+    if ((len > 0) && ((size_t)len < buffer_size))
+    {
+        len += snprintf(p_buffer + len, buffer_size - (size_t)len,
+            p_message->p_format, p_entry->args[0], p_entry->args[1],
+            p_entry->args[2], p_entry->args[3]);
+    }
+
+    if ((len > 0) && ((size_t)len >= buffer_size))
+    {
+        len = (int)buffer_size - 1;
+    }
+
+    return len;
+}
+
+void
+log_ring_get_stats(log_ring_stats_t *p_stats)
+{
+    p_stats->written = atomic_load_explicit(&g_head, memory_order_relaxed);
+    p_stats->filtered = g_filtered;
+    p_stats->rate_dropped = g_rate_dropped;
+}
+
+void
+log_ring_set_crash_file(int fd, long offset, size_t size)
+{
+    g_crash_offset = offset;
+    g_crash_size = size;
+    g_crash_fd = fd;
+}
+
+void
+log_ring_crash_dump(int reason)
+{
+    if ((g_crash_fd < 0) || (g_crash_size <= sizeof(log_crash_header_t)))
+    {
+        return;
+    }
+
+    uint32_t head = atomic_load_explicit(&g_head, memory_order_relaxed);
+    uint32_t count = (uint32_t)((g_crash_size - sizeof(log_crash_header_t)) /
+        sizeof(log_record_t));
+
+    if (count > LOG_RING_SIZE)
+    {
+        count = LOG_RING_SIZE;
+    }
+    if (count > head)
+    {
+        count = head;
+    }
+
+    log_crash_header_t header = {
+        .magic = LOG_CRASH_MAGIC,
+        .reason = reason,
+        .count = count,
+        .record_size = sizeof(log_record_t)
+    };
+
+    // Newest records, in at most two runs of the ring
+    uint32_t first = (head - count) & LOG_RING_MASK;
+    uint32_t run = (first + count > LOG_RING_SIZE) ?
+        LOG_RING_SIZE - first : count;
+    off_t offset = (off_t)g_crash_offset + (off_t)sizeof(header);
+
+    (void)pwrite(g_crash_fd, &g_records[first], run * sizeof(log_record_t),
+        offset);
+    if (run < count)
+    {
+        (void)pwrite(g_crash_fd, &g_records[0],
+            (count - run) * sizeof(log_record_t),
+            offset + (off_t)(run * sizeof(log_record_t)));
+    }
+
+    // Header last, a dump cut short is not loaded
+    (void)pwrite(g_crash_fd, &header, sizeof(header), (off_t)g_crash_offset);
+}
+
+size_t
+log_ring_crash_load(int fd, long offset, size_t size, log_entry_t *p_entries,
+    size_t max_entries, int *p_reason)
+{
+    log_crash_header_t header;
+
+    if ((pread(fd, &header, sizeof(header), (off_t)offset) !=
+        (ssize_t)sizeof(header)) || (header.magic != LOG_CRASH_MAGIC) ||
+        (header.record_size != sizeof(log_record_t)) ||
+        (size < sizeof(header)) ||
+        (header.count > (size - sizeof(header)) / sizeof(log_record_t)))
+    {
+        return 0;
+    }
+
+    if (p_reason != NULL)
+    {
+        *p_reason = header.reason;
+    }
+
+    // Skip the oldest records if they do not fit
+    uint32_t skip = (header.count > max_entries) ?
+        header.count - (uint32_t)max_entries : 0;
+    off_t position = (off_t)offset + (off_t)sizeof(header) +
+        (off_t)(skip * sizeof(log_record_t));
+    size_t count = 0;
+
+    for (uint32_t idx = skip; idx < header.count; idx++)
+    {
+        log_record_t record;
+
+        if (pread(fd, &record, sizeof(record), position) !=
+            (ssize_t)sizeof(record))
+        {
+            break;
+        }
+        position += (off_t)sizeof(record);
+
+        // Records being written at the time of the crash are left out
+        uint32_t seq = atomic_load_explicit(&record.seq, memory_order_relaxed);
+        if (seq != 0)
+        {
+            entry_from_record(&p_entries[count++], &record, seq - 1);
+        }
+    }
+
+    return count;
+}
+
+void
+log_ring_crash_clear(int fd, long offset)
+{
+    log_crash_header_t header;
+
+    memset(&header, 0, sizeof(header));
+    (void)pwrite(fd, &header, sizeof(header), (off_t)offset);
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+static uint32_t
+now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)ts.tv_sec * 1000u + (uint32_t)(ts.tv_nsec / 1000000);
+}
+
+static bool
+rate_take(log_module_state_t *p_state, uint32_t time_ms)
+{
+    if (p_state->per_sec == 0)
+    {
+        return true;
+    }
+
+    uint32_t full = p_state->burst * 1000u;
+    uint64_t refill = (uint64_t)(time_ms - p_state->refill_ms) *
+        p_state->per_sec;
+
+    if (refill > 0)
+    {
+        p_state->tokens_milli = (p_state->tokens_milli + refill > full) ?
+            full : p_state->tokens_milli + (uint32_t)refill;
+        p_state->refill_ms = time_ms;
+    }
+
+    if (p_state->tokens_milli < 1000u)
+    {
+        return false;
+    }
+
+    p_state->tokens_milli -= 1000u;
+    return true;
+}
+
+static void
+entry_from_record(log_entry_t *p_entry, const log_record_t *p_record,
+    uint32_t seq)
+{
+    p_entry->seq = seq;
+    p_entry->time_ms = p_record->time_ms;
+    p_entry->id = p_record->id;
+    memcpy(p_entry->args, p_record->args, sizeof(p_entry->args));
+}
+
+/* [] END OF FILE */
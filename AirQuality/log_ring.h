@@ -0,0 +1,267 @@
+/***************************************************************************//**
+* @file    log_ring.h
+* @version 1.0.0
+*
+* @brief Binary structured log in a lock-free in-memory ring.
+*
+* Log_Debug() formats its text with printf() and writes it out before it
+* returns. On the sampling, message and DoWork paths the log is recorded
+* instead: a record holds the id of a message listed in log_config.h, a
+* millisecond time stamp and up to LOG_RING_ARGS integer arguments. The
+* format is applied by the reader, e.g. the getLog direct method, so the
+* writer costs a level check, a rate check and a few stores.
+*
+* Writers claim a slot with an atomic increment of the head and publish the
+* record with its sequence number, the reader checks that number before and
+* after copying the record and skips records overwritten meanwhile. The
+* oldest records are overwritten once the ring is full.
+*
+* Each module has a level, messages above it are dropped before the time is
+* read, and a token bucket rate limit. Levels, rate limits and their
+* counters are not atomic, they are set and updated on the event loop
+* thread only.
+*
+* log_ring_crash_dump() is async-signal-safe. It writes the newest records
+* into the file set with log_ring_set_crash_file(), to be loaded with
+* log_ring_crash_load() after the restart.
+*
+* A different message list, e.g. for host benchmarks, is selected by
+* defining LOG_RING_CONFIG as the name of the header to include.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#ifndef LOG_RING_CONFIG
+#define LOG_RING_CONFIG "log_config.h"
+#endif
+#include LOG_RING_CONFIG
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+// Records of the ring, a power of two
+#ifndef LOG_RING_SIZE
+#define LOG_RING_SIZE           (256)
+#endif
+
+#define LOG_RING_ARGS           (4)
+
+// Formatted line, "[  1234.567] W module: text"
+#define LOG_RING_LINE_SIZE      (160)
+
+/**
+ * @brief Record message id with up to LOG_RING_ARGS integer arguments.
+ *
+ *   LOG_RING(LOG_SAMPLE_GAS, tvoc, eco2, flags);
+ */
+#define LOG_RING(...)           LOG_RING_(__VA_ARGS__, 0, 0, 0, 0, 0)
+#define LOG_RING_(id, a0, a1, a2, a3, ...)                                    \
+    log_ring_write((id), (long)(a0), (long)(a1), (long)(a2), (long)(a3))
+
+/*******************************************************************************
+*   Data types
+*******************************************************************************/
+
+typedef enum
+{
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_WARNING,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_DEBUG,
+    LOG_LEVEL_COUNT
+} log_level_t;
+
+#define LOG_MODULE_ENUM(id, name)               LOG_MODULE_##id,
+typedef enum
+{
+    LOG_MODULES(LOG_MODULE_ENUM)
+    LOG_MODULE_COUNT
+} log_module_t;
+#undef LOG_MODULE_ENUM
+
+#define LOG_MESSAGE_ENUM(id, module, level, format)     LOG_##id,
+typedef enum
+{
+    LOG_MESSAGES(LOG_MESSAGE_ENUM)
+    LOG_ID_COUNT
+} log_id_t;
+#undef LOG_MESSAGE_ENUM
+
+typedef struct
+{
+    _Atomic uint32_t seq;       // Sequence number + 1, 0 while written
+    uint32_t time_ms;           // Monotonic time, wraps after 49 days
+    uint32_t id;                // log_id_t
+    long args[LOG_RING_ARGS];
+} log_record_t;
+
+// Plain copy of a record as returned to the reader
+typedef struct
+{
+    uint32_t seq;
+    uint32_t time_ms;
+    uint32_t id;
+    long args[LOG_RING_ARGS];
+} log_entry_t;
+
+typedef struct
+{
+    uint32_t written;           // Records written since init
+    uint32_t filtered;          // Dropped by module level
+    uint32_t rate_dropped;      // Dropped by module rate limit
+} log_ring_stats_t;
+
+/**
+ * @brief Record echo callback, e.g. to format records to Log_Debug() while
+ *        debugging.
+ */
+typedef void (*log_ring_echo_fn_t)(const log_entry_t *p_entry);
+
+/*******************************************************************************
+*   Function declarations
+*******************************************************************************/
+
+/**
+ * @brief Clear ring, set default levels and rate limits.
+ */
+void
+log_ring_init(void);
+
+/**
+ * @brief Set level of module, messages above it are dropped.
+ */
+void
+log_ring_set_level(log_module_t module, log_level_t level);
+
+/**
+ * @brief Set rate limit of module, 0 records per second = unlimited.
+ */
+void
+log_ring_set_rate(log_module_t module, uint32_t per_sec, uint32_t burst);
+
+/**
+ * @brief Find module by name.
+ *
+ * @return LOG_MODULE_COUNT if there is no such module.
+ */
+log_module_t
+log_ring_module_from_name(const char *p_name);
+
+/**
+ * @brief Find level by name, "error", "warning", "info" or "debug".
+ *
+ * @return LOG_LEVEL_COUNT if there is no such level.
+ */
+log_level_t
+log_ring_level_from_name(const char *p_name);
+
+/**
+ * @brief Set callback called with each record written, NULL to disable.
+ */
+void
+log_ring_set_echo(log_ring_echo_fn_t echo_fn);
+
+/**
+ * @brief Record message, use LOG_RING().
+ *
+ * @return false if the record was dropped by level or rate limit.
+ */
+bool
+log_ring_write(log_id_t id, long a0, long a1, long a2, long a3);
+
+/**
+ * @brief Get sequence number of the oldest record still in the ring, the
+ *        cursor to read all records from.
+ */
+uint32_t
+log_ring_oldest(void);
+
+/**
+ * @brief Copy records from cursor on, oldest first, and advance cursor.
+ *
+ * Reading stops at a record still being written. Records overwritten before
+ * they were copied are skipped.
+ *
+ * @param p_cursor Sequence number of the next record to read.
+ * @param p_entries Output records.
+ * @param max_entries Capacity of p_entries.
+ * @param p_lost Optional output, number of records skipped.
+ *
+ * @return Number of records copied.
+ */
+size_t
+log_ring_read(uint32_t *p_cursor, log_entry_t *p_entries, size_t max_entries,
+    uint32_t *p_lost);
+
+/**
+ * @brief Format record as a text line, without line feed.
+ *
+ * @return Length of the line, truncated to buffer_size - 1.
+ */
+int
+log_ring_format(const log_entry_t *p_entry, char *p_buffer,
+    size_t buffer_size);
+
+/**
+ * @brief Get counters since init.
+ */
+void
+log_ring_get_stats(log_ring_stats_t *p_stats);
+
+/**
+ * @brief Set file and area for crash dumps, fd < 0 to disable.
+ */
+void
+log_ring_set_crash_file(int fd, long offset, size_t size);
+
+/**
+ * @brief Write newest records that fit into the crash dump area.
+ *
+ * Async-signal-safe, to be called from a fatal signal handler.
+ *
+ * @param reason Reason stored with the dump, e.g. the signal number.
+ */
+void
+log_ring_crash_dump(int reason);
+
+/**
+ * @brief Load records of a crash dump.
+ *
+ * @param fd File the dump was written to.
+ * @param p_reason Optional output, reason of the dump.
+ *
+ * @return Number of records loaded, 0 if there is no valid dump.
+ */
+size_t
+log_ring_crash_load(int fd, long offset, size_t size, log_entry_t *p_entries,
+    size_t max_entries, int *p_reason);
+
+/**
+ * @brief Invalidate crash dump once it has been reported.
+ */
+void
+log_ring_crash_clear(int fd, long offset);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LOG_RING_H
+
+/* [] END OF FILE */
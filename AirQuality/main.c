@@ -17,10 +17,12 @@
 #include <time.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "applibs_versions.h"   // API struct versions to use for applibs APIs
 #include <applibs/log.h>
 #include <applibs/gpio.h>
+#include <applibs/storage.h>
 
 #define I2C_STRUCTS_VERSION 1
 #include <applibs/i2c.h>
@@ -40,29 +42,101 @@
 // This application Azure IoT configuration
 #include "azure_iot_settings.h"
 
+// Runtime configuration controlled by Device Twin
+#include "device_config.h"
+#include "json_scan.h"
+
+// Event loop handler run time and timer lateness statistics
+#include "event_loop_stats.h"
+#include "latency_histogram.h"
+
+// Telemetry message encoding
+#include "telemetry.h"
+
+// Fixed point measurements
+#include "measurement.h"
+
+// Sensor drivers and sampling scheduler
+#include "i2c_bus.h"
+#include "anomaly.h"
+#include "iaq.h"
+#include "rgb_led.h"
+#include "sensor_registry.h"
+#include "sensor_ccs811.h"
+
+// Sample history graphs
+#include "trend.h"
+#include "trend_view.h"
+
 // Referenced libraries
-#include "lib_ccs811.h"
-#include "lib_hdc1000.h"
 #include "lib_u8g2.h"
 
+// Pre-rendered display text
+#include "render_cache.h"
+
+// Display refresh and power management
+#include "display_manager.h"
+
+// Operating mode profiles and energy estimate
+#include "power_mode.h"
+
+// Structured log ring and crash log in mutable storage
+#include "log_ring.h"
+#include "persist.h"
+
+// Start up steps in dependency order and their timing
+#include "startup.h"
+
 /*******************************************************************************
 *   Macros and #define Constants
 *******************************************************************************/
 
 #define I2C_ISU             PROJECT_ISU2_I2C
+#define I2C_TIMEOUT_MS      (100)
 #define I2C_ADDR_OLED       (0x3C)
+#define I2C_ADDR_OLED_ALT   (0x3D)  // SA0 strapped high
 
 #define OLED_ROTATION       U8G2_R1 // Display is rotated 90 degrees clockwise
 #define OLED_LINE_LENGTH    16      // Max number of chars on display line
 
 #define JSON_BUFFER_SIZE    128     // JSON buffer for Azure uplod
+#define STATS_BUFFER_SIZE   1856    // JSON buffer for event loop statistics
+#define STARTUP_BUFFER_SIZE 512     // JSON buffer for start up times
+
+// Records of the previous crash kept for the getCrashLog direct method
+#define CRASH_LOG_MAX_ENTRIES   (PERSIST_CRASH_LOG_SIZE / sizeof(log_record_t))
+
+// Shortest connection window, time to receive Device Twin updates [ms]
+#define CONNECTION_WINDOW_MIN_MS    (10 * 1000)
 
 /*******************************************************************************
-* External variables
+*   Data types
 *******************************************************************************/
 
-// TODO: Refactor to use function instead of extern var
-extern IOTHUB_DEVICE_CLIENT_LL_HANDLE iothubClientHandle;
+// Start up steps, in the order they are run once their dependencies are
+// done: the display first to show the first screen early, the sensors next
+// so they warm up while the rest is initialized
+typedef enum
+{
+    INIT_STEP_I2C,
+    INIT_STEP_DISPLAY,
+    INIT_STEP_STATE,
+    INIT_STEP_SENSORS,
+    INIT_STEP_BUTTON,
+    INIT_STEP_POWER_MODE,
+#   if (defined(IOT_CENTRAL_APPLICATION) || defined(IOT_HUB_APPLICATION))
+    INIT_STEP_IOT_CLIENT,
+#   endif
+    INIT_STEP_COUNT
+} init_step_t;
+
+// Display screens, cycled by Button1
+typedef enum
+{
+    DISPLAY_SCREEN_MEASUREMENTS,
+    DISPLAY_SCREEN_TREND,
+    DISPLAY_SCREEN_COUNT
+} display_screen_t;
 
 /*******************************************************************************
 * Forward declarations of private functions
@@ -79,6 +153,29 @@ extern IOTHUB_DEVICE_CLIENT_LL_HANDLE iothubClientHandle;
 static void
 termination_handler(int signal_number);
 
+/** @brief Fatal signal handler.
+ *
+ * Dumps the log ring into mutable storage and re-raises the signal with its
+ * default action. This handler must be async-signal-safe.
+ */
+static void
+fatal_signal_handler(int signal_number);
+
+#ifdef LOG_RING_ECHO
+/**
+ * @brief Format log ring records to the debug output as they are written
+ */
+static void
+log_echo(const log_entry_t *p_entry);
+#endif
+
+/**
+ * @brief Open crash log area, load the previous crash dump, install fatal
+ *        signal handlers
+ */
+static void
+crash_log_init(void);
+
 /**
  * @brief Button1 press handler
  */
@@ -86,10 +183,29 @@ static void
 button1_press_handler(void);
 
 /**
- * @brief CCS811 DATA READY interrupt handler
+ * @brief Sensor reading handler
+ */
+static void
+sensor_reading_handler(const sensor_t *p_sensor,
+    const sensor_reading_t *p_reading);
+
+/**
+ * @brief Get IAQ index while the gas readings are usable
+ */
+static bool
+iaq_get_current(uint32_t usable, iaq_result_t *p_iaq);
+
+/**
+ * @brief Run a sample through its anomaly detector, raise alerts
+ */
+static void
+anomaly_check(anomaly_metric_t metric, int32_t value, uint64_t now_us);
+
+/**
+ * @brief Pre-render display labels and value characters
  */
 static void
-ccs811_interrupt_handler(void);
+display_cache_init(void);
 
 /**
  * @brief Show measured values on OLED display
@@ -98,16 +214,43 @@ static void
 display_measurements(void);
 
 /**
- * @brief Timer event handler for polling button states
+ * @brief Show eCO2 and TVOC trend graphs on OLED display
  */
 static void
-button_timer_event_handler(EventData *event_data);
+display_trend(void);
+
+/**
+ * @brief Scroll trend graphs by newly committed columns
+ */
+static void
+display_trend_advance(uint32_t columns);
 
 /**
- * @brief Timer event handler for polling CCS811 interrupt pin
+ * @brief Compose current screen into the frame buffer
  */
 static void
-ccs811_int_timer_event_handler(EventData *event_data);
+display_show(void);
+
+#if (defined(IOT_CENTRAL_APPLICATION) || defined(IOT_HUB_APPLICATION))
+/**
+ * @brief Device Twin update handler, parses the SDK buffer in place
+ */
+static void
+device_twin_update_handler(bool b_is_complete, const unsigned char *p_payload,
+    size_t size);
+
+/**
+ * @brief Apply changed configuration items to timers and peripherals
+ */
+static void
+apply_config_changes(uint32_t changed_mask);
+#endif
+
+/**
+ * @brief Timer event handler for polling button states
+ */
+static void
+button_timer_event_handler(EventData *event_data);
 
 /**
  * @brief Timer event handler for uploading data to Azure
@@ -115,16 +258,105 @@ ccs811_int_timer_event_handler(EventData *event_data);
 static void
 upload_timer_event_handler(EventData *event_data);
 
+/**
+ * @brief Timer event handler for sending event loop statistics
+ */
+static void
+loop_stats_timer_event_handler(EventData *event_data);
+
+#if (defined(IOT_CENTRAL_APPLICATION) || defined(IOT_HUB_APPLICATION))
+/**
+ * @brief Direct method call handler
+ */
+static int
+direct_method_handler(const char *p_method_name, const char *p_payload,
+    size_t payload_size, char **pp_response, size_t *p_response_size);
+
+/**
+ * @brief Format log records as {"log":["line",...]} direct method response
+ */
+static int
+log_to_response(const log_entry_t *p_entries, size_t count,
+    uint32_t cursor, char **pp_response, size_t *p_response_size);
+
+/**
+ * @brief Advance response length by snprintf() result if it fits.
+ *
+ * @return false if written is negative or does not fit into size.
+ */
+static bool
+response_advance(size_t size, size_t *p_len, int written);
+
+/**
+ * @brief Set module levels from {"module":"level",...}
+ */
+static int
+log_set_levels(const char *p_payload, size_t payload_size);
+#endif
+
 /**
  * @brief Azure upload handler
  */
 static void
 azure_upload_handler(void);
 
+/**
+ * @brief Apply timer cadences and peripheral power states of power mode
+ */
+static void
+power_mode_apply(void);
+
+/**
+ * @brief Get upload period raised to the minimum of the power mode
+ */
+static uint32_t
+upload_period_get(void);
+
+/**
+ * @brief Set upload timer to the current upload period
+ */
+static void
+upload_period_apply(void);
+
+/**
+ * @brief Get CCS811 drive mode, configured or set by the power mode
+ */
+static ccs811_mode_t
+ccs811_mode_get(void);
+
+/**
+ * @brief Set sensor sampling period of the power mode, or of the CCS811
+ *        drive mode when the power mode keeps the sensor_config.h period
+ */
+static void
+sensor_period_apply(void);
+
+/**
+ * @brief Add radio on time up to now to the energy estimate counters
+ */
+static void
+radio_on_update(uint64_t now_ms);
+
+#if (defined(IOT_CENTRAL_APPLICATION) || defined(IOT_HUB_APPLICATION))
+/**
+ * @brief Keep IoT Hub client until the batch is delivered
+ */
+static void
+connection_window_open(void);
+
+/**
+ * @brief Destroy IoT Hub client once the batch is delivered or the window
+ *        is over
+ */
+static void
+connection_window_check(void);
+#endif
+
 /**
  * @brief Initialize signal handlers.
  *
- * Set up SIGTERM termination handler.
+ * Set up SIGTERM termination handler and the fatal signal handlers
+ * writing the crash log.
  *
  * @return 0 on success, -1 otherwise.
  */
@@ -132,14 +364,90 @@ static int
 init_handlers(void);
 
 /**
- * @brief Initialize peripherals.
- *
- * Initialize all peripherals used by this project.
+ * @brief Start up step: open the I2C master.
  *
  * @return 0 on success, -1 otherwise.
  */
 static int
-init_peripherals(I2C_InterfaceId isu_id);
+init_step_i2c(void);
+
+/**
+ * @brief Start up step: initialize the OLED and show the first screen.
+ */
+static int
+init_step_display(void);
+
+/**
+ * @brief Start up step: IAQ index, trend history, anomaly detectors and the
+ *        alert LED.
+ */
+static int
+init_step_state(void);
+
+/**
+ * @brief Start up step: bind sensors and start sampling them.
+ */
+static int
+init_step_sensors(void);
+
+/**
+ * @brief Start up step: open Button1 GPIO and its poll timer.
+ */
+static int
+init_step_button(void);
+
+/**
+ * @brief Start up step: apply timer cadences of the power mode.
+ */
+static int
+init_step_power_mode(void);
+
+#if (defined(IOT_CENTRAL_APPLICATION) || defined(IOT_HUB_APPLICATION))
+/**
+ * @brief Start up step: create the IoT Hub client, loading its certificates.
+ */
+static int
+init_step_iot_client(void);
+
+/**
+ * @brief IoT Hub connection status handler
+ */
+static void
+connection_status_handler(bool b_is_connected);
+
+/**
+ * @brief Telemetry message delivery handler
+ */
+static void
+message_delivery_handler(bool b_is_delivered);
+#endif
+
+/**
+ * @brief All start up steps are done, or one has failed
+ */
+static void
+startup_done_handler(bool b_is_ok);
+
+/**
+ * @brief Log start up times, report them as Device Twin property
+ */
+static void
+startup_report(void);
+
+/**
+ * @brief Open and configure the I2C master.
+ *
+ * @return I2C master file descriptor, -1 on failure.
+ */
+static int
+i2c_open(I2C_InterfaceId isu_id);
+
+/**
+ * @brief Reset the I2C master and clock a stuck bus free, keeping the I2C
+ *        descriptor number.
+ */
+static bool
+i2c_bus_recovery_handler(void);
 
 /**
  * @brief Close all peripherals and handlers
@@ -151,8 +459,8 @@ close_peripherals_and_handlers(void);
 * Global variables
 *******************************************************************************/
 
-// Period how often will be data uploaded to Azure
-static const struct timespec AZURE_UPLOAD_PERIOD = { 1 * 60, 0 };
+// Runtime configuration, defaults overridden by Device Twin
+static device_config_t g_config;
 
 // Termination state flag
 static volatile sig_atomic_t gb_is_termination_requested = false;
@@ -161,42 +469,106 @@ static volatile sig_atomic_t gb_is_termination_requested = false;
 static int g_fd_epoll = -1;                 // Epoll
 static int g_fd_i2c = -1;                   // I2C
 static int g_fd_poll_timer_button = -1;     // Button1 poll timer
-static int g_fd_poll_timer_ccs811_int = -1; // CCS811 interrupt pin poll timer
 static int g_fd_poll_timer_upload = -1;     // Azure upload poll timer
+static int g_fd_timer_loop_stats = -1;      // Event loop statistics timer
 static int g_fd_gpio_button1 = -1;          // Button1 GPIO
-static int g_fd_gpio_ccs811_int = -1;       // CCS811 interrupt pin GPIO
+static int g_fd_crash_log = -1;             // Mutable storage, crash log
+
+// Log records of the previous run, from its crash dump
+static log_entry_t *gp_crash_entries = NULL;
+static size_t g_crash_entry_count = 0;
+static int g_crash_reason = 0;
 
 // Button1 state storage
 static GPIO_Value_Type g_state_button1 = GPIO_Value_High;
 
-// CCS811 interrupt pin state storage
-static GPIO_Value_Type g_state_ccs811_int = GPIO_Value_High;
-
 // Event handler data
 static EventData g_event_data_button = {        // Button state poll timer
-    .eventHandler = &button_timer_event_handler
-};
-static EventData g_event_data_ccs811_int = {    // CCS811 int pin poll timer
-    .eventHandler = &ccs811_int_timer_event_handler
+    .eventHandler = &button_timer_event_handler,
+    .name = "button"
 };
 static EventData g_event_data_poll_upload = {   // Azure upload timer
-    .eventHandler = &upload_timer_event_handler
+    .eventHandler = &upload_timer_event_handler,
+    .name = "upload"
 };
+static EventData g_event_data_loop_stats = {    // Loop statistics timer
+    .eventHandler = &loop_stats_timer_event_handler,
+    .name = "stats"
+};
+
+#if (defined(IOT_CENTRAL_APPLICATION) || defined(IOT_HUB_APPLICATION))
+// Event loop statistics slot for Azure IoT client processing
+static int g_stats_slot_dowork = 0;
+#endif
 
-static hdc1000_t *gp_hdc;       // HDC1000 sensor data pointer
-static ccs811_t *gp_ccs;        // CCS811 sensor data pointer
 static u8g2_t g_u8g2;           // OLED device descriptor for u8g2
+static uint8_t g_oled_addr = I2C_ADDR_OLED;
 
-// Current data from sensors
-static double g_temperature, g_humidity;
-static int16_t g_eco2, g_tvoc;
+// Indoor air quality index over rolling gas averages
+static iaq_t g_iaq;
+
+// Streaming anomaly detectors, one per metric
+static anomaly_t g_anomaly[ANOMALY_METRIC_COUNT];
+static rgb_led_color_t g_alert_color = RGB_LED_OFF;
 
 // Print buffer for outputting data to display
 static char g_print_buffer[OLED_LINE_LENGTH + 1];
 
-#if (defined(IOT_CENTRAL_APPLICATION) || defined(IOT_HUB_APPLICATION))
-static bool versionStringSent = false;
-#endif
+// Measurements screen labels and value characters, rendered once
+static render_bitmap_t g_label_eco2;
+static render_bitmap_t g_label_tvoc;
+static render_bitmap_t g_label_humidity;
+static render_bitmap_t g_label_iaq;
+static render_bitmap_t g_label_bands[IAQ_BAND_COUNT];
+static render_atlas_t g_value_chars;
+
+// Screen shown on display
+static display_screen_t g_screen = DISPLAY_SCREEN_MEASUREMENTS;
+
+// Gas history per graph column and its graphs, labels above the graphs
+static trend_t g_trend_eco2;
+static trend_t g_trend_tvoc;
+static const trend_view_t g_view_eco2 = { 12, 50, 400, 2000 };  // [ppm]
+static const trend_view_t g_view_tvoc = { 76, 50, 0, 600 };     // [ppb]
+
+// Activity of the statistics period for the energy estimate
+static power_usage_t g_power_usage;
+static uint64_t g_power_period_start_ms = 0;
+
+// Connection window, the IoT Hub client exists while it is open. Always
+// open in normal power mode.
+static bool gb_is_window_open = false;
+static uint64_t g_window_open_ms = 0;       // Start of the window
+static uint64_t g_radio_since_ms = 0;       // Radio on time counted until
+
+// Pipeline stage latency histograms [us]
+static latency_hist_t g_hist_display_push;  // OLED frame buffer transfer
+static latency_hist_t g_hist_delivery;      // Azure message delivery [ms]
+static latency_hist_t g_hist_reconnect;     // Connection loss to reconnect [ms]
+static latency_hist_t g_hist_drain;         // Backlog drain after reconnect [ms]
+
+// Start up steps and the steps each depends on
+static const startup_step_t g_init_steps[INIT_STEP_COUNT] = {
+    [INIT_STEP_I2C] = { "i2c", &init_step_i2c, 0 },
+    [INIT_STEP_DISPLAY] = { "display", &init_step_display,
+        STARTUP_AFTER(INIT_STEP_I2C) },
+    [INIT_STEP_STATE] = { "state", &init_step_state, 0 },
+    [INIT_STEP_SENSORS] = { "sensors", &init_step_sensors,
+        STARTUP_AFTER(INIT_STEP_I2C) | STARTUP_AFTER(INIT_STEP_STATE) |
+        STARTUP_AFTER(INIT_STEP_DISPLAY) },
+    [INIT_STEP_BUTTON] = { "button", &init_step_button,
+        STARTUP_AFTER(INIT_STEP_DISPLAY) },
+    [INIT_STEP_POWER_MODE] = { "power", &init_step_power_mode,
+        STARTUP_AFTER(INIT_STEP_SENSORS) | STARTUP_AFTER(INIT_STEP_BUTTON) },
+#   if (defined(IOT_CENTRAL_APPLICATION) || defined(IOT_HUB_APPLICATION))
+    // Device Twin and direct method handlers use all of the above
+    [INIT_STEP_IOT_CLIENT] = { "iot", &init_step_iot_client,
+        STARTUP_AFTER(INIT_STEP_POWER_MODE) },
+#   endif
+};
+
+// First usable sample is uploaded right away, not after an upload period
+static bool gb_is_first_upload_pending = true;
 
 /*******************************************************************************
 * Function definitions
@@ -207,6 +579,22 @@ main(int argc, char *argv[])
 {
     gb_is_termination_requested = false;
 
+    // Start up steps and milestones are timed from here
+    startup_begin();
+
+    // Start with default configuration until Device Twin is received
+    device_config_init(&g_config);
+
+    log_ring_init();
+#   ifdef LOG_RING_ECHO
+    log_ring_set_echo(&log_echo);
+#   endif
+
+    latency_hist_reset(&g_hist_display_push);
+    latency_hist_reset(&g_hist_delivery);
+    latency_hist_reset(&g_hist_reconnect);
+    latency_hist_reset(&g_hist_drain);
+
 	// Initialize handlers
 	if (init_handlers() != 0)
 	{
@@ -214,12 +602,13 @@ main(int argc, char *argv[])
         gb_is_termination_requested = true;
 	}
 
-	// Initialize peripherals
+	// Initialize peripherals, one step per event loop event
 	if (!gb_is_termination_requested)
 	{
-		if (init_peripherals(I2C_ISU) != 0)
+		if (startup_run(g_fd_epoll, g_init_steps, INIT_STEP_COUNT,
+            &startup_done_handler) != 0)
 		{
-            // Failed to initialize peripherals
+            // Failed to create start up timer
             gb_is_termination_requested = true;
 		}
 	}
@@ -227,16 +616,34 @@ main(int argc, char *argv[])
 	// Main program
     if (!gb_is_termination_requested) 
     {
-        // All handlers and peripherals are initialized properly at this point
+        // Handlers are initialized at this point, peripherals are
+        // initialized by the start up steps in the event loop
 
-        u8g2_ClearDisplay(&g_u8g2);
+#       if (defined(IOT_CENTRAL_APPLICATION) || defined(IOT_HUB_APPLICATION))
+        // Receive runtime configuration changes from Device Twin
+        AzureIoT_SetDeviceTwinUpdateBufferCallback(&device_twin_update_handler);
 
-        // Initialize CCS811 measurement mode and enable interrupt
-		ccs811_set_mode(gp_ccs, CCS811_MODE_10S);
-        ccs811_enable_interrupt(gp_ccs, true);
+        // Serve diagnostic requests
+        AzureIoT_SetDirectMethodCallback(&direct_method_handler);
 
-        // Show measurement display while waiting for the first data
-        display_measurements();
+        // Start up milestones
+        AzureIoT_SetConnectionStatusCallback(&connection_status_handler);
+        AzureIoT_SetMessageConfirmationCallback(&message_delivery_handler);
+
+        // Report application version, it is sent once the client connects
+        if (argc > 1)
+        {
+            // Quoted and escaped as JSON string
+            JSON_Value *p_version = json_value_init_string(argv[1]);
+            char *p_version_json = json_serialize_to_string(p_version);
+            if (p_version_json != NULL)
+            {
+                AzureIoT_TwinReportProperty("versionString", p_version_json);
+                json_free_serialized_string(p_version_json);
+            }
+            json_value_free(p_version);
+        }
+#       endif
 
 		// Main program loop
         while (!gb_is_termination_requested)
@@ -247,6 +654,7 @@ main(int argc, char *argv[])
                 // Timer event polling failed
                 gb_is_termination_requested = true;
             }
+            g_power_usage.wakeups++;
 
 #           if (defined(IOT_CENTRAL_APPLICATION) || defined(IOT_HUB_APPLICATION))
             // Setup the IoT Hub client.
@@ -254,7 +662,12 @@ main(int argc, char *argv[])
             // - it is safe to call this function even if the client has already
             //   been set up, as in this case it would have no effect
             // - a failure to setup the client is a fatal error.
-            if (!AzureIoT_SetupClient(AZURE_CONNECTION_STRING)) 
+            // - in low power mode the client only exists during connection
+            //   windows
+            // - the client is first created by its start up step
+            if (gb_is_window_open &&
+                startup_is_done(INIT_STEP_IOT_CLIENT) &&
+                !AzureIoT_SetupClient()) 
             {
                 Log_Debug("ERROR: Failed to set up IoT Hub client\n");
                 gb_is_termination_requested = true;
@@ -262,20 +675,25 @@ main(int argc, char *argv[])
 #           endif 
 
 #           if (defined(IOT_CENTRAL_APPLICATION) || defined(IOT_HUB_APPLICATION))
-            if (iothubClientHandle != NULL && !versionStringSent) 
-            {
-                checkAndUpdateDeviceTwin("versionString", argv[1], TYPE_STRING, false);
-                versionStringSent = true;
-            }
-
             // AzureIoT_DoPeriodicTasks() needs to be called frequently in order
             // to keep active data flow to the Azure IoT Hub
-            AzureIoT_DoPeriodicTasks();
+            if (gb_is_window_open)
+            {
+                uint64_t dowork_start = loop_stats_begin("dowork",
+                    &g_stats_slot_dowork);
+                AzureIoT_DoPeriodicTasks();
+                loop_stats_end(dowork_start);
+
+                connection_window_check();
+            }
 #           endif
         }
 
-        u8g2_ClearDisplay(&g_u8g2);
+        if (startup_is_done(INIT_STEP_DISPLAY))
+        {
+            u8g2_ClearDisplay(&g_u8g2);
         }
+    }
 
     // Clean up and shutdown
     close_peripherals_and_handlers();
@@ -290,98 +708,445 @@ button1_press_handler(void)
 {
     Log_Debug("Button1 pressed.\n");
     //gb_is_termination_requested = true;
+
+    // First press only wakes the display
+    if (!display_manager_wake())
+    {
+        g_screen = (display_screen_t)((g_screen + 1) % DISPLAY_SCREEN_COUNT);
+        display_manager_update(DISPLAY_UPDATE_IMMEDIATE);
+    }
 }
 
 static void
-ccs811_interrupt_handler(void)
+sensor_reading_handler(const sensor_t *p_sensor,
+    const sensor_reading_t *p_reading)
 {
-    // Read temperature and humidity from HDC1000
-	g_temperature = hdc1000_get_temp(gp_hdc);
-	g_humidity = hdc1000_get_humi(gp_hdc);
+    uint64_t now_us = loop_stats_now_us();
+
+    // Only usable quantities are aggregated, flagged ones are logged
+    uint32_t usable = SENSOR_USABLE(p_reading->valid, p_reading->flags);
+
+    g_power_usage.samples++;
+
+    if (startup_mark(STARTUP_MILESTONE_FIRST_SAMPLE))
+    {
+#       if !(defined(IOT_CENTRAL_APPLICATION) || defined(IOT_HUB_APPLICATION))
+        // Nothing is uploaded, the first sample ends the start up
+        startup_report();
+#       endif
+    }
+
+    if (p_reading->valid & SENSOR_QUANTITY_TEMPERATURE)
+    {
+        LOG_RING(LOG_SAMPLE_ENV, p_reading->temperature, p_reading->humidity,
+            p_reading->flags);
+    }
 
-    Log_Debug("Temperature [degC]: %f, Humidity [percRH]: %f\n",
-        g_temperature, g_humidity);
+    if ((usable & SENSOR_QUANTITY_ENV) == SENSOR_QUANTITY_ENV)
+    {
+        iaq_set_comfort(&g_iaq, p_reading->temperature, p_reading->humidity);
 
-    // Feed environmental data to CCS811
-    bool set_result = ccs811_set_environmental_data(gp_ccs,
-        (float)g_temperature, (float)g_humidity);
+        anomaly_check(ANOMALY_METRIC_TEMPERATURE, p_reading->temperature,
+            now_us);
+        anomaly_check(ANOMALY_METRIC_HUMIDITY, p_reading->humidity, now_us);
+    }
 
-    if (set_result)
+    if (p_reading->valid & SENSOR_QUANTITY_ECO2)
     {
-        // Reading CCS811 result will reset /INT pin.
-        if (!ccs811_get_results(gp_ccs, &g_tvoc, &g_eco2, 0, 0)) 
+        LOG_RING(LOG_SAMPLE_GAS, p_reading->tvoc, p_reading->eco2,
+            p_reading->flags);
+
+        if ((usable & SENSOR_QUANTITY_GAS) == SENSOR_QUANTITY_GAS)
         {
-            Log_Debug("Could not read measurement from CCS811.\n");
-            gb_is_termination_requested = true;
+            iaq_add_gas(&g_iaq, p_reading->eco2, p_reading->tvoc);
+
+            anomaly_check(ANOMALY_METRIC_ECO2, p_reading->eco2, now_us);
+            anomaly_check(ANOMALY_METRIC_TVOC, p_reading->tvoc, now_us);
+
+            // Both histories commit their columns at the same time
+            uint32_t columns = trend_add(&g_trend_eco2, p_reading->eco2,
+                now_us / 1000u);
+            trend_add(&g_trend_tvoc, p_reading->tvoc, now_us / 1000u);
+            if ((columns > 0) && (g_screen == DISPLAY_SCREEN_TREND))
+            {
+                display_trend_advance(columns);
+            }
         }
-        else
-        {
-            Log_Debug("CCS811 Sensor: TVOC %d ppb, eCO2 %d ppm\n", g_tvoc, g_eco2);
 
-            // Output data on display
-            display_measurements();
+        // Output data on display, trend graphs are updated as their
+        // columns are committed
+        if (g_screen == DISPLAY_SCREEN_MEASUREMENTS)
+        {
+            display_manager_update(DISPLAY_UPDATE_RENDER);
         }
     }
+
+    // Upload the first usable sample right away, it is buffered until the
+    // client connects, instead of waiting for an upload period
+    if (gb_is_first_upload_pending && (usable != 0))
+    {
+        gb_is_first_upload_pending = false;
+        azure_upload_handler();
+    }
 }
 
-static void
-display_measurements(void)
+static bool
+iaq_get_current(uint32_t usable, iaq_result_t *p_iaq)
 {
-    u8g2_ClearBuffer(&g_u8g2);
-
-    //u8g2_ClearDisplay(&g_u8g2);
-    u8g2_SetFont(&g_u8g2, u8g2_font_helvB08_tf);
-
-    lib_u8g2_DrawCenteredStr(&g_u8g2, 11, "eCO2 [ppm]");
-    lib_u8g2_DrawCenteredStr(&g_u8g2, 56, "TVOC [ppb]");
-    lib_u8g2_DrawCenteredStr(&g_u8g2, 101, "Humidity [%]");
+    return ((usable & SENSOR_QUANTITY_GAS) == SENSOR_QUANTITY_GAS) &&
+        iaq_get(&g_iaq, p_iaq);
+}
 
-    u8g2_SetFont(&g_u8g2, u8g2_font_crox4tb_tn);
+static void
+anomaly_check(anomaly_metric_t metric, int32_t value, uint64_t now_us)
+{
+    uint32_t raised = anomaly_update(&g_anomaly[metric], value, now_us);
 
-    // Print eCO2 value
-    if (g_eco2 > 0)
+    if (raised != 0)
     {
-        sprintf(g_print_buffer, "%d", g_eco2);
+        char alert_json[TELEMETRY_BUFFER_SIZE];
+        if (telemetry_format_alert(&g_anomaly[metric], raised, alert_json,
+            sizeof(alert_json)) > 0)
+        {
+            Log_Debug("ALERT: %s\n", alert_json);
+#           if (defined(IOT_CENTRAL_APPLICATION) || defined(IOT_HUB_APPLICATION))
+            // Sent right away, the upload timer only carries regular telemetry
+            AzureIoT_SendPriorityMessage(alert_json);
+            connection_window_open();
+#           endif
+        }
     }
-    else
+
+    // Red for a level over its limit, yellow for a fast rise or a shift
+    uint32_t active = 0;
+    for (size_t idx = 0; idx < ANOMALY_METRIC_COUNT; idx++)
     {
-        sprintf(g_print_buffer, "...");
+        active |= g_anomaly[idx].active;
     }
-    lib_u8g2_DrawCenteredStr(&g_u8g2, 32, g_print_buffer);
 
-    // Print TVOC value
-    if (g_eco2 > 0)
+    rgb_led_color_t color = RGB_LED_OFF;
+    if (active & ANOMALY_LEVEL)
     {
-        // TVOC value is valid only after eCO2 measurement is valid
-        sprintf(g_print_buffer, "%d", g_tvoc);
+        color = RGB_LED_RED;
     }
-    else
+    else if (active != 0)
     {
-        sprintf(g_print_buffer, "...");
+        color = RGB_LED_YELLOW;
     }
-    lib_u8g2_DrawCenteredStr(&g_u8g2, 77, g_print_buffer);
 
-    // Print humidity value
-    if (g_humidity > 0)
-    {
-        sprintf(g_print_buffer, "%.1f", g_humidity);
-    }
-    else
+    if (color != g_alert_color)
     {
-        sprintf(g_print_buffer, "...");
+        rgb_led_set(color);
+        g_alert_color = color;
     }
-    lib_u8g2_DrawCenteredStr(&g_u8g2, 123, g_print_buffer);
-
-    u8g2_SendBuffer(&g_u8g2);
-
 }
 
 static void
-termination_handler(int signal_number)
+display_cache_init(void)
+{
+    bool b_is_cached = render_bitmap_init(&g_label_eco2, &g_u8g2,
+        u8g2_font_helvB08_tf, "eCO2 [ppm]");
+    b_is_cached &= render_bitmap_init(&g_label_tvoc, &g_u8g2,
+        u8g2_font_helvB08_tf, "TVOC [ppb]");
+    b_is_cached &= render_bitmap_init(&g_label_humidity, &g_u8g2,
+        u8g2_font_helvB08_tf, "Humidity [%]");
+    b_is_cached &= render_bitmap_init(&g_label_iaq, &g_u8g2,
+        u8g2_font_helvB08_tf, "IAQ");
+    for (size_t idx = 0; idx < IAQ_BAND_COUNT; idx++)
+    {
+        b_is_cached &= render_bitmap_init(&g_label_bands[idx], &g_u8g2,
+            u8g2_font_helvB08_tf, iaq_get_band_name((iaq_band_t)idx));
+    }
+    b_is_cached &= render_atlas_init(&g_value_chars, &g_u8g2,
+        u8g2_font_crox4tb_tn);
+
+    if (!b_is_cached)
+    {
+        Log_Debug("WARNING: Display text not pre-rendered, drawn with u8g2.\n");
+    }
+}
+
+static void
+display_measurements(void)
+{
+    u8g2_ClearBuffer(&g_u8g2);
+
+    // Four 32 pixel rows: eCO2, TVOC, humidity and IAQ with its band,
+    // "..." while a value is missing, warming up, stale or out of range.
+    // Labels and values are blitted from pre-rendered bitmaps.
+    const sensor_reading_t *p_latest = sensor_registry_get_latest();
+    uint32_t usable = SENSOR_USABLE(p_latest->valid, p_latest->flags);
+    iaq_result_t iaq;
+    bool b_has_iaq = iaq_get_current(usable, &iaq);
+
+    render_bitmap_draw_centered(&g_u8g2, &g_label_eco2, 9);
+    render_bitmap_draw_centered(&g_u8g2, &g_label_tvoc, 41);
+    render_bitmap_draw_centered(&g_u8g2, &g_label_humidity, 73);
+    render_bitmap_draw_centered(&g_u8g2, b_has_iaq ?
+        &g_label_bands[iaq.band] : &g_label_iaq, 105);
+
+    // Print eCO2 value
+    if (usable & SENSOR_QUANTITY_ECO2)
+    {
+        sprintf(g_print_buffer, "%u", p_latest->eco2);
+    }
+    else
+    {
+        sprintf(g_print_buffer, "...");
+    }
+    render_atlas_draw_centered(&g_u8g2, &g_value_chars, 28, g_print_buffer);
+
+    // Print TVOC value
+    if (usable & SENSOR_QUANTITY_TVOC)
+    {
+        sprintf(g_print_buffer, "%u", p_latest->tvoc);
+    }
+    else
+    {
+        sprintf(g_print_buffer, "...");
+    }
+    render_atlas_draw_centered(&g_u8g2, &g_value_chars, 60, g_print_buffer);
+
+    // Print humidity value
+    if (usable & SENSOR_QUANTITY_HUMIDITY)
+    {
+        measurement_format(p_latest->humidity, 1, g_print_buffer,
+            sizeof(g_print_buffer));
+    }
+    else
+    {
+        sprintf(g_print_buffer, "...");
+    }
+    render_atlas_draw_centered(&g_u8g2, &g_value_chars, 92, g_print_buffer);
+
+    // Print IAQ index
+    if (b_has_iaq)
+    {
+        sprintf(g_print_buffer, "%u", iaq.index);
+    }
+    else
+    {
+        sprintf(g_print_buffer, "...");
+    }
+    render_atlas_draw_centered(&g_u8g2, &g_value_chars, 124, g_print_buffer);
+}
+
+static void
+display_trend(void)
+{
+    u8g2_ClearBuffer(&g_u8g2);
+    u8g2_SetFont(&g_u8g2, u8g2_font_helvB08_tf);
+
+    snprintf(g_print_buffer, sizeof(g_print_buffer), "eCO2 %uh",
+        TREND_SPAN_MS / (60u * 60u * 1000u));
+    lib_u8g2_DrawCenteredStr(&g_u8g2, 9, g_print_buffer);
+    snprintf(g_print_buffer, sizeof(g_print_buffer), "TVOC %uh",
+        TREND_SPAN_MS / (60u * 60u * 1000u));
+    lib_u8g2_DrawCenteredStr(&g_u8g2, 73, g_print_buffer);
+
+    trend_view_draw(&g_u8g2, &g_view_eco2, &g_trend_eco2);
+    trend_view_draw(&g_u8g2, &g_view_tvoc, &g_trend_tvoc);
+}
+
+static void
+display_trend_advance(uint32_t columns)
+{
+    // Only the new columns are drawn, the rest is scrolled in the buffer
+    trend_view_advance(&g_u8g2, &g_view_eco2, &g_trend_eco2, columns);
+    trend_view_advance(&g_u8g2, &g_view_tvoc, &g_trend_tvoc, columns);
+
+    display_manager_update(DISPLAY_UPDATE_FLUSH);
+}
+
+static void
+display_show(void)
+{
+    switch (g_screen)
+    {
+        case DISPLAY_SCREEN_TREND:
+            display_trend();
+            break;
+
+        default:
+            display_measurements();
+            break;
+    }
+}
+
+#if (defined(IOT_CENTRAL_APPLICATION) || defined(IOT_HUB_APPLICATION))
+static void
+device_twin_update_handler(bool b_is_complete, const unsigned char *p_payload,
+    size_t size)
+{
+    json_scan_value_t root;
+    json_scan_value_t desired;
+
+    if (!json_scan_parse(p_payload, size, &root))
+    {
+        Log_Debug("WARNING: Device Twin update is not valid JSON, skipped.\n");
+        return;
+    }
+
+    // The complete document holds desired and reported properties, a patch
+    // only desired ones
+    if (!b_is_complete || !json_scan_get_member(&root, "desired", &desired) ||
+        (json_scan_type(&desired) != JSON_SCAN_OBJECT))
+    {
+        desired = root;
+    }
+
+    uint32_t present;
+    uint32_t rejected;
+    uint32_t changed = device_config_apply_desired(&g_config, &desired,
+        &present, &rejected);
+
+    if (rejected)
+    {
+        Log_Debug("WARNING: Invalid Device Twin config values, mask 0x%02X.\n",
+            rejected);
+    }
+
+    if (changed)
+    {
+        apply_config_changes(changed);
+    }
+
+    // Acknowledge every item of the patch, also those equal to the value in
+    // use, or IoT Central keeps them pending. Rejected items are reported
+    // as refused, with the value still in use.
+    uint32_t report_mask = present;
+    if (report_mask)
+    {
+        char json[JSON_BUFFER_SIZE * 3];
+        int len = device_config_to_json(&g_config, report_mask, rejected,
+            json, sizeof(json));
+        if (len > 0)
+        {
+            AzureIoT_TwinReportStateJson(json, (size_t)len);
+        }
+    }
+}
+
+static void
+apply_config_changes(uint32_t changed_mask)
+{
+    if (changed_mask & CONFIG_ITEM_POWER_MODE)
+    {
+        Log_Debug("Config: power mode %s\n",
+            power_mode_get_profile(g_config.power_mode)->name);
+        power_mode_apply();
+    }
+
+    // Low power mode limits the upload period and the CCS811 mode
+    if (changed_mask & CONFIG_ITEM_UPLOAD_PERIOD)
+    {
+        Log_Debug("Config: upload period %lu s, uploading every %lu s\n",
+            (unsigned long)g_config.upload_period_sec,
+            (unsigned long)upload_period_get());
+        upload_period_apply();
+    }
+
+    if (changed_mask & CONFIG_ITEM_CCS811_MODE)
+    {
+        Log_Debug("Config: CCS811 mode %s, running %s\n",
+            device_config_ccs811_mode_name(g_config.ccs811_mode),
+            device_config_ccs811_mode_name(ccs811_mode_get()));
+        if (!sensor_ccs811_set_mode(ccs811_mode_get()))
+        {
+            Log_Debug("ERROR: Could not set CCS811 mode.\n");
+        }
+        sensor_period_apply();
+    }
+
+    if (changed_mask & CONFIG_ITEM_DISPLAY_REFRESH)
+    {
+        Log_Debug("Config: display refresh limit %lu s\n",
+            (unsigned long)g_config.display_refresh_sec);
+        display_manager_set_refresh(g_config.display_refresh_sec * 1000u);
+    }
+}
+#endif
+
+static void
+termination_handler(int signal_number)
 {
     gb_is_termination_requested = true;
 }
 
+static void
+fatal_signal_handler(int signal_number)
+{
+    log_ring_crash_dump(signal_number);
+
+    // Handler was reset to the default action on entry
+    raise(signal_number);
+}
+
+#ifdef LOG_RING_ECHO
+static void
+log_echo(const log_entry_t *p_entry)
+{
+    char line[LOG_RING_LINE_SIZE];
+
+    log_ring_format(p_entry, line, sizeof(line));
+    Log_Debug("%s\n", line);
+}
+#endif
+
+static void
+crash_log_init(void)
+{
+    static const int fatal_signals[] = {
+        SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT
+    };
+
+    g_fd_crash_log = Storage_OpenMutableFile();
+    if (g_fd_crash_log < 0)
+    {
+        // Not fatal, the log is kept in memory only
+        Log_Debug("ERROR: Could not open mutable storage: %s (%d).\n",
+            strerror(errno), errno);
+        return;
+    }
+
+    // Keep the previous crash dump until the next one is written
+    gp_crash_entries = malloc(CRASH_LOG_MAX_ENTRIES * sizeof(log_entry_t));
+    if (gp_crash_entries != NULL)
+    {
+        g_crash_entry_count = log_ring_crash_load(g_fd_crash_log,
+            PERSIST_CRASH_LOG_OFFSET, PERSIST_CRASH_LOG_SIZE,
+            gp_crash_entries, CRASH_LOG_MAX_ENTRIES, &g_crash_reason);
+        if (g_crash_entry_count > 0)
+        {
+            Log_Debug("WARNING: previous run ended by signal %d, %u log "
+                "records saved.\n", g_crash_reason,
+                (unsigned)g_crash_entry_count);
+            log_ring_crash_clear(g_fd_crash_log, PERSIST_CRASH_LOG_OFFSET);
+        }
+        else
+        {
+            free(gp_crash_entries);
+            gp_crash_entries = NULL;
+        }
+    }
+
+    log_ring_set_crash_file(g_fd_crash_log, PERSIST_CRASH_LOG_OFFSET,
+        PERSIST_CRASH_LOG_SIZE);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(struct sigaction));
+    action.sa_handler = fatal_signal_handler;
+    action.sa_flags = SA_RESETHAND;
+    for (size_t idx = 0; idx < sizeof(fatal_signals) / sizeof(fatal_signals[0]); idx++)
+    {
+        if (sigaction(fatal_signals[idx], &action, NULL) != 0)
+        {
+            Log_Debug("ERROR: %s - sigaction: errno=%d (%s)\n",
+                __FUNCTION__, errno, strerror(errno));
+        }
+    }
+}
+
 static void
 button_timer_event_handler(EventData *event_data)
 {
@@ -391,105 +1156,592 @@ button_timer_event_handler(EventData *event_data)
         return;
     }
 
-    // Check for a button press
-    GPIO_Value_Type new_g_state_button1;
-    int result = GPIO_GetValue(g_fd_gpio_button1, &new_g_state_button1);
-    if (result != 0) {
-        Log_Debug("ERROR: Could not read button GPIO: %s (%d).\n", 
-            strerror(errno), errno);
-        gb_is_termination_requested = true;
-        return;
+    // Check for a button press
+    GPIO_Value_Type new_g_state_button1;
+    int result = GPIO_GetValue(g_fd_gpio_button1, &new_g_state_button1);
+    if (result != 0) {
+        // Not fatal, the button is polled again
+        Log_Debug("ERROR: Could not read button GPIO: %s (%d).\n", 
+            strerror(errno), errno);
+        return;
+    }
+
+    if (new_g_state_button1 != g_state_button1)
+    {
+        if (new_g_state_button1 == GPIO_Value_Low)
+        {
+            button1_press_handler();
+        }
+        g_state_button1 = new_g_state_button1;
+    }
+}
+
+static void
+upload_timer_event_handler(EventData *event_data)
+{
+    bool b_is_all_ok = true;
+
+    // Consume timer event
+    if (ConsumeTimerFdEvent(g_fd_poll_timer_upload) != 0)
+    {
+        // Failed to consume timer event
+        gb_is_termination_requested = true;
+        b_is_all_ok = false;
+    }
+
+    if (b_is_all_ok)
+    {
+        // Request measurement data from all sources
+        azure_upload_handler();
+    }
+
+    return;
+}
+
+static void
+loop_stats_timer_event_handler(EventData *event_data)
+{
+    if (ConsumeTimerFdEvent(g_fd_timer_loop_stats) != 0)
+    {
+        gb_is_termination_requested = true;
+        return;
+    }
+
+    char *p_buffer_json = malloc(STATS_BUFFER_SIZE);
+    if (p_buffer_json == NULL)
+    {
+        Log_Debug("ERROR: not enough memory for statistics buffer.\n");
+        return;
+    }
+
+    // Compact record:
+    // {"loopStats":{"name":[calls,avg,p50,p99,max,...],...},
+    //  "latency":{"hdcRead":[count,p50,p90,p99,max],...},
+    //  "sensorHealth":{"hdc1000":[state,errors,retries,breakerOpens],...},
+    //  "display":[frames,coalesced,suppressed,wakeups,i2cBytes,onSec],
+    //  "power":[wakeups,samples,busBytes,radioOnSec,displayOnSec,mAhPerDay],
+    //  "log":[written,filtered,rateDropped]}
+#   if (defined(IOT_CENTRAL_APPLICATION) || defined(IOT_HUB_APPLICATION))
+    AzureIoT_MessageStats message_stats;
+    AzureIoT_GetMessageStats(&message_stats, true);
+    g_hist_delivery = message_stats.latencyMs;
+
+    AzureIoT_ConnectionStats connection_stats;
+    AzureIoT_GetConnectionStats(&connection_stats, true);
+    g_hist_reconnect = connection_stats.reconnectMs;
+    g_hist_drain = connection_stats.drainMs;
+#   endif
+
+    const struct
+    {
+        const char *name;
+        latency_hist_t *p_hist;
+    } latencies[] = {
+        { "hdcRead", &sensor_registry_get(SENSOR_ID_HDC1000)->hist_bus_us },
+        { "ccsRead", &sensor_registry_get(SENSOR_ID_CCS811)->hist_bus_us },
+        { "displayPush", &g_hist_display_push },
+        { "deliveryMs", &g_hist_delivery },
+        { "reconnectMs", &g_hist_reconnect },
+        { "drainMs", &g_hist_drain },
+    };
+
+    size_t len = (size_t)snprintf(p_buffer_json, STATS_BUFFER_SIZE,
+        "{\"loopStats\":");
+    int written = loop_stats_to_json(p_buffer_json + len,
+        STATS_BUFFER_SIZE - len);
+    bool b_is_ok = (written > 0);
+
+    for (size_t idx = 0; b_is_ok && (idx < sizeof(latencies) / sizeof(latencies[0])); idx++)
+    {
+        len += (size_t)written;
+        written = snprintf(p_buffer_json + len, STATS_BUFFER_SIZE - len,
+            "%s\"%s\":", (idx == 0) ? ",\"latency\":{" : ",",
+            latencies[idx].name);
+        b_is_ok = (written > 0) && ((size_t)written < STATS_BUFFER_SIZE - len);
+        if (b_is_ok)
+        {
+            len += (size_t)written;
+            written = latency_hist_to_json(latencies[idx].p_hist,
+                p_buffer_json + len, STATS_BUFFER_SIZE - len);
+            b_is_ok = (written > 0);
+        }
+        latency_hist_reset(latencies[idx].p_hist);
+    }
+
+    // Sensor health counters since start
+    if (b_is_ok)
+    {
+        len += (size_t)written;
+        written = snprintf(p_buffer_json + len, STATS_BUFFER_SIZE - len,
+            "},\"sensorHealth\":");
+        b_is_ok = (written > 0) && ((size_t)written < STATS_BUFFER_SIZE - len);
+    }
+    if (b_is_ok)
+    {
+        len += (size_t)written;
+        written = sensor_registry_health_to_json(p_buffer_json + len,
+            STATS_BUFFER_SIZE - len);
+        b_is_ok = (written > 0);
+    }
+
+    // Display activity and energy estimate of the period, log counters
+    const power_model_t power_model = POWER_MODEL_DEFAULT;
+    log_ring_stats_t log_stats;
+    uint64_t now_ms = loop_stats_now_us() / 1000u;
+    display_manager_stats_t display_stats;
+
+    display_manager_get_stats(&display_stats, true);
+    radio_on_update(now_ms);
+    g_power_usage.period_ms = now_ms - g_power_period_start_ms;
+    g_power_usage.bus_bytes = display_stats.i2c_bytes + i2c_bus_get_bytes(true);
+    g_power_usage.display_on_ms = display_stats.on_ms;
+    g_power_usage.ccs811_period_ms = sensor_ccs811_get_period_ms(ccs811_mode_get());
+
+    if (b_is_ok)
+    {
+        len += (size_t)written;
+        written = snprintf(p_buffer_json + len, STATS_BUFFER_SIZE - len,
+            ",\"display\":");
+        b_is_ok = (written > 0) && ((size_t)written < STATS_BUFFER_SIZE - len);
+    }
+    if (b_is_ok)
+    {
+        len += (size_t)written;
+        written = display_manager_stats_to_json(&display_stats,
+            p_buffer_json + len, STATS_BUFFER_SIZE - len);
+        b_is_ok = (written > 0);
+    }
+    log_ring_get_stats(&log_stats);
+    if (b_is_ok)
+    {
+        len += (size_t)written;
+        written = snprintf(p_buffer_json + len, STATS_BUFFER_SIZE - len,
+            ",\"power\":[%llu,%llu,%llu,%lu,%lu,%lu],\"log\":[%lu,%lu,%lu]",
+            (unsigned long long)g_power_usage.wakeups,
+            (unsigned long long)g_power_usage.samples,
+            (unsigned long long)g_power_usage.bus_bytes,
+            (unsigned long)(g_power_usage.radio_on_ms / 1000u),
+            (unsigned long)(g_power_usage.display_on_ms / 1000u),
+            (unsigned long)(power_estimate_mah_per_day(&power_model,
+                &g_power_usage) + 0.5),
+            (unsigned long)log_stats.written,
+            (unsigned long)log_stats.filtered,
+            (unsigned long)log_stats.rate_dropped);
+        b_is_ok = (written > 0) && ((size_t)written < STATS_BUFFER_SIZE - len);
+    }
+    memset(&g_power_usage, 0, sizeof(g_power_usage));
+    g_power_period_start_ms = now_ms;
+
+    if (b_is_ok && (len + (size_t)written + 2 <= STATS_BUFFER_SIZE))
+    {
+        strcpy(p_buffer_json + len + written, "}");
+#       if (defined(IOT_CENTRAL_APPLICATION) || defined(IOT_HUB_APPLICATION))
+        AzureIoT_SendMessage(p_buffer_json);
+#       else
+        Log_Debug("%s\n", p_buffer_json);
+#       endif
+    }
+    free(p_buffer_json);
+
+    // Each record covers one statistics period
+    loop_stats_reset();
+}
+
+#if (defined(IOT_CENTRAL_APPLICATION) || defined(IOT_HUB_APPLICATION))
+static int
+direct_method_handler(const char *p_method_name, const char *p_payload,
+    size_t payload_size, char **pp_response, size_t *p_response_size)
+{
+    int status = 404;
+    *pp_response = NULL;
+    *p_response_size = 0;
+
+    if (strcmp(p_method_name, "getLoopStats") == 0)
+    {
+        // Dump statistics of the current period without resetting them
+        char *p_buffer_json = malloc(STATS_BUFFER_SIZE);
+        if (p_buffer_json == NULL)
+        {
+            return 500;
+        }
+
+        int len = loop_stats_to_json(p_buffer_json, STATS_BUFFER_SIZE);
+        if (len > 0)
+        {
+            *pp_response = p_buffer_json;
+            *p_response_size = (size_t)len;
+            status = 200;
+        }
+        else
+        {
+            free(p_buffer_json);
+            status = 500;
+        }
+    }
+    else if (strcmp(p_method_name, "getLog") == 0)
+    {
+        // Records are formatted here, not when they are written
+        uint32_t cursor = log_ring_oldest();
+
+        status = log_to_response(NULL, LOG_RING_SIZE, cursor, pp_response,
+            p_response_size);
+    }
+    else if (strcmp(p_method_name, "getCrashLog") == 0)
+    {
+        status = log_to_response(gp_crash_entries, g_crash_entry_count, 0,
+            pp_response, p_response_size);
+    }
+    else if (strcmp(p_method_name, "setLogLevel") == 0)
+    {
+        status = log_set_levels(p_payload, payload_size);
+    }
+    else if (strcmp(p_method_name, "getStartup") == 0)
+    {
+        // Step times do not fit into the reported property
+        char *p_buffer_json = malloc(STARTUP_BUFFER_SIZE);
+        if (p_buffer_json == NULL)
+        {
+            return 500;
+        }
+
+        int len = startup_to_json(p_buffer_json, STARTUP_BUFFER_SIZE, true);
+        if (len > 0)
+        {
+            *pp_response = p_buffer_json;
+            *p_response_size = (size_t)len;
+            status = 200;
+        }
+        else
+        {
+            free(p_buffer_json);
+            status = 500;
+        }
+    }
+
+    return status;
+}
+
+static int
+log_to_response(const log_entry_t *p_entries, size_t count,
+    uint32_t cursor, char **pp_response, size_t *p_response_size)
+{
+    // Lines hold no quotes or backslashes, they need no escaping. Each
+    // line is truncated to LOG_RING_LINE_SIZE, the buffer fits them all.
+    size_t size = count * (LOG_RING_LINE_SIZE + 3) + 16;
+    char *p_buffer_json = malloc(size);
+    if (p_buffer_json == NULL)
+    {
+        return 500;
+    }
+
+    // Room for the closing "]}" is kept, a line that does not fit is
+    // dropped with the ones after it
+    size_t limit = size - 3;
+    size_t len = 0;
+    bool b_is_ok = response_advance(limit, &len,
+        snprintf(p_buffer_json, limit, "{\"log\":["));
+    log_entry_t chunk[16];
+    size_t done = 0;
+
+    while (b_is_ok && (done < count))
+    {
+        const log_entry_t *p_chunk = p_entries + done;
+        size_t chunk_count = count - done;
+
+        // Ring records are copied out first, the ring is written meanwhile
+        if (p_entries == NULL)
+        {
+            p_chunk = chunk;
+            chunk_count = log_ring_read(&cursor, chunk,
+                (chunk_count < 16) ? chunk_count : 16, NULL);
+            if (chunk_count == 0)
+            {
+                break;
+            }
+        }
+
+        for (size_t idx = 0; b_is_ok && (idx < chunk_count); idx++)
+        {
+            size_t line_start = len;
+            b_is_ok = response_advance(limit, &len,
+                snprintf(p_buffer_json + len, limit - len, "%s\"",
+                (done + idx > 0) ? "," : ""));
+            if (b_is_ok)
+            {
+                size_t line_size = limit - len;
+                b_is_ok = response_advance(limit, &len,
+                    log_ring_format(&p_chunk[idx], p_buffer_json + len,
+                    (line_size < LOG_RING_LINE_SIZE) ?
+                        line_size : LOG_RING_LINE_SIZE));
+            }
+            b_is_ok = b_is_ok && response_advance(limit, &len,
+                snprintf(p_buffer_json + len, limit - len, "\""));
+            if (!b_is_ok)
+            {
+                len = line_start;
+            }
+        }
+        done += chunk_count;
+    }
+
+    len += (size_t)snprintf(p_buffer_json + len, size - len, "]}");
+
+    *pp_response = p_buffer_json;
+    *p_response_size = len;
+    return 200;
+}
+
+static bool
+response_advance(size_t size, size_t *p_len, int written)
+{
+    if ((written < 0) || (*p_len + (size_t)written >= size))
+    {
+        return false;
+    }
+
+    *p_len += (size_t)written;
+    return true;
+}
+
+static int
+log_set_levels(const char *p_payload, size_t payload_size)
+{
+    int status = 400;
+    json_scan_value_t levels;
+    json_scan_value_t name;
+    json_scan_value_t value;
+    size_t pos = 0;
+
+    if (!json_scan_parse(p_payload, payload_size, &levels))
+    {
+        return 400;
+    }
+
+    while (json_scan_next_member(&levels, &pos, &name, &value))
+    {
+        // Names longer than any module or level are unknown as well
+        char module_name[16];
+        char level_name[16];
+        log_module_t module = json_scan_get_string(&name, module_name,
+            sizeof(module_name)) ?
+            log_ring_module_from_name(module_name) : LOG_MODULE_COUNT;
+        log_level_t level = json_scan_get_string(&value, level_name,
+            sizeof(level_name)) ?
+            log_ring_level_from_name(level_name) : LOG_LEVEL_COUNT;
+
+        if ((module == LOG_MODULE_COUNT) || (level == LOG_LEVEL_COUNT))
+        {
+            status = 400;
+            break;
+        }
+        log_ring_set_level(module, level);
+        status = 200;
+    }
+
+    return status;
+}
+#endif
+
+static void
+azure_upload_handler(void)
+{
+#   if (defined(IOT_CENTRAL_APPLICATION) || defined(IOT_HUB_APPLICATION))
+    char *p_buffer_json;
+    const sensor_reading_t *p_latest = sensor_registry_get_latest();
+    uint32_t usable = SENSOR_USABLE(p_latest->valid, p_latest->flags);
+    telemetry_sample_t sample = {
+        .eco2 = (int16_t)p_latest->eco2,
+        .tvoc = (int16_t)p_latest->tvoc,
+        .temperature = p_latest->temperature,
+        .humidity = p_latest->humidity,
+        .iaq = TELEMETRY_IAQ_NONE,
+        .valid = p_latest->valid,
+        .flags = p_latest->flags
+    };
+    iaq_result_t iaq;
+
+    if (iaq_get_current(usable, &iaq))
+    {
+        sample.iaq = iaq.index;
+    }
+
+    if (usable == 0)
+    {
+        // Nothing worth sending, e.g. before the first reading
+        Log_Debug("INFO: upload skipped, no usable readings.\n");
+    }
+    else if (!AzureIoT_CanSendMessage())
+    {
+        // Too many messages waiting for delivery, skip this sample
+        Log_Debug("WARNING: upload skipped, %u messages in flight.\n",
+            AzureIoT_GetInFlightMessageCount());
+    }
+    else if ((p_buffer_json = malloc(TELEMETRY_BUFFER_SIZE)) == NULL)
+    {
+        Log_Debug("ERROR: not enough memory for upload buffer.\n");
+    }
+    else
+    {
+        // Construct Azure upload message
+        telemetry_format_sample(&sample, p_buffer_json, TELEMETRY_BUFFER_SIZE);
+
+        LOG_RING(LOG_UPLOAD, sample.eco2, sample.tvoc, sample.iaq,
+            sample.valid);
+        AzureIoT_SendMessage(p_buffer_json);
+        free(p_buffer_json);
     }
 
-    if (new_g_state_button1 != g_state_button1)
+    // Low power mode connects once a batch of samples is queued
+    uint32_t batch = power_mode_get_profile(g_config.power_mode)->upload_batch;
+    if ((batch > 0) && (AzureIoT_GetInFlightMessageCount() >= batch))
     {
-        if (new_g_state_button1 == GPIO_Value_Low)
-        {
-            button1_press_handler();
-        }
-        g_state_button1 = new_g_state_button1;
+        connection_window_open();
     }
+#   endif
+
+    return;
 }
 
 static void
-ccs811_int_timer_event_handler(EventData *event_data)
+power_mode_apply(void)
 {
-    // Consume timer event
-    if (ConsumeTimerFdEvent(g_fd_poll_timer_ccs811_int) != 0) {
+    const power_profile_t *p_profile =
+        power_mode_get_profile(g_config.power_mode);
+    struct timespec button_period = {
+        (time_t)(p_profile->button_poll_ms / 1000u),
+        (long)(p_profile->button_poll_ms % 1000u) * 1000000L
+    };
+    struct timespec stats_period = { (time_t)p_profile->stats_period_sec, 0 };
+
+    Log_Debug("Power mode %s.\n", p_profile->name);
+
+    if ((SetTimerFdToPeriod(g_fd_poll_timer_button, &button_period) != 0) ||
+        (SetTimerFdToPeriod(g_fd_timer_loop_stats, &stats_period) != 0))
+    {
         gb_is_termination_requested = true;
-        return;
+    }
+    upload_period_apply();
+
+    // The HDC1000 has no sleep command, it returns to sleep after each
+    // triggered conversion by itself and draws about 0.1 uA between them,
+    // so a longer period is all low power needs.
+    // Its heater stays off, sensor_hdc1000.c clears it when probing.
+    sensor_period_apply();
+    if (!sensor_ccs811_set_mode(ccs811_mode_get()))
+    {
+        Log_Debug("ERROR: Could not set CCS811 mode.\n");
     }
 
-    // Check for interrupt signal state change
-    GPIO_Value_Type new_g_state_ccs811_int;
+    display_manager_set_timeouts(
+        (p_profile->display_dim_ms > 0) ?
+            p_profile->display_dim_ms : DISPLAY_DIM_AFTER_MS,
+        (p_profile->display_off_ms > 0) ?
+            p_profile->display_off_ms : DISPLAY_OFF_AFTER_MS);
 
-    int result = GPIO_GetValue(g_fd_gpio_ccs811_int, &new_g_state_ccs811_int);
-    if (result != 0) {
-        Log_Debug("ERROR: Could not read CCS811 interrupt GPIO: %s (%d).\n",
-            strerror(errno), errno);
-        gb_is_termination_requested = true;
-        return;
-    }
+#   if (defined(IOT_CENTRAL_APPLICATION) || defined(IOT_HUB_APPLICATION))
+    // Connect now, in low power mode until the pending messages are sent
+    connection_window_open();
+#   endif
+}
 
-    if (new_g_state_ccs811_int != g_state_ccs811_int)
-    {
-        if (new_g_state_ccs811_int == GPIO_Value_Low)
-        {
-            // CCS811 /INT pin is asserted. New measurement is available.
-            ccs811_interrupt_handler();
-        }
-        g_state_ccs811_int = new_g_state_ccs811_int;
-    }
+static uint32_t
+upload_period_get(void)
+{
+    uint32_t min_sec =
+        power_mode_get_profile(g_config.power_mode)->upload_period_min_sec;
+
+    return (g_config.upload_period_sec > min_sec) ?
+        g_config.upload_period_sec : min_sec;
 }
 
 static void
-upload_timer_event_handler(EventData *event_data)
+upload_period_apply(void)
 {
-    bool b_is_all_ok = true;
+    struct timespec upload_period = { (time_t)upload_period_get(), 0 };
 
-    // Consume timer event
-    if (ConsumeTimerFdEvent(g_fd_poll_timer_upload) != 0)
+    if (SetTimerFdToPeriod(g_fd_poll_timer_upload, &upload_period) != 0)
     {
-        // Failed to consume timer event
         gb_is_termination_requested = true;
-        b_is_all_ok = false;
     }
+}
 
-    if (b_is_all_ok)
+static ccs811_mode_t
+ccs811_mode_get(void)
+{
+    return power_mode_get_profile(g_config.power_mode)->b_ccs811_slow ?
+        CCS811_MODE_60S : g_config.ccs811_mode;
+}
+
+static void
+sensor_period_apply(void)
+{
+    uint32_t period_ms =
+        power_mode_get_profile(g_config.power_mode)->sample_period_ms;
+
+    // The HDC1000 only compensates the CCS811 and feeds displays and uploads
+    // of 10 s and more, one reading per CCS811 result is enough. An idle
+    // CCS811 leaves the sensor_config.h period.
+    if (period_ms == 0)
     {
-        // Request measurement data from all sources
-        azure_upload_handler();
+        period_ms = sensor_ccs811_get_period_ms(ccs811_mode_get());
     }
 
-    return;
+    sensor_registry_set_period(period_ms);
 }
 
 static void
-azure_upload_handler(void)
+radio_on_update(uint64_t now_ms)
 {
-#   if (defined(IOT_CENTRAL_APPLICATION) || defined(IOT_HUB_APPLICATION))
-    char *p_buffer_json;
-
-    if ((p_buffer_json = malloc(JSON_BUFFER_SIZE)) == NULL)
+    if (gb_is_window_open)
     {
-        Log_Debug("ERROR: not enough memory for upload buffer.\n");
+        g_power_usage.radio_on_ms += now_ms - g_radio_since_ms;
     }
-    else
+    g_radio_since_ms = now_ms;
+}
+
+#if (defined(IOT_CENTRAL_APPLICATION) || defined(IOT_HUB_APPLICATION))
+static void
+connection_window_open(void)
+{
+    uint64_t now_ms = loop_stats_now_us() / 1000u;
+
+    if (!gb_is_window_open)
     {
-        // Construct Azure upload message
-        snprintf(p_buffer_json, JSON_BUFFER_SIZE,
-            "{\"eco2\":\"%d\", \"tvoc\":\"%d\", "
-            "\"temperature\":\"%.1f\", \"humidity\":\"%.1f\"}",
-            g_eco2, g_tvoc, g_temperature, g_humidity);
+        radio_on_update(now_ms);
+        gb_is_window_open = true;
+    }
+    g_window_open_ms = now_ms;
+}
 
-        Log_Debug("Uploading to Azure: %s\n", p_buffer_json);
-        AzureIoT_SendMessage(p_buffer_json);
-        free(p_buffer_json);
+static void
+connection_window_check(void)
+{
+    const power_profile_t *p_profile =
+        power_mode_get_profile(g_config.power_mode);
+    uint64_t now_ms = loop_stats_now_us() / 1000u;
+    uint64_t open_ms = now_ms - g_window_open_ms;
+
+    // Normal power mode stays connected
+    if (p_profile->upload_batch == 0)
+    {
+        return;
     }
-#   endif
 
-    return;
+    // Undelivered messages are kept for the next window
+    if (((open_ms >= CONNECTION_WINDOW_MIN_MS) &&
+        (AzureIoT_GetConnectionState() == AzureIoT_ConnectionState_Live) &&
+        !AzureIoT_HasPendingDeliveries()) ||
+        (open_ms >= p_profile->window_max_ms))
+    {
+        Log_Debug("INFO: connection window closed after %lu ms, %u messages "
+            "pending.\n", (unsigned long)open_ms,
+            AzureIoT_GetInFlightMessageCount());
+        AzureIoT_DestroyClient();
+        radio_on_update(now_ms);
+        gb_is_window_open = false;
+    }
 }
+#endif
 
 static int
 init_handlers(void)
@@ -507,6 +1759,8 @@ init_handlers(void)
             __FUNCTION__, errno, strerror(errno));
     }
 
+    crash_log_init();
+
     g_fd_epoll = CreateEpollFd();
     if (g_fd_epoll < 0) {
         result = -1;
@@ -515,8 +1769,9 @@ init_handlers(void)
     // Create poll timer for Azure upload
     if (result != -1)
     {
+        struct timespec upload_period = { (time_t)upload_period_get(), 0 };
         g_fd_poll_timer_upload = CreateTimerFdAndAddToEpoll(g_fd_epoll,
-            &AZURE_UPLOAD_PERIOD, &g_event_data_poll_upload, EPOLLIN);
+            &upload_period, &g_event_data_poll_upload, EPOLLIN);
         if (g_fd_poll_timer_upload < 0)
         {
             // Failed to create Azure upload poll timer
@@ -526,168 +1781,343 @@ init_handlers(void)
         }
     }
 
+    // Create timer for sending event loop statistics
+    if (result != -1)
+    {
+        struct timespec stats_period = {
+            (time_t)power_mode_get_profile(g_config.power_mode)->stats_period_sec,
+            0
+        };
+        g_fd_timer_loop_stats = CreateTimerFdAndAddToEpoll(g_fd_epoll,
+            &stats_period, &g_event_data_loop_stats, EPOLLIN);
+        if (g_fd_timer_loop_stats < 0)
+        {
+            Log_Debug("ERROR: Could not create statistics timer: %s (%d).\n",
+                strerror(errno), errno);
+            result = -1;
+        }
+    }
+
     return result;
 }
 
 static int
-init_peripherals(I2C_InterfaceId isu_id)
+init_step_i2c(void)
 {
-    int result = -1;
-
-    // Initialize I2C
     Log_Debug("Init I2C\n");
-    g_fd_i2c = I2CMaster_Open(isu_id);
-    if (g_fd_i2c < 0) {
-        Log_Debug("ERROR: I2CMaster_Open: errno=%d (%s)\n", 
-            errno, strerror(errno));
+    g_fd_i2c = i2c_open(I2C_ISU);
+
+    return (g_fd_i2c >= 0) ? 0 : -1;
+}
+
+static int
+init_step_display(void)
+{
+    if (g_fd_i2c < 0)
+    {
+        return -1;
     }
-    else
+
+    // Probe only the OLED addresses, the full bus scan comes with the
+    // sensors after the first screen
+    i2c_scan_map_t oled_map;
+    memset(&oled_map, 0, sizeof(oled_map));
+    i2c_scan_range(g_fd_i2c, I2C_ADDR_OLED, I2C_ADDR_OLED_ALT, &oled_map,
+        NULL);
+
+    g_oled_addr = i2c_scan_find(&oled_map, I2C_ADDR_OLED, I2C_ADDR_OLED_ALT);
+    if (g_oled_addr == 0)
     {
-        result = I2CMaster_SetBusSpeed(g_fd_i2c, I2C_BUS_SPEED_STANDARD);
-        if (result != 0) {
-            Log_Debug("ERROR: I2CMaster_SetBusSpeed: errno=%d (%s)\n", 
-                errno, strerror(errno));
-        }
-        else 
-        {
-            result = I2CMaster_SetTimeout(g_fd_i2c, 100);
-            if (result != 0) {
-                Log_Debug("ERROR: I2CMaster_SetTimeout: errno=%d (%s)\n", 
-                    errno, strerror(errno));
-            }
-        }
+        Log_Debug("WARNING: OLED display not found.\n");
+        g_oled_addr = I2C_ADDR_OLED;
     }
 
-    // Initialize HDC1000 Click board
-    // Default sensor I2C address, not using DRDYn signal
-    if (result != -1)
+    Log_Debug("Initializing OLED display at 0x%02X.\n", g_oled_addr);
+
+    // Set lib_u8g2 I2C interface file descriptor and device address
+    lib_u8g2_set_i2c(g_fd_i2c, g_oled_addr);
+
+    // Set display type and callbacks
+    u8g2_Setup_ssd1306_i2c_128x64_noname_f(&g_u8g2, OLED_ROTATION,
+        display_manager_byte_i2c, lib_u8g2_custom_cb);
+
+    // Initialize display descriptor
+    u8g2_InitDisplay(&g_u8g2);
+
+    // Wake up display
+    u8g2_SetPowerSave(&g_u8g2, 0);
+
+    display_cache_init();
+
+    // Refresh limit, panel dimming and pixel shift
+    if (display_manager_init(g_fd_epoll, &g_u8g2, &display_show,
+        &g_hist_display_push) != 0)
     {
-        Log_Debug("Init HDC1000\n");
-        gp_hdc = hdc1000_open(g_fd_i2c, HDC1000_I2C_ADDR, -1);
-        if (!gp_hdc)
-        {
-            Log_Debug("ERROR: Cannot initialize HDC1000 sensor.\n");
-            result = -1;
-        }
+        Log_Debug("ERROR: Could not create display timer: %s (%d).\n",
+            strerror(errno), errno);
+        return -1;
     }
+    display_manager_set_refresh(g_config.display_refresh_sec * 1000u);
 
-    // Initialize Air Quality 3 Click board (CCS811 sensor)
-    // Default sensor I2C address, located in  Socket1
-    if (result != -1)
+    // Show measurement display while waiting for the first data. The frame
+    // covers the whole panel, it is not cleared before.
+    display_manager_update(DISPLAY_UPDATE_IMMEDIATE);
+    startup_mark(STARTUP_MILESTONE_FIRST_SCREEN);
+
+    return 0;
+}
+
+static int
+init_step_state(void)
+{
+    iaq_init(&g_iaq);
+    trend_init(&g_trend_eco2, TREND_SPAN_MS);
+    trend_init(&g_trend_tvoc, TREND_SPAN_MS);
+
+    // Initialize anomaly detectors and the alert LED, the LED is optional
+    for (size_t idx = 0; idx < ANOMALY_METRIC_COUNT; idx++)
     {
-        Log_Debug("Init CCS811\n");
-        gp_ccs = ccs811_open(g_fd_i2c, CCS811_I2C_ADDRESS_1, SK_SOCKET1_CS_GPIO);
-        if (!gp_ccs)
-        {
-            Log_Debug("ERROR: Cannot initialize CCS811 sensor.\n");
-            result = -1;
-        }
+        anomaly_init(&g_anomaly[idx], &anomaly_configs[idx]);
+    }
+    if (!rgb_led_open(PROJECT_RGBLED_RED, PROJECT_RGBLED_GREEN,
+        PROJECT_RGBLED_BLUE))
+    {
+        Log_Debug("WARNING: Alert LED not available.\n");
     }
 
-    // Initialize Air Quality 3 Click board interrupt GPIO
-    // Set development kit Socket 1 & 2 INT pin as Input
-    if (result != -1)
+    return 0;
+}
+
+static int
+init_step_sensors(void)
+{
+    if (g_fd_i2c < 0)
     {
-        Log_Debug("Opening PROJECT_SOCKET12_INT as input.\n");
-        g_fd_gpio_ccs811_int = GPIO_OpenAsInput(PROJECT_SOCKET12_INT);
-        if (g_fd_gpio_ccs811_int < 0) {
-            Log_Debug("ERROR: Could not open GPIO: %s (%d).\n",
-                strerror(errno), errno);
-            result = -1;
-        }
+        return -1;
     }
 
-    // Initialize 128x64 SSD1306 OLED
-    if (result != -1)
+    sensor_registry_set_bus_recovery(&i2c_bus_recovery_handler);
+    return sensor_registry_init(g_fd_epoll, g_fd_i2c, &sensor_reading_handler);
+}
+
+static int
+init_step_button(void)
+{
+    // Initialize development kit button GPIO
+    // Open button 1 GPIO as input
+    Log_Debug("Opening PROJECT_BUTTON_1 as input.\n");
+    g_fd_gpio_button1 = GPIO_OpenAsInput(PROJECT_BUTTON_1);
+    if (g_fd_gpio_button1 < 0) {
+        Log_Debug("ERROR: Could not open button GPIO: %s (%d).\n",
+            strerror(errno), errno);
+        return -1;
+    }
+
+    // Create timer for button press check
+    uint32_t poll_ms =
+        power_mode_get_profile(g_config.power_mode)->button_poll_ms;
+    struct timespec button_press_check_period = {
+        (time_t)(poll_ms / 1000u), (long)(poll_ms % 1000u) * 1000000L
+    };
+    g_fd_poll_timer_button = CreateTimerFdAndAddToEpoll(g_fd_epoll,
+        &button_press_check_period, &g_event_data_button, EPOLLIN);
+    if (g_fd_poll_timer_button < 0)
     {
-        Log_Debug("Initializing OLED display.\n");
+        Log_Debug("ERROR: Could not create button poll timer: %s (%d).\n",
+            strerror(errno), errno);
+        return -1;
+    }
 
-        // Set lib_u8g2 I2C interface file descriptor and device address
-        lib_u8g2_set_i2c(g_fd_i2c, I2C_ADDR_OLED);
+    return 0;
+}
 
-        // Set display type and callbacks
-        u8g2_Setup_ssd1306_i2c_128x64_noname_f(&g_u8g2, OLED_ROTATION,
-            lib_u8g2_byte_i2c, lib_u8g2_custom_cb);
+static int
+init_step_power_mode(void)
+{
+    // Timer cadences, CCS811 measurement mode and display timeouts
+    g_power_period_start_ms = loop_stats_now_us() / 1000u;
+    power_mode_apply();
 
-        // Initialize display descriptor
-        u8g2_InitDisplay(&g_u8g2);
+    return gb_is_termination_requested ? -1 : 0;
+}
 
-        // Wake up display
-        u8g2_SetPowerSave(&g_u8g2, 0);
+#if (defined(IOT_CENTRAL_APPLICATION) || defined(IOT_HUB_APPLICATION))
+static int
+init_step_iot_client(void)
+{
+    // In low power mode the client is created by the first connection window
+    if (gb_is_window_open && !AzureIoT_SetupClient())
+    {
+        Log_Debug("ERROR: Failed to set up IoT Hub client\n");
+        return -1;
     }
 
-    // Initialize development kit button GPIO
-    // Open button 1 GPIO as input
-    if (result != -1)
+    return 0;
+}
+
+static void
+connection_status_handler(bool b_is_connected)
+{
+    if (b_is_connected)
     {
-        Log_Debug("Opening PROJECT_BUTTON_1 as input.\n");
-        g_fd_gpio_button1 = GPIO_OpenAsInput(PROJECT_BUTTON_1);
-        if (g_fd_gpio_button1 < 0) {
-            Log_Debug("ERROR: Could not open button GPIO: %s (%d).\n",
-                strerror(errno), errno);
-            result = -1;
-        }
+        startup_mark(STARTUP_MILESTONE_CONNECTED);
     }
+}
 
-    // Create timer for button press check
-    if (result != -1)
+static void
+message_delivery_handler(bool b_is_delivered)
+{
+    if (b_is_delivered && startup_mark(STARTUP_MILESTONE_FIRST_UPLOAD))
     {
-        struct timespec button_press_check_period = { 0, 1000000 };
-        g_fd_poll_timer_button = CreateTimerFdAndAddToEpoll(g_fd_epoll,
-            &button_press_check_period, &g_event_data_button, EPOLLIN);
-        if (g_fd_poll_timer_button < 0)
-        {
-            Log_Debug("ERROR: Could not create button poll timer: %s (%d).\n",
-                strerror(errno), errno);
-            result = -1;
+        startup_report();
+    }
+}
+#endif
+
+static void
+startup_done_handler(bool b_is_ok)
+{
+    if (!b_is_ok)
+    {
+        gb_is_termination_requested = true;
+        return;
+    }
+
+    Log_Debug("Start up steps done.\n");
+}
+
+static void
+startup_report(void)
+{
+    startup_log();
+
+#   if (defined(IOT_CENTRAL_APPLICATION) || defined(IOT_HUB_APPLICATION))
+    // Milestones only, steps do not fit into a reported property
+    char startup_json[JSON_BUFFER_SIZE];
+    if ((startup_to_json(startup_json, sizeof(startup_json), false) < 0) ||
+        !AzureIoT_TwinReportProperty("startup", startup_json))
+    {
+        Log_Debug("ERROR: Start up milestones not reported.\n");
+    }
+#   endif
+}
+
+static int
+i2c_open(I2C_InterfaceId isu_id)
+{
+    int fd_i2c = I2CMaster_Open(isu_id);
+    if (fd_i2c < 0) {
+        Log_Debug("ERROR: I2CMaster_Open: errno=%d (%s)\n", 
+            errno, strerror(errno));
+        return -1;
+    }
+
+    int result = I2CMaster_SetBusSpeed(fd_i2c, I2C_BUS_SPEED_STANDARD);
+    if (result != 0) {
+        Log_Debug("ERROR: I2CMaster_SetBusSpeed: errno=%d (%s)\n", 
+            errno, strerror(errno));
+    }
+    else 
+    {
+        result = I2CMaster_SetTimeout(fd_i2c, I2C_TIMEOUT_MS);
+        if (result != 0) {
+            Log_Debug("ERROR: I2CMaster_SetTimeout: errno=%d (%s)\n", 
+                errno, strerror(errno));
         }
     }
 
-    // Create timer for CCS811 interrupt signal check
-    if (result != -1)
+    if (result != 0)
+    {
+        close(fd_i2c);
+        fd_i2c = -1;
+    }
+
+    return fd_i2c;
+}
+
+static bool
+i2c_bus_recovery_handler(void)
+{
+    if (g_fd_i2c < 0)
+    {
+        return false;
+    }
+
+    // Closing the I2C master resets its controller
+    int fd_kept = g_fd_i2c;
+    close(g_fd_i2c);
+    g_fd_i2c = -1;
+
+    // Sensor drivers and the display keep the descriptor number. Without
+    // the I2C master the number may be reused by any other descriptor, the
+    // application cannot go on.
+    int fd_i2c = i2c_open(I2C_ISU);
+    if ((fd_i2c >= 0) && (fd_i2c != fd_kept))
     {
-        struct timespec ccs811_int_check_period = { 0, 250000000 };
-        g_fd_poll_timer_ccs811_int = CreateTimerFdAndAddToEpoll(g_fd_epoll,
-            &ccs811_int_check_period, &g_event_data_ccs811_int, EPOLLIN);
-        if (g_fd_poll_timer_ccs811_int < 0)
+        if (dup2(fd_i2c, fd_kept) < 0)
         {
-            Log_Debug("ERROR: Could not create interrupt poll timer: %s (%d).\n",
+            Log_Debug("ERROR: Could not restore I2C descriptor: %s (%d).\n",
                 strerror(errno), errno);
-            result = -1;
+            close(fd_i2c);
+            fd_i2c = -1;
+        }
+        else
+        {
+            close(fd_i2c);
+            fd_i2c = fd_kept;
         }
     }
+    if (fd_i2c < 0)
+    {
+        Log_Debug("ERROR: I2C master lost in bus recovery, exiting.\n");
+        gb_is_termination_requested = true;
+        return false;
+    }
+    g_fd_i2c = fd_i2c;
 
-    return result;
+    return i2c_bus_recover(g_fd_i2c, g_oled_addr);
 }
 
 static void
 close_peripherals_and_handlers(void)
 {
-    // Close CCS811 sensor
-    Log_Debug("Close CCS811\n");
-    if (gp_ccs)
-    {
-        ccs811_close(gp_ccs);
-    }
+    // Reverse order of the start up steps, then of init_handlers()
 
-    // Close HDC1000 sensor
-    Log_Debug("Close HDC1000\n");
-    if (gp_hdc)
-    {
-        hdc1000_close(gp_hdc);
-    }
+    // Close start up timer, if steps are still running
+    startup_close();
+
+#   if (defined(IOT_CENTRAL_APPLICATION) || defined(IOT_HUB_APPLICATION))
+    // Destroy IoT Hub client, messages not yet delivered are dropped
+    AzureIoT_DestroyClient();
+#   endif
+
+    // Close button poll timer and button1 GPIO fd
+    CloseFdAndPrintError(g_fd_poll_timer_button, "Button poll timer");
+    CloseFdAndPrintError(g_fd_gpio_button1, "Button1 GPIO");
+
+    // Close sensors and sampling timer
+    sensor_registry_close();
+
+    // Switch alert LED off
+    rgb_led_close();
+
+    // Close display timer
+    display_manager_close();
 
     // Close I2C
     CloseFdAndPrintError(g_fd_i2c, "I2C");
 
-    // Close CCS811 interrupt GPIO fd
-    CloseFdAndPrintError(g_fd_gpio_ccs811_int, "CSS811 INT GPIO");
-
-    // Close button1 GPIO fd
-    CloseFdAndPrintError(g_fd_gpio_button1, "Button1 GPIO");
+    // Close statistics and upload timer fds
+    CloseFdAndPrintError(g_fd_timer_loop_stats, "Statistics timer");
+    CloseFdAndPrintError(g_fd_poll_timer_upload, "Upload poll timer");
 
     // Close Epoll fd
     CloseFdAndPrintError(g_fd_epoll, "Epoll");
+
+    // Close crash log, a crash during shutdown is not recorded
+    log_ring_set_crash_file(-1, 0, 0);
+    CloseFdAndPrintError(g_fd_crash_log, "Mutable storage");
+    free(gp_crash_entries);
 }
 
 /* [] END OF FILE */
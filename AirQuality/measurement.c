@@ -0,0 +1,77 @@
+/***************************************************************************//**
+* @file    measurement.c
+* @version 1.0.0
+*
+* @brief Fixed point environmental measurements.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "measurement.h"
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+int16_t
+measurement_temperature_from_hdc1000(uint16_t raw)
+{
+    // 16500 * 65535 fits in 31 bits
+    return (int16_t)((int32_t)(((uint32_t)raw * 16500u + 32768u) >> 16) - 4000);
+}
+
+uint16_t
+measurement_humidity_from_hdc1000(uint16_t raw)
+{
+    return (uint16_t)(((uint32_t)raw * 10000u + 32768u) >> 16);
+}
+
+int
+measurement_format(int32_t centi, unsigned decimals, char *p_buffer,
+    size_t buffer_size)
+{
+    static const int32_t divisors[] = { 100, 10, 1 };
+    int written;
+
+    if (decimals > 2)
+    {
+        decimals = 2;
+    }
+
+    // Round to requested precision, half away from zero
+    int32_t divisor = divisors[decimals];
+    uint32_t magnitude = (uint32_t)labs((long)centi);
+    magnitude = (magnitude + (uint32_t)divisor / 2) / (uint32_t)divisor;
+
+    // Sign only if something non zero remains after rounding
+    const char *p_sign = ((centi < 0) && (magnitude > 0)) ? "-" : "";
+
+    if (decimals == 0)
+    {
+        written = snprintf(p_buffer, buffer_size, "%s%lu", p_sign,
+            (unsigned long)magnitude);
+    }
+    else
+    {
+        uint32_t scale = (decimals == 1) ? 10u : 100u;
+        written = snprintf(p_buffer, buffer_size, "%s%lu.%0*lu", p_sign,
+            (unsigned long)(magnitude / scale), (int)decimals,
+            (unsigned long)(magnitude % scale));
+    }
+
+    return ((written < 0) || ((size_t)written >= buffer_size)) ? -1 : written;
+}
+
+float
+measurement_to_float(int32_t centi)
+{
+    return (float)centi / 100.0f;
+}
+
+/* [] END OF FILE */
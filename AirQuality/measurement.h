@@ -0,0 +1,99 @@
+/***************************************************************************//**
+* @file    measurement.h
+* @version 1.0.0
+*
+* @brief Fixed point environmental measurements.
+*
+* Temperature and relative humidity are carried as integers in hundredths of
+* degree Celsius and hundredths of percent RH from the raw HDC1000 readings
+* to the display, log and telemetry text, so that no floating point math or
+* float formatting runs per sample. Float values are available as a view for
+* APIs which require them.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef MEASUREMENT_H
+#define MEASUREMENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+// Buffer size sufficient for any value formatted by measurement_format()
+#define MEASUREMENT_TEXT_SIZE       (12)
+
+/*******************************************************************************
+*   Data types
+*******************************************************************************/
+
+typedef struct
+{
+    int16_t temperature;        // Temperature [0.01 degC]
+    uint16_t humidity;          // Relative humidity [0.01 %RH]
+} measurement_env_t;
+
+/*******************************************************************************
+*   Function declarations
+*******************************************************************************/
+
+/**
+ * @brief Convert raw HDC1000 temperature register value.
+ *
+ * T = raw / 2^16 * 165 - 40 degC, rounded to nearest 0.01 degC.
+ *
+ * @return Temperature [0.01 degC], -4000 to 12500.
+ */
+int16_t
+measurement_temperature_from_hdc1000(uint16_t raw);
+
+/**
+ * @brief Convert raw HDC1000 humidity register value.
+ *
+ * RH = raw / 2^16 * 100 %, rounded to nearest 0.01 %RH.
+ *
+ * @return Relative humidity [0.01 %RH], 0 to 10000.
+ */
+uint16_t
+measurement_humidity_from_hdc1000(uint16_t raw);
+
+/**
+ * @brief Format fixed point value in hundredths as decimal text.
+ *
+ * Value is rounded half away from zero to the given number of decimals,
+ * e.g. 2345 with 1 decimal gives "23.5".
+ *
+ * @param centi Value in hundredths.
+ * @param decimals Number of decimals, 0 to 2.
+ * @param p_buffer Output buffer.
+ * @param buffer_size Output buffer size.
+ *
+ * @return Length of text written, -1 if it does not fit.
+ */
+int
+measurement_format(int32_t centi, unsigned decimals, char *p_buffer,
+    size_t buffer_size);
+
+/**
+ * @brief Float view of fixed point value in hundredths.
+ */
+float
+measurement_to_float(int32_t centi);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // MEASUREMENT_H
+
+/* [] END OF FILE */
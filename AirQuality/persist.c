@@ -0,0 +1,151 @@
+/***************************************************************************//**
+* @file    persist.c
+* @version 1.0.0
+*
+* @brief Small records in the application mutable storage.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "applibs_versions.h"
+#include <applibs/log.h>
+#include <applibs/storage.h>
+
+#include "persist.h"
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+
+#define PERSIST_MAGIC       (0x41515031u)   // "AQP1"
+
+/*******************************************************************************
+* Data types
+*******************************************************************************/
+
+typedef struct
+{
+    uint32_t magic;
+    uint16_t size;
+    uint16_t crc;               // CRC-16/CCITT of the record data
+} persist_header_t;
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+static uint16_t
+crc16(const uint8_t *p_data, size_t size);
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+bool
+persist_load(persist_region_t region, void *p_data, size_t size)
+{
+    uint8_t buffer[PERSIST_REGION_SIZE];
+    persist_header_t header;
+
+    if ((region >= PERSIST_REGION_COUNT) ||
+        (size > sizeof(buffer) - sizeof(header)))
+    {
+        return false;
+    }
+
+    int fd = Storage_OpenMutableFile();
+    if (fd < 0)
+    {
+        Log_Debug("ERROR: Could not open mutable storage: %s (%d).\n",
+            strerror(errno), errno);
+        return false;
+    }
+
+    ssize_t length = pread(fd, buffer, sizeof(header) + size,
+        (off_t)region * PERSIST_REGION_SIZE);
+    close(fd);
+
+    if (length != (ssize_t)(sizeof(header) + size))
+    {
+        return false;
+    }
+
+    memcpy(&header, buffer, sizeof(header));
+    if ((header.magic != PERSIST_MAGIC) || (header.size != size) ||
+        (header.crc != crc16(buffer + sizeof(header), size)))
+    {
+        return false;
+    }
+
+    memcpy(p_data, buffer + sizeof(header), size);
+    return true;
+}
+
+bool
+persist_store(persist_region_t region, const void *p_data, size_t size)
+{
+    uint8_t buffer[PERSIST_REGION_SIZE];
+    persist_header_t header;
+
+    if ((region >= PERSIST_REGION_COUNT) ||
+        (size > sizeof(buffer) - sizeof(header)))
+    {
+        return false;
+    }
+
+    header.magic = PERSIST_MAGIC;
+    header.size = (uint16_t)size;
+    header.crc = crc16(p_data, size);
+    memcpy(buffer, &header, sizeof(header));
+    memcpy(buffer + sizeof(header), p_data, size);
+
+    int fd = Storage_OpenMutableFile();
+    if (fd < 0)
+    {
+        Log_Debug("ERROR: Could not open mutable storage: %s (%d).\n",
+            strerror(errno), errno);
+        return false;
+    }
+
+    ssize_t length = pwrite(fd, buffer, sizeof(header) + size,
+        (off_t)region * PERSIST_REGION_SIZE);
+    if (length != (ssize_t)(sizeof(header) + size))
+    {
+        Log_Debug("ERROR: Could not write mutable storage: %s (%d).\n",
+            strerror(errno), errno);
+    }
+    close(fd);
+
+    return length == (ssize_t)(sizeof(header) + size);
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+static uint16_t
+crc16(const uint8_t *p_data, size_t size)
+{
+    uint16_t crc = 0xFFFF;
+
+    for (size_t idx = 0; idx < size; idx++)
+    {
+        crc ^= (uint16_t)(p_data[idx] << 8);
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) :
+                (uint16_t)(crc << 1);
+        }
+    }
+
+    return crc;
+}
+
+/* [] END OF FILE */
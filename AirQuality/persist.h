@@ -0,0 +1,85 @@
+/***************************************************************************//**
+* @file    persist.h
+* @version 1.0.0
+*
+* @brief Small records in the application mutable storage.
+*
+* The mutable storage file is split into fixed size regions, one record per
+* region. A record carries a magic, its size and a CRC, so that a missing,
+* partially written or outdated record is rejected on load.
+*
+* Requires "MutableStorage" in app_manifest.json, sized to hold
+* PERSIST_REGION_COUNT regions and the crash log area.
+*
+* The second half of the file is kept for the log ring crash dump
+* (log_ring.h), written from a fatal signal handler through a descriptor
+* opened at start up.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef PERSIST_H
+#define PERSIST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+#define PERSIST_REGION_SIZE     (64)    // Header included
+
+// Log ring crash dump area
+#define PERSIST_CRASH_LOG_OFFSET    (4096)
+#define PERSIST_CRASH_LOG_SIZE      (4096)
+
+/*******************************************************************************
+*   Data types
+*******************************************************************************/
+
+typedef enum
+{
+    PERSIST_REGION_CCS811_BASELINE,
+    PERSIST_REGION_COUNT
+} persist_region_t;
+
+/*******************************************************************************
+*   Function declarations
+*******************************************************************************/
+
+/**
+ * @brief Load record of region.
+ *
+ * @param region Region.
+ * @param p_data Record output.
+ * @param size Record size, must match the stored record.
+ *
+ * @return false if there is no valid record of this size.
+ */
+bool
+persist_load(persist_region_t region, void *p_data, size_t size);
+
+/**
+ * @brief Store record in region.
+ *
+ * @return false if the record does not fit or could not be written.
+ */
+bool
+persist_store(persist_region_t region, const void *p_data, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // PERSIST_H
+
+/* [] END OF FILE */
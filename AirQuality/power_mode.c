@@ -0,0 +1,107 @@
+/***************************************************************************//**
+* @file    power_mode.c
+* @version 1.0.0
+*
+* @brief Operating mode profiles and energy estimate.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <string.h>
+
+#include "power_mode.h"
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+
+#define MS_PER_HOUR             (60.0 * 60.0 * 1000.0)
+#define UC_PER_MAH              (3.6e6)
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+static const power_profile_t g_profiles[POWER_MODE_COUNT] = {
+    [POWER_MODE_NORMAL] = {
+        .name = "normal",
+        .button_poll_ms = 1,
+        .sample_period_ms = 0,
+        .b_ccs811_slow = false,
+        .upload_period_min_sec = 0,
+        .upload_batch = 0,
+        .window_max_ms = 0,
+        .stats_period_sec = 10 * 60,
+        .display_dim_ms = 0,
+        .display_off_ms = 0
+    },
+    // Button press still registers within 100 ms, one window per
+    // 30 minutes at the 5 minute upload period
+    [POWER_MODE_LOW] = {
+        .name = "low",
+        .button_poll_ms = 100,
+        .sample_period_ms = 60 * 1000,
+        .b_ccs811_slow = true,
+        .upload_period_min_sec = 5 * 60,
+        .upload_batch = 6,
+        .window_max_ms = 60 * 1000,
+        .stats_period_sec = 60 * 60,
+        .display_dim_ms = 10 * 1000,
+        .display_off_ms = 30 * 1000
+    }
+};
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+const power_profile_t *
+power_mode_get_profile(power_mode_t mode)
+{
+    return ((unsigned)mode < POWER_MODE_COUNT) ? &g_profiles[mode] :
+        &g_profiles[POWER_MODE_NORMAL];
+}
+
+bool
+power_mode_from_name(const char *p_name, power_mode_t *p_mode)
+{
+    for (int mode = 0; mode < POWER_MODE_COUNT; mode++)
+    {
+        if (strcmp(p_name, g_profiles[mode].name) == 0)
+        {
+            *p_mode = (power_mode_t)mode;
+            return true;
+        }
+    }
+    return false;
+}
+
+double
+power_estimate_mah_per_day(const power_model_t *p_model,
+    const power_usage_t *p_usage)
+{
+    if (p_usage->period_ms == 0)
+    {
+        return 0.0;
+    }
+
+    double ccs811_ma = (p_usage->ccs811_period_ms == 0) ? 0.0 :
+        (p_usage->ccs811_period_ms <= 1000) ? p_model->ccs811_1s_ma :
+        (p_usage->ccs811_period_ms <= 10000) ? p_model->ccs811_10s_ma :
+        p_model->ccs811_60s_ma;
+
+    double mah = (p_model->base_ma + ccs811_ma) *
+        (double)p_usage->period_ms / MS_PER_HOUR;
+    mah += p_model->radio_ma * (double)p_usage->radio_on_ms / MS_PER_HOUR;
+    mah += p_model->display_ma * (double)p_usage->display_on_ms / MS_PER_HOUR;
+    mah += (p_model->wakeup_uc * (double)p_usage->wakeups +
+        p_model->bus_byte_uc * (double)p_usage->bus_bytes +
+        p_model->sample_uc * (double)p_usage->samples) / UC_PER_MAH;
+
+    return mah * 24.0 * MS_PER_HOUR / (double)p_usage->period_ms;
+}
+
+/* [] END OF FILE */
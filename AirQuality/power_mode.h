@@ -0,0 +1,138 @@
+/***************************************************************************//**
+* @file    power_mode.h
+* @version 1.0.0
+*
+* @brief Operating mode profiles and energy estimate.
+*
+* A profile sets the cadence of every timer of the application and the
+* power states of the peripherals. The normal profile polls the button
+* every millisecond and keeps the IoT Hub connection open. The low power
+* profile stretches every timer to its slowest acceptable cadence, runs the
+* CCS811 in its 60 s mode, switches the display off soon after the last
+* button press and collects samples to upload them together in a short
+* connection window.
+*
+* The energy estimate converts counted activity into mAh per day with a
+* simple charge model. It is shared by the application and the host side
+* energy model tool, the coefficients are rough figures to be calibrated
+* with a current meter.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef POWER_MODE_H
+#define POWER_MODE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+// Energy model coefficients, currents above the sleeping board [mA] and
+// charge per event [uC]
+#define POWER_MODEL_DEFAULT {                                               \
+    .base_ma = 8.0,             /* MT3620 waiting in epoll */               \
+    .radio_ma = 40.0,           /* IoT Hub connection open */               \
+    .display_ma = 10.0,         /* SSD1306 panel on */                      \
+    .ccs811_1s_ma = 7.9,        /* CCS811 drive modes */                    \
+    .ccs811_10s_ma = 1.2,                                                   \
+    .ccs811_60s_ma = 0.4,                                                   \
+    .wakeup_uc = 15.0,          /* Event loop wakeup, about 1 ms */         \
+    .bus_byte_uc = 0.5,         /* I2C byte, 90 us at 100 kHz */            \
+    .sample_uc = 5.0            /* Sensor conversion and its transfers */   \
+}
+
+/*******************************************************************************
+*   Data types
+*******************************************************************************/
+
+typedef enum
+{
+    POWER_MODE_NORMAL,
+    POWER_MODE_LOW,
+    POWER_MODE_COUNT
+} power_mode_t;
+
+typedef struct
+{
+    const char *name;               // Device Twin value
+    uint32_t button_poll_ms;        // Button 1 GPIO poll interval
+    uint32_t sample_period_ms;      // Sensor sampling, 0 = CCS811 period
+    bool b_ccs811_slow;             // CCS811 in 60 s mode, else configured
+    uint32_t upload_period_min_sec; // Lower bound of the upload period
+    uint32_t upload_batch;          // Samples per connection window, 0 =
+                                    // connection kept open
+    uint32_t window_max_ms;         // Longest connection window
+    uint32_t stats_period_sec;      // Statistics record period
+    uint32_t display_dim_ms;        // Display inactivity timeouts, 0 =
+    uint32_t display_off_ms;        // display_manager.h defaults
+} power_profile_t;
+
+typedef struct
+{
+    double base_ma;
+    double radio_ma;
+    double display_ma;
+    double ccs811_1s_ma;
+    double ccs811_10s_ma;
+    double ccs811_60s_ma;
+    double wakeup_uc;
+    double bus_byte_uc;
+    double sample_uc;
+} power_model_t;
+
+// Activity counted over a period
+typedef struct
+{
+    uint64_t period_ms;
+    uint64_t wakeups;           // Event loop wakeups
+    uint64_t samples;           // Sensor measurements
+    uint64_t bus_bytes;         // I2C bytes of the display and sensors
+    uint64_t radio_on_ms;       // IoT Hub connection open
+    uint64_t display_on_ms;     // Display panel on
+    uint32_t ccs811_period_ms;  // CCS811 drive mode period, 0 = idle
+} power_usage_t;
+
+/*******************************************************************************
+*   Function declarations
+*******************************************************************************/
+
+/**
+ * @brief Get profile of operating mode.
+ */
+const power_profile_t *
+power_mode_get_profile(power_mode_t mode);
+
+/**
+ * @brief Find operating mode by its Device Twin name.
+ *
+ * @return false if the name is unknown.
+ */
+bool
+power_mode_from_name(const char *p_name, power_mode_t *p_mode);
+
+/**
+ * @brief Estimate charge per day of the activity counted in usage.
+ *
+ * @return Estimate [mAh/day], 0 for an empty period.
+ */
+double
+power_estimate_mah_per_day(const power_model_t *p_model,
+    const power_usage_t *p_usage);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // POWER_MODE_H
+
+/* [] END OF FILE */
@@ -0,0 +1,274 @@
+/***************************************************************************//**
+* @file    render_cache.c
+* @version 1.0.0
+*
+* @brief Pre-rendered text for the OLED frame buffer.
+*
+* The full buffer is organized in pages of 8 pixel rows, one byte per pixel
+* column with the top row in bit 0. With U8G2_R0 a bitmap row is a bit in
+* consecutive bytes of a page. With U8G2_R1 (rotated 90 degrees clockwise)
+* it is a physical pixel column, which holds all 64 pixels of the row in
+* one byte per page, so a row is OR-ed in with a shift and a few bytes.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <string.h>
+
+#include "render_cache.h"
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+static bool
+is_supported(u8g2_t *p_u8g2);
+
+static uint64_t
+row_get(u8g2_t *p_u8g2, uint16_t y, uint16_t width);
+
+static void
+row_or(u8g2_t *p_u8g2, uint16_t x, int32_t y, uint64_t bits);
+
+static void
+bitmap_draw(u8g2_t *p_u8g2, const render_bitmap_t *p_bitmap, uint16_t x,
+    uint16_t y);
+
+static void
+draw_centered_str(u8g2_t *p_u8g2, const uint8_t *p_font, uint16_t y,
+    const char *p_text);
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+bool
+render_bitmap_init(render_bitmap_t *p_bitmap, u8g2_t *p_u8g2,
+    const uint8_t *p_font, const char *p_text)
+{
+    memset(p_bitmap, 0, sizeof(*p_bitmap));
+    p_bitmap->p_font = p_font;
+    p_bitmap->p_text = p_text;
+
+    u8g2_SetFont(p_u8g2, p_font);
+
+    // Glyphs span max_char_height rows, y_offset of them below the baseline
+    int32_t height = u8g2_GetMaxCharHeight(p_u8g2);
+    int32_t ascent = height + p_u8g2->font_info.y_offset;
+
+    if (is_supported(p_u8g2) && (height <= RENDER_BITMAP_MAX_HEIGHT) &&
+        (ascent >= 0))
+    {
+        u8g2_ClearBuffer(p_u8g2);
+        uint16_t width = u8g2_DrawStr(p_u8g2, 0, (uint16_t)ascent, p_text);
+
+        if (width <= RENDER_BITMAP_MAX_WIDTH)
+        {
+            for (int32_t row = 0; row < height; row++)
+            {
+                p_bitmap->rows[row] = row_get(p_u8g2, (uint16_t)row, width);
+            }
+            p_bitmap->width = (uint8_t)width;
+            p_bitmap->height = (uint8_t)height;
+            p_bitmap->ascent = (uint8_t)ascent;
+            p_bitmap->b_is_cached = true;
+        }
+        u8g2_ClearBuffer(p_u8g2);
+    }
+
+    return p_bitmap->b_is_cached;
+}
+
+void
+render_bitmap_draw_centered(u8g2_t *p_u8g2, const render_bitmap_t *p_bitmap,
+    uint16_t y)
+{
+    if (p_bitmap->b_is_cached && is_supported(p_u8g2))
+    {
+        uint16_t display_width = u8g2_GetDisplayWidth(p_u8g2);
+        uint16_t x = (p_bitmap->width < display_width) ?
+            (uint16_t)((display_width - p_bitmap->width) / 2) : 0;
+
+        bitmap_draw(p_u8g2, p_bitmap, x, y);
+    }
+    else
+    {
+        draw_centered_str(p_u8g2, p_bitmap->p_font, y, p_bitmap->p_text);
+    }
+}
+
+bool
+render_atlas_init(render_atlas_t *p_atlas, u8g2_t *p_u8g2,
+    const uint8_t *p_font)
+{
+    static const char texts[RENDER_ATLAS_SIZE][2] = {
+        "-", ".", "/", "0", "1", "2", "3", "4", "5", "6", "7", "8", "9"
+    };
+    bool b_is_cached = true;
+
+    // Characters missing from the font are cached with zero width
+    for (size_t idx = 0; idx < RENDER_ATLAS_SIZE; idx++)
+    {
+        b_is_cached &= render_bitmap_init(&p_atlas->chars[idx], p_u8g2,
+            p_font, texts[idx]);
+    }
+
+    return b_is_cached;
+}
+
+void
+render_atlas_draw_centered(u8g2_t *p_u8g2, const render_atlas_t *p_atlas,
+    uint16_t y, const char *p_text)
+{
+    const render_bitmap_t *p_chars = p_atlas->chars - RENDER_ATLAS_FIRST;
+    uint16_t width = 0;
+
+    for (const char *p_char = p_text; *p_char != '\0'; p_char++)
+    {
+        if ((*p_char >= RENDER_ATLAS_FIRST) && (*p_char <= RENDER_ATLAS_LAST))
+        {
+            if (!p_chars[(int)*p_char].b_is_cached || !is_supported(p_u8g2))
+            {
+                draw_centered_str(p_u8g2, p_atlas->chars[0].p_font, y,
+                    p_text);
+                return;
+            }
+            width = (uint16_t)(width + p_chars[(int)*p_char].width);
+        }
+    }
+
+    uint16_t display_width = u8g2_GetDisplayWidth(p_u8g2);
+    uint16_t x = (width < display_width) ?
+        (uint16_t)((display_width - width) / 2) : 0;
+
+    for (const char *p_char = p_text; *p_char != '\0'; p_char++)
+    {
+        if ((*p_char >= RENDER_ATLAS_FIRST) && (*p_char <= RENDER_ATLAS_LAST))
+        {
+            bitmap_draw(p_u8g2, &p_chars[(int)*p_char], x, y);
+            x = (uint16_t)(x + p_chars[(int)*p_char].width);
+        }
+    }
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+/**
+ * @brief Check if bitmaps can be blitted, with U8G2_R1 the display height
+ *        must fit a bitmap row.
+ */
+static bool
+is_supported(u8g2_t *p_u8g2)
+{
+    return (p_u8g2->cb == U8G2_R0) || ((p_u8g2->cb == U8G2_R1) &&
+        (u8g2_GetBufferTileHeight(p_u8g2) * 8u <= RENDER_BITMAP_MAX_WIDTH));
+}
+
+/**
+ * @brief Read leftmost width pixels of row y from the frame buffer.
+ */
+static uint64_t
+row_get(u8g2_t *p_u8g2, uint16_t y, uint16_t width)
+{
+    const uint8_t *p_buffer = u8g2_GetBufferPtr(p_u8g2);
+    uint16_t buffer_width = (uint16_t)(u8g2_GetBufferTileWidth(p_u8g2) * 8u);
+    uint16_t pages = u8g2_GetBufferTileHeight(p_u8g2);
+    uint64_t bits = 0;
+
+    if (p_u8g2->cb == U8G2_R1)
+    {
+        // Physical column of the row, top page in the lowest byte
+        for (uint16_t page = 0; (page < pages) && (y < buffer_width); page++)
+        {
+            bits |= (uint64_t)p_buffer[page * buffer_width +
+                (buffer_width - 1u - y)] << (8u * page);
+        }
+    }
+    else if (y / 8u < pages)
+    {
+        const uint8_t *p_page = &p_buffer[(y / 8u) * buffer_width];
+        for (uint16_t x = 0; (x < width) && (x < buffer_width); x++)
+        {
+            bits |= (uint64_t)((p_page[x] >> (y % 8u)) & 1u) << x;
+        }
+    }
+
+    return (width < 64u) ? (bits & ((1ull << width) - 1u)) : bits;
+}
+
+/**
+ * @brief OR bits into row y of the frame buffer from pixel x on, pixels
+ *        outside the display are clipped.
+ */
+static void
+row_or(u8g2_t *p_u8g2, uint16_t x, int32_t y, uint64_t bits)
+{
+    uint8_t *p_buffer = u8g2_GetBufferPtr(p_u8g2);
+    uint16_t buffer_width = (uint16_t)(u8g2_GetBufferTileWidth(p_u8g2) * 8u);
+    uint16_t pages = u8g2_GetBufferTileHeight(p_u8g2);
+
+    if (p_u8g2->cb == U8G2_R1)
+    {
+        if ((y >= 0) && (y < buffer_width) && (x < 64u))
+        {
+            uint64_t column = bits << x;
+            uint8_t *p_column = &p_buffer[buffer_width - 1u - (uint32_t)y];
+            for (uint16_t page = 0; page < pages; page++)
+            {
+                p_column[page * buffer_width] |= (uint8_t)(column >>
+                    (8u * page));
+            }
+        }
+    }
+    else if ((y >= 0) && ((uint32_t)y / 8u < pages))
+    {
+        uint8_t *p_page = &p_buffer[((uint32_t)y / 8u) * buffer_width];
+        uint8_t mask = (uint8_t)(1u << ((uint32_t)y % 8u));
+        for (uint16_t pos = x; (bits != 0) && (pos < buffer_width); pos++)
+        {
+            if (bits & 1u)
+            {
+                p_page[pos] |= mask;
+            }
+            bits >>= 1;
+        }
+    }
+}
+
+static void
+bitmap_draw(u8g2_t *p_u8g2, const render_bitmap_t *p_bitmap, uint16_t x,
+    uint16_t y)
+{
+    int32_t top = (int32_t)y - p_bitmap->ascent;
+
+    for (uint16_t row = 0; row < p_bitmap->height; row++)
+    {
+        if (p_bitmap->rows[row] != 0)
+        {
+            row_or(p_u8g2, x, top + row, p_bitmap->rows[row]);
+        }
+    }
+}
+
+/**
+ * @brief Draw text with u8g2, as lib_u8g2_DrawCenteredStr().
+ */
+static void
+draw_centered_str(u8g2_t *p_u8g2, const uint8_t *p_font, uint16_t y,
+    const char *p_text)
+{
+    u8g2_SetFont(p_u8g2, p_font);
+
+    uint16_t display_width = u8g2_GetDisplayWidth(p_u8g2);
+    uint16_t width = u8g2_GetStrWidth(p_u8g2, p_text);
+
+    u8g2_DrawStr(p_u8g2, (width < display_width) ?
+        (uint16_t)((display_width - width) / 2) : 0, y, p_text);
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,115 @@
+/***************************************************************************//**
+* @file    render_cache.h
+* @version 1.0.0
+*
+* @brief Pre-rendered text for the OLED frame buffer.
+*
+* u8g2 decodes the run length encoded glyphs of a font each time a string
+* is drawn, and measures the string by decoding the glyph headers again for
+* centering. Static labels are rasterized once into a bitmap, and numbers
+* are composed from an atlas of pre-rendered characters with their advance
+* widths, so drawing is reduced to OR-ing bitmap rows into the frame buffer.
+*
+* Bitmaps are blitted directly into the full buffer for display rotations
+* U8G2_R0 and U8G2_R1. With other rotations, or text too large for a
+* bitmap, the text is drawn with u8g2 as before.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef RENDER_CACHE_H
+#define RENDER_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "u8g2.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+#define RENDER_BITMAP_MAX_WIDTH     (64)    // Bits of a bitmap row
+#define RENDER_BITMAP_MAX_HEIGHT    (24)
+
+// Characters of the atlas, numbers with sign and decimal point
+#define RENDER_ATLAS_FIRST          '-'
+#define RENDER_ATLAS_LAST           '9'
+#define RENDER_ATLAS_SIZE           (RENDER_ATLAS_LAST - RENDER_ATLAS_FIRST + 1)
+
+/*******************************************************************************
+*   Data types
+*******************************************************************************/
+
+typedef struct
+{
+    uint64_t rows[RENDER_BITMAP_MAX_HEIGHT];    // Bit x is pixel x of the row
+    uint8_t width;                              // Advance width
+    uint8_t height;
+    uint8_t ascent;                             // Rows above the baseline
+    bool b_is_cached;                           // Otherwise drawn with u8g2
+    const uint8_t *p_font;
+    const char *p_text;
+} render_bitmap_t;
+
+typedef struct
+{
+    render_bitmap_t chars[RENDER_ATLAS_SIZE];
+} render_atlas_t;
+
+/*******************************************************************************
+*   Function declarations
+*******************************************************************************/
+
+/**
+ * @brief Rasterize text in font into bitmap.
+ *
+ * Uses the frame buffer as scratch area, it is cleared on return. The text
+ * is not copied and must stay valid.
+ *
+ * @return false if the bitmap will be drawn with u8g2.
+ */
+bool
+render_bitmap_init(render_bitmap_t *p_bitmap, u8g2_t *p_u8g2,
+    const uint8_t *p_font, const char *p_text);
+
+/**
+ * @brief Draw bitmap horizontally centered, baseline at row y.
+ */
+void
+render_bitmap_draw_centered(u8g2_t *p_u8g2, const render_bitmap_t *p_bitmap,
+    uint16_t y);
+
+/**
+ * @brief Rasterize atlas characters of font.
+ *
+ * Uses the frame buffer as scratch area, it is cleared on return.
+ *
+ * @return false if any character will be drawn with u8g2.
+ */
+bool
+render_atlas_init(render_atlas_t *p_atlas, u8g2_t *p_u8g2,
+    const uint8_t *p_font);
+
+/**
+ * @brief Draw text of atlas characters horizontally centered, baseline at
+ *        row y. Other characters are skipped.
+ */
+void
+render_atlas_draw_centered(u8g2_t *p_u8g2, const render_atlas_t *p_atlas,
+    uint16_t y, const char *p_text);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // RENDER_CACHE_H
+
+/* [] END OF FILE */
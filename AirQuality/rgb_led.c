@@ -0,0 +1,88 @@
+/***************************************************************************//**
+* @file    rgb_led.c
+* @version 1.0.0
+*
+* @brief RGB LED of the MT3620 Starter Kit.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <errno.h>
+#include <string.h>
+
+#include <applibs/log.h>
+
+#include "epoll_timerfd_utilities.h"
+#include "rgb_led.h"
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+
+#define RGB_LED_CHANNELS    (3)
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+static int g_fd_channels[RGB_LED_CHANNELS] = { -1, -1, -1 };
+static rgb_led_color_t g_color = RGB_LED_OFF;
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+bool
+rgb_led_open(GPIO_Id red, GPIO_Id green, GPIO_Id blue)
+{
+    const GPIO_Id ids[RGB_LED_CHANNELS] = { red, green, blue };
+
+    for (size_t idx = 0; idx < RGB_LED_CHANNELS; idx++)
+    {
+        g_fd_channels[idx] = GPIO_OpenAsOutput(ids[idx],
+            GPIO_OutputMode_PushPull, GPIO_Value_High);
+        if (g_fd_channels[idx] < 0)
+        {
+            Log_Debug("ERROR: Could not open LED GPIO: %s (%d).\n",
+                strerror(errno), errno);
+            rgb_led_close();
+            return false;
+        }
+    }
+
+    g_color = RGB_LED_OFF;
+    return true;
+}
+
+void
+rgb_led_set(rgb_led_color_t color)
+{
+    for (size_t idx = 0; idx < RGB_LED_CHANNELS; idx++)
+    {
+        uint32_t bit = 1u << idx;
+        if (((color ^ g_color) & bit) && (g_fd_channels[idx] >= 0))
+        {
+            GPIO_SetValue(g_fd_channels[idx],
+                (color & bit) ? GPIO_Value_Low : GPIO_Value_High);
+        }
+    }
+
+    g_color = color;
+}
+
+void
+rgb_led_close(void)
+{
+    rgb_led_set(RGB_LED_OFF);
+
+    for (size_t idx = 0; idx < RGB_LED_CHANNELS; idx++)
+    {
+        CloseFdAndPrintError(g_fd_channels[idx], "LED GPIO");
+        g_fd_channels[idx] = -1;
+    }
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,74 @@
+/***************************************************************************//**
+* @file    rgb_led.h
+* @version 1.0.0
+*
+* @brief RGB LED of the MT3620 Starter Kit.
+*
+* The LED channels are active low, each channel is either on or off.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef RGB_LED_H
+#define RGB_LED_H
+
+#include <stdbool.h>
+
+#include "applibs_versions.h"
+#include <applibs/gpio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+*   Data types
+*******************************************************************************/
+
+// Channel bits: red 1, green 2, blue 4
+typedef enum
+{
+    RGB_LED_OFF = 0,
+    RGB_LED_RED = 1,
+    RGB_LED_GREEN = 2,
+    RGB_LED_YELLOW = 3,
+    RGB_LED_BLUE = 4,
+    RGB_LED_MAGENTA = 5,
+    RGB_LED_CYAN = 6,
+    RGB_LED_WHITE = 7
+} rgb_led_color_t;
+
+/*******************************************************************************
+*   Function declarations
+*******************************************************************************/
+
+/**
+ * @brief Open the LED channel GPIOs, LED off.
+ *
+ * @return true on success.
+ */
+bool
+rgb_led_open(GPIO_Id red, GPIO_Id green, GPIO_Id blue);
+
+/**
+ * @brief Set LED color, writes only changed channels.
+ */
+void
+rgb_led_set(rgb_led_color_t color);
+
+/**
+ * @brief Switch the LED off and close its GPIOs.
+ */
+void
+rgb_led_close(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // RGB_LED_H
+
+/* [] END OF FILE */
@@ -0,0 +1,79 @@
+/***************************************************************************//**
+* @file    scratch_buffer.c
+* @version 1.0.0
+*
+* @brief Reusable, size bounded buffer for zero terminated copies.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "scratch_buffer.h"
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+
+#define SCRATCH_BUFFER_MIN_SIZE     (256)
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+const char *
+scratch_buffer_terminate(scratch_buffer_t *p_scratch, const void *p_src,
+    size_t length)
+{
+    if (length >= p_scratch->max_size)
+    {
+        p_scratch->fail_count++;
+        return NULL;
+    }
+
+    if (length >= p_scratch->capacity)
+    {
+        // Double the size to keep the number of reallocations low
+        size_t capacity = (p_scratch->capacity > 0) ? p_scratch->capacity :
+            SCRATCH_BUFFER_MIN_SIZE;
+        while (capacity <= length)
+        {
+            capacity *= 2;
+        }
+        if (capacity > p_scratch->max_size)
+        {
+            capacity = p_scratch->max_size;
+        }
+
+        // Contents are replaced, no need for realloc() to copy them
+        char *p_data = malloc(capacity);
+        if (p_data == NULL)
+        {
+            p_scratch->fail_count++;
+            return NULL;
+        }
+        free(p_scratch->p_data);
+        p_scratch->p_data = p_data;
+        p_scratch->capacity = capacity;
+        p_scratch->grow_count++;
+    }
+
+    memcpy(p_scratch->p_data, p_src, length);
+    p_scratch->p_data[length] = '\0';
+
+    return p_scratch->p_data;
+}
+
+void
+scratch_buffer_release(scratch_buffer_t *p_scratch)
+{
+    free(p_scratch->p_data);
+    p_scratch->p_data = NULL;
+    p_scratch->capacity = 0;
+}
+
+/* [] END OF FILE */
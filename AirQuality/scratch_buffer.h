@@ -0,0 +1,81 @@
+/***************************************************************************//**
+* @file    scratch_buffer.h
+* @version 1.0.0
+*
+* @brief Reusable, size bounded buffer for zero terminated copies.
+*
+* Payloads handed over by the IoT Hub SDK are not zero terminated. Consumers
+* which need a C string get a copy in a buffer that is kept between calls and
+* grows on demand up to a fixed limit, instead of a malloc() and free() for
+* every payload. A failed allocation leaves the previous buffer in place and
+* is reported to the caller.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef SCRATCH_BUFFER_H
+#define SCRATCH_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+*   Macros
+*******************************************************************************/
+
+// Static initializer, max_size includes the terminating zero
+#define SCRATCH_BUFFER_INIT(max_size)   { NULL, 0, (max_size), 0, 0 }
+
+/*******************************************************************************
+*   Data types
+*******************************************************************************/
+
+typedef struct
+{
+    char *p_data;
+    size_t capacity;            // Allocated size
+    size_t max_size;            // Allocation limit
+    uint32_t grow_count;        // Successful allocations
+    uint32_t fail_count;        // Payloads too large or allocation failures
+} scratch_buffer_t;
+
+/*******************************************************************************
+*   Function declarations
+*******************************************************************************/
+
+/**
+ * @brief Copy data into the buffer and terminate it with zero.
+ *
+ * The returned string is valid until the next call or release.
+ *
+ * @param p_scratch Pointer to scratch buffer.
+ * @param p_src Data, may contain no terminating zero.
+ * @param length Length of data in bytes.
+ *
+ * @return Zero terminated copy, NULL if length reaches max_size or memory
+ *         could not be allocated.
+ */
+const char *
+scratch_buffer_terminate(scratch_buffer_t *p_scratch, const void *p_src,
+    size_t length);
+
+/**
+ * @brief Free the buffer, it is allocated again by the next copy.
+ */
+void
+scratch_buffer_release(scratch_buffer_t *p_scratch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SCRATCH_BUFFER_H
+
+/* [] END OF FILE */
@@ -0,0 +1,273 @@
+/***************************************************************************//**
+* @file    sensor_ccs811.c
+* @version 1.0.0
+*
+* @brief CCS811 air quality sensor driver.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include "applibs_versions.h"
+#ifndef I2C_STRUCTS_VERSION
+#define I2C_STRUCTS_VERSION 1
+#endif
+#include <applibs/log.h>
+#include <applibs/gpio.h>
+#include <applibs/i2c.h>
+
+#include <hw/project_hardware.h>
+
+#include "ccs811_baseline.h"
+#include "ccs811_regs.h"
+#include "epoll_timerfd_utilities.h"
+#include "event_loop_stats.h"
+#include "i2c_bus.h"
+#include "measurement.h"
+#include "sensor_ccs811.h"
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+static bool
+ccs811_probe(sensor_t *p_sensor);
+
+static int32_t
+ccs811_start(sensor_t *p_sensor, const sensor_reading_t *p_latest);
+
+static bool
+ccs811_ready(sensor_t *p_sensor);
+
+static bool
+ccs811_read(sensor_t *p_sensor, sensor_reading_t *p_reading);
+
+static void
+ccs811_close_sensor(sensor_t *p_sensor);
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+const sensor_driver_t sensor_ccs811_driver = {
+    .probe = &ccs811_probe,
+    .start = &ccs811_start,
+    .ready = &ccs811_ready,
+    .read = &ccs811_read,
+    .sleep = NULL,
+    .close = &ccs811_close_sensor,
+    .b_needs_wake = true,
+    .b_is_self_timed = true
+};
+
+static ccs811_t *gp_ccs = NULL;         // CCS811 sensor data pointer
+static int g_fd_gpio_int = -1;          // CCS811 interrupt pin GPIO
+static ccs811_mode_t g_mode = CCS811_MODE_1S;   // Set on every bind
+static bool gb_is_compensated = false;  // Environmental data of this period
+static uint64_t g_result_us = 0;        // Last result, 0 = none in this mode
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+bool
+sensor_ccs811_set_mode(ccs811_mode_t mode)
+{
+    g_mode = mode;
+    g_result_us = 0;
+    return (gp_ccs != NULL) && ccs811_set_mode(gp_ccs, mode);
+}
+
+uint32_t
+sensor_ccs811_get_period_ms(ccs811_mode_t mode)
+{
+    switch (mode)
+    {
+        case CCS811_MODE_250MS:
+            return 250;
+
+        case CCS811_MODE_1S:
+            return 1000;
+
+        case CCS811_MODE_10S:
+            return 10000;
+
+        case CCS811_MODE_60S:
+            return 60000;
+
+        default:
+            return 0;
+    }
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+static bool
+ccs811_probe(sensor_t *p_sensor)
+{
+    gp_ccs = ccs811_open(p_sensor->fd_i2c, p_sensor->i2c_addr,
+        SENSOR_CCS811_WAKE_GPIO);
+    if (gp_ccs == NULL)
+    {
+        return false;
+    }
+
+    // Another device may answer at the CCS811 address
+    const uint8_t reg = CCS811_REG_HW_ID;
+    uint8_t hw_id = 0;
+    if ((i2c_bus_write_then_read(p_sensor->fd_i2c, p_sensor->i2c_addr, &reg,
+            1, &hw_id, 1) != (1 + 1)) || (hw_id != CCS811_HW_ID_VALUE))
+    {
+        ccs811_close_sensor(p_sensor);
+        return false;
+    }
+
+    g_fd_gpio_int = GPIO_OpenAsInput(SENSOR_CCS811_INT_GPIO);
+    if (g_fd_gpio_int < 0)
+    {
+        Log_Debug("ERROR: Could not open CCS811 interrupt GPIO: %s (%d).\n",
+            strerror(errno), errno);
+        ccs811_close_sensor(p_sensor);
+        return false;
+    }
+
+    // Mode is lost when the sensor is powered off, e.g. unplugged
+    if (!ccs811_set_mode(gp_ccs, g_mode) ||
+        !ccs811_enable_interrupt(gp_ccs, true))
+    {
+        ccs811_close_sensor(p_sensor);
+        return false;
+    }
+
+    // So is the baseline, restore it to skip the warm-up drift
+    ccs811_baseline_restore(p_sensor->fd_i2c, p_sensor->i2c_addr,
+        loop_stats_now_us() / 1000, time(NULL));
+
+    g_result_us = 0;
+    return true;
+}
+
+static int32_t
+ccs811_start(sensor_t *p_sensor, const sensor_reading_t *p_latest)
+{
+    // Feed environmental data to CCS811, the library takes float values
+    gb_is_compensated = false;
+    if ((SENSOR_USABLE(p_latest->valid, p_latest->flags) &
+        SENSOR_QUANTITY_ENV) == SENSOR_QUANTITY_ENV)
+    {
+        gb_is_compensated = ccs811_set_environmental_data(gp_ccs,
+            measurement_to_float(p_latest->temperature),
+            measurement_to_float(p_latest->humidity));
+        if (gb_is_compensated)
+        {
+            // Register address and ENV_DATA written by lib_ccs811
+            i2c_bus_add_bytes(1 + CCS811_ENV_DATA_SIZE);
+        }
+        else
+        {
+            Log_Debug("ERROR: Could not write environmental data to CCS811.\n");
+        }
+    }
+
+    // Results are signalled on /INT once per drive mode period, the pin is
+    // watched from one poll before the next one is due
+    uint32_t period_ms = sensor_ccs811_get_period_ms(g_mode);
+    uint64_t now_us = loop_stats_now_us();
+    uint64_t due_us = g_result_us + (uint64_t)period_ms * 1000u;
+    uint64_t early_us = (uint64_t)p_sensor->p_desc->poll_ms * 1000u;
+
+    p_sensor->period_ms = period_ms;
+    if ((g_result_us == 0) || (period_ms == 0) || (due_us < now_us + early_us))
+    {
+        return 0;
+    }
+
+    return (int32_t)((due_us - early_us - now_us) / 1000u);
+}
+
+static bool
+ccs811_ready(sensor_t *p_sensor)
+{
+    GPIO_Value_Type state;
+
+    (void)p_sensor;
+
+    if (GPIO_GetValue(g_fd_gpio_int, &state) != 0)
+    {
+        Log_Debug("ERROR: Could not read CCS811 interrupt GPIO: %s (%d).\n",
+            strerror(errno), errno);
+        return false;
+    }
+
+    // /INT is asserted until the results are read
+    return (state == GPIO_Value_Low);
+}
+
+static bool
+ccs811_read(sensor_t *p_sensor, sensor_reading_t *p_reading)
+{
+    // Results with STATUS and ERROR_ID in one transfer, reading the results
+    // resets /INT
+    const uint8_t reg = CCS811_REG_ALG_RESULT_DATA;
+    uint8_t data[CCS811_ALG_RESULT_SIZE];
+    ccs811_alg_result_t result;
+
+    if (i2c_bus_write_then_read(p_sensor->fd_i2c, p_sensor->i2c_addr, &reg, 1,
+        data, sizeof(data)) != (1 + sizeof(data)))
+    {
+        return false;
+    }
+    ccs811_regs_decode_alg_result(data, &result);
+
+    g_result_us = loop_stats_now_us();
+    uint64_t uptime_ms = g_result_us / 1000;
+    p_reading->valid = SENSOR_QUANTITY_GAS;
+    p_reading->eco2 = result.eco2;
+    p_reading->tvoc = result.tvoc;
+
+    if (result.status & CCS811_STATUS_ERROR)
+    {
+        Log_Debug("ERROR: CCS811 %s (0x%02X).\n",
+            ccs811_regs_get_error_name(result.error_id), result.error_id);
+        p_reading->flags |= SENSOR_FLAG_ERROR(SENSOR_QUANTITY_GAS);
+        p_reading->error_id = result.error_id;
+    }
+    if (!ccs811_baseline_is_settled(uptime_ms))
+    {
+        p_reading->flags |= SENSOR_FLAG_WARMUP(SENSOR_QUANTITY_GAS);
+    }
+    if (!gb_is_compensated)
+    {
+        p_reading->flags |= SENSOR_FLAG_UNCOMPENSATED(SENSOR_QUANTITY_GAS);
+    }
+
+    ccs811_baseline_service(p_sensor->fd_i2c, p_sensor->i2c_addr, uptime_ms,
+        time(NULL));
+
+    return true;
+}
+
+static void
+ccs811_close_sensor(sensor_t *p_sensor)
+{
+    (void)p_sensor;
+
+    if (gp_ccs != NULL)
+    {
+        ccs811_close(gp_ccs);
+        gp_ccs = NULL;
+    }
+
+    CloseFdAndPrintError(g_fd_gpio_int, "CSS811 INT GPIO");
+    g_fd_gpio_int = -1;
+}
+
+/* [] END OF FILE */
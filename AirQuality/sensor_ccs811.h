@@ -0,0 +1,69 @@
+/***************************************************************************//**
+* @file    sensor_ccs811.h
+* @version 1.0.0
+*
+* @brief CCS811 air quality sensor driver.
+*
+* The CCS811 measures continuously in the drive mode set by
+* sensor_ccs811_set_mode() and signals new results on its /INT pin, which is
+* polled by the ready operation. The start operation feeds the latest
+* temperature and humidity to the sensor for compensation.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef SENSOR_CCS811_H
+#define SENSOR_CCS811_H
+
+#include <stdbool.h>
+
+#include "sensor_registry.h"
+
+#include "lib_ccs811.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+// Air Quality 3 Click in Socket 1, nWAKE on CS, /INT on INT
+#define SENSOR_CCS811_WAKE_GPIO     SK_SOCKET1_CS_GPIO
+#define SENSOR_CCS811_INT_GPIO      PROJECT_SOCKET12_INT
+
+/*******************************************************************************
+*   Global variables
+*******************************************************************************/
+
+extern const sensor_driver_t sensor_ccs811_driver;
+
+/*******************************************************************************
+*   Function declarations
+*******************************************************************************/
+
+/**
+ * @brief Set CCS811 drive mode.
+ *
+ * @return false if the sensor is not open or the mode could not be set.
+ */
+bool
+sensor_ccs811_set_mode(ccs811_mode_t mode);
+
+/**
+ * @brief Get measurement period of CCS811 drive mode, 0 = idle
+ */
+uint32_t
+sensor_ccs811_get_period_ms(ccs811_mode_t mode);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SENSOR_CCS811_H
+
+/* [] END OF FILE */
@@ -0,0 +1,43 @@
+/***************************************************************************//**
+* @file    sensor_config.h
+* @version 1.0.0
+*
+* @brief Sensors of the Air Quality Monitor.
+*
+* Each X() entry registers one sensor with sensor_registry.c:
+*
+*   X(id, name, driver, addr_first, addr_last, period_ms, poll_ms)
+*
+*   id          sensor_id_t suffix, e.g. SENSOR_ID_HDC1000
+*   name        log and event loop statistics name
+*   driver      sensor_driver_t operations table
+*   addr_first  7 bit I2C address range the device can be strapped to,
+*   addr_last   probed in this order
+*   period_ms   sampling period, of self timed drivers until the device sets it
+*   poll_ms     ready poll interval, for drivers with a ready operation
+*
+* Adding a sensor takes a driver module and an entry here, the event loop
+* in main.c is not changed.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef SENSOR_CONFIG_H
+#define SENSOR_CONFIG_H
+
+#include "sensor_ccs811.h"
+#include "sensor_hdc1000.h"
+
+#define SENSOR_REGISTRY(X)                                                    \
+    X(HDC1000, "hdc1000", sensor_hdc1000_driver, 0x40, 0x43, 1000, 5)         \
+    X(CCS811, "ccs811", sensor_ccs811_driver, 0x5A, 0x5B, 1000, 100)
+
+// Bus rescan period for boards plugged in or recovered while running
+#define SENSOR_REGISTRY_RESCAN_MS   (30000)
+
+#endif  // SENSOR_CONFIG_H
+
+/* [] END OF FILE */
@@ -0,0 +1,101 @@
+/***************************************************************************//**
+* @file    sensor_hdc1000.c
+* @version 1.0.0
+*
+* @brief HDC1000 temperature and humidity sensor driver.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <applibs/log.h>
+
+#include "hdc1000_regs.h"
+#include "measurement.h"
+#include "sensor_hdc1000.h"
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+static bool
+hdc1000_probe(sensor_t *p_sensor);
+
+static int32_t
+hdc1000_start(sensor_t *p_sensor, const sensor_reading_t *p_latest);
+
+static bool
+hdc1000_read(sensor_t *p_sensor, sensor_reading_t *p_reading);
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+const sensor_driver_t sensor_hdc1000_driver = {
+    .probe = &hdc1000_probe,
+    .start = &hdc1000_start,
+    .ready = NULL,
+    .read = &hdc1000_read,
+    .sleep = NULL,                      // Sleeps after each conversion
+    .close = NULL
+};
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+static bool
+hdc1000_probe(sensor_t *p_sensor)
+{
+    uint16_t manufacturer;
+    uint16_t device;
+
+    if (!hdc1000_regs_read(p_sensor->fd_i2c, p_sensor->i2c_addr,
+            HDC1000_REG_MANUFACTURER_ID, &manufacturer) ||
+        !hdc1000_regs_read(p_sensor->fd_i2c, p_sensor->i2c_addr,
+            HDC1000_REG_DEVICE_ID, &device) ||
+        (manufacturer != SENSOR_HDC1000_MANUFACTURER) ||
+        (device != SENSOR_HDC1000_DEVICE))
+    {
+        return false;
+    }
+
+    // Measurements are read as raw values, temperature and humidity in
+    // sequence with 14 bit resolution
+    return hdc1000_regs_write(p_sensor->fd_i2c, p_sensor->i2c_addr,
+        HDC1000_REG_CONFIGURATION, HDC1000_CONFIG_MODE);
+}
+
+static int32_t
+hdc1000_start(sensor_t *p_sensor, const sensor_reading_t *p_latest)
+{
+    // No compensation input
+    (void)p_latest;
+
+    return hdc1000_regs_start_conversion(p_sensor->fd_i2c, p_sensor->i2c_addr) ?
+        HDC1000_CONVERSION_TIME_MS : SENSOR_START_ERROR;
+}
+
+static bool
+hdc1000_read(sensor_t *p_sensor, sensor_reading_t *p_reading)
+{
+    // Read both raw values in one transfer
+    uint16_t raw_temperature;
+    uint16_t raw_humidity;
+
+    if (!hdc1000_regs_read_conversion(p_sensor->fd_i2c, p_sensor->i2c_addr,
+        &raw_temperature, &raw_humidity))
+    {
+        return false;
+    }
+
+    p_reading->valid = SENSOR_QUANTITY_TEMPERATURE | SENSOR_QUANTITY_HUMIDITY;
+    p_reading->temperature = measurement_temperature_from_hdc1000(raw_temperature);
+    p_reading->humidity = measurement_humidity_from_hdc1000(raw_humidity);
+
+    return true;
+}
+
+/* [] END OF FILE */
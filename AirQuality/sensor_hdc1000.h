@@ -0,0 +1,45 @@
+/***************************************************************************//**
+* @file    sensor_hdc1000.h
+* @version 1.0.0
+*
+* @brief HDC1000 temperature and humidity sensor driver.
+*
+* Both channels are converted in one 14 bit conversion, read in one
+* transfer after HDC1000_CONVERSION_TIME_MS. The device returns to sleep by
+* itself after each conversion.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef SENSOR_HDC1000_H
+#define SENSOR_HDC1000_H
+
+#include "sensor_registry.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+#define SENSOR_HDC1000_MANUFACTURER (0x5449)    // "TI"
+#define SENSOR_HDC1000_DEVICE       (0x1000)
+
+/*******************************************************************************
+*   Global variables
+*******************************************************************************/
+
+extern const sensor_driver_t sensor_hdc1000_driver;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SENSOR_HDC1000_H
+
+/* [] END OF FILE */
@@ -0,0 +1,73 @@
+/***************************************************************************//**
+* @file    sensor_quality.h
+* @version 1.0.0
+*
+* @brief Quantities of a sample and their quality flags.
+*
+* A sample holds the quantities set in its valid mask. Each quality flag is
+* a mask of the quantities it applies to, shifted into its own nibble of the
+* flags word, so that the quantities fit for display, upload and aggregation
+* are found with a few shifts:
+*
+*   usable = SENSOR_USABLE(valid, flags)
+*
+* Flags shared by the application, the host benchmarks and the fleet
+* simulator, as they are carried in telemetry.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef SENSOR_QUALITY_H
+#define SENSOR_QUALITY_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+// Quantities
+#define SENSOR_QUANTITY_TEMPERATURE (1u << 0)
+#define SENSOR_QUANTITY_HUMIDITY    (1u << 1)
+#define SENSOR_QUANTITY_ECO2        (1u << 2)
+#define SENSOR_QUANTITY_TVOC        (1u << 3)
+#define SENSOR_QUANTITY_ALL         (0x0Fu)
+#define SENSOR_QUANTITY_ENV         (SENSOR_QUANTITY_TEMPERATURE | \
+                                     SENSOR_QUANTITY_HUMIDITY)
+#define SENSOR_QUANTITY_GAS         (SENSOR_QUANTITY_ECO2 | SENSOR_QUANTITY_TVOC)
+
+// Quality flags of the given quantities
+#define SENSOR_FLAG_WARMUP(q)       ((uint32_t)(q) << 4)    // Still settling
+#define SENSOR_FLAG_STALE(q)        ((uint32_t)(q) << 8)    // Not updated
+#define SENSOR_FLAG_RANGE(q)        ((uint32_t)(q) << 12)   // Out of range
+#define SENSOR_FLAG_ERROR(q)        ((uint32_t)(q) << 16)   // Device error
+#define SENSOR_FLAG_UNCOMPENSATED(q) ((uint32_t)(q) << 20)  // Informational
+
+// All flags of the given quantities
+#define SENSOR_FLAGS_OF(q)          (SENSOR_FLAG_WARMUP(q) | \
+    SENSOR_FLAG_STALE(q) | SENSOR_FLAG_RANGE(q) | SENSOR_FLAG_ERROR(q) | \
+    SENSOR_FLAG_UNCOMPENSATED(q))
+
+// Quantities with flags that make them unusable
+#define SENSOR_FLAGS_UNUSABLE(flags) \
+    ((((flags) >> 4) | ((flags) >> 8) | ((flags) >> 12) | ((flags) >> 16)) & \
+    SENSOR_QUANTITY_ALL)
+
+// Quantities that are valid and usable
+#define SENSOR_USABLE(valid, flags) \
+    ((valid) & ~SENSOR_FLAGS_UNUSABLE(flags) & SENSOR_QUANTITY_ALL)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SENSOR_QUALITY_H
+
+/* [] END OF FILE */
@@ -0,0 +1,887 @@
+/***************************************************************************//**
+* @file    sensor_registry.c
+* @version 1.0.0
+*
+* @brief Sensor driver registry and sampling scheduler.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <applibs/log.h>
+
+#include "event_loop_stats.h"
+#include "sensor_registry.h"
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+
+#define SENSOR_REGISTRY_DESC(id, name, driver, addr_first, addr_last,      \
+    period_ms, poll_ms)                                                     \
+    { name, &driver, addr_first, addr_last, period_ms, poll_ms,             \
+      name "Start", name "Read", name "Publish" },
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+static void
+sensor_event_handler(EventData *p_event_data);
+
+static void
+scan_event_handler(EventData *p_event_data);
+
+static bool
+sensor_bind(sensor_t *p_sensor, uint64_t now_us);
+
+static void
+sensor_unbind(sensor_t *p_sensor);
+
+static bool
+sensor_retry(sensor_t *p_sensor, uint64_t now_us);
+
+static void
+sensor_fail(sensor_t *p_sensor, uint64_t now_us);
+
+static void
+sensor_trial(sensor_t *p_sensor, uint64_t now_us);
+
+static void
+bus_check(void);
+
+static void
+sensor_run_operation(sensor_t *p_sensor);
+
+static void
+sensor_end_period(sensor_t *p_sensor, uint64_t now_us);
+
+static void
+sensor_merge_latest(const sensor_reading_t *p_reading);
+
+static void
+sensor_check_range(sensor_reading_t *p_reading);
+
+static void
+schedule_next(void);
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+static const sensor_desc_t g_descs[SENSOR_COUNT] = {
+    SENSOR_REGISTRY(SENSOR_REGISTRY_DESC)
+};
+
+static sensor_t g_sensors[SENSOR_COUNT];
+static sensor_reading_t g_latest;
+
+// Measurement ranges of the quantities
+static const struct
+{
+    uint32_t quantity;
+    int32_t min;
+    int32_t max;
+} g_ranges[] = {
+    { SENSOR_QUANTITY_TEMPERATURE, -4000, 12500 },  // [0.01 degC]
+    { SENSOR_QUANTITY_HUMIDITY, 0, 10000 },         // [0.01 %RH]
+    { SENSOR_QUANTITY_ECO2, 400, 8192 },            // [ppm], CCS811
+    { SENSOR_QUANTITY_TVOC, 0, 1187 }               // [ppb], CCS811
+};
+
+static sensor_reading_fn_t gp_callback = NULL;
+
+static int g_fd_i2c = -1;
+static int g_fd_timer = -1;
+static int g_fd_timer_scan = -1;
+
+// Devices found on the bus, next address of the running rescan
+static i2c_scan_map_t g_bus_map;
+static uint32_t g_scan_next_addr = 0;
+
+// Stuck bus detection
+static sensor_bus_recovery_fn_t gp_bus_recovery = NULL;
+static uint32_t g_bus_failures = 0;     // Failed measurements since success
+static uint32_t g_bus_recoveries = 0;
+
+// Takes the statistics name and slot of the operation it is armed for
+static EventData g_event_data_sensor = {
+    .eventHandler = &sensor_event_handler,
+    .name = "sensor"
+};
+
+static EventData g_event_data_scan = {
+    .eventHandler = &scan_event_handler,
+    .name = "i2cScan"
+};
+
+// Sensor and operation the timer is armed for
+static sensor_t *gp_armed = NULL;
+static EventData *gp_armed_event = NULL;
+
+// Sampling period set by sensor_registry_set_period(), 0 = descriptor
+static uint32_t g_period_ms = 0;
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+int
+sensor_registry_init(int fd_epoll, int fd_i2c, sensor_reading_fn_t p_callback)
+{
+    static const struct timespec disarmed = { 0, 0 };
+    const struct timespec rescan_period = {
+        SENSOR_REGISTRY_RESCAN_MS / 1000,
+        (SENSOR_REGISTRY_RESCAN_MS % 1000) * 1000000L
+    };
+
+    g_fd_i2c = fd_i2c;
+    gp_callback = p_callback;
+    g_scan_next_addr = 0;
+    g_bus_failures = 0;
+    g_bus_recoveries = 0;
+    memset(&g_latest, 0, sizeof(g_latest));
+    memset(&g_bus_map, 0, sizeof(g_bus_map));
+
+    // Full scan before the event loop runs
+    uint64_t now_us = loop_stats_now_us();
+    uint32_t found = i2c_scan_range(fd_i2c, I2C_SCAN_ADDR_FIRST,
+        I2C_SCAN_ADDR_LAST, &g_bus_map, NULL);
+    uint64_t scanned_us = loop_stats_now_us();
+    Log_Debug("I2C scan: %lu devices in %lu us\n", (unsigned long)found,
+        (unsigned long)(scanned_us - now_us));
+
+    for (size_t idx = 0; idx < SENSOR_COUNT; idx++)
+    {
+        sensor_t *p_sensor = &g_sensors[idx];
+        const sensor_desc_t *p_desc = &g_descs[idx];
+
+        // Statistics entries stay registered when the registry is opened
+        // again
+        int slots[] = {
+            p_sensor->event_start.statsSlot, p_sensor->event_read.statsSlot,
+            p_sensor->event_publish.statsSlot
+        };
+
+        memset(p_sensor, 0, sizeof(*p_sensor));
+        p_sensor->p_desc = p_desc;
+        p_sensor->period_ms = ((g_period_ms > p_desc->period_ms) &&
+            !p_desc->p_driver->b_is_self_timed) ?
+            g_period_ms : p_desc->period_ms;
+        p_sensor->fd_i2c = fd_i2c;
+        p_sensor->state = SENSOR_STATE_ABSENT;
+        p_sensor->cooldown_ms = SENSOR_BREAKER_COOLDOWN_MS;
+        p_sensor->event_start.name = p_desc->p_start_name;
+        p_sensor->event_read.name = p_desc->p_read_name;
+        p_sensor->event_publish.name = p_desc->p_publish_name;
+        p_sensor->event_start.statsSlot = slots[0];
+        p_sensor->event_read.statsSlot = slots[1];
+        p_sensor->event_publish.statsSlot = slots[2];
+        latency_hist_reset(&p_sensor->hist_bus_us);
+
+        if (!sensor_bind(p_sensor, scanned_us))
+        {
+            Log_Debug("WARNING: %s sensor not found.\n", p_desc->name);
+        }
+    }
+
+    g_fd_timer = CreateTimerFdAndAddToEpoll(fd_epoll, &disarmed,
+        &g_event_data_sensor, EPOLLIN);
+    g_fd_timer_scan = CreateTimerFdAndAddToEpoll(fd_epoll, &rescan_period,
+        &g_event_data_scan, EPOLLIN);
+    if ((g_fd_timer < 0) || (g_fd_timer_scan < 0))
+    {
+        return -1;
+    }
+
+    schedule_next();
+    return 0;
+}
+
+sensor_t *
+sensor_registry_get(sensor_id_t id)
+{
+    return ((size_t)id < SENSOR_COUNT) ? &g_sensors[id] : NULL;
+}
+
+const i2c_scan_map_t *
+sensor_registry_get_bus_map(void)
+{
+    return &g_bus_map;
+}
+
+void
+sensor_registry_set_period(uint32_t period_ms)
+{
+    uint64_t now_us = loop_stats_now_us();
+
+    g_period_ms = period_ms;
+
+    // Applied by sensor_registry_init()
+    if (g_fd_timer < 0)
+    {
+        return;
+    }
+
+    for (size_t idx = 0; idx < SENSOR_COUNT; idx++)
+    {
+        sensor_t *p_sensor = &g_sensors[idx];
+        uint32_t desc_ms = p_sensor->p_desc->period_ms;
+
+        // The device sets the period of self timed sensors
+        if (p_sensor->p_desc->p_driver->b_is_self_timed)
+        {
+            continue;
+        }
+
+        p_sensor->period_ms = (period_ms > desc_ms) ? period_ms : desc_ms;
+        if (p_sensor->state == SENSOR_STATE_IDLE)
+        {
+            p_sensor->due_us = p_sensor->period_start_us +
+                (uint64_t)p_sensor->period_ms * 1000u;
+            if (p_sensor->due_us < now_us)
+            {
+                p_sensor->due_us = now_us;
+            }
+        }
+    }
+
+    schedule_next();
+}
+
+void
+sensor_registry_set_bus_recovery(sensor_bus_recovery_fn_t p_recovery)
+{
+    gp_bus_recovery = p_recovery;
+}
+
+uint32_t
+sensor_registry_get_bus_recoveries(void)
+{
+    return g_bus_recoveries;
+}
+
+int
+sensor_registry_health_to_json(char *p_buffer, size_t buffer_size)
+{
+    size_t len = 0;
+    int written;
+
+    if (buffer_size < 3)
+    {
+        return -1;
+    }
+    p_buffer[len++] = '{';
+
+    for (size_t idx = 0; idx < SENSOR_COUNT; idx++)
+    {
+        const sensor_t *p_sensor = &g_sensors[idx];
+
+        written = snprintf(p_buffer + len, buffer_size - len,
+            "\"%s\":[%d,%lu,%lu,%lu],",
+            p_sensor->p_desc->name,
+            (int)p_sensor->state,
+            (unsigned long)p_sensor->errors,
+            (unsigned long)p_sensor->retries,
+            (unsigned long)p_sensor->breaker_opens);
+
+        if ((written < 0) || ((size_t)written >= buffer_size - len))
+        {
+            return -1;
+        }
+        len += (size_t)written;
+    }
+
+    written = snprintf(p_buffer + len, buffer_size - len,
+        "\"busRecoveries\":%lu}", (unsigned long)g_bus_recoveries);
+    if ((written < 0) || ((size_t)written >= buffer_size - len))
+    {
+        return -1;
+    }
+
+    return (int)(len + (size_t)written);
+}
+
+const sensor_reading_t *
+sensor_registry_get_latest(void)
+{
+    uint64_t now_us = loop_stats_now_us();
+
+    for (size_t idx = 0; idx < SENSOR_COUNT; idx++)
+    {
+        const sensor_t *p_sensor = &g_sensors[idx];
+        uint32_t quantities = p_sensor->reading.valid;
+        uint64_t stale_us = (uint64_t)SENSOR_STALE_PERIODS *
+            p_sensor->period_ms * 1000u;
+
+        if (now_us - p_sensor->read_us > stale_us)
+        {
+            g_latest.flags |= SENSOR_FLAG_STALE(quantities);
+        }
+        else
+        {
+            g_latest.flags &= ~SENSOR_FLAG_STALE(quantities);
+        }
+    }
+
+    return &g_latest;
+}
+
+void
+sensor_registry_close(void)
+{
+    for (size_t idx = 0; idx < SENSOR_COUNT; idx++)
+    {
+        sensor_t *p_sensor = &g_sensors[idx];
+
+        if (p_sensor->state != SENSOR_STATE_ABSENT)
+        {
+            Log_Debug("Close %s\n", p_sensor->p_desc->name);
+            sensor_unbind(p_sensor);
+        }
+    }
+
+    CloseFdAndPrintError(g_fd_timer, "Sensor timer");
+    CloseFdAndPrintError(g_fd_timer_scan, "Bus scan timer");
+    g_fd_timer = -1;
+    g_fd_timer_scan = -1;
+    gp_armed = NULL;
+    gp_armed_event = NULL;
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+static void
+sensor_event_handler(EventData *p_event_data)
+{
+    if (ConsumeTimerFdEvent(g_fd_timer) != 0)
+    {
+        return;
+    }
+
+    // Keep the statistics slot the event loop assigned to the operation
+    if (gp_armed_event != NULL)
+    {
+        gp_armed_event->statsSlot = p_event_data->statsSlot;
+    }
+
+    sensor_t *p_sensor = gp_armed;
+    gp_armed = NULL;
+    gp_armed_event = NULL;
+
+    if (p_sensor != NULL)
+    {
+        sensor_run_operation(p_sensor);
+    }
+
+    schedule_next();
+}
+
+/**
+ * @brief Rescan SENSOR_SCAN_CHUNK addresses, bind absent sensors once the
+ *        whole range is done.
+ */
+static void
+scan_event_handler(EventData *p_event_data)
+{
+    static const struct timespec next_chunk = { 0, 1 };
+    const struct timespec rescan_period = {
+        SENSOR_REGISTRY_RESCAN_MS / 1000,
+        (SENSOR_REGISTRY_RESCAN_MS % 1000) * 1000000L
+    };
+
+    (void)p_event_data;
+
+    if (ConsumeTimerFdEvent(g_fd_timer_scan) != 0)
+    {
+        return;
+    }
+
+    // Bound devices may NACK while converting, they are not probed
+    i2c_scan_map_t skip;
+    memset(&skip, 0, sizeof(skip));
+    for (size_t idx = 0; idx < SENSOR_COUNT; idx++)
+    {
+        if (g_sensors[idx].state != SENSOR_STATE_ABSENT)
+        {
+            i2c_scan_set(&skip, g_sensors[idx].i2c_addr, true);
+        }
+    }
+
+    if (g_scan_next_addr == 0)
+    {
+        g_scan_next_addr = I2C_SCAN_ADDR_FIRST;
+    }
+    uint32_t last = g_scan_next_addr + SENSOR_SCAN_CHUNK - 1;
+    if (last > I2C_SCAN_ADDR_LAST)
+    {
+        last = I2C_SCAN_ADDR_LAST;
+    }
+    i2c_scan_range(g_fd_i2c, (uint8_t)g_scan_next_addr, (uint8_t)last,
+        &g_bus_map, &skip);
+    g_scan_next_addr = last + 1;
+
+    if (g_scan_next_addr <= I2C_SCAN_ADDR_LAST)
+    {
+        SetTimerFdToSingleExpiry(g_fd_timer_scan, &next_chunk);
+        return;
+    }
+
+    g_scan_next_addr = 0;
+    SetTimerFdToPeriod(g_fd_timer_scan, &rescan_period);
+
+    bool b_is_bound = false;
+    uint64_t now_us = loop_stats_now_us();
+    for (size_t idx = 0; idx < SENSOR_COUNT; idx++)
+    {
+        if (g_sensors[idx].state == SENSOR_STATE_ABSENT)
+        {
+            b_is_bound |= sensor_bind(&g_sensors[idx], now_us);
+        }
+    }
+
+    if (b_is_bound)
+    {
+        schedule_next();
+    }
+}
+
+/**
+ * @brief Probe the sensor at the present addresses of its range.
+ *
+ * @return true if the sensor has been bound and is due at now_us.
+ */
+static bool
+sensor_bind(sensor_t *p_sensor, uint64_t now_us)
+{
+    const sensor_desc_t *p_desc = p_sensor->p_desc;
+
+    for (uint32_t addr = p_desc->i2c_addr_first;
+        addr <= p_desc->i2c_addr_last; addr++)
+    {
+        bool b_is_used = false;
+        for (size_t idx = 0; idx < SENSOR_COUNT; idx++)
+        {
+            b_is_used |= (g_sensors[idx].state != SENSOR_STATE_ABSENT) &&
+                (g_sensors[idx].i2c_addr == addr);
+        }
+
+        if (b_is_used || (!p_desc->p_driver->b_needs_wake &&
+            !i2c_scan_is_present(&g_bus_map, (uint8_t)addr)))
+        {
+            continue;
+        }
+
+        p_sensor->i2c_addr = (uint8_t)addr;
+        if (p_desc->p_driver->probe(p_sensor))
+        {
+            Log_Debug("Found %s at 0x%02X\n", p_desc->name, addr);
+            i2c_scan_set(&g_bus_map, (uint8_t)addr, true);
+            p_sensor->state = SENSOR_STATE_IDLE;
+            p_sensor->due_us = now_us;
+            p_sensor->consecutive_errors = 0;
+            return true;
+        }
+    }
+
+    p_sensor->i2c_addr = 0;
+    return false;
+}
+
+/**
+ * @brief Close the sensor, a later rescan binds it again.
+ */
+static void
+sensor_unbind(sensor_t *p_sensor)
+{
+    // Isolated sensors are already closed
+    if ((p_sensor->state != SENSOR_STATE_ISOLATED) &&
+        (p_sensor->p_desc->p_driver->close != NULL))
+    {
+        p_sensor->p_desc->p_driver->close(p_sensor);
+    }
+
+    // Probed again by the next rescan
+    i2c_scan_set(&g_bus_map, p_sensor->i2c_addr, false);
+    p_sensor->state = SENSOR_STATE_ABSENT;
+    p_sensor->i2c_addr = 0;
+    p_sensor->attempt = 0;
+    p_sensor->consecutive_errors = 0;
+    p_sensor->cooldown_ms = SENSOR_BREAKER_COOLDOWN_MS;
+
+    if (gp_armed == p_sensor)
+    {
+        gp_armed = NULL;
+        gp_armed_event = NULL;
+    }
+}
+
+/**
+ * @brief Schedule a failed operation again while retries are left.
+ *
+ * @return false if the retries are used up.
+ */
+static bool
+sensor_retry(sensor_t *p_sensor, uint64_t now_us)
+{
+    if (p_sensor->attempt >= SENSOR_RETRIES)
+    {
+        return false;
+    }
+
+    p_sensor->attempt++;
+    p_sensor->retries++;
+    p_sensor->due_us = now_us + SENSOR_RETRY_MS * 1000u;
+    return true;
+}
+
+/**
+ * @brief Count a failed measurement, isolate a sensor failing repeatedly.
+ */
+static void
+sensor_fail(sensor_t *p_sensor, uint64_t now_us)
+{
+    p_sensor->attempt = 0;
+    p_sensor->errors++;
+    p_sensor->consecutive_errors++;
+    g_bus_failures++;
+
+    if (p_sensor->consecutive_errors < SENSOR_BREAKER_ERRORS)
+    {
+        sensor_end_period(p_sensor, now_us);
+    }
+    else
+    {
+        Log_Debug("ERROR: %s failed %lu times, isolated for %lu ms.\n",
+            p_sensor->p_desc->name,
+            (unsigned long)p_sensor->consecutive_errors,
+            (unsigned long)p_sensor->cooldown_ms);
+
+        if (p_sensor->p_desc->p_driver->close != NULL)
+        {
+            p_sensor->p_desc->p_driver->close(p_sensor);
+        }
+        p_sensor->state = SENSOR_STATE_ISOLATED;
+        p_sensor->breaker_opens++;
+        p_sensor->due_us = now_us + (uint64_t)p_sensor->cooldown_ms * 1000u;
+        p_sensor->cooldown_ms = (p_sensor->cooldown_ms * 2 <
+            SENSOR_BREAKER_COOLDOWN_MAX_MS) ? p_sensor->cooldown_ms * 2 :
+            SENSOR_BREAKER_COOLDOWN_MAX_MS;
+    }
+
+    bus_check();
+}
+
+/**
+ * @brief Probe an isolated sensor after its cooldown.
+ *
+ * The breaker closes only when the next measurement succeeds, until then
+ * one failure isolates the sensor again.
+ */
+static void
+sensor_trial(sensor_t *p_sensor, uint64_t now_us)
+{
+    const sensor_desc_t *p_desc = p_sensor->p_desc;
+
+    if (p_desc->p_driver->probe(p_sensor))
+    {
+        Log_Debug("Trial measurement of %s\n", p_desc->name);
+        p_sensor->state = SENSOR_STATE_IDLE;
+        p_sensor->due_us = now_us;
+    }
+    else if (p_sensor->cooldown_ms >= SENSOR_BREAKER_COOLDOWN_MAX_MS)
+    {
+        Log_Debug("ERROR: %s does not answer, unbound.\n", p_desc->name);
+        sensor_unbind(p_sensor);
+    }
+    else
+    {
+        p_sensor->due_us = now_us + (uint64_t)p_sensor->cooldown_ms * 1000u;
+        p_sensor->cooldown_ms *= 2;
+        if (p_sensor->cooldown_ms > SENSOR_BREAKER_COOLDOWN_MAX_MS)
+        {
+            p_sensor->cooldown_ms = SENSOR_BREAKER_COOLDOWN_MAX_MS;
+        }
+    }
+}
+
+/**
+ * @brief Recover the bus when every sensor in use is failing.
+ */
+static void
+bus_check(void)
+{
+    uint32_t active = 0;
+    bool b_is_stuck = (gp_bus_recovery != NULL);
+
+    for (size_t idx = 0; idx < SENSOR_COUNT; idx++)
+    {
+        const sensor_t *p_sensor = &g_sensors[idx];
+        if ((p_sensor->state != SENSOR_STATE_ABSENT) &&
+            (p_sensor->state != SENSOR_STATE_ISOLATED))
+        {
+            active++;
+            b_is_stuck &= (p_sensor->consecutive_errors > 0);
+        }
+    }
+
+    // One failure per sensor in use since the last success or recovery
+    if (b_is_stuck && (active > 0) && (g_bus_failures >= active))
+    {
+        g_bus_failures = 0;
+        g_bus_recoveries++;
+        Log_Debug("I2C bus stuck, recovering.\n");
+        if (!gp_bus_recovery())
+        {
+            Log_Debug("ERROR: I2C bus recovery failed.\n");
+        }
+    }
+}
+
+static void
+sensor_run_operation(sensor_t *p_sensor)
+{
+    const sensor_desc_t *p_desc = p_sensor->p_desc;
+    const sensor_driver_t *p_driver = p_desc->p_driver;
+    uint64_t start_us = loop_stats_now_us();
+
+    switch (p_sensor->state)
+    {
+        case SENSOR_STATE_IDLE:
+        {
+            // Keep the cadence of the scheduled time, not of the event
+            if (p_sensor->attempt == 0)
+            {
+                p_sensor->period_start_us = p_sensor->due_us;
+                p_sensor->bus_us = 0;
+            }
+            int32_t delay_ms = p_driver->start(p_sensor,
+                sensor_registry_get_latest());
+            uint64_t now_us = loop_stats_now_us();
+            p_sensor->bus_us += (uint32_t)(now_us - start_us);
+
+            if (delay_ms < 0)
+            {
+                if (!sensor_retry(p_sensor, now_us))
+                {
+                    Log_Debug("ERROR: Could not start %s measurement.\n",
+                        p_desc->name);
+                    sensor_fail(p_sensor, now_us);
+                }
+            }
+            else
+            {
+                p_sensor->attempt = 0;
+                p_sensor->state = SENSOR_STATE_CONVERTING;
+                p_sensor->due_us = now_us + (uint64_t)delay_ms * 1000u;
+            }
+            break;
+        }
+
+        case SENSOR_STATE_CONVERTING:
+        {
+            bool b_is_ready = (p_driver->ready == NULL) ||
+                p_driver->ready(p_sensor);
+            if (b_is_ready)
+            {
+                // Drivers only set the flags that apply to this reading
+                p_sensor->reading.flags = 0;
+                p_sensor->reading.error_id = 0;
+            }
+            bool b_is_read = b_is_ready &&
+                p_driver->read(p_sensor, &p_sensor->reading);
+            uint64_t now_us = loop_stats_now_us();
+            p_sensor->bus_us += (uint32_t)(now_us - start_us);
+
+            if (!b_is_ready)
+            {
+                p_sensor->due_us = now_us + (uint64_t)p_desc->poll_ms * 1000u;
+            }
+            else if (!b_is_read)
+            {
+                if (!sensor_retry(p_sensor, now_us))
+                {
+                    Log_Debug("ERROR: Could not read %s measurement.\n",
+                        p_desc->name);
+                    sensor_fail(p_sensor, now_us);
+                }
+            }
+            else
+            {
+                latency_hist_record(&p_sensor->hist_bus_us, p_sensor->bus_us);
+                if (p_sensor->consecutive_errors >= SENSOR_BREAKER_ERRORS)
+                {
+                    Log_Debug("%s recovered\n", p_desc->name);
+                }
+                p_sensor->attempt = 0;
+                p_sensor->consecutive_errors = 0;
+                p_sensor->cooldown_ms = SENSOR_BREAKER_COOLDOWN_MS;
+                g_bus_failures = 0;
+                p_sensor->read_us = now_us;
+                sensor_check_range(&p_sensor->reading);
+                sensor_merge_latest(&p_sensor->reading);
+                p_sensor->state = SENSOR_STATE_PUBLISH;
+                p_sensor->due_us = now_us;
+            }
+            break;
+        }
+
+        case SENSOR_STATE_PUBLISH:
+            if (gp_callback != NULL)
+            {
+                gp_callback(p_sensor, &p_sensor->reading);
+            }
+            sensor_end_period(p_sensor, loop_stats_now_us());
+            break;
+
+        case SENSOR_STATE_ISOLATED:
+            sensor_trial(p_sensor, start_us);
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Put the sensor to sleep until its next period, start a self timed
+ *        sensor again at once.
+ */
+static void
+sensor_end_period(sensor_t *p_sensor, uint64_t now_us)
+{
+    if (p_sensor->p_desc->p_driver->sleep != NULL)
+    {
+        p_sensor->p_desc->p_driver->sleep(p_sensor);
+    }
+
+    p_sensor->state = SENSOR_STATE_IDLE;
+    if (p_sensor->p_desc->p_driver->b_is_self_timed)
+    {
+        p_sensor->due_us = now_us;
+        return;
+    }
+
+    p_sensor->due_us = p_sensor->period_start_us +
+        (uint64_t)p_sensor->period_ms * 1000u;
+
+    // Overrun periods are skipped, not caught up
+    if (p_sensor->due_us < now_us)
+    {
+        p_sensor->due_us = now_us;
+    }
+}
+
+static void
+sensor_merge_latest(const sensor_reading_t *p_reading)
+{
+    if (p_reading->valid & SENSOR_QUANTITY_TEMPERATURE)
+    {
+        g_latest.temperature = p_reading->temperature;
+    }
+    if (p_reading->valid & SENSOR_QUANTITY_HUMIDITY)
+    {
+        g_latest.humidity = p_reading->humidity;
+    }
+    if (p_reading->valid & SENSOR_QUANTITY_ECO2)
+    {
+        g_latest.eco2 = p_reading->eco2;
+    }
+    if (p_reading->valid & SENSOR_QUANTITY_TVOC)
+    {
+        g_latest.tvoc = p_reading->tvoc;
+    }
+    if (p_reading->flags & SENSOR_FLAG_ERROR(p_reading->valid))
+    {
+        g_latest.error_id = p_reading->error_id;
+    }
+    g_latest.valid |= p_reading->valid;
+
+    // Flags of the quantities are replaced by those of the reading
+    g_latest.flags = (g_latest.flags & ~SENSOR_FLAGS_OF(p_reading->valid)) |
+        (p_reading->flags & SENSOR_FLAGS_OF(p_reading->valid));
+}
+
+/**
+ * @brief Flag quantities outside the measurement range.
+ */
+static void
+sensor_check_range(sensor_reading_t *p_reading)
+{
+    const int32_t values[] = {
+        p_reading->temperature, p_reading->humidity, p_reading->eco2,
+        p_reading->tvoc
+    };
+
+    for (size_t idx = 0; idx < sizeof(g_ranges) / sizeof(g_ranges[0]); idx++)
+    {
+        if ((p_reading->valid & g_ranges[idx].quantity) &&
+            ((values[idx] < g_ranges[idx].min) ||
+            (values[idx] > g_ranges[idx].max)))
+        {
+            p_reading->flags |= SENSOR_FLAG_RANGE(g_ranges[idx].quantity);
+        }
+    }
+}
+
+/**
+ * @brief Arm the timer for the sensor due first.
+ */
+static void
+schedule_next(void)
+{
+    sensor_t *p_next = NULL;
+
+    for (size_t idx = 0; idx < SENSOR_COUNT; idx++)
+    {
+        sensor_t *p_sensor = &g_sensors[idx];
+        if ((p_sensor->state != SENSOR_STATE_ABSENT) &&
+            ((p_next == NULL) || (p_sensor->due_us < p_next->due_us)))
+        {
+            p_next = p_sensor;
+        }
+    }
+
+    if (p_next == NULL)
+    {
+        return;
+    }
+
+    // Trial probes of isolated sensors count as start operations
+    EventData *p_event_data = (p_next->state == SENSOR_STATE_CONVERTING) ?
+        &p_next->event_read : (p_next->state == SENSOR_STATE_PUBLISH) ?
+        &p_next->event_publish : &p_next->event_start;
+
+    uint64_t now_us = loop_stats_now_us();
+    uint64_t delay_us = (p_next->due_us > now_us) ? p_next->due_us - now_us : 0;
+
+    // Zero would disarm the timer, shortest expiry runs the operation after
+    // events already pending
+    struct timespec expiry = {
+        (time_t)(delay_us / 1000000u),
+        (delay_us > 0) ? (long)(delay_us % 1000000u) * 1000L : 1
+    };
+
+    // The timer stays registered, only the statistics entry changes
+    g_event_data_sensor.name = p_event_data->name;
+    g_event_data_sensor.statsSlot = p_event_data->statsSlot;
+
+    if (SetTimerFdToSingleExpiry(g_fd_timer, &expiry) != 0)
+    {
+        Log_Debug("ERROR: Could not schedule %s.\n", p_event_data->name);
+        return;
+    }
+
+    gp_armed = p_next;
+    gp_armed_event = p_event_data;
+}
+
+/* [] END OF FILE */
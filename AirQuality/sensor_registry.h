@@ -0,0 +1,309 @@
+/***************************************************************************//**
+* @file    sensor_registry.h
+* @version 1.0.0
+*
+* @brief Sensor driver registry and sampling scheduler.
+*
+* Sensors are listed once in the SENSOR_REGISTRY() X-macro of
+* sensor_config.h, from which a static const descriptor table and the
+* sensor_id_t enumeration are generated at compile time. Each entry binds a
+* driver, a uniform table of operations:
+*
+*   probe   detect and initialize the device, false if it is absent
+*   start   trigger a measurement, returns the time until it is ready
+*   ready   optional, polled until the measurement is ready
+*   read    read the measurement
+*   sleep   optional, put the device into low power between measurements
+*   close   release the device
+*
+* Sensors are bound to devices found by an I2C bus scan at start up: a
+* sensor is probed at each present address of its address range until the
+* probe, which checks the device ID registers, succeeds. Devices which only
+* answer once woken by their driver are probed at every address of the range.
+* The bus is rescanned periodically, a few addresses per event, to bind
+* boards plugged in later.
+*
+* Faults are contained per sensor:
+*
+*   retry     a failed start or read is repeated SENSOR_RETRIES times,
+*             SENSOR_RETRY_MS apart, before the measurement counts as failed
+*   breaker   after SENSOR_BREAKER_ERRORS failed measurements in a row the
+*             sensor is closed and isolated while the others keep sampling;
+*             after a cooldown it is probed and measured once more, a failure
+*             doubles the cooldown up to SENSOR_BREAKER_COOLDOWN_MAX_MS, after
+*             which the sensor is unbound and left to the rescan
+*   bus       when every bound sensor is failing, the bus is assumed stuck
+*             and the recovery callback runs, e.g. resetting the I2C master
+*             (i2c_bus.h)
+*
+* The scheduler samples every bound sensor at its own period on the shared
+* event loop. One timerfd is armed for the sensor due first and each event
+* runs a single operation of a single sensor, so no handler runs longer than
+* one driver operation. Readings are delivered to the application callback
+* in a separate event after the read.
+*
+* A different sensor list, e.g. for host benchmarks, is selected by defining
+* SENSOR_REGISTRY_CONFIG as the name of the header to include.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef SENSOR_REGISTRY_H
+#define SENSOR_REGISTRY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "epoll_timerfd_utilities.h"
+#include "i2c_scan.h"
+#include "latency_histogram.h"
+#include "sensor_quality.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+// Periods without reading after which the quantities of a sensor are stale
+#define SENSOR_STALE_PERIODS        (3)
+
+// Start operation failure
+#define SENSOR_START_ERROR          (-1)
+
+// Repetitions of a failed operation and their interval
+#define SENSOR_RETRIES              (2)
+#define SENSOR_RETRY_MS             (10)
+
+// Consecutive failed measurements after which a sensor is isolated
+#define SENSOR_BREAKER_ERRORS       (3)
+
+// Addresses probed per rescan event
+#define SENSOR_SCAN_CHUNK           (4)
+
+/*******************************************************************************
+*   Data types
+*******************************************************************************/
+
+typedef struct
+{
+    uint32_t valid;             // SENSOR_QUANTITY_* mask
+    uint32_t flags;             // SENSOR_FLAG_* of the quantities
+    int16_t temperature;        // [0.01 degC]
+    uint16_t humidity;          // [0.01 %RH]
+    uint16_t eco2;              // [ppm]
+    uint16_t tvoc;              // [ppb]
+    uint8_t error_id;           // Device error code with SENSOR_FLAG_ERROR
+} sensor_reading_t;
+
+typedef struct sensor sensor_t;
+
+typedef struct
+{
+    bool (*probe)(sensor_t *p_sensor);
+
+    /**
+     * @param p_latest Latest readings of all sensors, e.g. for compensation.
+     *
+     * @return Time until the measurement is ready [ms], SENSOR_START_ERROR
+     *         on failure.
+     */
+    int32_t (*start)(sensor_t *p_sensor, const sensor_reading_t *p_latest);
+
+    bool (*ready)(sensor_t *p_sensor);
+    bool (*read)(sensor_t *p_sensor, sensor_reading_t *p_reading);
+    void (*sleep)(sensor_t *p_sensor);
+    void (*close)(sensor_t *p_sensor);
+
+    // The device does not answer the bus scan until probe() wakes it, it is
+    // probed at every address of its range
+    bool b_needs_wake;
+
+    // The device measures on its own cadence and signals each result, e.g.
+    // on an interrupt pin tested by ready(). The next measurement is started
+    // right after publishing instead of after the period, start() returns
+    // the time until the signal is due and keeps period_ms at the device
+    // period.
+    bool b_is_self_timed;
+} sensor_driver_t;
+
+typedef struct
+{
+    const char *name;
+    const sensor_driver_t *p_driver;
+    uint8_t i2c_addr_first;     // 7 bit I2C address range of the device
+    uint8_t i2c_addr_last;
+    uint32_t period_ms;         // Sampling period
+    uint32_t poll_ms;           // Ready poll interval
+    const char *p_start_name;   // Event loop statistics names
+    const char *p_read_name;
+    const char *p_publish_name;
+} sensor_desc_t;
+
+typedef enum
+{
+    SENSOR_STATE_ABSENT,        // Not bound to a device
+    SENSOR_STATE_IDLE,          // Waiting for the next period
+    SENSOR_STATE_CONVERTING,    // Waiting for the measurement
+    SENSOR_STATE_PUBLISH,       // Reading waits for delivery
+    SENSOR_STATE_ISOLATED       // Closed by the breaker until its cooldown
+} sensor_state_t;
+
+struct sensor
+{
+    const sensor_desc_t *p_desc;
+    int fd_i2c;
+    uint8_t i2c_addr;           // Bound address, 0 if absent
+    sensor_state_t state;
+    uint64_t due_us;            // Next operation
+    uint32_t period_ms;         // Sampling period in use, device period of
+                                // self timed sensors
+    uint64_t period_start_us;   // Start of the current period
+    uint32_t bus_us;            // Operation time of the current measurement
+    uint64_t read_us;           // Last successful reading
+    uint32_t attempt;           // Retries of the current operation
+    uint32_t cooldown_ms;       // Isolation time if the breaker opens
+    uint32_t errors;            // Failed measurements
+    uint32_t consecutive_errors;
+    uint32_t retries;           // Repeated operations
+    uint32_t breaker_opens;
+    sensor_reading_t reading;
+    latency_hist_t hist_bus_us; // Operation time per measurement
+    EventData event_start;      // Event loop statistics name and slot of
+    EventData event_read;       // the operations
+    EventData event_publish;
+};
+
+/**
+ * @brief Reading delivery callback.
+ */
+typedef void (*sensor_reading_fn_t)(const sensor_t *p_sensor,
+    const sensor_reading_t *p_reading);
+
+/**
+ * @brief Bus recovery callback.
+ *
+ * @return true if the bus has been released.
+ */
+typedef bool (*sensor_bus_recovery_fn_t)(void);
+
+#ifndef SENSOR_REGISTRY_CONFIG
+#define SENSOR_REGISTRY_CONFIG "sensor_config.h"
+#endif
+#include SENSOR_REGISTRY_CONFIG
+
+// Bus rescan period
+#ifndef SENSOR_REGISTRY_RESCAN_MS
+#define SENSOR_REGISTRY_RESCAN_MS   (30000)
+#endif
+
+// First and longest isolation of a failing sensor
+#ifndef SENSOR_BREAKER_COOLDOWN_MS
+#define SENSOR_BREAKER_COOLDOWN_MS  (10000)
+#endif
+#ifndef SENSOR_BREAKER_COOLDOWN_MAX_MS
+#define SENSOR_BREAKER_COOLDOWN_MAX_MS  (320000)
+#endif
+
+#define SENSOR_REGISTRY_ID(id, name, driver, addr_first, addr_last,        \
+    period_ms, poll_ms) SENSOR_ID_##id,
+
+typedef enum
+{
+    SENSOR_REGISTRY(SENSOR_REGISTRY_ID)
+    SENSOR_COUNT
+} sensor_id_t;
+
+// Event loop handlers of the registry: bus scan, start, read and publish of
+// each sensor
+#define SENSOR_REGISTRY_HANDLER_COUNT   (1 + 3 * SENSOR_COUNT)
+
+/*******************************************************************************
+*   Function declarations
+*******************************************************************************/
+
+/**
+ * @brief Scan the bus, bind the registered sensors found and start sampling
+ *        them.
+ *
+ * @param fd_epoll Event loop epoll descriptor.
+ * @param fd_i2c I2C master descriptor.
+ * @param p_callback Reading delivery callback.
+ *
+ * @return 0 on success, -1 if the scheduler timers could not be created.
+ *         Absent sensors are not an error, they are bound once found.
+ */
+int
+sensor_registry_init(int fd_epoll, int fd_i2c, sensor_reading_fn_t p_callback);
+
+/**
+ * @brief Get sensor by identifier.
+ */
+sensor_t *
+sensor_registry_get(sensor_id_t id);
+
+/**
+ * @brief Get devices found by the last bus scan.
+ */
+const i2c_scan_map_t *
+sensor_registry_get_bus_map(void);
+
+/**
+ * @brief Get latest readings merged over all sensors.
+ *
+ * Quantities of sensors without a reading for SENSOR_STALE_PERIODS periods,
+ * e.g. unplugged or isolated, are flagged stale.
+ */
+const sensor_reading_t *
+sensor_registry_get_latest(void);
+
+/**
+ * @brief Set sampling period of all sensors, 0 = period of sensor_config.h.
+ *
+ * Longer periods of the descriptor are kept. Idle sensors are rescheduled
+ * from the start of their current period.
+ */
+void
+sensor_registry_set_period(uint32_t period_ms);
+
+/**
+ * @brief Set the callback run when the bus is stuck.
+ */
+void
+sensor_registry_set_bus_recovery(sensor_bus_recovery_fn_t p_recovery);
+
+/**
+ * @brief Get the number of bus recoveries since start.
+ */
+uint32_t
+sensor_registry_get_bus_recoveries(void);
+
+/**
+ * @brief Write sensor health counters since start as JSON.
+ *
+ * Format: {"name":[state,errors,retries,breakerOpens],...,"busRecoveries":n}
+ *
+ * @return Length of the JSON text, -1 if the buffer is too small.
+ */
+int
+sensor_registry_health_to_json(char *p_buffer, size_t buffer_size);
+
+/**
+ * @brief Close all sensors and the scheduler timer.
+ */
+void
+sensor_registry_close(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SENSOR_REGISTRY_H
+
+/* [] END OF FILE */
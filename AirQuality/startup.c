@@ -0,0 +1,318 @@
+/***************************************************************************//**
+* @file    startup.c
+* @version 1.0.0
+*
+* @brief Start up steps run on the event loop in dependency order.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <applibs/log.h>
+
+#include "epoll_timerfd_utilities.h"
+#include "event_loop_stats.h"
+#include "startup.h"
+
+/*******************************************************************************
+* Data types
+*******************************************************************************/
+
+typedef struct
+{
+    uint32_t start_us;          // Since startup_begin()
+    uint32_t duration_us;
+} startup_timing_t;
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+static void
+startup_event_handler(EventData *p_event_data);
+
+static int
+next_step(uint32_t done_mask);
+
+static void
+finish(bool b_is_ok);
+
+static uint32_t
+elapsed_us(void);
+
+static bool
+append(char *p_buffer, size_t buffer_size, size_t *p_len,
+    const char *p_format, ...);
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+static const char *gp_milestone_names[STARTUP_MILESTONE_COUNT] = {
+    "firstScreen", "firstSample", "connected", "firstUpload"
+};
+
+static const startup_step_t *gp_steps = NULL;
+static size_t g_step_count = 0;
+static startup_done_fn_t gp_done_fn = NULL;
+
+static int g_fd_timer = -1;
+
+static EventData g_event_data_startup = {
+    .eventHandler = &startup_event_handler,
+    .name = "startup"
+};
+
+static uint64_t g_begin_us = 0;
+static uint32_t g_done_mask = 0;
+static startup_timing_t g_timings[STARTUP_STEPS_MAX];
+static uint32_t g_milestones_us[STARTUP_MILESTONE_COUNT];   // 0 = not yet
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+void
+startup_begin(void)
+{
+    g_begin_us = loop_stats_now_us();
+    g_done_mask = 0;
+    memset(g_timings, 0, sizeof(g_timings));
+    memset(g_milestones_us, 0, sizeof(g_milestones_us));
+}
+
+int
+startup_run(int fd_epoll, const startup_step_t *p_steps, size_t count,
+    startup_done_fn_t done_fn)
+{
+    static const struct timespec next = { 0, 1 };
+
+    if ((count == 0) || (count > STARTUP_STEPS_MAX))
+    {
+        return -1;
+    }
+
+    gp_steps = p_steps;
+    g_step_count = count;
+    gp_done_fn = done_fn;
+    g_done_mask = 0;
+
+    // Dry run, every step must become ready once the ones before are done
+    uint32_t mask = 0;
+    for (size_t idx = 0; idx < count; idx++)
+    {
+        int step = next_step(mask);
+        if (step < 0)
+        {
+            Log_Debug("ERROR: start up step dependencies cannot be met.\n");
+            return -1;
+        }
+        mask |= STARTUP_AFTER(step);
+    }
+
+    g_fd_timer = CreateTimerFdAndAddToEpoll(fd_epoll, &next,
+        &g_event_data_startup, EPOLLIN);
+
+    return (g_fd_timer < 0) ? -1 : 0;
+}
+
+bool
+startup_is_done(size_t step)
+{
+    return (step < STARTUP_STEPS_MAX) &&
+        ((g_done_mask & STARTUP_AFTER(step)) != 0);
+}
+
+bool
+startup_mark(startup_milestone_t milestone)
+{
+    if ((milestone >= STARTUP_MILESTONE_COUNT) ||
+        (g_milestones_us[milestone] != 0))
+    {
+        return false;
+    }
+
+    uint32_t time_us = elapsed_us();
+    g_milestones_us[milestone] = (time_us > 0) ? time_us : 1;
+    return true;
+}
+
+uint32_t
+startup_get_ms(startup_milestone_t milestone)
+{
+    return (milestone < STARTUP_MILESTONE_COUNT) ?
+        (g_milestones_us[milestone] + 999u) / 1000u : 0;
+}
+
+int
+startup_to_json(char *p_buffer, size_t buffer_size, bool b_with_steps)
+{
+    size_t len = 0;
+    bool b_is_ok = append(p_buffer, buffer_size, &len, "{");
+    const char *p_separator = "";
+
+    for (size_t idx = 0; b_is_ok && b_with_steps && (idx < g_step_count); idx++)
+    {
+        b_is_ok = append(p_buffer, buffer_size, &len,
+            "%s\"%s\":[%lu.%lu,%lu.%lu]", (idx > 0) ? "," : "\"steps\":{",
+            gp_steps[idx].name,
+            (unsigned long)(g_timings[idx].start_us / 1000u),
+            (unsigned long)(g_timings[idx].start_us % 1000u / 100u),
+            (unsigned long)(g_timings[idx].duration_us / 1000u),
+            (unsigned long)(g_timings[idx].duration_us % 1000u / 100u));
+    }
+    if (b_with_steps && (g_step_count > 0))
+    {
+        b_is_ok = b_is_ok && append(p_buffer, buffer_size, &len, "}");
+        p_separator = ",";
+    }
+
+    for (int milestone = 0; b_is_ok && (milestone < STARTUP_MILESTONE_COUNT);
+        milestone++)
+    {
+        if (g_milestones_us[milestone] != 0)
+        {
+            b_is_ok = append(p_buffer, buffer_size, &len, "%s\"%s\":%lu",
+                p_separator, gp_milestone_names[milestone],
+                (unsigned long)startup_get_ms((startup_milestone_t)milestone));
+            p_separator = ",";
+        }
+    }
+    b_is_ok = b_is_ok && append(p_buffer, buffer_size, &len, "}");
+
+    return b_is_ok ? (int)len : -1;
+}
+
+void
+startup_log(void)
+{
+    for (size_t idx = 0; idx < g_step_count; idx++)
+    {
+        Log_Debug("Start up: %-8s at %6lu us, took %6lu us%s\n",
+            gp_steps[idx].name, (unsigned long)g_timings[idx].start_us,
+            (unsigned long)g_timings[idx].duration_us,
+            startup_is_done(idx) ? "" : ", not done");
+    }
+
+    for (int milestone = 0; milestone < STARTUP_MILESTONE_COUNT; milestone++)
+    {
+        if (g_milestones_us[milestone] != 0)
+        {
+            Log_Debug("Start up: %s after %lu ms\n",
+                gp_milestone_names[milestone],
+                (unsigned long)startup_get_ms((startup_milestone_t)milestone));
+        }
+    }
+}
+
+void
+startup_close(void)
+{
+    CloseFdAndPrintError(g_fd_timer, "Start up timer");
+    g_fd_timer = -1;
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+static void
+startup_event_handler(EventData *p_event_data)
+{
+    static const struct timespec next = { 0, 1 };
+
+    if (ConsumeTimerFdEvent(g_fd_timer) != 0)
+    {
+        finish(false);
+        return;
+    }
+
+    int step = next_step(g_done_mask);
+    if (step < 0)
+    {
+        // Checked by startup_run()
+        finish(false);
+        return;
+    }
+
+    startup_timing_t *p_timing = &g_timings[step];
+    p_timing->start_us = elapsed_us();
+    int result = gp_steps[step].run();
+    p_timing->duration_us = elapsed_us() - p_timing->start_us;
+
+    if (result != 0)
+    {
+        Log_Debug("ERROR: start up step %s failed.\n", gp_steps[step].name);
+        finish(false);
+        return;
+    }
+
+    g_done_mask |= STARTUP_AFTER(step);
+    if (g_done_mask == (uint32_t)((1ull << g_step_count) - 1u))
+    {
+        finish(true);
+    }
+    else if (SetTimerFdToSingleExpiry(g_fd_timer, &next) != 0)
+    {
+        finish(false);
+    }
+}
+
+static int
+next_step(uint32_t done_mask)
+{
+    for (size_t idx = 0; idx < g_step_count; idx++)
+    {
+        if (((done_mask & STARTUP_AFTER(idx)) == 0) &&
+            ((gp_steps[idx].depends & ~done_mask) == 0))
+        {
+            return (int)idx;
+        }
+    }
+
+    return -1;
+}
+
+static void
+finish(bool b_is_ok)
+{
+    startup_close();
+
+    if (gp_done_fn != NULL)
+    {
+        gp_done_fn(b_is_ok);
+    }
+}
+
+static uint32_t
+elapsed_us(void)
+{
+    return (uint32_t)(loop_stats_now_us() - g_begin_us);
+}
+
+static bool
+append(char *p_buffer, size_t buffer_size, size_t *p_len,
+    const char *p_format, ...)
+{
+    va_list args;
+    va_start(args, p_format);
+    int written = vsnprintf(p_buffer + *p_len, buffer_size - *p_len, p_format,
+        args);
+    va_end(args);
+
+    if ((written < 0) || ((size_t)written >= buffer_size - *p_len))
+    {
+        return false;
+    }
+
+    *p_len += (size_t)written;
+    return true;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,149 @@
+/***************************************************************************//**
+* @file    startup.h
+* @version 1.0.0
+*
+* @brief Start up steps run on the event loop in dependency order.
+*
+* Initialization is a table of steps, each with the mask of steps it
+* depends on. One step is run per event loop event: the first step of the
+* table whose dependencies are done, so the table order is the priority
+* among the steps ready to run. Between the steps the event loop serves
+* sensor readings, display updates and the IoT Hub client, e.g. the
+* CCS811 starts measuring while the steps after the sensors still run.
+*
+* Each step is timed from startup_begin(), as are the milestones the
+* application marks, like the first sample shown or uploaded.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+#define STARTUP_STEPS_MAX       (32)    // Bits of a dependency mask
+
+// Dependency mask bit of step
+#define STARTUP_AFTER(step)     (1u << (step))
+
+/*******************************************************************************
+*   Data types
+*******************************************************************************/
+
+typedef enum
+{
+    STARTUP_MILESTONE_FIRST_SCREEN,     // First frame on the display
+    STARTUP_MILESTONE_FIRST_SAMPLE,     // First reading of any sensor
+    STARTUP_MILESTONE_CONNECTED,        // IoT Hub connection established
+    STARTUP_MILESTONE_FIRST_UPLOAD,     // First telemetry message delivered
+    STARTUP_MILESTONE_COUNT
+} startup_milestone_t;
+
+/**
+ * @brief Start up step.
+ *
+ * @return 0 on success, -1 if the application cannot run.
+ */
+typedef int (*startup_step_fn_t)(void);
+
+typedef struct
+{
+    const char *name;           // Log and JSON name
+    startup_step_fn_t run;
+    uint32_t depends;           // STARTUP_AFTER() of the steps run before
+} startup_step_t;
+
+/**
+ * @brief Called once all steps are done or one has failed.
+ */
+typedef void (*startup_done_fn_t)(bool b_is_ok);
+
+/*******************************************************************************
+*   Function declarations
+*******************************************************************************/
+
+/**
+ * @brief Set the time origin of step and milestone timing, the start of
+ *        main().
+ */
+void
+startup_begin(void);
+
+/**
+ * @brief Start running steps from the event loop.
+ *
+ * Steps and the table must stay valid until done_fn is called.
+ *
+ * @return -1 if the dependencies cannot be met or the step timer could not
+ *         be created, 0 otherwise.
+ */
+int
+startup_run(int fd_epoll, const startup_step_t *p_steps, size_t count,
+    startup_done_fn_t done_fn);
+
+/**
+ * @brief Check if step has been run successfully.
+ */
+bool
+startup_is_done(size_t step);
+
+/**
+ * @brief Record milestone time, the first time it is reached.
+ *
+ * @return true the first time.
+ */
+bool
+startup_mark(startup_milestone_t milestone);
+
+/**
+ * @brief Get time of milestone since startup_begin() [ms], 0 if not
+ *        reached.
+ */
+uint32_t
+startup_get_ms(startup_milestone_t milestone);
+
+/**
+ * @brief Format milestone times and optionally step times as JSON:
+ *
+ *   {"steps":{"i2c":[startMs,durationMs],...},"firstScreen":ms,...}
+ *
+ * Milestones not reached are left out.
+ *
+ * @return Length of the string, -1 if it does not fit.
+ */
+int
+startup_to_json(char *p_buffer, size_t buffer_size, bool b_with_steps);
+
+/**
+ * @brief Log step and milestone times.
+ */
+void
+startup_log(void);
+
+/**
+ * @brief Close step timer if steps are still running.
+ */
+void
+startup_close(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // STARTUP_H
+
+/* [] END OF FILE */
@@ -0,0 +1,185 @@
+/***************************************************************************//**
+* @file    telemetry.c
+* @version 1.0.0
+*
+* @brief Telemetry message encoding.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "iaq.h"
+#include "measurement.h"
+#include "telemetry.h"
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+static bool
+append(char *p_buffer, size_t buffer_size, size_t *p_len,
+    const char *p_format, ...);
+
+static void
+format_value(const anomaly_t *p_anomaly, int32_t value, char *p_buffer,
+    size_t buffer_size);
+
+static void
+format_kinds(uint32_t kinds, char *p_buffer, size_t buffer_size);
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+int
+telemetry_format_sample(const telemetry_sample_t *p_sample, char *p_buffer,
+    size_t buffer_size)
+{
+    char temperature[MEASUREMENT_TEXT_SIZE];
+    char humidity[MEASUREMENT_TEXT_SIZE];
+    uint32_t usable = SENSOR_USABLE(p_sample->valid, p_sample->flags);
+    size_t len = 0;
+    bool b_is_ok = append(p_buffer, buffer_size, &len, "{");
+
+    // Values are formatted with 1 decimal, without float formatting
+    measurement_format(p_sample->temperature, 1, temperature,
+        sizeof(temperature));
+    measurement_format(p_sample->humidity, 1, humidity, sizeof(humidity));
+
+    // Unusable quantities are left out, the flags tell why
+    if (usable & SENSOR_QUANTITY_ECO2)
+    {
+        b_is_ok &= append(p_buffer, buffer_size, &len, "%s\"eco2\":\"%d\"",
+            (len > 1) ? ", " : "", p_sample->eco2);
+    }
+    if (usable & SENSOR_QUANTITY_TVOC)
+    {
+        b_is_ok &= append(p_buffer, buffer_size, &len, "%s\"tvoc\":\"%d\"",
+            (len > 1) ? ", " : "", p_sample->tvoc);
+    }
+    if (usable & SENSOR_QUANTITY_TEMPERATURE)
+    {
+        b_is_ok &= append(p_buffer, buffer_size, &len,
+            "%s\"temperature\":\"%s\"", (len > 1) ? ", " : "", temperature);
+    }
+    if (usable & SENSOR_QUANTITY_HUMIDITY)
+    {
+        b_is_ok &= append(p_buffer, buffer_size, &len,
+            "%s\"humidity\":\"%s\"", (len > 1) ? ", " : "", humidity);
+    }
+    if (p_sample->iaq != TELEMETRY_IAQ_NONE)
+    {
+        b_is_ok &= append(p_buffer, buffer_size, &len,
+            "%s\"iaq\":\"%u\", \"iaqBand\":\"%s\"", (len > 1) ? ", " : "",
+            p_sample->iaq, iaq_get_band_name(iaq_get_band(p_sample->iaq)));
+    }
+    if (p_sample->flags != 0)
+    {
+        b_is_ok &= append(p_buffer, buffer_size, &len,
+            "%s\"flags\":\"0x%06lX\"", (len > 1) ? ", " : "",
+            (unsigned long)p_sample->flags);
+    }
+    b_is_ok &= append(p_buffer, buffer_size, &len, "}");
+
+    return b_is_ok ? (int)len : -1;
+}
+
+int
+telemetry_format_alert(const anomaly_t *p_anomaly, uint32_t raised,
+    char *p_buffer, size_t buffer_size)
+{
+    char value[MEASUREMENT_TEXT_SIZE];
+    char mean[MEASUREMENT_TEXT_SIZE];
+    char rate[MEASUREMENT_TEXT_SIZE];
+    char raised_kinds[32];
+    char active_kinds[32];
+
+    format_value(p_anomaly, p_anomaly->last_value, value, sizeof(value));
+    format_value(p_anomaly, anomaly_get_mean(p_anomaly), mean, sizeof(mean));
+    format_value(p_anomaly, p_anomaly->rate_per_min, rate, sizeof(rate));
+    format_kinds(raised, raised_kinds, sizeof(raised_kinds));
+    format_kinds(p_anomaly->active, active_kinds, sizeof(active_kinds));
+
+    int written = snprintf(p_buffer, buffer_size,
+        "{\"alert\":{\"metric\":\"%s\",\"value\":\"%s\",\"mean\":\"%s\","
+        "\"ratePerMin\":\"%s\",\"raised\":[%s],\"active\":[%s]}}",
+        p_anomaly->p_config->name, value, mean, rate, raised_kinds,
+        active_kinds);
+
+    return ((written < 0) || ((size_t)written >= buffer_size)) ? -1 : written;
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+/**
+ * @brief Append formatted text at *p_len, advancing it.
+ *
+ * @return false if the text does not fit.
+ */
+static bool
+append(char *p_buffer, size_t buffer_size, size_t *p_len,
+    const char *p_format, ...)
+{
+    if (*p_len >= buffer_size)
+    {
+        return false;
+    }
+
+    va_list args;
+    va_start(args, p_format);
+    int written = vsnprintf(p_buffer + *p_len, buffer_size - *p_len, p_format,
+        args);
+    va_end(args);
+
+    if ((written < 0) || ((size_t)written >= buffer_size - *p_len))
+    {
+        *p_len = buffer_size;
+        return false;
+    }
+
+    *p_len += (size_t)written;
+    return true;
+}
+
+static void
+format_value(const anomaly_t *p_anomaly, int32_t value, char *p_buffer,
+    size_t buffer_size)
+{
+    if (p_anomaly->p_config->b_is_centi)
+    {
+        measurement_format(value, 1, p_buffer, buffer_size);
+    }
+    else
+    {
+        snprintf(p_buffer, buffer_size, "%ld", (long)value);
+    }
+}
+
+static void
+format_kinds(uint32_t kinds, char *p_buffer, size_t buffer_size)
+{
+    static const char *p_names[] = { "\"level\"", "\"rise\"", "\"shift\"" };
+    size_t len = 0;
+
+    p_buffer[0] = '\0';
+    for (size_t idx = 0; idx < sizeof(p_names) / sizeof(p_names[0]); idx++)
+    {
+        if ((kinds & (1u << idx)) &&
+            (len + strlen(p_names[idx]) + 2 <= buffer_size))
+        {
+            len += (size_t)snprintf(p_buffer + len, buffer_size - len, "%s%s",
+                (len > 0) ? "," : "", p_names[idx]);
+        }
+    }
+}
+
+/* [] END OF FILE */
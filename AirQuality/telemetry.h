@@ -0,0 +1,98 @@
+/***************************************************************************//**
+* @file    telemetry.h
+* @version 1.0.0
+*
+* @brief Telemetry message encoding.
+*
+* Shared by the application and the host side fleet simulator so that both
+* produce identical upload messages.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "anomaly.h"
+#include "sensor_quality.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+// Buffer size sufficient for any encoded sample or alert
+#define TELEMETRY_BUFFER_SIZE       (192)
+
+// telemetry_sample_t iaq value when no index is available yet
+#define TELEMETRY_IAQ_NONE          (UINT16_MAX)
+
+/*******************************************************************************
+*   Data types
+*******************************************************************************/
+
+typedef struct
+{
+    int16_t eco2;               // Equivalent CO2 [ppm]
+    int16_t tvoc;               // Total VOC [ppb]
+    int16_t temperature;        // Temperature [0.01 degC]
+    uint16_t humidity;          // Relative humidity [0.01 %RH]
+    uint16_t iaq;               // Indoor air quality index or TELEMETRY_IAQ_NONE
+    uint32_t valid;             // SENSOR_QUANTITY_* holding data
+    uint32_t flags;             // SENSOR_FLAG_* of the quantities
+} telemetry_sample_t;
+
+/*******************************************************************************
+*   Function declarations
+*******************************************************************************/
+
+/**
+ * @brief Encode measurement sample as JSON upload message.
+ *
+ * Only usable quantities (SENSOR_USABLE) are sent, quality flags as hex
+ * string "flags" when set. The IAQ index is sent with its band name, e.g.
+ * "iaq":"87","iaqBand":"good".
+ *
+ * @param p_sample Pointer to sample.
+ * @param p_buffer Output buffer.
+ * @param buffer_size Output buffer size.
+ *
+ * @return Length of message written, -1 if it does not fit.
+ */
+int
+telemetry_format_sample(const telemetry_sample_t *p_sample, char *p_buffer,
+    size_t buffer_size);
+
+/**
+ * @brief Encode an anomaly alert as JSON message.
+ *
+ * Format: {"alert":{"metric":"eco2","value":"1520","mean":"830",
+ *          "ratePerMin":"310","raised":["level"],"active":["level","rise"]}}
+ *
+ * @param p_anomaly Detector of the metric.
+ * @param raised ANOMALY_* kinds raised by the last sample.
+ * @param p_buffer Output buffer.
+ * @param buffer_size Output buffer size.
+ *
+ * @return Length of message written, -1 if it does not fit.
+ */
+int
+telemetry_format_alert(const anomaly_t *p_anomaly, uint32_t raised,
+    char *p_buffer, size_t buffer_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // TELEMETRY_H
+
+/* [] END OF FILE */
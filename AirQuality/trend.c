@@ -0,0 +1,108 @@
+/***************************************************************************//**
+* @file    trend.c
+* @version 1.0.0
+*
+* @brief Sample history summarized per graph column.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include "trend.h"
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+static const trend_column_t g_empty_column = { UINT16_MAX, 0 };
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+static void
+trend_commit(trend_t *p_trend);
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+void
+trend_init(trend_t *p_trend, uint32_t span_ms)
+{
+    for (uint32_t idx = 0; idx < TREND_COLUMNS; idx++)
+    {
+        p_trend->columns[idx] = g_empty_column;
+    }
+    p_trend->oldest = 0;
+    p_trend->open = g_empty_column;
+    p_trend->column_ms = (span_ms >= TREND_COLUMNS) ?
+        span_ms / TREND_COLUMNS : 1;
+    p_trend->open_end_ms = 0;
+}
+
+uint32_t
+trend_add(trend_t *p_trend, uint16_t value, uint64_t now_ms)
+{
+    uint32_t committed = 0;
+
+    if (p_trend->open_end_ms == 0)
+    {
+        p_trend->open_end_ms = now_ms + p_trend->column_ms;
+    }
+    else if (now_ms >= p_trend->open_end_ms)
+    {
+        // Columns over, beyond a full graph only the count matters
+        uint64_t over = (now_ms - p_trend->open_end_ms) / p_trend->column_ms
+            + 1;
+
+        committed = (over < TREND_COLUMNS) ? (uint32_t)over : TREND_COLUMNS;
+        for (uint32_t idx = 0; idx < committed; idx++)
+        {
+            trend_commit(p_trend);
+        }
+        p_trend->open_end_ms += over * p_trend->column_ms;
+    }
+
+    if (value < p_trend->open.min)
+    {
+        p_trend->open.min = value;
+    }
+    if (value > p_trend->open.max)
+    {
+        p_trend->open.max = value;
+    }
+
+    return committed;
+}
+
+const trend_column_t *
+trend_get_column(const trend_t *p_trend, uint32_t index)
+{
+    return &p_trend->columns[(p_trend->oldest + index) % TREND_COLUMNS];
+}
+
+bool
+trend_column_is_empty(const trend_column_t *p_column)
+{
+    return p_column->min > p_column->max;
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+/**
+ * @brief Move open column to the ring over the oldest one, open empty column.
+ */
+static void
+trend_commit(trend_t *p_trend)
+{
+    p_trend->columns[p_trend->oldest] = p_trend->open;
+    p_trend->oldest = (uint16_t)((p_trend->oldest + 1) % TREND_COLUMNS);
+    p_trend->open = g_empty_column;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,102 @@
+/***************************************************************************//**
+* @file    trend.h
+* @version 1.0.0
+*
+* @brief Sample history summarized per graph column.
+*
+* The history of a quantity is kept as TREND_COLUMNS columns, each with the
+* minimum and maximum of the readings over column_ms. Readings are folded
+* into the open column as they arrive; when its time is over the column is
+* committed to a ring and a new one opened. Graphs are drawn from the
+* committed columns only, so no raw readings are stored or rescanned.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef TREND_H
+#define TREND_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+// Columns of history, width of the graph on the rotated display
+#ifndef TREND_COLUMNS
+#define TREND_COLUMNS           (64)
+#endif
+
+// History shown on the display
+#define TREND_SPAN_MS           (4u * 60u * 60u * 1000u)
+
+/*******************************************************************************
+*   Data types
+*******************************************************************************/
+
+// Readings summary of a column, min > max while it has no readings
+typedef struct
+{
+    uint16_t min;
+    uint16_t max;
+} trend_column_t;
+
+typedef struct
+{
+    trend_column_t columns[TREND_COLUMNS];  // Ring of committed columns
+    uint16_t oldest;                        // Ring index of the oldest
+    trend_column_t open;                    // Column being filled
+    uint32_t column_ms;                     // Time covered by a column
+    uint64_t open_end_ms;                   // End of the open column, 0 if
+                                            // no reading was added yet
+} trend_t;
+
+/*******************************************************************************
+*   Function declarations
+*******************************************************************************/
+
+/**
+ * @brief Clear history covering span_ms over all columns.
+ */
+void
+trend_init(trend_t *p_trend, uint32_t span_ms);
+
+/**
+ * @brief Add reading taken at now_ms.
+ *
+ * Columns whose time is over are committed first, empty ones for gaps
+ * between readings.
+ *
+ * @return Number of columns committed, at most TREND_COLUMNS.
+ */
+uint32_t
+trend_add(trend_t *p_trend, uint16_t value, uint64_t now_ms);
+
+/**
+ * @brief Get committed column, 0 is the oldest, TREND_COLUMNS - 1 the
+ *        newest.
+ */
+const trend_column_t *
+trend_get_column(const trend_t *p_trend, uint32_t index);
+
+/**
+ * @brief Check if column holds readings.
+ */
+bool
+trend_column_is_empty(const trend_column_t *p_column);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // TREND_H
+
+/* [] END OF FILE */
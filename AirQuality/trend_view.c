@@ -0,0 +1,212 @@
+/***************************************************************************//**
+* @file    trend_view.c
+* @version 1.0.0
+*
+* @brief Trend graph of the sample history on the OLED.
+*
+* The full buffer of the SSD1306 is organized in pages of 8 pixel rows, one
+* byte per pixel column with the top row in bit 0. With U8G2_R0 a graph
+* column is a bit in consecutive bytes of a page, with U8G2_R1 (rotated 90
+* degrees clockwise) it is a physical pixel row, so the graph scrolls by
+* shifting bytes within pages, or bits across pages respectively.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <stdbool.h>
+
+#include "trend_view.h"
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+static uint16_t
+graph_left(u8g2_t *p_u8g2);
+
+static void
+draw_column(u8g2_t *p_u8g2, const trend_view_t *p_view,
+    const trend_t *p_trend, uint32_t index);
+
+static uint16_t
+value_to_row(const trend_view_t *p_view, uint16_t value);
+
+static bool
+scroll_r0(u8g2_t *p_u8g2, const trend_view_t *p_view);
+
+static bool
+scroll_r1(u8g2_t *p_u8g2, const trend_view_t *p_view);
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+void
+trend_view_draw(u8g2_t *p_u8g2, const trend_view_t *p_view,
+    const trend_t *p_trend)
+{
+    for (uint32_t idx = 0; idx < TREND_COLUMNS; idx++)
+    {
+        draw_column(p_u8g2, p_view, p_trend, idx);
+    }
+}
+
+void
+trend_view_advance(u8g2_t *p_u8g2, const trend_view_t *p_view,
+    const trend_t *p_trend, uint32_t columns)
+{
+    bool b_is_scrolled = (columns < TREND_COLUMNS);
+
+    for (uint32_t idx = 0; b_is_scrolled && (idx < columns); idx++)
+    {
+        b_is_scrolled = scroll_r0(p_u8g2, p_view) ||
+            scroll_r1(p_u8g2, p_view);
+    }
+
+    if (b_is_scrolled)
+    {
+        for (uint32_t idx = TREND_COLUMNS - columns; idx < TREND_COLUMNS;
+            idx++)
+        {
+            draw_column(p_u8g2, p_view, p_trend, idx);
+        }
+    }
+    else
+    {
+        u8g2_SetDrawColor(p_u8g2, 0);
+        u8g2_DrawBox(p_u8g2, graph_left(p_u8g2), p_view->y, TREND_COLUMNS,
+            p_view->height);
+        u8g2_SetDrawColor(p_u8g2, 1);
+        trend_view_draw(p_u8g2, p_view, p_trend);
+    }
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+/**
+ * @brief Leftmost pixel column of the graph, the graph is right aligned.
+ */
+static uint16_t
+graph_left(u8g2_t *p_u8g2)
+{
+    uint16_t width = u8g2_GetDisplayWidth(p_u8g2);
+
+    return (width > TREND_COLUMNS) ? (uint16_t)(width - TREND_COLUMNS) : 0;
+}
+
+static void
+draw_column(u8g2_t *p_u8g2, const trend_view_t *p_view,
+    const trend_t *p_trend, uint32_t index)
+{
+    const trend_column_t *p_column = trend_get_column(p_trend, index);
+
+    if (!trend_column_is_empty(p_column))
+    {
+        uint16_t top = value_to_row(p_view, p_column->max);
+        uint16_t bottom = value_to_row(p_view, p_column->min);
+
+        u8g2_DrawVLine(p_u8g2, (uint16_t)(graph_left(p_u8g2) + index), top,
+            (uint16_t)(bottom - top + 1));
+    }
+}
+
+static uint16_t
+value_to_row(const trend_view_t *p_view, uint16_t value)
+{
+    uint32_t offset = 0;
+
+    if (value >= p_view->max)
+    {
+        offset = p_view->height - 1u;
+    }
+    else if (value > p_view->min)
+    {
+        offset = (uint32_t)(value - p_view->min) * (p_view->height - 1u) /
+            (uint32_t)(p_view->max - p_view->min);
+    }
+
+    return (uint16_t)(p_view->y + p_view->height - 1u - offset);
+}
+
+/**
+ * @brief Scroll graph rows left by one column, unrotated display.
+ */
+static bool
+scroll_r0(u8g2_t *p_u8g2, const trend_view_t *p_view)
+{
+    if (p_u8g2->cb != U8G2_R0)
+    {
+        return false;
+    }
+
+    uint8_t *p_buffer = u8g2_GetBufferPtr(p_u8g2);
+    uint16_t width = (uint16_t)(u8g2_GetBufferTileWidth(p_u8g2) * 8u);
+    uint16_t left = graph_left(p_u8g2);
+    uint16_t last_row = (uint16_t)(p_view->y + p_view->height - 1u);
+
+    for (uint16_t page = p_view->y / 8u; page <= last_row / 8u; page++)
+    {
+        // Graph rows within the page
+        uint8_t mask = 0xFF;
+        if (page == p_view->y / 8u)
+        {
+            mask &= (uint8_t)(0xFF << (p_view->y % 8u));
+        }
+        if (page == last_row / 8u)
+        {
+            mask &= (uint8_t)(0xFF >> (7u - last_row % 8u));
+        }
+
+        uint8_t *p_page = &p_buffer[page * width];
+        for (uint16_t x = left; x + 1u < width; x++)
+        {
+            p_page[x] = (uint8_t)((p_page[x] & ~mask) | (p_page[x + 1] & mask));
+        }
+        p_page[width - 1] &= (uint8_t)~mask;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Scroll graph rows left by one column, display rotated clockwise.
+ *
+ * Graph column x is the physical pixel row x, graph row y the physical
+ * pixel column width - 1 - y. Each physical column of the graph is shifted
+ * up by one bit across the pages from the graph left edge downwards.
+ */
+static bool
+scroll_r1(u8g2_t *p_u8g2, const trend_view_t *p_view)
+{
+    uint16_t left = graph_left(p_u8g2);
+
+    if ((p_u8g2->cb != U8G2_R1) || (left % 8u != 0))
+    {
+        return false;
+    }
+
+    uint8_t *p_buffer = u8g2_GetBufferPtr(p_u8g2);
+    uint16_t width = (uint16_t)(u8g2_GetBufferTileWidth(p_u8g2) * 8u);
+    uint16_t pages = u8g2_GetBufferTileHeight(p_u8g2);
+
+    for (uint16_t x = (uint16_t)(width - p_view->y - p_view->height);
+        x < width - p_view->y; x++)
+    {
+        uint8_t carry = 0;
+        for (uint16_t page = pages; page-- > left / 8u; )
+        {
+            uint8_t bits = p_buffer[page * width + x];
+            p_buffer[page * width + x] = (uint8_t)((bits >> 1) | (carry << 7));
+            carry = bits & 1u;
+        }
+    }
+
+    return true;
+}
+
+/* [] END OF FILE */
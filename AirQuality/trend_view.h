@@ -0,0 +1,72 @@
+/***************************************************************************//**
+* @file    trend_view.h
+* @version 1.0.0
+*
+* @brief Trend graph of the sample history on the OLED.
+*
+* A graph shows one vertical line per trend column, from the column minimum
+* to its maximum, the newest column at the right edge of the display. When
+* columns are committed the graph region of the u8g2 frame buffer is
+* scrolled left in place and only the new columns are drawn; the whole
+* graph is drawn from the column summaries when the screen is entered.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef TREND_VIEW_H
+#define TREND_VIEW_H
+
+#include <stdint.h>
+
+#include "lib_u8g2.h"
+#include "trend.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+*   Data types
+*******************************************************************************/
+
+typedef struct
+{
+    uint16_t y;                 // Top row of the graph
+    uint16_t height;            // Rows of the graph
+    uint16_t min;               // Value at the bottom row
+    uint16_t max;               // Value at the top row, higher values clipped
+} trend_view_t;
+
+/*******************************************************************************
+*   Function declarations
+*******************************************************************************/
+
+/**
+ * @brief Draw all columns into the frame buffer, the graph region must have
+ *        been cleared.
+ */
+void
+trend_view_draw(u8g2_t *p_u8g2, const trend_view_t *p_view,
+    const trend_t *p_trend);
+
+/**
+ * @brief Scroll graph by the number of newly committed columns and draw
+ *        them.
+ *
+ * The frame buffer is scrolled with display rotations U8G2_R0 and U8G2_R1,
+ * with others the graph region is cleared and drawn again.
+ */
+void
+trend_view_advance(u8g2_t *p_u8g2, const trend_view_t *p_view,
+    const trend_t *p_trend, uint32_t columns);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // TREND_VIEW_H
+
+/* [] END OF FILE */
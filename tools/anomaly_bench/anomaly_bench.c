@@ -0,0 +1,461 @@
+/***************************************************************************//**
+* @file    anomaly_bench.c
+* @version 1.0.0
+*
+* @brief Host side replay benchmark of the streaming anomaly detector.
+*
+* Replays traces at the 1 s sampling rate through anomaly_update() and
+* compares the time to the first on-device alert with a cloud side check
+* that only sees the values uploaded every upload period (60 s) and
+* compares them to the level limit. Alerts raised before the event of a
+* trace are counted as false alarms.
+*
+* Built in traces model recorded situations: a quiet office with CCS811
+* outlier samples, an occupancy eCO2 ramp, a VOC burst, a humidity step
+* and a heater temperature ramp. With -f a recorded trace is replayed,
+* lines "seconds,value" with values in metric units (0.01 for temperature
+* and humidity), the event start is given by -e.
+*
+* Build on a Linux host from the repository root:
+*
+*   gcc -O2 -std=gnu11 -I AirQuality -o anomaly_bench \
+*       tools/anomaly_bench/anomaly_bench.c AirQuality/anomaly.c
+*
+* Example, replay of a recorded eCO2 trace with the event at 3600 s:
+*
+*   ./anomaly_bench -f office.csv -m eco2 -e 3600
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "anomaly.h"
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+#define BENCH_TRACE_MAX_SAMPLES (4 * 3600 * 6)  // Six hours at 1 Hz
+#define BENCH_NO_EVENT          (UINT32_MAX)
+#define BENCH_TIMING_ROUNDS     (20)
+
+/*******************************************************************************
+*   Data types
+*******************************************************************************/
+
+typedef struct
+{
+    const char *p_name;
+    anomaly_metric_t metric;
+    uint32_t event_s;           // BENCH_NO_EVENT for a trace without event
+    uint32_t count;
+    uint32_t *p_seconds;
+    int32_t *p_values;
+} bench_trace_t;
+
+typedef struct
+{
+    uint32_t alerts;
+    uint32_t false_alarms;
+    uint32_t first_alert_s;     // BENCH_NO_EVENT if not detected
+    uint32_t first_kinds;
+    uint32_t cloud_s;           // BENCH_NO_EVENT if not detected
+    double ns_per_sample;
+} bench_result_t;
+
+/*******************************************************************************
+*   Global variables
+*******************************************************************************/
+
+static uint32_t g_rng = 0x2545F491u;
+static uint32_t g_upload_period_s = 60;
+
+/*******************************************************************************
+*   Function definitions
+*******************************************************************************/
+
+static uint32_t
+rng_next(void)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return g_rng;
+}
+
+/**
+ * @brief Approximately normal noise, sum of four uniform values.
+ */
+static int32_t
+rng_noise(int32_t sigma)
+{
+    int32_t sum = 0;
+    for (int idx = 0; idx < 4; idx++)
+    {
+        sum += (int32_t)(rng_next() % 2001) - 1000;
+    }
+    return (int32_t)((int64_t)sum * sigma * 17 / 20000);
+}
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static bool
+trace_alloc(bench_trace_t *p_trace, const char *p_name,
+    anomaly_metric_t metric, uint32_t event_s)
+{
+    memset(p_trace, 0, sizeof(*p_trace));
+    p_trace->p_name = p_name;
+    p_trace->metric = metric;
+    p_trace->event_s = event_s;
+    p_trace->p_seconds = malloc(BENCH_TRACE_MAX_SAMPLES * sizeof(uint32_t));
+    p_trace->p_values = malloc(BENCH_TRACE_MAX_SAMPLES * sizeof(int32_t));
+
+    return (p_trace->p_seconds != NULL) && (p_trace->p_values != NULL);
+}
+
+static void
+trace_free(bench_trace_t *p_trace)
+{
+    free(p_trace->p_seconds);
+    free(p_trace->p_values);
+}
+
+static void
+trace_add(bench_trace_t *p_trace, uint32_t second, int32_t value)
+{
+    if (p_trace->count < BENCH_TRACE_MAX_SAMPLES)
+    {
+        p_trace->p_seconds[p_trace->count] = second;
+        p_trace->p_values[p_trace->count] = value;
+        p_trace->count++;
+    }
+}
+
+/**
+ * @brief Build a built in trace.
+ *
+ * @return false when the trace index is out of range.
+ */
+static bool
+trace_build(bench_trace_t *p_trace, int index)
+{
+    static const char *p_names[] = {
+        "quiet", "occupancy", "voc_burst", "humidity", "heater"
+    };
+    static const anomaly_metric_t metrics[] = {
+        ANOMALY_METRIC_ECO2, ANOMALY_METRIC_ECO2, ANOMALY_METRIC_TVOC,
+        ANOMALY_METRIC_HUMIDITY, ANOMALY_METRIC_TEMPERATURE
+    };
+    static const uint32_t events_s[] = {
+        BENCH_NO_EVENT, 1830, 915, 1210, 625
+    };
+
+    if ((index < 0) || (index >= (int)(sizeof(p_names) / sizeof(p_names[0]))))
+    {
+        return false;
+    }
+    if (!trace_alloc(p_trace, p_names[index], metrics[index], events_s[index]))
+    {
+        return false;
+    }
+
+    uint32_t duration_s = (index == 0) ? 4 * 3600 : 3600;
+    for (uint32_t sec = 0; sec < duration_s; sec++)
+    {
+        int32_t value = 0;
+        uint32_t since_s = (sec >= events_s[index]) ? sec - events_s[index] : 0;
+        bool b_is_after = (sec >= events_s[index]);
+
+        switch (index)
+        {
+            case 0:
+                // Slow daily drift and CCS811 outlier samples, 1 %
+                value = 450 + (int32_t)(sec / 240) + rng_noise(12);
+                if ((rng_next() % 100) == 0)
+                {
+                    value += 150 + (int32_t)(rng_next() % 150);
+                }
+                break;
+            case 1:
+                // Meeting starts, 8 ppm/s for 3 minutes, then holds
+                value = 520 + rng_noise(12);
+                if (b_is_after)
+                {
+                    value += (int32_t)((since_s < 180 ? since_s : 180) * 8);
+                }
+                break;
+            case 2:
+                // Cleaning spray, jump and decay
+                value = 90 + rng_noise(8);
+                if (b_is_after)
+                {
+                    value += (int32_t)(700 * 300 / (300 + since_s * 2));
+                }
+                break;
+            case 3:
+                // Window opened on a rainy day, 45 % to 60 %RH within 2 minutes
+                value = 4500 + rng_noise(40);
+                if (b_is_after)
+                {
+                    value += (int32_t)((since_s < 120 ? since_s : 120) * 1500 / 120);
+                }
+                break;
+            default:
+                // Heater next to the sensor, 2 degC/min up to 40 degC
+                value = 2200 + rng_noise(8);
+                if (b_is_after)
+                {
+                    value += (int32_t)((since_s < 540 ? since_s : 540) * 200 / 60);
+                }
+                break;
+        }
+        trace_add(p_trace, sec, value);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Load "seconds,value" lines.
+ */
+static bool
+trace_load(bench_trace_t *p_trace, const char *p_path,
+    anomaly_metric_t metric, uint32_t event_s)
+{
+    FILE *p_file = fopen(p_path, "r");
+    if ((p_file == NULL) || !trace_alloc(p_trace, p_path, metric, event_s))
+    {
+        fprintf(stderr, "Cannot read %s\n", p_path);
+        if (p_file != NULL)
+        {
+            fclose(p_file);
+        }
+        return false;
+    }
+
+    char line[128];
+    while (fgets(line, sizeof(line), p_file) != NULL)
+    {
+        unsigned long second;
+        long value;
+        if (sscanf(line, "%lu,%ld", &second, &value) == 2)
+        {
+            trace_add(p_trace, (uint32_t)second, (int32_t)value);
+        }
+    }
+    fclose(p_file);
+
+    return p_trace->count > 0;
+}
+
+static void
+trace_replay(const bench_trace_t *p_trace, bench_result_t *p_result)
+{
+    const anomaly_config_t *p_config = &anomaly_configs[p_trace->metric];
+    anomaly_t anomaly;
+
+    memset(p_result, 0, sizeof(*p_result));
+    p_result->first_alert_s = BENCH_NO_EVENT;
+    p_result->cloud_s = BENCH_NO_EVENT;
+    anomaly_init(&anomaly, p_config);
+
+    for (uint32_t idx = 0; idx < p_trace->count; idx++)
+    {
+        uint32_t second = p_trace->p_seconds[idx];
+        int32_t value = p_trace->p_values[idx];
+        uint32_t raised = anomaly_update(&anomaly, value,
+            (uint64_t)second * 1000000u);
+
+        if (raised != 0)
+        {
+            p_result->alerts++;
+            if (second < p_trace->event_s)
+            {
+                p_result->false_alarms++;
+            }
+            else if (p_result->first_alert_s == BENCH_NO_EVENT)
+            {
+                p_result->first_alert_s = second;
+                p_result->first_kinds = raised;
+            }
+        }
+
+        // Cloud side only sees the uploaded samples
+        if ((second >= p_trace->event_s) && (second % g_upload_period_s == 0) &&
+            (value >= p_config->level) && (p_result->cloud_s == BENCH_NO_EVENT))
+        {
+            p_result->cloud_s = second;
+        }
+    }
+
+    // Detector cost
+    uint64_t start_ns = now_ns();
+    int32_t checksum = 0;
+    for (int round = 0; round < BENCH_TIMING_ROUNDS; round++)
+    {
+        anomaly_init(&anomaly, p_config);
+        for (uint32_t idx = 0; idx < p_trace->count; idx++)
+        {
+            checksum += (int32_t)anomaly_update(&anomaly, p_trace->p_values[idx],
+                (uint64_t)p_trace->p_seconds[idx] * 1000000u);
+        }
+    }
+    p_result->ns_per_sample = (double)(now_ns() - start_ns) /
+        ((double)p_trace->count * BENCH_TIMING_ROUNDS);
+    if (checksum < 0)
+    {
+        fprintf(stderr, "Unexpected checksum\n");
+    }
+}
+
+static void
+format_delay(uint32_t detected_s, uint32_t event_s, char *p_buffer,
+    size_t buffer_size)
+{
+    if ((detected_s == BENCH_NO_EVENT) || (event_s == BENCH_NO_EVENT))
+    {
+        snprintf(p_buffer, buffer_size, "-");
+    }
+    else
+    {
+        snprintf(p_buffer, buffer_size, "%lu s",
+            (unsigned long)(detected_s - event_s));
+    }
+}
+
+static void
+print_result(const bench_trace_t *p_trace, const bench_result_t *p_result)
+{
+    char device[16];
+    char cloud[16];
+    char kinds[24];
+
+    format_delay(p_result->first_alert_s, p_trace->event_s, device,
+        sizeof(device));
+    format_delay(p_result->cloud_s, p_trace->event_s, cloud, sizeof(cloud));
+    snprintf(kinds, sizeof(kinds), "%s%s%s",
+        (p_result->first_kinds & ANOMALY_LEVEL) ? "level " : "",
+        (p_result->first_kinds & ANOMALY_RISE) ? "rise " : "",
+        (p_result->first_kinds & ANOMALY_SHIFT) ? "shift " : "");
+
+    printf("%-12s %-12s %8lu %8lu %8lu %10s %-14s %10s %8.1f\n",
+        p_trace->p_name, anomaly_configs[p_trace->metric].name,
+        (unsigned long)p_trace->count, (unsigned long)p_result->alerts,
+        (unsigned long)p_result->false_alarms, device, kinds, cloud,
+        p_result->ns_per_sample);
+}
+
+static bool
+parse_metric(const char *p_text, anomaly_metric_t *p_metric)
+{
+    for (int idx = 0; idx < ANOMALY_METRIC_COUNT; idx++)
+    {
+        if (strcmp(p_text, anomaly_configs[idx].name) == 0)
+        {
+            *p_metric = (anomaly_metric_t)idx;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void
+usage(const char *p_name)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -f file         replay recorded trace, \"seconds,value\" lines\n"
+        "  -m metric       metric of the recorded trace (eco2)\n"
+        "  -e seconds      event start in the recorded trace (none)\n"
+        "  -u seconds      cloud side upload period (60)\n"
+        "  -s seed         noise seed of the built in traces\n",
+        p_name);
+}
+
+/*******************************************************************************
+* Main program
+*******************************************************************************/
+
+int
+main(int argc, char *argv[])
+{
+    const char *p_path = NULL;
+    anomaly_metric_t metric = ANOMALY_METRIC_ECO2;
+    uint32_t event_s = BENCH_NO_EVENT;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:m:e:u:s:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 'f': p_path = optarg; break;
+            case 'm':
+                if (!parse_metric(optarg, &metric))
+                {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'e': event_s = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'u': g_upload_period_s = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 's': g_rng = (uint32_t)strtoul(optarg, NULL, 0) | 1u; break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (g_upload_period_s == 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("%-12s %-12s %8s %8s %8s %10s %-14s %10s %8s\n", "trace", "metric",
+        "samples", "alerts", "false", "device", "first", "cloud", "ns/sample");
+
+    bench_trace_t trace = { 0 };
+    bench_result_t result;
+    uint32_t false_alarms = 0;
+
+    if (p_path != NULL)
+    {
+        if (!trace_load(&trace, p_path, metric, event_s))
+        {
+            trace_free(&trace);
+            return 1;
+        }
+        trace_replay(&trace, &result);
+        print_result(&trace, &result);
+        trace_free(&trace);
+        return 0;
+    }
+
+    for (int index = 0; trace_build(&trace, index); index++)
+    {
+        trace_replay(&trace, &result);
+        print_result(&trace, &result);
+        false_alarms += result.false_alarms;
+        trace_free(&trace);
+    }
+
+    return (false_alarms > 0) ? 1 : 0;
+}
+
+/* [] END OF FILE */
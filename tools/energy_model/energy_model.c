@@ -0,0 +1,277 @@
+/***************************************************************************//**
+* @file    energy_model.c
+* @version 1.0.0
+*
+* @brief Host side energy model of the operating modes.
+*
+* Estimates the charge per day of the application with the model of
+* power_mode.c, in two ways:
+*
+*   profiles  expected activity of a day in each operating mode, derived
+*             from the timer cadences of its profile (power_mode.c)
+*   measured  activity counted by a device, the "power" array of the
+*             statistics record: [wakeups,samples,busBytes,radioOnSec,
+*             displayOnSec,mAhPerDay] over the statistics period
+*
+* The model coefficients can be overridden to calibrate them against a
+* current meter.
+*
+* Build on a Linux host from the repository root:
+*
+*   gcc -O2 -std=gnu11 -I AirQuality -o energy_model \
+*       tools/energy_model/energy_model.c AirQuality/power_mode.c
+*
+* Example, profiles with 20 button presses a day and a 2000 mAh battery:
+*
+*   ./energy_model -u 20 -B 2000
+*
+* Example, a record of a device in low power mode over one hour:
+*
+*   ./energy_model -m 36250,120,21800,52,30 -t 3600 -c 60000
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "power_mode.h"
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+#define MS_PER_DAY              (24ull * 60ull * 60ull * 1000ull)
+
+// Period and CCS811 mode of sensor_config.h and device_config.h defaults
+#define SENSOR_PERIOD_MS        (1000u)
+#define SENSOR_COUNT            (2u)
+#define CCS811_DEFAULT_MS       (10000u)
+#define UPLOAD_PERIOD_SEC       (60u)
+
+// Start and read events per sensor measurement
+#define WAKEUPS_PER_SAMPLE      (2u)
+
+// Bytes of a full SSD1306 frame with the I2C control bytes
+#define FRAME_BYTES             (1090u)
+
+/*******************************************************************************
+*   Function definitions
+*******************************************************************************/
+
+/**
+ * @brief Expected activity of a day in operating mode.
+ *
+ * @param presses Button presses per day, each keeps the display on until
+ *                its off timeout.
+ * @param window_sec Length of a connection window.
+ */
+static void
+profile_usage(const power_profile_t *p_profile, uint32_t presses,
+    uint32_t window_sec, power_usage_t *p_usage)
+{
+    uint32_t sample_ms = (p_profile->sample_period_ms > SENSOR_PERIOD_MS) ?
+        p_profile->sample_period_ms : SENSOR_PERIOD_MS;
+    uint32_t upload_sec = (p_profile->upload_period_min_sec > UPLOAD_PERIOD_SEC) ?
+        p_profile->upload_period_min_sec : UPLOAD_PERIOD_SEC;
+    uint64_t display_on_ms = (uint64_t)presses * ((p_profile->display_off_ms > 0) ?
+        p_profile->display_off_ms : 15u * 60u * 1000u);
+
+    memset(p_usage, 0, sizeof(*p_usage));
+    p_usage->period_ms = MS_PER_DAY;
+    p_usage->display_on_ms = (display_on_ms < MS_PER_DAY) ? display_on_ms :
+        MS_PER_DAY;
+    p_usage->samples = SENSOR_COUNT * MS_PER_DAY / sample_ms;
+    p_usage->ccs811_period_ms = p_profile->b_ccs811_slow ? 60000u :
+        CCS811_DEFAULT_MS;
+
+    // Measurements refresh the display while it is on
+    p_usage->bus_bytes = FRAME_BYTES * (p_usage->display_on_ms / sample_ms);
+
+    p_usage->wakeups = MS_PER_DAY / p_profile->button_poll_ms +
+        WAKEUPS_PER_SAMPLE * p_usage->samples +
+        MS_PER_DAY / (upload_sec * 1000u);
+
+    if (p_profile->upload_batch == 0)
+    {
+        p_usage->radio_on_ms = MS_PER_DAY;
+    }
+    else
+    {
+        uint64_t windows = MS_PER_DAY /
+            ((uint64_t)upload_sec * 1000u * p_profile->upload_batch);
+        p_usage->radio_on_ms = windows * window_sec * 1000u;
+    }
+}
+
+static void
+print_usage(const char *p_name, const power_model_t *p_model,
+    const power_usage_t *p_usage, uint32_t battery_mah)
+{
+    double days = (double)p_usage->period_ms / MS_PER_DAY;
+    double mah = power_estimate_mah_per_day(p_model, p_usage);
+
+    printf("%-10s %12.0f %10.0f %10.1f %8.2f %8.2f %10.1f",
+        p_name,
+        (double)p_usage->wakeups / days,
+        (double)p_usage->samples / days,
+        (double)p_usage->bus_bytes / days / 1024.0,
+        (double)p_usage->radio_on_ms / days / 3600000.0,
+        (double)p_usage->display_on_ms / days / 3600000.0,
+        mah);
+    if (battery_mah > 0)
+    {
+        printf(" %8.1f", battery_mah / mah);
+    }
+    printf("\n");
+}
+
+static void
+usage(const char *p_name)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -u presses      button presses per day (10)\n"
+        "  -W seconds      connection window length (15)\n"
+        "  -B mAh          battery capacity, prints days of operation\n"
+        "  -m w,s,b,r,d    measured power record: wakeups, samples, bus\n"
+        "                  bytes, radio on and display on seconds\n"
+        "  -t seconds      period of the measured record (600)\n"
+        "  -c ms           CCS811 mode period of the record (10000)\n"
+        "  -k name=value   model coefficient, e.g. radio_ma=35\n",
+        p_name);
+}
+
+/**
+ * @brief Override a model coefficient.
+ */
+static bool
+model_set(power_model_t *p_model, const char *p_arg)
+{
+    static const struct
+    {
+        const char *name;
+        size_t offset;
+    } coefficients[] = {
+        { "base_ma", offsetof(power_model_t, base_ma) },
+        { "radio_ma", offsetof(power_model_t, radio_ma) },
+        { "display_ma", offsetof(power_model_t, display_ma) },
+        { "ccs811_1s_ma", offsetof(power_model_t, ccs811_1s_ma) },
+        { "ccs811_10s_ma", offsetof(power_model_t, ccs811_10s_ma) },
+        { "ccs811_60s_ma", offsetof(power_model_t, ccs811_60s_ma) },
+        { "wakeup_uc", offsetof(power_model_t, wakeup_uc) },
+        { "bus_byte_uc", offsetof(power_model_t, bus_byte_uc) },
+        { "sample_uc", offsetof(power_model_t, sample_uc) },
+    };
+    const char *p_value = strchr(p_arg, '=');
+
+    for (size_t idx = 0; (p_value != NULL) &&
+        (idx < sizeof(coefficients) / sizeof(coefficients[0])); idx++)
+    {
+        if ((strlen(coefficients[idx].name) == (size_t)(p_value - p_arg)) &&
+            (strncmp(p_arg, coefficients[idx].name, (size_t)(p_value - p_arg)) == 0))
+        {
+            *(double *)((char *)p_model + coefficients[idx].offset) =
+                strtod(p_value + 1, NULL);
+            return true;
+        }
+    }
+    return false;
+}
+
+/*******************************************************************************
+* Main program
+*******************************************************************************/
+
+int
+main(int argc, char *argv[])
+{
+    power_model_t model = POWER_MODEL_DEFAULT;
+    power_usage_t measured;
+    bool b_has_measured = false;
+    uint32_t presses = 10;
+    uint32_t window_sec = 15;
+    uint32_t battery_mah = 0;
+    uint32_t period_sec = 600;
+    uint32_t ccs811_ms = CCS811_DEFAULT_MS;
+    int opt;
+
+    memset(&measured, 0, sizeof(measured));
+
+    while ((opt = getopt(argc, argv, "u:W:B:m:t:c:k:h")) != -1)
+    {
+        uint32_t value = (optarg != NULL) ? (uint32_t)strtoul(optarg, NULL, 0) : 0;
+        unsigned long long w, s, b, r, d;
+        switch (opt)
+        {
+            case 'u': presses = value; break;
+            case 'W': window_sec = value; break;
+            case 'B': battery_mah = value; break;
+            case 't': period_sec = value; break;
+            case 'c': ccs811_ms = value; break;
+            case 'm':
+                if (sscanf(optarg, "%llu,%llu,%llu,%llu,%llu", &w, &s, &b, &r,
+                    &d) != 5)
+                {
+                    usage(argv[0]);
+                    return 1;
+                }
+                measured.wakeups = w;
+                measured.samples = s;
+                measured.bus_bytes = b;
+                measured.radio_on_ms = r * 1000u;
+                measured.display_on_ms = d * 1000u;
+                b_has_measured = true;
+                break;
+            case 'k':
+                if (!model_set(&model, optarg))
+                {
+                    fprintf(stderr, "Unknown coefficient %s\n", optarg);
+                    return 1;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (period_sec == 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("%-10s %12s %10s %10s %8s %8s %10s%s\n", "mode", "wakeups/d",
+        "samples/d", "busKB/d", "radioH/d", "dispH/d", "mAh/d",
+        (battery_mah > 0) ? "     days" : "");
+
+    for (int mode = 0; mode < POWER_MODE_COUNT; mode++)
+    {
+        const power_profile_t *p_profile =
+            power_mode_get_profile((power_mode_t)mode);
+        power_usage_t usage_day;
+
+        profile_usage(p_profile, presses, window_sec, &usage_day);
+        print_usage(p_profile->name, &model, &usage_day, battery_mah);
+    }
+
+    if (b_has_measured)
+    {
+        measured.period_ms = (uint64_t)period_sec * 1000u;
+        measured.ccs811_period_ms = ccs811_ms;
+        print_usage("measured", &model, &measured, battery_mah);
+    }
+
+    return 0;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,39 @@
+/***************************************************************************//**
+* @file    log.h
+* @version 1.0.0
+*
+* @brief Host replacement of the Azure Sphere applibs log API.
+*
+* Lets azure_iot_utilities.c and fake_hub.c be built into the fleet
+* simulator. Messages are discarded, thousands of virtual devices would
+* bury the report.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef APPLIBS_LOG_H
+#define APPLIBS_LOG_H
+
+#include <stdarg.h>
+
+static inline int
+Log_Debug(const char *fmt, ...)
+{
+    (void)fmt;
+    return 0;
+}
+
+static inline int
+Log_DebugVarArgs(const char *fmt, va_list args)
+{
+    (void)fmt;
+    (void)args;
+    return 0;
+}
+
+#endif  // APPLIBS_LOG_H
+
+/* [] END OF FILE */
@@ -0,0 +1,21 @@
+/***************************************************************************//**
+* @file    networking.h
+* @version 1.0.0
+*
+* @brief Host replacement of the Azure Sphere applibs networking API.
+*
+* Included by azure_iot_utilities.h, nothing of it is used by the fleet
+* simulator.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef APPLIBS_NETWORKING_H
+#define APPLIBS_NETWORKING_H
+
+#endif  // APPLIBS_NETWORKING_H
+
+/* [] END OF FILE */
@@ -0,0 +1,29 @@
+/***************************************************************************//**
+* @file    iothub.h
+* @version 1.0.0
+*
+* @brief Host replacement of the Azure IoT C SDK platform initialization.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef IOTHUB_H
+#define IOTHUB_H
+
+static inline int
+IoTHub_Init(void)
+{
+    return 0;
+}
+
+static inline void
+IoTHub_Deinit(void)
+{
+}
+
+#endif  // IOTHUB_H
+
+/* [] END OF FILE */
@@ -0,0 +1,20 @@
+/***************************************************************************//**
+* @file    iothub_client_core_common.h
+* @version 1.0.0
+*
+* @brief Host replacement of the Azure IoT C SDK common client header.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef IOTHUB_CLIENT_CORE_COMMON_H
+#define IOTHUB_CLIENT_CORE_COMMON_H
+
+#include "iothub_device_client_ll.h"
+
+#endif  // IOTHUB_CLIENT_CORE_COMMON_H
+
+/* [] END OF FILE */
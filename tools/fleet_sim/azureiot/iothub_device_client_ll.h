@@ -0,0 +1,82 @@
+/***************************************************************************//**
+* @file    iothub_device_client_ll.h
+* @version 1.0.0
+*
+* @brief Host replacement of the Azure IoT C SDK client types.
+*
+* Declares the result codes and callback types used by the transport
+* interface (azure_iot_transport.h), so that azure_iot_utilities.c can be
+* built against the fake hub transport without the SDK.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef IOTHUB_DEVICE_CLIENT_LL_H
+#define IOTHUB_DEVICE_CLIENT_LL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum
+{
+    IOTHUB_CLIENT_CONFIRMATION_OK,
+    IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY,
+    IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT,
+    IOTHUB_CLIENT_CONFIRMATION_ERROR
+} IOTHUB_CLIENT_CONFIRMATION_RESULT;
+
+typedef enum
+{
+    IOTHUBMESSAGE_ACCEPTED,
+    IOTHUBMESSAGE_REJECTED,
+    IOTHUBMESSAGE_ABANDONED
+} IOTHUBMESSAGE_DISPOSITION_RESULT;
+
+typedef enum
+{
+    DEVICE_TWIN_UPDATE_COMPLETE,
+    DEVICE_TWIN_UPDATE_PARTIAL
+} DEVICE_TWIN_UPDATE_STATE;
+
+typedef enum
+{
+    IOTHUB_CLIENT_CONNECTION_AUTHENTICATED,
+    IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED
+} IOTHUB_CLIENT_CONNECTION_STATUS;
+
+typedef enum
+{
+    IOTHUB_CLIENT_CONNECTION_EXPIRED_SAS_TOKEN,
+    IOTHUB_CLIENT_CONNECTION_DEVICE_DISABLED,
+    IOTHUB_CLIENT_CONNECTION_BAD_CREDENTIAL,
+    IOTHUB_CLIENT_CONNECTION_RETRY_EXPIRED,
+    IOTHUB_CLIENT_CONNECTION_NO_NETWORK,
+    IOTHUB_CLIENT_CONNECTION_COMMUNICATION_ERROR,
+    IOTHUB_CLIENT_CONNECTION_OK
+} IOTHUB_CLIENT_CONNECTION_STATUS_REASON;
+
+typedef void (*IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK)(
+    IOTHUB_CLIENT_CONFIRMATION_RESULT result, void *p_context);
+
+typedef void (*IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK)(
+    DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char *p_payload,
+    size_t size, void *p_context);
+
+typedef int (*IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC)(
+    const char *p_method_name, const unsigned char *p_payload, size_t size,
+    unsigned char **pp_response, size_t *p_response_size, void *p_context);
+
+typedef void (*IOTHUB_CLIENT_REPORTED_STATE_CALLBACK)(int status_code,
+    void *p_context);
+
+typedef void (*IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK)(
+    IOTHUB_CLIENT_CONNECTION_STATUS result,
+    IOTHUB_CLIENT_CONNECTION_STATUS_REASON reason, void *p_context);
+
+#endif  // IOTHUB_DEVICE_CLIENT_LL_H
+
+/* [] END OF FILE */
@@ -0,0 +1,20 @@
+/***************************************************************************//**
+* @file    iothubtransportmqtt.h
+* @version 1.0.0
+*
+* @brief Host replacement of the Azure IoT C SDK MQTT transport header.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef IOTHUBTRANSPORTMQTT_H
+#define IOTHUBTRANSPORTMQTT_H
+
+#include "iothub_device_client_ll.h"
+
+#endif  // IOTHUBTRANSPORTMQTT_H
+
+/* [] END OF FILE */
@@ -0,0 +1,971 @@
+/***************************************************************************//**
+* @file    fleet_sim.c
+* @version 1.0.0
+*
+* @brief Host side fleet simulator.
+*
+* Runs N virtual AirQuality devices in one process against a simulated IoT
+* Hub, to size the ingestion path and to observe the device upload logic
+* under hub side throttling and outages.
+*
+* Every device runs the upload path of the application itself: simulated
+* HDC1000 and CCS811 readings are encoded by the telemetry encoder
+* (telemetry.c) and queued with AzureIoT_SendMessage(), and
+* AzureIoT_DoPeriodicTasks() is called as after every event of the device
+* event loop. In-flight window, delivery retries, connection state machine,
+* reconnect backoff and backlog drain are those of azure_iot_utilities.c,
+* which talks to the in process hub emulation of fake_hub.c through the
+* transport interface. Each device has its own client state and fake hub
+* state (AzureIoT_SelectClientState(), FakeHub_SelectState()).
+*
+* The fake hub of a device provides latency, jitter and drops. The limits of
+* the shared hub are added by a transport wrapping the fake hub one: a
+* message rate, refused hand overs are retried by the client like any other
+* failed hand over, and a connection rate, refused connection attempts are
+* reported as connection failures. A hub outage can be scheduled to watch
+* the fleet reconnect.
+*
+* The simulation runs in virtual time with a fixed tick: clock_gettime() is
+* replaced for the whole process, so the client modules see the tick time
+* plus a per device offset below one millisecond, which also seeds their
+* backoff differently. In each tick the devices are split into chunks spread
+* over per worker deques, workers pop chunks from their own deque and steal
+* from the others when they run dry.
+*
+* Build on a Linux host from the repository root:
+*
+*   gcc -O2 -std=gnu11 -pthread -DAZURE_IOT_FAKE_HUB \
+*       -I tools/fleet_sim -I AirQuality -o fleet_sim \
+*       tools/fleet_sim/fleet_sim.c AirQuality/azure_iot_utilities.c \
+*       AirQuality/fake_hub.c AirQuality/parson.c AirQuality/scratch_buffer.c \
+*       AirQuality/latency_histogram.c AirQuality/telemetry.c \
+*       AirQuality/backoff.c AirQuality/measurement.c AirQuality/anomaly.c \
+*       AirQuality/iaq.c -lm
+*
+* Example, 10k devices uploading every 10 s into a hub limited to 500
+* messages per second, 10 virtual minutes, 4 worker threads on one core:
+*
+*   ./fleet_sim -n 10000 -p 10000 -r 500 -s 600 -t 4
+*
+*   devices 10000, threads 4, period 10000 ms, tick 100 ms, hub rate 500/s
+*   virtual 600 s in 15.36 s wall (39x), 3905646 device ticks/s,
+*       69.41 % chunks stolen
+*   samples 599891, skipped 227614, delivered 299531, failed 0, retried 0,
+*       throttled 19039321
+*   throughput 499.2 msg/s delivered, 999.8 msg/s offered, 50.5 kB/s into hub
+*   fleet latency [ms] p50 73727, p90 229375, p99 425983, max 586100
+*   per device p99 [ms] median 354800, p99 540200, worst 586100
+*   connections 10000 attempts, 0 failed, 0 refused by hub, peak 2038 attempts/s
+*   memory per device 12501 B resident
+*
+* The threads outnumber the core here, so workers preempted in the middle of
+* a tick have their chunks stolen by the others. Hand overs refused by the
+* hub are retried by every buffered message each 2 s, without backoff.
+* Results vary slightly between runs as the threads compete for the hub
+* quota in a different order.
+*
+* 10k devices losing the hub for 5 minutes, hub accepting 200 connections
+* per second:
+*
+*   ./fleet_sim -n 10000 -o 120 -O 300 -c 200 -s 900
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#define _GNU_SOURCE             // sched_getaffinity()
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <sys/syscall.h>
+
+#include "azure_iot_transport.h"
+#include "azure_iot_utilities.h"
+#include "fake_hub.h"
+#include "iaq.h"
+#include "latency_histogram.h"
+#include "log_ring.h"
+#include "measurement.h"
+#include "telemetry.h"
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+#define SIM_CHUNK_DEVICES       (64)    // Devices per work item
+#define SIM_MAX_THREADS         (256)
+#define SIM_EPOCH_S             (1700000000)    // CLOCK_REALTIME at time 0
+
+/*******************************************************************************
+*   Data types
+*******************************************************************************/
+
+typedef struct
+{
+    AzureIoT_ClientState *p_client;     // azure_iot_utilities.c state
+    FakeHub_State *p_hub;               // fake_hub.c state
+    uint32_t rng;               // xorshift32 state
+    uint32_t phase_ns;          // Clock offset of the device
+    double temperature;         // Simulated HDC1000
+    double humidity;
+    double eco2;                // Simulated CCS811
+    uint32_t next_sample_ms;
+    bool b_is_attempting;       // Connection attempt passed to the hub
+    bool b_is_outage_applied;   // Fleet outage passed to the fake hub
+    uint32_t sampled;
+    uint32_t skipped;           // Sample skipped, in-flight window full
+    uint32_t throttled;         // Hand overs refused by the hub rate limit
+} sim_device_t;
+
+typedef struct
+{
+    uint32_t rate;              // Accepted messages per second, 0 = unlimited
+    uint32_t latency_ms;
+    uint32_t jitter_ms;
+    uint32_t drop_per_mille;
+    uint32_t drop_timeout_ms;
+    int64_t quota;              // Messages accepted in current tick
+    atomic_int_fast64_t used;
+    uint32_t connect_rate;      // Accepted connections per second, 0 = unlimited
+    int64_t connect_quota;
+    atomic_int_fast64_t connect_used;
+    uint32_t outage_start_ms;
+    uint32_t outage_end_ms;
+} sim_hub_t;
+
+typedef struct
+{
+    pthread_mutex_t lock;
+    uint32_t *p_items;
+    size_t top;                 // Thieves take from here
+    size_t bottom;              // Owner pushes and pops here
+} sim_deque_t;
+
+typedef struct
+{
+    int index;
+    uint64_t chunks;
+    uint64_t steals;
+    uint64_t connect_attempts;
+    uint64_t connect_throttled;
+} sim_worker_t;
+
+/*******************************************************************************
+* Forward declarations of private functions
+*******************************************************************************/
+
+static bool
+fleet_transport_create(const AzureIoT_TransportCallbacks *p_callbacks);
+
+static void
+fleet_transport_destroy(void);
+
+static bool
+fleet_transport_send_event(const char *p_payload, const char *p_message_id,
+    void *p_context);
+
+static bool
+fleet_transport_send_reported_state(const unsigned char *p_json, size_t size,
+    void *p_context);
+
+static void
+fleet_transport_do_work(void);
+
+static void
+fleet_transport_hold_connection(bool b_hold);
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+static uint32_t g_devices = 1000;
+static uint32_t g_threads = 0;
+static uint32_t g_duration_s = 600;
+static uint32_t g_period_ms = 60000;
+static uint32_t g_tick_ms = 100;
+
+static sim_device_t *gp_devices;
+static sim_hub_t g_hub = {
+    .latency_ms = 80, .jitter_ms = 120, .drop_per_mille = 0,
+    .drop_timeout_ms = 10000
+};
+
+/**
+ * Fake hub transport with the limits of the shared hub, selected for every
+ * device client.
+ */
+static const AzureIoT_Transport g_fleet_transport = {
+    .name = "fleet hub",
+    .create = fleet_transport_create,
+    .destroy = fleet_transport_destroy,
+    .sendEvent = fleet_transport_send_event,
+    .sendReportedState = fleet_transport_send_reported_state,
+    .doWork = fleet_transport_do_work,
+    .holdConnection = fleet_transport_hold_connection
+};
+
+// Same for all clients, set while the devices are created
+static const AzureIoT_TransportCallbacks *gp_callbacks;
+
+static sim_deque_t g_deques[SIM_MAX_THREADS];
+static sim_worker_t g_workers[SIM_MAX_THREADS];
+static pthread_barrier_t g_barrier;
+static uint32_t g_chunk_count;
+static uint32_t g_now_ms;
+static bool gb_done;
+
+// Device stepped by the calling worker, for the transport and the clock
+static _Thread_local sim_device_t *gp_device;
+static _Thread_local sim_worker_t *gp_worker;
+
+// Connection attempts per tick over the last second, for the peak rate
+static uint32_t *gp_attempt_window;
+static uint32_t g_attempt_window_len;
+static uint64_t g_attempt_window_sum;
+static uint64_t g_attempt_peak;
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+/**
+ * @brief Virtual clock of the client modules.
+ *
+ * Replaces the C library function for the whole process. CLOCK_MONOTONIC
+ * and CLOCK_REALTIME return the tick time plus the offset of the device
+ * being stepped, other clocks are read from the kernel.
+ */
+int
+clock_gettime(clockid_t clock_id, struct timespec *p_ts)
+{
+    if ((clock_id != CLOCK_MONOTONIC) && (clock_id != CLOCK_REALTIME))
+    {
+        return (int)syscall(SYS_clock_gettime, clock_id, p_ts);
+    }
+
+    p_ts->tv_sec = (time_t)(g_now_ms / 1000u) +
+        ((clock_id == CLOCK_REALTIME) ? SIM_EPOCH_S : 0);
+    p_ts->tv_nsec = (long)(g_now_ms % 1000u) * 1000000L +
+        ((gp_device != NULL) ? (long)gp_device->phase_ns : 0);
+    return 0;
+}
+
+/**
+ * @brief Log ring of the client modules, not recorded.
+ *
+ * Level and rate limit counters of log_ring.c are updated by the event loop
+ * thread only, they are not shared by worker threads.
+ */
+bool
+log_ring_write(log_id_t id, long a0, long a1, long a2, long a3)
+{
+    (void)id;
+    (void)a0;
+    (void)a1;
+    (void)a2;
+    (void)a3;
+    return false;
+}
+
+/*******************************************************************************
+* Private function definitions
+*******************************************************************************/
+
+static uint32_t
+rng_next(uint32_t *p_state)
+{
+    uint32_t x = *p_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *p_state = x;
+    return x;
+}
+
+static double
+rng_uniform(uint32_t *p_state)
+{
+    return (double)rng_next(p_state) / 4294967296.0;
+}
+
+static bool
+hub_is_up(uint32_t now_ms)
+{
+    return (g_hub.outage_end_ms == g_hub.outage_start_ms) ||
+        (now_ms < g_hub.outage_start_ms) || (now_ms >= g_hub.outage_end_ms);
+}
+
+static bool
+fleet_transport_create(const AzureIoT_TransportCallbacks *p_callbacks)
+{
+    gp_callbacks = p_callbacks;
+    return AzureIoT_FakeHubTransport.create(p_callbacks);
+}
+
+static void
+fleet_transport_destroy(void)
+{
+    AzureIoT_FakeHubTransport.destroy();
+}
+
+/**
+ * @brief Hand message over to the hub, refused above the hub message rate.
+ */
+static bool
+fleet_transport_send_event(const char *p_payload, const char *p_message_id,
+    void *p_context)
+{
+    if ((g_hub.rate > 0) && (atomic_fetch_add_explicit(&g_hub.used, 1,
+        memory_order_relaxed) >= g_hub.quota))
+    {
+        gp_device->throttled++;
+        return false;
+    }
+
+    return AzureIoT_FakeHubTransport.sendEvent(p_payload, p_message_id,
+        p_context);
+}
+
+static bool
+fleet_transport_send_reported_state(const unsigned char *p_json, size_t size,
+    void *p_context)
+{
+    return AzureIoT_FakeHubTransport.sendReportedState(p_json, size,
+        p_context);
+}
+
+/**
+ * @brief Exchange data with the hub.
+ *
+ * The first DoWork of a connection attempt takes a connection of the hub
+ * connection rate. Above the rate the attempt fails right away, as when the
+ * hub refuses the connection. During an outage the fake hub fails the
+ * attempts itself.
+ */
+static void
+fleet_transport_do_work(void)
+{
+    if ((AzureIoT_GetConnectionState() == AzureIoT_ConnectionState_Connecting) &&
+        !gp_device->b_is_attempting)
+    {
+        gp_device->b_is_attempting = true;
+        gp_worker->connect_attempts++;
+
+        if (hub_is_up(g_now_ms) && (g_hub.connect_rate > 0) &&
+            (atomic_fetch_add_explicit(&g_hub.connect_used, 1,
+                memory_order_relaxed) >= g_hub.connect_quota))
+        {
+            gp_worker->connect_throttled++;
+            gp_callbacks->connectionStatus(IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED,
+                IOTHUB_CLIENT_CONNECTION_COMMUNICATION_ERROR, NULL);
+            return;
+        }
+    }
+
+    AzureIoT_FakeHubTransport.doWork();
+}
+
+static void
+fleet_transport_hold_connection(bool b_hold)
+{
+    AzureIoT_FakeHubTransport.holdConnection(b_hold);
+}
+
+/**
+ * @brief Advance simulated HDC1000 and CCS811 readings.
+ *
+ * Slow random walks around indoor conditions, eCO2 rising while the room is
+ * occupied and decaying towards outdoor level otherwise. TVOC follows eCO2
+ * as both are derived from the same CCS811 sensing element.
+ */
+static void
+sensors_read(sim_device_t *p_dev, telemetry_sample_t *p_sample)
+{
+    p_dev->temperature += (rng_uniform(&p_dev->rng) - 0.5) * 0.2;
+    if (p_dev->temperature < 18.0) p_dev->temperature = 18.0;
+    if (p_dev->temperature > 28.0) p_dev->temperature = 28.0;
+
+    p_dev->humidity += (rng_uniform(&p_dev->rng) - 0.5) * 1.0;
+    if (p_dev->humidity < 20.0) p_dev->humidity = 20.0;
+    if (p_dev->humidity > 80.0) p_dev->humidity = 80.0;
+
+    bool occupied = (rng_next(&p_dev->rng) % 4) != 0;
+    p_dev->eco2 += occupied ? rng_uniform(&p_dev->rng) * 25.0
+                            : (400.0 - p_dev->eco2) * 0.05;
+    if (p_dev->eco2 > 8192.0) p_dev->eco2 = 8192.0;
+
+    p_sample->eco2 = (int16_t)p_dev->eco2;
+    p_sample->tvoc = (int16_t)((p_dev->eco2 - 400.0) * 0.3);
+    // Through the raw HDC1000 register values, as read on the device
+    p_sample->temperature = measurement_temperature_from_hdc1000(
+        (uint16_t)((p_dev->temperature + 40.0) / 165.0 * 65536.0));
+    p_sample->humidity = measurement_humidity_from_hdc1000(
+        (uint16_t)(p_dev->humidity / 100.0 * 65536.0));
+
+    // Instant values, the device averages over a window
+    iaq_result_t iaq;
+    iaq_compute((uint16_t)p_sample->eco2,
+        (uint16_t)((p_sample->tvoc > 0) ? p_sample->tvoc : 0),
+        p_sample->temperature, p_sample->humidity, &iaq);
+    p_sample->iaq = iaq.index;
+    p_sample->valid = SENSOR_QUANTITY_ALL;
+    p_sample->flags = 0;
+}
+
+/**
+ * @brief Select client and fake hub state of device for the calling thread.
+ */
+static void
+device_select(sim_device_t *p_dev)
+{
+    gp_device = p_dev;
+    AzureIoT_SelectClientState(p_dev->p_client);
+    FakeHub_SelectState(p_dev->p_hub);
+}
+
+/**
+ * @brief One tick of the device, one event loop event.
+ */
+static void
+device_step(sim_device_t *p_dev, uint32_t now_ms)
+{
+    device_select(p_dev);
+
+    if (!p_dev->b_is_outage_applied && !hub_is_up(now_ms))
+    {
+        FakeHub_SimulateOutage(g_hub.outage_end_ms - now_ms);
+        p_dev->b_is_outage_applied = true;
+    }
+
+    // Sample and queue, like azure_upload_handler
+    if ((int32_t)(now_ms - p_dev->next_sample_ms) >= 0)
+    {
+        telemetry_sample_t sample;
+        char payload[TELEMETRY_BUFFER_SIZE];
+
+        p_dev->next_sample_ms += g_period_ms;
+        p_dev->sampled++;
+        sensors_read(p_dev, &sample);
+
+        if (!AzureIoT_CanSendMessage())
+        {
+            p_dev->skipped++;
+        }
+        else
+        {
+            telemetry_format_sample(&sample, payload, sizeof(payload));
+            AzureIoT_SendMessage(payload);
+        }
+    }
+
+    AzureIoT_DoPeriodicTasks();
+
+    if (AzureIoT_GetConnectionState() != AzureIoT_ConnectionState_Connecting)
+    {
+        p_dev->b_is_attempting = false;
+    }
+}
+
+static bool
+deque_pop(sim_deque_t *p_deque, uint32_t *p_item)
+{
+    bool result = false;
+
+    pthread_mutex_lock(&p_deque->lock);
+    if (p_deque->bottom > p_deque->top)
+    {
+        *p_item = p_deque->p_items[--p_deque->bottom];
+        result = true;
+    }
+    pthread_mutex_unlock(&p_deque->lock);
+
+    return result;
+}
+
+static bool
+deque_steal(sim_deque_t *p_deque, uint32_t *p_item)
+{
+    bool result = false;
+
+    pthread_mutex_lock(&p_deque->lock);
+    if (p_deque->bottom > p_deque->top)
+    {
+        *p_item = p_deque->p_items[p_deque->top++];
+        result = true;
+    }
+    pthread_mutex_unlock(&p_deque->lock);
+
+    return result;
+}
+
+/**
+ * @brief Distribute chunks over worker deques and refill hub quota.
+ *
+ * Runs on a single thread between ticks. The chunk order rotates every tick
+ * so that no device range gets the hub quota first all the time.
+ */
+static void
+tick_prepare(uint32_t tick)
+{
+    static int64_t rate_carry = 0;
+
+    for (uint32_t idx = 0; idx < g_threads; idx++)
+    {
+        g_deques[idx].top = 0;
+        g_deques[idx].bottom = 0;
+    }
+
+    for (uint32_t idx = 0; idx < g_chunk_count; idx++)
+    {
+        uint32_t chunk = (idx + tick) % g_chunk_count;
+        sim_deque_t *p_deque = &g_deques[idx % g_threads];
+        p_deque->p_items[p_deque->bottom++] = chunk;
+    }
+
+    static int64_t connect_carry = 0;
+
+    if (g_hub.rate > 0)
+    {
+        // Whole messages per tick, remainder carried over
+        int64_t budget = (int64_t)g_hub.rate * g_tick_ms + rate_carry;
+        g_hub.quota = budget / 1000;
+        rate_carry = budget % 1000;
+        atomic_store(&g_hub.used, 0);
+    }
+
+    if (g_hub.connect_rate > 0)
+    {
+        int64_t budget = (int64_t)g_hub.connect_rate * g_tick_ms + connect_carry;
+        g_hub.connect_quota = budget / 1000;
+        connect_carry = budget % 1000;
+        atomic_store(&g_hub.connect_used, 0);
+    }
+
+    // Attempts of the previous tick into the one second window
+    uint64_t attempts = 0;
+    for (uint32_t idx = 0; idx < g_threads; idx++)
+    {
+        attempts += g_workers[idx].connect_attempts;
+    }
+
+    static uint64_t attempts_before = 0;
+    uint32_t slot = tick % g_attempt_window_len;
+    g_attempt_window_sum -= gp_attempt_window[slot];
+    gp_attempt_window[slot] = (uint32_t)(attempts - attempts_before);
+    g_attempt_window_sum += gp_attempt_window[slot];
+    attempts_before = attempts;
+    if (g_attempt_window_sum > g_attempt_peak)
+    {
+        g_attempt_peak = g_attempt_window_sum;
+    }
+}
+
+static void *
+worker_thread(void *p_arg)
+{
+    sim_worker_t *p_worker = (sim_worker_t *)p_arg;
+    uint32_t rng = 0x9E3779B9u * (uint32_t)(p_worker->index + 1);
+    uint32_t tick = 0;
+
+    gp_worker = p_worker;
+
+    while (true)
+    {
+        if (pthread_barrier_wait(&g_barrier) == PTHREAD_BARRIER_SERIAL_THREAD)
+        {
+            gb_done = (g_now_ms >= g_duration_s * 1000u);
+            if (!gb_done)
+            {
+                tick_prepare(tick);
+            }
+        }
+        pthread_barrier_wait(&g_barrier);
+        if (gb_done)
+        {
+            break;
+        }
+
+        uint32_t chunk;
+        while (true)
+        {
+            if (!deque_pop(&g_deques[p_worker->index], &chunk))
+            {
+                // Own deque empty, try to steal from a random victim
+                bool stolen = false;
+                uint32_t start = rng_next(&rng) % g_threads;
+                for (uint32_t idx = 0; (idx < g_threads) && !stolen; idx++)
+                {
+                    uint32_t victim = (start + idx) % g_threads;
+                    if ((int)victim != p_worker->index)
+                    {
+                        stolen = deque_steal(&g_deques[victim], &chunk);
+                    }
+                }
+                if (!stolen)
+                {
+                    break;
+                }
+                p_worker->steals++;
+            }
+
+            uint32_t first = chunk * SIM_CHUNK_DEVICES;
+            uint32_t last = first + SIM_CHUNK_DEVICES;
+            if (last > g_devices)
+            {
+                last = g_devices;
+            }
+            for (uint32_t dev = first; dev < last; dev++)
+            {
+                device_step(&gp_devices[dev], g_now_ms);
+            }
+            p_worker->chunks++;
+        }
+
+        if (pthread_barrier_wait(&g_barrier) == PTHREAD_BARRIER_SERIAL_THREAD)
+        {
+            g_now_ms += g_tick_ms;
+        }
+        tick++;
+    }
+
+    gp_device = NULL;
+    return NULL;
+}
+
+/**
+ * @brief Number of CPUs the process may run on.
+ */
+static uint32_t
+cpus_available(void)
+{
+    cpu_set_t set;
+
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        return (uint32_t)CPU_COUNT(&set);
+    }
+
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    return (online > 0) ? (uint32_t)online : 1u;
+}
+
+static long
+rss_kib(void)
+{
+    long pages = 0;
+    long resident = 0;
+    FILE *p_file = fopen("/proc/self/statm", "r");
+
+    if (p_file)
+    {
+        if (fscanf(p_file, "%ld %ld", &pages, &resident) != 2)
+        {
+            resident = 0;
+        }
+        fclose(p_file);
+    }
+
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static int
+compare_u32(const void *p_a, const void *p_b)
+{
+    uint32_t a = *(const uint32_t *)p_a;
+    uint32_t b = *(const uint32_t *)p_b;
+    return (a > b) - (a < b);
+}
+
+static void
+usage(const char *p_name)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -n devices      number of virtual devices (%u)\n"
+        "  -t threads      worker threads, 0 = available CPUs (%u)\n"
+        "  -s seconds      virtual duration (%u)\n"
+        "  -p ms           upload period (%u)\n"
+        "  -k ms           simulation tick, event loop period (%u)\n"
+        "  -r rate         hub limit in messages/s, 0 = unlimited (%u)\n"
+        "  -l ms           hub latency (%u)\n"
+        "  -j ms           hub latency jitter (%u)\n"
+        "  -d per_mille    hub drop probability (%u)\n"
+        "  -o seconds      hub outage start (%u)\n"
+        "  -O seconds      hub outage length, 0 = no outage (%u)\n"
+        "  -c rate         hub limit in connections/s, 0 = unlimited (%u)\n",
+        p_name, g_devices, cpus_available(), g_duration_s, g_period_ms,
+        g_tick_ms, g_hub.rate, g_hub.latency_ms, g_hub.jitter_ms,
+        g_hub.drop_per_mille, g_hub.outage_start_ms / 1000u,
+        (g_hub.outage_end_ms - g_hub.outage_start_ms) / 1000u,
+        g_hub.connect_rate);
+}
+
+/*******************************************************************************
+* Main program
+*******************************************************************************/
+
+int
+main(int argc, char *argv[])
+{
+    int opt;
+    uint32_t outage_start_s = 0;
+    uint32_t outage_length_s = 0;
+
+    while ((opt = getopt(argc, argv, "n:t:s:p:k:r:l:j:d:o:O:c:h")) != -1)
+    {
+        uint32_t value = (optarg != NULL) ? (uint32_t)strtoul(optarg, NULL, 0) : 0;
+        switch (opt)
+        {
+            case 'n': g_devices = value; break;
+            case 't': g_threads = value; break;
+            case 's': g_duration_s = value; break;
+            case 'p': g_period_ms = value; break;
+            case 'k': g_tick_ms = value; break;
+            case 'r': g_hub.rate = value; break;
+            case 'l': g_hub.latency_ms = value; break;
+            case 'j': g_hub.jitter_ms = value; break;
+            case 'd': g_hub.drop_per_mille = value; break;
+            case 'o': outage_start_s = value; break;
+            case 'O': outage_length_s = value; break;
+            case 'c': g_hub.connect_rate = value; break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (g_threads == 0)
+    {
+        g_threads = cpus_available();
+    }
+    if ((g_devices == 0) || (g_period_ms == 0) || (g_tick_ms == 0) ||
+        (g_tick_ms >= 1000) || (g_threads > SIM_MAX_THREADS))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    g_hub.outage_start_ms = outage_start_s * 1000u;
+    g_hub.outage_end_ms = (outage_start_s + outage_length_s) * 1000u;
+
+    g_attempt_window_len = (1000u + g_tick_ms - 1) / g_tick_ms;
+    gp_attempt_window = calloc(g_attempt_window_len, sizeof(uint32_t));
+    if (gp_attempt_window == NULL)
+    {
+        fprintf(stderr, "Not enough memory\n");
+        return 1;
+    }
+
+    // Devices, the whole fleet powered on at once
+    long rss_before = rss_kib();
+    gp_devices = calloc(g_devices, sizeof(sim_device_t));
+    if (gp_devices == NULL)
+    {
+        fprintf(stderr, "Not enough memory for %u devices\n", g_devices);
+        return 1;
+    }
+
+    FakeHub_Config hub_config;
+    FakeHub_GetDefaultConfig(&hub_config);
+    hub_config.latencyMs = g_hub.latency_ms;
+    hub_config.jitterMs = g_hub.jitter_ms;
+    hub_config.dropPerMille = g_hub.drop_per_mille;
+    hub_config.dropTimeoutMs = g_hub.drop_timeout_ms;
+
+    for (uint32_t idx = 0; idx < g_devices; idx++)
+    {
+        sim_device_t *p_dev = &gp_devices[idx];
+        p_dev->rng = 0x2545F491u ^ (idx * 0x9E3779B9u) ^ 1u;
+        p_dev->phase_ns = rng_next(&p_dev->rng) % 1000000u;
+        p_dev->temperature = 21.0 + rng_uniform(&p_dev->rng) * 3.0;
+        p_dev->humidity = 35.0 + rng_uniform(&p_dev->rng) * 20.0;
+        p_dev->eco2 = 400.0;
+        p_dev->next_sample_ms = rng_next(&p_dev->rng) % g_period_ms;
+        p_dev->p_client = AzureIoT_CreateClientState();
+        p_dev->p_hub = FakeHub_CreateState();
+        if ((p_dev->p_client == NULL) || (p_dev->p_hub == NULL))
+        {
+            fprintf(stderr, "Not enough memory for %u devices\n", g_devices);
+            return 1;
+        }
+
+        device_select(p_dev);
+        hub_config.seed = rng_next(&p_dev->rng) | 1u;
+        FakeHub_Configure(&hub_config);
+        AzureIoT_SetTransport(&g_fleet_transport);
+        if (!AzureIoT_SetupClient())
+        {
+            fprintf(stderr, "Client setup of device %u failed\n", idx);
+            return 1;
+        }
+    }
+    gp_device = NULL;
+    long rss_devices = rss_kib() - rss_before;
+
+    // Thread pool
+    g_chunk_count = (g_devices + SIM_CHUNK_DEVICES - 1) / SIM_CHUNK_DEVICES;
+    pthread_barrier_init(&g_barrier, NULL, g_threads);
+    pthread_t threads[SIM_MAX_THREADS];
+
+    for (uint32_t idx = 0; idx < g_threads; idx++)
+    {
+        pthread_mutex_init(&g_deques[idx].lock, NULL);
+        g_deques[idx].p_items = calloc(g_chunk_count, sizeof(uint32_t));
+        if (g_deques[idx].p_items == NULL)
+        {
+            fprintf(stderr, "Not enough memory for work queues\n");
+            return 1;
+        }
+        g_workers[idx].index = (int)idx;
+    }
+
+    struct timespec wall_start, wall_end;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &wall_start);
+
+    for (uint32_t idx = 1; idx < g_threads; idx++)
+    {
+        pthread_create(&threads[idx], NULL, worker_thread, &g_workers[idx]);
+    }
+    worker_thread(&g_workers[0]);
+    for (uint32_t idx = 1; idx < g_threads; idx++)
+    {
+        pthread_join(threads[idx], NULL);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &wall_end);
+    double wall_s = (double)(wall_end.tv_sec - wall_start.tv_sec) +
+        (double)(wall_end.tv_nsec - wall_start.tv_nsec) / 1e9;
+    double virtual_s = (double)g_now_ms / 1000.0;
+
+    // Aggregate the statistics of the device clients and fake hubs
+    static latency_hist_t fleet;
+    static latency_hist_t reconnect;
+    static latency_hist_t drain;
+    static AzureIoT_MessageStats message_stats;
+    static AzureIoT_ConnectionStats connection_stats;
+    FakeHub_Stats hub_stats;
+    uint64_t connect_attempts = 0, connect_throttled = 0, connect_failures = 0;
+    uint64_t sampled = 0, skipped = 0, delivered = 0, failed = 0;
+    uint64_t retried = 0, throttled = 0, steals = 0, chunks = 0, bytes = 0;
+    uint32_t *p_p99 = calloc(g_devices, sizeof(uint32_t));
+
+    latency_hist_reset(&fleet);
+    latency_hist_reset(&reconnect);
+    latency_hist_reset(&drain);
+    for (uint32_t idx = 0; idx < g_devices; idx++)
+    {
+        sim_device_t *p_dev = &gp_devices[idx];
+        device_select(p_dev);
+        AzureIoT_GetMessageStats(&message_stats, false);
+        AzureIoT_GetConnectionStats(&connection_stats, false);
+        FakeHub_GetStats(&hub_stats, false);
+
+        sampled += p_dev->sampled;
+        skipped += p_dev->skipped;
+        throttled += p_dev->throttled;
+        delivered += message_stats.delivered;
+        failed += message_stats.failed;
+        retried += message_stats.retried;
+        connect_failures += connection_stats.failures;
+        bytes += hub_stats.eventBytes;
+        latency_hist_merge(&fleet, &message_stats.latencyMs);
+        latency_hist_merge(&reconnect, &connection_stats.reconnectMs);
+        latency_hist_merge(&drain, &connection_stats.drainMs);
+        if (p_p99)
+        {
+            p_p99[idx] = latency_hist_percentile(&message_stats.latencyMs, 990);
+        }
+    }
+    for (uint32_t idx = 0; idx < g_threads; idx++)
+    {
+        steals += g_workers[idx].steals;
+        chunks += g_workers[idx].chunks;
+        connect_attempts += g_workers[idx].connect_attempts;
+        connect_throttled += g_workers[idx].connect_throttled;
+    }
+
+    latency_summary_t summary;
+    latency_hist_summarize(&fleet, &summary);
+
+    printf("devices %u, threads %u, period %u ms, tick %u ms, hub rate %u/s\n",
+        g_devices, g_threads, g_period_ms, g_tick_ms, g_hub.rate);
+    printf("virtual %.0f s in %.2f s wall (%.0fx), %.0f device ticks/s, "
+        "%.2f %% chunks stolen\n",
+        virtual_s, wall_s, virtual_s / wall_s,
+        (double)g_devices * (g_now_ms / g_tick_ms) / wall_s,
+        chunks ? 100.0 * (double)steals / (double)chunks : 0.0);
+    printf("samples %llu, skipped %llu, delivered %llu, failed %llu, "
+        "retried %llu, throttled %llu\n",
+        (unsigned long long)sampled, (unsigned long long)skipped,
+        (unsigned long long)delivered, (unsigned long long)failed,
+        (unsigned long long)retried, (unsigned long long)throttled);
+    printf("throughput %.1f msg/s delivered, %.1f msg/s offered, "
+        "%.1f kB/s into hub\n",
+        (double)delivered / virtual_s, (double)sampled / virtual_s,
+        (double)bytes / virtual_s / 1000.0);
+    printf("fleet latency [ms] p50 %lu, p90 %lu, p99 %lu, max %lu\n",
+        (unsigned long)summary.p50, (unsigned long)summary.p90,
+        (unsigned long)summary.p99, (unsigned long)summary.max);
+
+    if (p_p99)
+    {
+        qsort(p_p99, g_devices, sizeof(uint32_t), compare_u32);
+        printf("per device p99 [ms] median %lu, p99 %lu, worst %lu\n",
+            (unsigned long)p_p99[g_devices / 2],
+            (unsigned long)p_p99[(uint32_t)((uint64_t)g_devices * 99 / 100)],
+            (unsigned long)p_p99[g_devices - 1]);
+        free(p_p99);
+    }
+
+    printf("connections %llu attempts, %llu failed, %llu refused by hub, "
+        "peak %llu attempts/s\n",
+        (unsigned long long)connect_attempts,
+        (unsigned long long)connect_failures,
+        (unsigned long long)connect_throttled,
+        (unsigned long long)g_attempt_peak);
+    if (g_hub.outage_end_ms != g_hub.outage_start_ms)
+    {
+        latency_hist_summarize(&reconnect, &summary);
+        printf("reconnect [ms] n %lu, p50 %lu, p99 %lu, max %lu\n",
+            (unsigned long)summary.count, (unsigned long)summary.p50,
+            (unsigned long)summary.p99, (unsigned long)summary.max);
+        latency_hist_summarize(&drain, &summary);
+        printf("backlog drain [ms] n %lu, p50 %lu, p99 %lu, max %lu\n",
+            (unsigned long)summary.count, (unsigned long)summary.p50,
+            (unsigned long)summary.p99, (unsigned long)summary.max);
+    }
+
+    printf("memory per device %.0f B resident\n",
+        (double)rss_devices * 1024.0 / g_devices);
+
+    for (uint32_t idx = 0; idx < g_devices; idx++)
+    {
+        device_select(&gp_devices[idx]);
+        AzureIoT_DestroyClientState(gp_devices[idx].p_client);
+        FakeHub_DestroyState(gp_devices[idx].p_hub);
+    }
+    for (uint32_t idx = 0; idx < g_threads; idx++)
+    {
+        free(g_deques[idx].p_items);
+        pthread_mutex_destroy(&g_deques[idx].lock);
+    }
+    pthread_barrier_destroy(&g_barrier);
+    free(gp_attempt_window);
+    free(gp_devices);
+
+    return 0;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,469 @@
+/***************************************************************************//**
+* @file    hist_bench.c
+* @version 1.0.0
+*
+* @brief Host side check and benchmark of the latency histogram.
+*
+* Records value sets into latency_histogram.c and compares
+* latency_hist_percentile() with the exact percentile of the sorted values,
+* the value of rank ceil(count * per_mille / 1000). A percentile must not be
+* below the exact one and may exceed it by less than exact / 2^SUB_BITS, the
+* width of its bucket:
+*
+*   single    one recorded value, every percentile is that value
+*   linear    values around LATENCY_HIST_LINEAR, the first shared bucket
+*   clamped   values over LATENCY_HIST_VALUE_MAX, counted as the maximum
+*   merged    sets split over several histograms and merged, also into an
+*             empty one, compared with one histogram of all values
+*   random    uniform, log-uniform and bimodal sets of random sizes
+*
+* The benchmark then reports the cost of latency_hist_record() on random
+* values and of latency_hist_summarize(). The exit status is 1 if a
+* percentile is out of bounds or a merged histogram differs.
+*
+* Build on a Linux host from the repository root:
+*
+*   gcc -O2 -std=gnu11 -I AirQuality -o hist_bench \
+*       tools/hist_bench/hist_bench.c AirQuality/latency_histogram.c
+*
+* Example, 200 random sets and ten million records:
+*
+*   ./hist_bench -s 200 -n 10000000
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "latency_histogram.h"
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+#define BENCH_SET_MAX       (20000)     // Values of one random set
+#define BENCH_MERGE_PARTS   (4)
+#define BENCH_VALUES        (4096)      // Recorded in turn by the benchmark
+
+/*******************************************************************************
+*   Data types
+*******************************************************************************/
+
+typedef struct
+{
+    uint32_t sets;
+    uint32_t percentiles;
+    uint32_t failures;
+} bench_check_t;
+
+/*******************************************************************************
+*   Global variables
+*******************************************************************************/
+
+// Percentiles checked for every set, in tenths of percent
+static const unsigned g_per_milles[] = {
+    0, 1, 10, 100, 250, 500, 750, 900, 950, 990, 999, 1000
+};
+
+#define PER_MILLE_COUNT (sizeof(g_per_milles) / sizeof(g_per_milles[0]))
+
+static uint32_t g_rand_state = 1;
+static volatile uint64_t g_sink = 0;
+
+/*******************************************************************************
+*   Function definitions
+*******************************************************************************/
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Xorshift pseudo random generator, repeatable across hosts.
+ */
+static uint32_t
+rand_next(void)
+{
+    g_rand_state ^= g_rand_state << 13;
+    g_rand_state ^= g_rand_state >> 17;
+    g_rand_state ^= g_rand_state << 5;
+    return g_rand_state;
+}
+
+static int
+compare_values(const void *p_a, const void *p_b)
+{
+    uint32_t a = *(const uint32_t *)p_a;
+    uint32_t b = *(const uint32_t *)p_b;
+
+    return (a > b) - (a < b);
+}
+
+/**
+ * @brief Compare histogram percentiles with the exact ones of the values.
+ *
+ * @param p_values Recorded values, sorted here, clamped as recorded.
+ */
+static void
+check_set(bench_check_t *p_check, const char *p_name,
+    const latency_hist_t *p_hist, uint32_t *p_values, uint32_t count)
+{
+    for (uint32_t idx = 0; idx < count; idx++)
+    {
+        if (p_values[idx] > LATENCY_HIST_VALUE_MAX)
+        {
+            p_values[idx] = LATENCY_HIST_VALUE_MAX;
+        }
+    }
+    qsort(p_values, count, sizeof(p_values[0]), compare_values);
+
+    p_check->sets++;
+    for (size_t idx = 0; idx < PER_MILLE_COUNT; idx++)
+    {
+        uint64_t rank = ((uint64_t)count * g_per_milles[idx] + 999) / 1000;
+        uint32_t exact = p_values[(rank > 0) ? rank - 1 : 0];
+        uint32_t value = latency_hist_percentile(p_hist, g_per_milles[idx]);
+
+        p_check->percentiles++;
+        if ((value < exact) ||
+            (value - exact > (exact >> LATENCY_HIST_SUB_BITS)))
+        {
+            if (p_check->failures++ < 10)
+            {
+                printf("%-8s count %u p%.1f: %u, exact %u\n", p_name,
+                    count, g_per_milles[idx] / 10.0, value, exact);
+            }
+        }
+    }
+}
+
+static void
+check_single(bench_check_t *p_check)
+{
+    static const uint32_t values[] = {
+        0, 1, LATENCY_HIST_LINEAR - 1, LATENCY_HIST_LINEAR, 1000, 123457,
+        LATENCY_HIST_VALUE_MAX
+    };
+    latency_hist_t hist;
+
+    for (size_t idx = 0; idx < sizeof(values) / sizeof(values[0]); idx++)
+    {
+        uint32_t value = values[idx];
+
+        latency_hist_reset(&hist);
+        latency_hist_record(&hist, value);
+        check_set(p_check, "single", &hist, &value, 1);
+
+        // Limited by the recorded maximum, so exact
+        if (latency_hist_percentile(&hist, 500) != values[idx])
+        {
+            p_check->failures++;
+            printf("single   %u: p50 %u\n", values[idx],
+                latency_hist_percentile(&hist, 500));
+        }
+    }
+
+    latency_hist_reset(&hist);
+    if (latency_hist_percentile(&hist, 990) != 0)
+    {
+        p_check->failures++;
+        printf("empty    p99 not 0\n");
+    }
+}
+
+static void
+check_linear(bench_check_t *p_check)
+{
+    static uint32_t values[4 * LATENCY_HIST_LINEAR];
+    latency_hist_t hist;
+
+    // Exact buckets below LINEAR, two values per bucket right above it
+    for (uint32_t first = 0; first < LATENCY_HIST_LINEAR + 4; first++)
+    {
+        uint32_t count = 0;
+
+        latency_hist_reset(&hist);
+        for (uint32_t value = first; value < 2 * LATENCY_HIST_LINEAR + 2;
+            value++)
+        {
+            latency_hist_record(&hist, value);
+            values[count++] = value;
+        }
+        check_set(p_check, "linear", &hist, values, count);
+    }
+
+    latency_hist_reset(&hist);
+    for (uint32_t idx = 0; idx < 3; idx++)
+    {
+        latency_hist_record(&hist, LATENCY_HIST_LINEAR);
+        values[idx] = LATENCY_HIST_LINEAR;
+    }
+    check_set(p_check, "linear", &hist, values, 3);
+}
+
+static void
+check_clamped(bench_check_t *p_check)
+{
+    static const uint32_t large[] = {
+        LATENCY_HIST_VALUE_MAX, LATENCY_HIST_VALUE_MAX + 1,
+        LATENCY_HIST_VALUE_MAX * 2u, UINT32_MAX
+    };
+    uint32_t values[64];
+    latency_hist_t hist;
+    uint32_t count = 0;
+
+    latency_hist_reset(&hist);
+    for (uint32_t idx = 0; idx < 60; idx++)
+    {
+        uint32_t value = (idx % 3 == 0) ?
+            large[idx % 4] : 1000u + idx * 50000u;
+
+        latency_hist_record(&hist, value);
+        values[count++] = value;
+    }
+    check_set(p_check, "clamped", &hist, values, count);
+
+    if ((hist.max != LATENCY_HIST_VALUE_MAX) ||
+        (latency_hist_percentile(&hist, 1000) != LATENCY_HIST_VALUE_MAX))
+    {
+        p_check->failures++;
+        printf("clamped  max %u, p100 %u\n", hist.max,
+            latency_hist_percentile(&hist, 1000));
+    }
+}
+
+/**
+ * @brief Fill a random set, shape selected by the set number.
+ *
+ * @return Number of values.
+ */
+static uint32_t
+fill_random(uint32_t set, uint32_t *p_values)
+{
+    uint32_t count = 1 + rand_next() % BENCH_SET_MAX;
+
+    for (uint32_t idx = 0; idx < count; idx++)
+    {
+        uint32_t random = rand_next();
+
+        switch (set % 3)
+        {
+            case 0:
+                // Uniform up to a random magnitude
+                p_values[idx] = random % (1u << (4 + set % 24));
+                break;
+
+            case 1:
+                // Log-uniform, as handler run times and lateness
+                p_values[idx] = (random >> 8) >> (random % 24);
+                break;
+
+            default:
+                // Bimodal, fast path and rare slow outliers
+                p_values[idx] = ((random & 0xFF) == 0) ?
+                    20000u + (random >> 20) : 50u + (random >> 26);
+                break;
+        }
+    }
+
+    return count;
+}
+
+static void
+check_random(bench_check_t *p_check, uint32_t sets)
+{
+    static uint32_t values[BENCH_SET_MAX];
+    latency_hist_t hist;
+
+    for (uint32_t set = 0; set < sets; set++)
+    {
+        uint32_t count = fill_random(set, values);
+
+        latency_hist_reset(&hist);
+        for (uint32_t idx = 0; idx < count; idx++)
+        {
+            latency_hist_record(&hist, values[idx]);
+        }
+        check_set(p_check, "random", &hist, values, count);
+    }
+}
+
+static void
+check_merged(bench_check_t *p_check, uint32_t sets)
+{
+    static uint32_t values[BENCH_SET_MAX];
+    latency_hist_t parts[BENCH_MERGE_PARTS];
+    latency_hist_t whole;
+    latency_hist_t merged;
+
+    for (uint32_t set = 0; set < sets; set++)
+    {
+        uint32_t count = fill_random(set, values);
+
+        latency_hist_reset(&whole);
+        latency_hist_reset(&merged);
+        for (uint32_t part = 0; part < BENCH_MERGE_PARTS; part++)
+        {
+            latency_hist_reset(&parts[part]);
+        }
+
+        // Uneven split, the last part stays empty for small sets
+        for (uint32_t idx = 0; idx < count; idx++)
+        {
+            uint32_t part = (idx * idx) % (BENCH_MERGE_PARTS - 1);
+
+            latency_hist_record(&parts[part], values[idx]);
+            latency_hist_record(&whole, values[idx]);
+        }
+        for (uint32_t part = 0; part < BENCH_MERGE_PARTS; part++)
+        {
+            latency_hist_merge(&merged, &parts[part]);
+        }
+
+        if (memcmp(&merged, &whole, sizeof(merged)) != 0)
+        {
+            if (p_check->failures++ < 10)
+            {
+                printf("merged   count %u: differs from one histogram\n",
+                    count);
+            }
+        }
+        check_set(p_check, "merged", &merged, values, count);
+    }
+}
+
+/**
+ * @brief Time latency_hist_record() of random values.
+ *
+ * @return Nanoseconds per record.
+ */
+static double
+bench_record(uint32_t records)
+{
+    static uint32_t values[BENCH_VALUES];
+    latency_hist_t hist;
+
+    // Log-uniform, so that all bucket groups are hit
+    for (uint32_t idx = 0; idx < BENCH_VALUES; idx++)
+    {
+        uint32_t random = rand_next();
+        values[idx] = (random >> 8) >> (random % 24);
+    }
+
+    latency_hist_reset(&hist);
+    uint64_t start_ns = now_ns();
+    for (uint32_t idx = 0; idx < records; idx++)
+    {
+        latency_hist_record(&hist, values[idx % BENCH_VALUES]);
+    }
+    uint64_t end_ns = now_ns();
+
+    g_sink += hist.sum;
+    return (double)(end_ns - start_ns) / records;
+}
+
+/**
+ * @brief Time latency_hist_summarize() of a filled histogram.
+ *
+ * @return Nanoseconds per summary.
+ */
+static double
+bench_summarize(uint32_t summaries)
+{
+    latency_hist_t hist;
+    latency_summary_t summary;
+
+    latency_hist_reset(&hist);
+    for (uint32_t idx = 0; idx < BENCH_VALUES; idx++)
+    {
+        uint32_t random = rand_next();
+        latency_hist_record(&hist, (random >> 8) >> (random % 24));
+    }
+
+    uint64_t start_ns = now_ns();
+    for (uint32_t idx = 0; idx < summaries; idx++)
+    {
+        hist.buckets[idx % LATENCY_HIST_BUCKETS]++;
+        hist.count++;
+        latency_hist_summarize(&hist, &summary);
+        g_sink += summary.p99;
+    }
+
+    return (double)(now_ns() - start_ns) / summaries;
+}
+
+static void
+usage(const char *p_name)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -s sets         random sets checked, also merged (100)\n"
+        "  -n records      records timed (10000000)\n",
+        p_name);
+}
+
+/*******************************************************************************
+* Main program
+*******************************************************************************/
+
+int
+main(int argc, char *argv[])
+{
+    uint32_t sets = 100;
+    uint32_t records = 10000000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:n:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 's': sets = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'n': records = (uint32_t)strtoul(optarg, NULL, 0); break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (records == 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    bench_check_t check = { 0, 0, 0 };
+
+    check_single(&check);
+    check_linear(&check);
+    check_clamped(&check);
+    check_random(&check, sets);
+    check_merged(&check, sets);
+
+    printf("percentiles: %u sets, %u percentiles, %u out of bounds "
+        "(%u sub-bucket bits, %u buckets, %zu bytes)\n", check.sets,
+        check.percentiles, check.failures, LATENCY_HIST_SUB_BITS,
+        LATENCY_HIST_BUCKETS, sizeof(latency_hist_t));
+
+    printf("record:    %6.1f ns/record\n", bench_record(records));
+    printf("summarize: %6.1f ns/summary\n",
+        bench_summarize(records / 1000 + 1));
+
+    printf("%s\n", (check.failures == 0) ? "PASS" : "FAIL");
+
+    return (check.failures == 0) ? 0 : 1;
+}
+
+/* [] END OF FILE */
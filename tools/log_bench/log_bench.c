@@ -0,0 +1,391 @@
+/***************************************************************************//**
+* @file    log_bench.c
+* @version 1.0.0
+*
+* @brief Host side benchmark of the structured log ring.
+*
+* Compares the cost per call of the logging on the sampling path:
+*
+*   printf    former path: two measurement_format() calls and the text
+*             formatted and written out synchronously, as Log_Debug() does,
+*             here to /dev/null
+*   ring      LOG_RING() record of the message id and raw arguments
+*             (log_ring.c), module at debug level, no rate limit
+*   filtered  LOG_RING() of a message above the module level
+*   limited   LOG_RING() dropped by the module rate limit
+*   format    reader side, log_ring_read() and log_ring_format() per record
+*
+* With -t a writer and a reader thread run concurrently for a second: the
+* writer records a pattern of arguments, the reader checks each record it
+* copies. The ring is then dumped into a temporary file as from a fatal
+* signal handler and loaded back. The exit status is 1 if a torn or out of
+* order record was read or the loaded dump differs from the ring.
+*
+* Build on a Linux host from the repository root:
+*
+*   gcc -O2 -std=gnu11 -pthread -I AirQuality -o log_bench \
+*       tools/log_bench/log_bench.c AirQuality/log_ring.c \
+*       AirQuality/measurement.c
+*
+* Example, one million calls per path and the concurrency check:
+*
+*   ./log_bench -n 1000000 -t
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "log_ring.h"
+#include "measurement.h"
+
+/*******************************************************************************
+*   Data types
+*******************************************************************************/
+
+typedef struct
+{
+    uint64_t read;
+    uint64_t lost;
+    uint64_t torn;
+    uint64_t out_of_order;
+} bench_check_t;
+
+/*******************************************************************************
+*   Global variables
+*******************************************************************************/
+
+static int g_fd_null = -1;
+static volatile uint64_t g_sink = 0;
+static _Atomic bool gb_is_writing = false;
+
+/*******************************************************************************
+*   Function definitions
+*******************************************************************************/
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Synchronous formatted output, as Log_Debug() on the device.
+ */
+static void
+log_debug(const char *p_format, ...)
+{
+    va_list args;
+    va_start(args, p_format);
+    vdprintf(g_fd_null, p_format, args);
+    va_end(args);
+}
+
+static void
+sample_printf(int32_t temperature, int32_t humidity, uint32_t flags)
+{
+    char temperature_text[MEASUREMENT_TEXT_SIZE];
+    char humidity_text[MEASUREMENT_TEXT_SIZE];
+
+    measurement_format(temperature, 2, temperature_text,
+        sizeof(temperature_text));
+    measurement_format(humidity, 2, humidity_text, sizeof(humidity_text));
+    log_debug("Temperature [degC]: %s, Humidity [percRH]: %s, "
+        "flags 0x%06lX\n", temperature_text, humidity_text,
+        (unsigned long)flags);
+}
+
+static double
+bench_path(int path, uint32_t calls)
+{
+    uint64_t start_ns = now_ns();
+
+    for (uint32_t idx = 0; idx < calls; idx++)
+    {
+        int32_t temperature = 2150 + (int32_t)(idx & 0xFF);
+        int32_t humidity = 4520 - (int32_t)(idx & 0x7F);
+
+        if (path == 0)
+        {
+            sample_printf(temperature, humidity, idx & 0x0F);
+        }
+        else
+        {
+            g_sink += LOG_RING(LOG_SAMPLE_ENV, temperature, humidity,
+                idx & 0x0F);
+        }
+    }
+
+    return (double)(now_ns() - start_ns) / calls;
+}
+
+static double
+bench_format(uint32_t calls)
+{
+    char line[LOG_RING_LINE_SIZE];
+    log_entry_t entries[16];
+    uint32_t cursor = log_ring_oldest();
+    uint32_t formatted = 0;
+    uint64_t start_ns = now_ns();
+
+    while (formatted < calls)
+    {
+        size_t count = log_ring_read(&cursor, entries, 16, NULL);
+        if (count == 0)
+        {
+            break;
+        }
+        for (size_t idx = 0; idx < count; idx++)
+        {
+            g_sink += (uint64_t)log_ring_format(&entries[idx], line,
+                sizeof(line));
+        }
+        formatted += (uint32_t)count;
+    }
+
+    return (formatted > 0) ? (double)(now_ns() - start_ns) / formatted : 0.0;
+}
+
+static void *
+writer_thread(void *p_arg)
+{
+    uint64_t *p_written = p_arg;
+    long value = 0;
+
+    while (atomic_load(&gb_is_writing))
+    {
+        LOG_RING(LOG_SAMPLE_GAS, value, value * 3, ~value);
+        value++;
+    }
+    *p_written = (uint64_t)value;
+
+    return NULL;
+}
+
+static void
+check_concurrent(bench_check_t *p_check, uint64_t *p_written)
+{
+    pthread_t writer;
+    log_entry_t entries[32];
+    long last = -1;
+
+    log_ring_init();
+    log_ring_set_level(LOG_MODULE_SENSOR, LOG_LEVEL_DEBUG);
+    log_ring_set_rate(LOG_MODULE_SENSOR, 0, 0);
+
+    uint32_t cursor = log_ring_oldest();
+
+    atomic_store(&gb_is_writing, true);
+    pthread_create(&writer, NULL, writer_thread, p_written);
+
+    uint64_t end_ns = now_ns() + 1000000000u;
+    while (now_ns() < end_ns)
+    {
+        uint32_t lost = 0;
+        size_t count = log_ring_read(&cursor, entries, 32, &lost);
+
+        p_check->lost += lost;
+        p_check->read += count;
+        for (size_t idx = 0; idx < count; idx++)
+        {
+            const long *p_args = entries[idx].args;
+
+            if ((p_args[1] != p_args[0] * 3) || (p_args[2] != ~p_args[0]) ||
+                (entries[idx].id != LOG_SAMPLE_GAS))
+            {
+                p_check->torn++;
+            }
+            else if (p_args[0] <= last)
+            {
+                p_check->out_of_order++;
+            }
+            last = p_args[0];
+        }
+    }
+
+    atomic_store(&gb_is_writing, false);
+    pthread_join(writer, NULL);
+}
+
+/**
+ * @brief Dump the ring into a temporary file and load it back.
+ *
+ * @return Number of records loaded matching the newest records of the ring.
+ */
+static size_t
+check_crash_dump(size_t *p_loaded)
+{
+    static log_entry_t ring[LOG_RING_SIZE];
+    static log_entry_t loaded[LOG_RING_SIZE];
+    FILE *p_file = tmpfile();
+    size_t matching = 0;
+
+    *p_loaded = 0;
+    if (p_file == NULL)
+    {
+        return 0;
+    }
+
+    // Ring wrapped, so that the dump is written in two runs
+    log_ring_init();
+    log_ring_set_level(LOG_MODULE_SENSOR, LOG_LEVEL_DEBUG);
+    log_ring_set_rate(LOG_MODULE_SENSOR, 0, 0);
+    for (long value = 0; value < LOG_RING_SIZE + LOG_RING_SIZE / 3; value++)
+    {
+        LOG_RING(LOG_SAMPLE_GAS, value, value * 3, ~value);
+    }
+
+    uint32_t cursor = log_ring_oldest();
+    size_t count = log_ring_read(&cursor, ring, LOG_RING_SIZE, NULL);
+
+    log_ring_set_crash_file(fileno(p_file), 512, 4096);
+    log_ring_crash_dump(11);
+    log_ring_set_crash_file(-1, 0, 0);
+
+    int reason = 0;
+    *p_loaded = log_ring_crash_load(fileno(p_file), 512, 4096, loaded,
+        LOG_RING_SIZE, &reason);
+
+    for (size_t idx = 0; (reason == 11) && (idx < *p_loaded) &&
+        (idx < count); idx++)
+    {
+        const log_entry_t *p_expected = &ring[count - *p_loaded + idx];
+
+        if ((loaded[idx].seq == p_expected->seq) &&
+            (loaded[idx].args[0] == p_expected->args[0]))
+        {
+            matching++;
+        }
+    }
+
+    log_ring_crash_clear(fileno(p_file), 512);
+    if (log_ring_crash_load(fileno(p_file), 512, 4096, loaded,
+        LOG_RING_SIZE, NULL) != 0)
+    {
+        matching = 0;
+    }
+    fclose(p_file);
+
+    return matching;
+}
+
+static void
+usage(const char *p_name)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -n calls        calls per path (1000000)\n"
+        "  -t              check a concurrent writer and reader\n",
+        p_name);
+}
+
+/*******************************************************************************
+* Main program
+*******************************************************************************/
+
+int
+main(int argc, char *argv[])
+{
+    static const char *p_path_names[] = {
+        "printf", "ring", "filtered", "limited"
+    };
+    uint32_t calls = 1000000;
+    bool b_check = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:th")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n': calls = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 't': b_check = true; break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    g_fd_null = open("/dev/null", O_WRONLY);
+    if ((calls == 0) || (g_fd_null < 0))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("%10s %10s %10s %10s\n", "path", "ns/call", "written", "dropped");
+
+    for (int path = 0; path < 4; path++)
+    {
+        log_ring_stats_t stats;
+
+        log_ring_init();
+        if (path == 1)
+        {
+            log_ring_set_level(LOG_MODULE_SENSOR, LOG_LEVEL_DEBUG);
+            log_ring_set_rate(LOG_MODULE_SENSOR, 0, 0);
+        }
+        else if (path == 3)
+        {
+            // Burst taken within the first calls, all later ones dropped
+            log_ring_set_level(LOG_MODULE_SENSOR, LOG_LEVEL_DEBUG);
+        }
+
+        double ns = bench_path(path, calls);
+        log_ring_get_stats(&stats);
+
+        printf("%10s %10.1f %10lu %10lu\n", p_path_names[path], ns,
+            (unsigned long)stats.written,
+            (unsigned long)(stats.filtered + stats.rate_dropped));
+
+        if (path == 1)
+        {
+            printf("%10s %10.1f %10s %10s\n", "format",
+                bench_format(calls), "-", "-");
+        }
+    }
+
+    int status = 0;
+    if (b_check)
+    {
+        bench_check_t check = { 0, 0, 0, 0 };
+        uint64_t written = 0;
+
+        check_concurrent(&check, &written);
+        printf("\nconcurrent: %llu written, %llu read, %llu lost, "
+            "%llu torn, %llu out of order\n",
+            (unsigned long long)written, (unsigned long long)check.read,
+            (unsigned long long)check.lost, (unsigned long long)check.torn,
+            (unsigned long long)check.out_of_order);
+        status = ((check.torn > 0) || (check.out_of_order > 0) ||
+            (check.read == 0)) ? 1 : 0;
+
+        size_t loaded = 0;
+        size_t matching = check_crash_dump(&loaded);
+        printf("crash dump: %zu records loaded, %zu matching\n", loaded,
+            matching);
+        if ((loaded == 0) || (matching != loaded))
+        {
+            status = 1;
+        }
+    }
+
+    close(g_fd_null);
+    printf("%s\n", (status == 0) ? "PASS" : "FAIL");
+
+    return status;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,265 @@
+/***************************************************************************//**
+* @file    render_bench.c
+* @version 1.0.0
+*
+* @brief Host side benchmark of the OLED frame composition.
+*
+* Composes the measurements screen of main.c into the u8g2 full buffer of a
+* memory only SSD1306 128x64 setup, rotated as on the device (U8G2_R1),
+* both ways:
+*
+*   u8g2    labels and values drawn with u8g2_DrawStr(), centered with
+*           u8g2_GetStrWidth(), fonts switched twice per frame, as before
+*   cached  labels blitted from bitmaps and values composed from the
+*           character atlas of render_cache.c, both rendered once
+*
+* and reports the composition time per frame, without the transfer to the
+* display. Every cached frame is compared with the u8g2 frame, the exit
+* status is 1 if any differs.
+*
+* Build on a Linux host from the repository root, with the u8g2 sources of
+* the lib_u8g2 submodule:
+*
+*   gcc -O2 -std=gnu11 -I AirQuality -I lib_u8g2/lib_u8g2 -o render_bench \
+*       tools/render_bench/render_bench.c AirQuality/render_cache.c \
+*       AirQuality/iaq.c lib_u8g2/lib_u8g2/u8g2_*.c \
+*       lib_u8g2/lib_u8g2/u8x8_*.c
+*
+* Run with the number of frames:
+*
+*   ./render_bench 100000
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "u8g2.h"
+#include "iaq.h"
+#include "render_cache.h"
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+#define BENCH_TEXT_SIZE     (17)
+#define BENCH_FRAMES        (256)   // Distinct frames, prepared in advance
+
+/*******************************************************************************
+*   Data types
+*******************************************************************************/
+
+// Values shown on one frame
+typedef struct
+{
+    char eco2[BENCH_TEXT_SIZE];
+    char tvoc[BENCH_TEXT_SIZE];
+    char humidity[BENCH_TEXT_SIZE];
+    char iaq[BENCH_TEXT_SIZE];
+    const char *p_band;
+    iaq_band_t band;
+} bench_frame_t;
+
+/*******************************************************************************
+*   Global variables
+*******************************************************************************/
+
+static render_bitmap_t g_label_eco2;
+static render_bitmap_t g_label_tvoc;
+static render_bitmap_t g_label_humidity;
+static render_bitmap_t g_label_iaq;
+static render_bitmap_t g_label_bands[IAQ_BAND_COUNT];
+static render_atlas_t g_value_chars;
+
+static bench_frame_t g_frames[BENCH_FRAMES];
+
+/*******************************************************************************
+*   Function definitions
+*******************************************************************************/
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void
+draw_centered_str(u8g2_t *p_u8g2, u8g2_uint_t y, const char *p_text)
+{
+    u8g2_uint_t display_width = u8g2_GetDisplayWidth(p_u8g2);
+    u8g2_uint_t width = u8g2_GetStrWidth(p_u8g2, p_text);
+
+    u8g2_DrawStr(p_u8g2, (width < display_width) ?
+        (u8g2_uint_t)((display_width - width) / 2) : 0, y, p_text);
+}
+
+/**
+ * @brief Frame values, "..." for missing ones now and then.
+ */
+static void
+frame_make(bench_frame_t *p_frame, uint32_t idx)
+{
+    uint32_t eco2 = 400 + (idx * 37) % 2000;
+
+    snprintf(p_frame->eco2, BENCH_TEXT_SIZE, "%u", eco2);
+    snprintf(p_frame->tvoc, BENCH_TEXT_SIZE, "%u", (idx * 13) % 1188);
+    snprintf(p_frame->humidity, BENCH_TEXT_SIZE, "%u.%u",
+        20 + (idx * 7) % 70, idx % 10);
+    if (idx % 16 == 0)
+    {
+        snprintf(p_frame->iaq, BENCH_TEXT_SIZE, "...");
+        p_frame->p_band = NULL;
+    }
+    else
+    {
+        iaq_result_t iaq;
+        iaq_compute((uint16_t)eco2, 0, 2200, 4500, &iaq);
+        snprintf(p_frame->iaq, BENCH_TEXT_SIZE, "%u", iaq.index);
+        p_frame->band = iaq.band;
+        p_frame->p_band = iaq_get_band_name(iaq.band);
+    }
+}
+
+static void
+compose_u8g2(u8g2_t *p_u8g2, const bench_frame_t *p_frame)
+{
+    u8g2_ClearBuffer(p_u8g2);
+    u8g2_SetFont(p_u8g2, u8g2_font_helvB08_tf);
+    draw_centered_str(p_u8g2, 9, "eCO2 [ppm]");
+    draw_centered_str(p_u8g2, 41, "TVOC [ppb]");
+    draw_centered_str(p_u8g2, 73, "Humidity [%]");
+    draw_centered_str(p_u8g2, 105, (p_frame->p_band != NULL) ?
+        p_frame->p_band : "IAQ");
+
+    u8g2_SetFont(p_u8g2, u8g2_font_crox4tb_tn);
+    draw_centered_str(p_u8g2, 28, p_frame->eco2);
+    draw_centered_str(p_u8g2, 60, p_frame->tvoc);
+    draw_centered_str(p_u8g2, 92, p_frame->humidity);
+    draw_centered_str(p_u8g2, 124, p_frame->iaq);
+}
+
+static void
+compose_cached(u8g2_t *p_u8g2, const bench_frame_t *p_frame)
+{
+    u8g2_ClearBuffer(p_u8g2);
+    render_bitmap_draw_centered(p_u8g2, &g_label_eco2, 9);
+    render_bitmap_draw_centered(p_u8g2, &g_label_tvoc, 41);
+    render_bitmap_draw_centered(p_u8g2, &g_label_humidity, 73);
+    render_bitmap_draw_centered(p_u8g2, (p_frame->p_band != NULL) ?
+        &g_label_bands[p_frame->band] : &g_label_iaq, 105);
+
+    render_atlas_draw_centered(p_u8g2, &g_value_chars, 28, p_frame->eco2);
+    render_atlas_draw_centered(p_u8g2, &g_value_chars, 60, p_frame->tvoc);
+    render_atlas_draw_centered(p_u8g2, &g_value_chars, 92,
+        p_frame->humidity);
+    render_atlas_draw_centered(p_u8g2, &g_value_chars, 124, p_frame->iaq);
+}
+
+static bool
+cache_init(u8g2_t *p_u8g2)
+{
+    bool b_is_cached = render_bitmap_init(&g_label_eco2, p_u8g2,
+        u8g2_font_helvB08_tf, "eCO2 [ppm]");
+    b_is_cached &= render_bitmap_init(&g_label_tvoc, p_u8g2,
+        u8g2_font_helvB08_tf, "TVOC [ppb]");
+    b_is_cached &= render_bitmap_init(&g_label_humidity, p_u8g2,
+        u8g2_font_helvB08_tf, "Humidity [%]");
+    b_is_cached &= render_bitmap_init(&g_label_iaq, p_u8g2,
+        u8g2_font_helvB08_tf, "IAQ");
+    for (size_t idx = 0; idx < IAQ_BAND_COUNT; idx++)
+    {
+        b_is_cached &= render_bitmap_init(&g_label_bands[idx], p_u8g2,
+            u8g2_font_helvB08_tf, iaq_get_band_name((iaq_band_t)idx));
+    }
+    b_is_cached &= render_atlas_init(&g_value_chars, p_u8g2,
+        u8g2_font_crox4tb_tn);
+
+    return b_is_cached;
+}
+
+/*******************************************************************************
+* Main program
+*******************************************************************************/
+
+int
+main(int argc, char *argv[])
+{
+    uint32_t frames = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : 100000;
+    static uint8_t reference[1024];
+    u8g2_t u8g2;
+    uint32_t mismatches = 0;
+    uint64_t checksum = 0;
+
+    if (frames == 0)
+    {
+        fprintf(stderr, "Usage: %s [frames]\n", argv[0]);
+        return 1;
+    }
+
+    // Memory only display, nothing is transferred
+    u8g2_Setup_ssd1306_128x64_noname_f(&u8g2, U8G2_R1, u8x8_byte_empty,
+        u8x8_dummy_cb);
+    size_t buffer_size = (size_t)u8g2_GetBufferTileWidth(&u8g2) *
+        u8g2_GetBufferTileHeight(&u8g2) * 8u;
+
+    uint64_t start_ns = now_ns();
+    bool b_is_cached = cache_init(&u8g2);
+    uint64_t init_ns = now_ns() - start_ns;
+
+    // Same frames both ways
+    for (uint32_t idx = 0; idx < BENCH_FRAMES; idx++)
+    {
+        frame_make(&g_frames[idx], idx);
+        compose_u8g2(&u8g2, &g_frames[idx]);
+        memcpy(reference, u8g2_GetBufferPtr(&u8g2), buffer_size);
+        compose_cached(&u8g2, &g_frames[idx]);
+        if (memcmp(reference, u8g2_GetBufferPtr(&u8g2), buffer_size) != 0)
+        {
+            mismatches++;
+        }
+    }
+
+    printf("cache     %s, rendered in %.1f us, %zu bytes\n",
+        b_is_cached ? "blitted" : "drawn with u8g2", (double)init_ns / 1e3,
+        sizeof(g_label_eco2) * (4 + IAQ_BAND_COUNT) + sizeof(g_value_chars));
+
+    static const char *p_names[] = { "u8g2", "cached" };
+    for (int way = 0; way < 2; way++)
+    {
+        start_ns = now_ns();
+        for (uint32_t idx = 0; idx < frames; idx++)
+        {
+            if (way == 0)
+            {
+                compose_u8g2(&u8g2, &g_frames[idx % BENCH_FRAMES]);
+            }
+            else
+            {
+                compose_cached(&u8g2, &g_frames[idx % BENCH_FRAMES]);
+            }
+            checksum += u8g2_GetBufferPtr(&u8g2)[idx % buffer_size];
+        }
+        uint64_t elapsed_ns = now_ns() - start_ns;
+
+        printf("%-9s %8.2f us/frame\n", p_names[way],
+            (double)elapsed_ns / frames / 1e3);
+    }
+
+    printf("frames    %u mismatches in %u compared: %s (%llu)\n",
+        mismatches, BENCH_FRAMES, (mismatches == 0) ? "PASS" : "FAIL",
+        (unsigned long long)checksum);
+
+    return (mismatches == 0) ? 0 : 1;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,40 @@
+/***************************************************************************//**
+* @file    i2c.h
+* @version 1.0.0
+*
+* @brief Host replacement of the Azure Sphere applibs I2C master API.
+*
+* Declares the subset used by hdc1000_regs.c, implemented by the simulated
+* bus in i2c_sim.c.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef APPLIBS_I2C_H
+#define APPLIBS_I2C_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+typedef uint32_t I2C_DeviceAddress;
+
+ssize_t
+I2CMaster_Write(int fd, I2C_DeviceAddress address, const uint8_t *data,
+    size_t length);
+
+ssize_t
+I2CMaster_Read(int fd, I2C_DeviceAddress address, uint8_t *buffer,
+    size_t maxLength);
+
+ssize_t
+I2CMaster_WriteThenRead(int fd, I2C_DeviceAddress address,
+    const uint8_t *writeData, size_t lenWriteData, uint8_t *readData,
+    size_t lenReadData);
+
+#endif  // APPLIBS_I2C_H
+
+/* [] END OF FILE */
@@ -0,0 +1,34 @@
+/***************************************************************************//**
+* @file    log.h
+* @version 1.0.0
+*
+* @brief Host replacement of the Azure Sphere applibs log API.
+*
+* Lets the event loop sources (epoll_timerfd_utilities.c, sensor_registry.c) be
+* built into host benchmarks, messages go to stderr.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef APPLIBS_LOG_H
+#define APPLIBS_LOG_H
+
+#include <stdarg.h>
+#include <stdio.h>
+
+static inline int
+Log_Debug(const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    int result = vfprintf(stderr, fmt, args);
+    va_end(args);
+    return result;
+}
+
+#endif  // APPLIBS_LOG_H
+
+/* [] END OF FILE */
@@ -0,0 +1,26 @@
+/***************************************************************************//**
+* @file    storage.h
+* @version 1.0.0
+*
+* @brief Host replacement of the Azure Sphere applibs storage API.
+*
+* The mutable storage file is a temporary file created by bench_accuracy.c.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef APPLIBS_STORAGE_H
+#define APPLIBS_STORAGE_H
+
+int
+Storage_OpenMutableFile(void);
+
+int
+Storage_DeleteMutableFile(void);
+
+#endif  // APPLIBS_STORAGE_H
+
+/* [] END OF FILE */
@@ -0,0 +1,575 @@
+/***************************************************************************//**
+* @file    bench_accuracy.c
+* @version 1.0.0
+*
+* @brief Accuracy checks of sensor_bench.
+*
+* The fixed point conversion of every raw HDC1000 value (measurement.c) is
+* compared with double precision references: the conversion error, the
+* display and telemetry text (telemetry.c) against "%.1f" of the double
+* value, and the CCS811 ENV_DATA encoding (ccs811_regs.c) against the exact
+* encoding. The IAQ index (iaq.c) is compared with a table of hand computed
+* indices and its rolling averages with a recomputation over the window.
+* Telemetry of flagged quantities, trend graph columns (trend.c) and CCS811
+* baseline persistence (ccs811_baseline.c, persist.c) against the simulated
+* CCS811 follow.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "applibs/i2c.h"
+#include "applibs/storage.h"
+#include "ccs811_baseline.h"
+#include "ccs811_regs.h"
+#include "i2c_sim.h"
+#include "iaq.h"
+#include "measurement.h"
+#include "persist.h"
+#include "sensor_bench.h"
+#include "sensor_quality.h"
+#include "telemetry.h"
+#include "trend.h"
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+#define BENCH_CCS811_PERIOD_S   (10)    // CCS811_MODE_10S, as set by main.c
+#define BENCH_ECO2_TOLERANCE    (10)    // Accurate reading [ppm]
+#define BENCH_CLEAN_ECO2        (400)   // Simulated clean air [ppm]
+#define BENCH_WALL_TIME         ((time_t)1700000000)
+
+/*******************************************************************************
+*   Global variables
+*******************************************************************************/
+
+// Mutable storage file
+static char g_storage_path[] = "/tmp/sensor_bench_storage_XXXXXX";
+
+/*******************************************************************************
+*   Function definitions
+*******************************************************************************/
+
+static double
+ref_temperature(uint16_t raw)
+{
+    return (double)raw / 65536.0 * 165.0 - 40.0;
+}
+
+static double
+ref_humidity(uint16_t raw)
+{
+    return (double)raw / 65536.0 * 100.0;
+}
+
+/**
+ * @brief Exact ENV_DATA encoding in double precision.
+ */
+static void
+ref_env_data(double temperature, double humidity, uint16_t *p_temp_reg,
+    uint16_t *p_humi_reg)
+{
+    temperature = fmax(-25.0, fmin(102.99, temperature));
+    humidity = fmax(0.0, fmin(100.0, humidity));
+    *p_humi_reg = (uint16_t)lround(humidity * 512.0);
+    *p_temp_reg = (uint16_t)lround((temperature + 25.0) * 512.0);
+}
+
+/**
+ * @brief Compare text of one decimal with "%.1f" of the double value.
+ *
+ * @return true if equal or the value is a tie the two roundings may resolve
+ *         differently.
+ */
+static bool
+check_text(int32_t centi, const char *p_text, double value)
+{
+    char reference[BENCH_TEXT_SIZE];
+
+    snprintf(reference, sizeof(reference), "%.1f", value);
+    if (strcmp(reference, "-0.0") == 0)
+    {
+        strcpy(reference, "0.0");
+    }
+
+    return (strcmp(reference, p_text) == 0) || ((labs((long)centi) % 10) == 5);
+}
+
+static bool
+check_conversion(void)
+{
+    double max_temp_error = 0.0;
+    double max_humi_error = 0.0;
+    uint32_t max_env_error = 0;
+    uint32_t max_env_raw_error = 0;
+    uint32_t text_mismatches = 0;
+    uint32_t telemetry_mismatches = 0;
+
+    for (uint32_t code = 0; code <= UINT16_MAX; code++)
+    {
+        uint16_t raw = (uint16_t)code;
+        int16_t temperature = measurement_temperature_from_hdc1000(raw);
+        uint16_t humidity = measurement_humidity_from_hdc1000(raw);
+
+        // Conversion, compared in hundredths
+        double error = fabs(temperature - ref_temperature(raw) * 100.0);
+        max_temp_error = fmax(max_temp_error, error);
+        error = fabs(humidity - ref_humidity(raw) * 100.0);
+        max_humi_error = fmax(max_humi_error, error);
+
+        // Display text of fixed point value
+        char text[MEASUREMENT_TEXT_SIZE];
+        measurement_format(temperature, 1, text, sizeof(text));
+        if (!check_text(temperature, text, temperature / 100.0))
+        {
+            text_mismatches++;
+        }
+        measurement_format(humidity, 1, text, sizeof(text));
+        if (!check_text(humidity, text, humidity / 100.0))
+        {
+            text_mismatches++;
+        }
+
+        // Telemetry, the former pipeline rounded the unquantized double
+        // value; allow the last digit to differ by one
+        telemetry_sample_t sample = {
+            .eco2 = 400,
+            .temperature = temperature,
+            .humidity = humidity,
+            .iaq = TELEMETRY_IAQ_NONE,
+            .valid = SENSOR_QUANTITY_ALL
+        };
+        char message[TELEMETRY_BUFFER_SIZE];
+        double sent_temperature;
+        double sent_humidity;
+        if ((telemetry_format_sample(&sample, message, sizeof(message)) < 0) ||
+            (sscanf(strstr(message, "\"temperature\":\"") + 15, "%lf",
+                &sent_temperature) != 1) ||
+            (sscanf(strstr(message, "\"humidity\":\"") + 12, "%lf",
+                &sent_humidity) != 1) ||
+            (fabs(sent_temperature - ref_temperature(raw)) > 0.1 + 1e-9) ||
+            (fabs(sent_humidity - ref_humidity(raw)) > 0.1 + 1e-9))
+        {
+            telemetry_mismatches++;
+        }
+
+        // ENV_DATA
+        uint8_t env[CCS811_ENV_DATA_SIZE];
+        uint16_t temp_reg;
+        uint16_t humi_reg;
+        ccs811_regs_encode_env_data(temperature, humidity, env);
+        int32_t env_humidity = (env[0] << 8) | env[1];
+        int32_t env_temperature = (env[2] << 8) | env[3];
+
+        ref_env_data(temperature / 100.0, humidity / 100.0, &temp_reg,
+            &humi_reg);
+        uint32_t env_error = (uint32_t)abs(env_humidity - humi_reg);
+        if ((uint32_t)abs(env_temperature - temp_reg) > env_error)
+        {
+            env_error = (uint32_t)abs(env_temperature - temp_reg);
+        }
+        if (env_error > max_env_error)
+        {
+            max_env_error = env_error;
+        }
+
+        ref_env_data(ref_temperature(raw), ref_humidity(raw), &temp_reg,
+            &humi_reg);
+        env_error = (uint32_t)abs(env_humidity - humi_reg);
+        if ((uint32_t)abs(env_temperature - temp_reg) > env_error)
+        {
+            env_error = (uint32_t)abs(env_temperature - temp_reg);
+        }
+        if (env_error > max_env_raw_error)
+        {
+            max_env_raw_error = env_error;
+        }
+    }
+
+    // Conversion rounds to the nearest hundredth
+    bool b_is_ok = (max_temp_error <= 0.5) && (max_humi_error <= 0.5) &&
+        (text_mismatches == 0) && (telemetry_mismatches == 0) &&
+        (max_env_error <= 1);
+
+    printf("accuracy over 65536 raw codes: %s\n", b_is_ok ? "PASS" : "FAIL");
+    printf("  temperature max error %.3f [0.01 degC]\n", max_temp_error);
+    printf("  humidity max error %.3f [0.01 %%RH]\n", max_humi_error);
+    printf("  display text mismatches %u, telemetry mismatches %u\n",
+        text_mismatches, telemetry_mismatches);
+    printf("  ENV_DATA max error %u [1/512], %u from raw value\n",
+        max_env_error, max_env_raw_error);
+
+    return b_is_ok;
+}
+
+static bool
+check_iaq(void)
+{
+    static const struct
+    {
+        uint16_t eco2;
+        uint16_t tvoc;
+        int16_t temperature;
+        uint16_t humidity;
+        uint16_t index;
+        iaq_band_t band;
+    } cases[] = {
+        {  400,     0,  2200, 4500,   0, IAQ_BAND_EXCELLENT },
+        {    0,     0,  2200, 4500,   0, IAQ_BAND_EXCELLENT },  // Below table
+        {  600,    65,  2200, 4500,  50, IAQ_BAND_EXCELLENT },
+        {  601,     0,  2200, 4500,  50, IAQ_BAND_EXCELLENT },  // 50.25
+        {  603,     0,  2200, 4500,  51, IAQ_BAND_GOOD },       // 50.75
+        {  700,     0,  2200, 4500,  75, IAQ_BAND_GOOD },
+        {  450,   300,  2200, 4500, 109, IAQ_BAND_MODERATE },   // TVOC worse
+        {  800,     0,  1400, 4500, 135, IAQ_BAND_MODERATE },   // Cold
+        { 1000,     0,  2200, 2500, 160, IAQ_BAND_POOR },       // Dry
+        { 1250,     0,  2200, 4500, 175, IAQ_BAND_POOR },
+        {  400,     0, -1000, 4500,  50, IAQ_BAND_EXCELLENT },  // Below table
+        {  400,     0,  3500, 9000, 100, IAQ_BAND_GOOD },       // Hot, humid
+        { 2000,     0,  2200, 4500, 300, IAQ_BAND_UNHEALTHY },
+        { 2100,     0,  2200, 4500, 307, IAQ_BAND_HAZARDOUS },
+        { 8000, 20000,  4000, 9500, 500, IAQ_BAND_HAZARDOUS },  // Capped
+    };
+    uint32_t table_mismatches = 0;
+    uint32_t window_mismatches = 0;
+
+    for (size_t idx = 0; idx < sizeof(cases) / sizeof(cases[0]); idx++)
+    {
+        iaq_result_t result;
+        iaq_compute(cases[idx].eco2, cases[idx].tvoc, cases[idx].temperature,
+            cases[idx].humidity, &result);
+        if ((result.index != cases[idx].index) ||
+            (result.band != cases[idx].band))
+        {
+            printf("  case %zu: index %u (%s), expected %u (%s)\n", idx,
+                result.index, iaq_get_band_name(result.band),
+                cases[idx].index, iaq_get_band_name(cases[idx].band));
+            table_mismatches++;
+        }
+    }
+
+    // Running sums against averages recomputed over the window
+    static uint16_t eco2[3 * IAQ_WINDOW_SAMPLES];
+    static uint16_t tvoc[3 * IAQ_WINDOW_SAMPLES];
+    uint32_t rng = 0x2545F491u;
+    iaq_t iaq;
+    iaq_result_t result;
+
+    iaq_init(&iaq);
+    if (iaq_get(&iaq, &result))
+    {
+        window_mismatches++;
+    }
+    for (uint32_t count = 1; count <= 3 * IAQ_WINDOW_SAMPLES; count++)
+    {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        eco2[count - 1] = (uint16_t)(400 + rng % 8000);
+        tvoc[count - 1] = (uint16_t)(rng % 1200);
+        iaq_add_gas(&iaq, eco2[count - 1], tvoc[count - 1]);
+
+        uint32_t window = (count < IAQ_WINDOW_SAMPLES) ?
+            count : IAQ_WINDOW_SAMPLES;
+        uint32_t eco2_sum = 0;
+        uint32_t tvoc_sum = 0;
+        for (uint32_t idx = count - window; idx < count; idx++)
+        {
+            eco2_sum += eco2[idx];
+            tvoc_sum += tvoc[idx];
+        }
+
+        iaq_result_t expected;
+        iaq_compute((uint16_t)((eco2_sum + window / 2) / window),
+            (uint16_t)((tvoc_sum + window / 2) / window),
+            IAQ_NEUTRAL_TEMPERATURE, IAQ_NEUTRAL_HUMIDITY, &expected);
+        if (!iaq_get(&iaq, &result) ||
+            (memcmp(&result, &expected, sizeof(result)) != 0))
+        {
+            window_mismatches++;
+        }
+    }
+
+    bool b_is_ok = (table_mismatches == 0) && (window_mismatches == 0);
+
+    printf("iaq over %zu table cases: %s\n", sizeof(cases) / sizeof(cases[0]),
+        b_is_ok ? "PASS" : "FAIL");
+    printf("  table mismatches %u, rolling average mismatches %u\n",
+        table_mismatches, window_mismatches);
+
+    return b_is_ok;
+}
+
+int
+Storage_OpenMutableFile(void)
+{
+    return open(g_storage_path, O_RDWR | O_CREAT, 0600);
+}
+
+int
+Storage_DeleteMutableFile(void)
+{
+    return unlink(g_storage_path);
+}
+
+/**
+ * @brief Read CCS811 results every drive mode period from power up until
+ *        the readings are accurate or the time runs out.
+ *
+ * @param p_uptime_ms Monotonic time, advanced.
+ * @param p_wall_time Wall clock, advanced.
+ * @param duration_s Time to run.
+ *
+ * @return Seconds from start to the first accurate reading, UINT32_MAX if
+ *         there was none.
+ */
+static uint32_t
+baseline_run(uint64_t *p_uptime_ms, time_t *p_wall_time, uint32_t duration_s)
+{
+    static const uint8_t reg = CCS811_REG_ALG_RESULT_DATA;
+    uint32_t accurate_s = UINT32_MAX;
+
+    for (uint32_t elapsed_s = BENCH_CCS811_PERIOD_S; elapsed_s <= duration_s;
+        elapsed_s += BENCH_CCS811_PERIOD_S)
+    {
+        uint8_t result[BENCH_ALG_RESULT_SIZE];
+
+        *p_uptime_ms += BENCH_CCS811_PERIOD_S * 1000;
+        *p_wall_time += BENCH_CCS811_PERIOD_S;
+        if (I2CMaster_WriteThenRead(BENCH_I2C_FD, BENCH_CCS811_ADDR, &reg, 1,
+            result, sizeof(result)) < 0)
+        {
+            continue;
+        }
+        ccs811_baseline_service(BENCH_I2C_FD, BENCH_CCS811_ADDR, *p_uptime_ms,
+            *p_wall_time);
+
+        int32_t eco2 = ((int32_t)result[0] << 8) | result[1];
+        if ((accurate_s == UINT32_MAX) &&
+            (abs(eco2 - BENCH_CLEAN_ECO2) <= BENCH_ECO2_TOLERANCE))
+        {
+            accurate_s = elapsed_s;
+        }
+    }
+
+    return accurate_s;
+}
+
+/**
+ * @brief Power cycle the simulated CCS811 and restore its baseline.
+ */
+static bool
+baseline_restart(uint64_t *p_uptime_ms, time_t wall_time)
+{
+    *p_uptime_ms = 0;
+    i2c_sim_ccs811_power_cycle();
+    return ccs811_baseline_restore(BENCH_I2C_FD, BENCH_CCS811_ADDR,
+        *p_uptime_ms, wall_time);
+}
+
+/**
+ * @brief Flagged quantities are left out of the telemetry.
+ */
+static bool
+check_quality(void)
+{
+    static const struct
+    {
+        uint32_t valid;
+        uint32_t flags;
+        const char *p_expected;
+    } cases[] = {
+        { SENSOR_QUANTITY_ALL, 0,
+            "{\"eco2\":\"800\", \"tvoc\":\"120\", \"temperature\":\"22.5\", "
+            "\"humidity\":\"45.0\"}" },
+        { SENSOR_QUANTITY_ENV, 0,
+            "{\"temperature\":\"22.5\", \"humidity\":\"45.0\"}" },
+        { SENSOR_QUANTITY_ALL, SENSOR_FLAG_WARMUP(SENSOR_QUANTITY_GAS),
+            "{\"temperature\":\"22.5\", \"humidity\":\"45.0\", "
+            "\"flags\":\"0x0000C0\"}" },
+        { SENSOR_QUANTITY_ALL, SENSOR_FLAG_UNCOMPENSATED(SENSOR_QUANTITY_GAS) |
+            SENSOR_FLAG_STALE(SENSOR_QUANTITY_HUMIDITY),
+            "{\"eco2\":\"800\", \"tvoc\":\"120\", \"temperature\":\"22.5\", "
+            "\"flags\":\"0xC00200\"}" },
+        { SENSOR_QUANTITY_ALL, SENSOR_FLAG_RANGE(SENSOR_QUANTITY_TEMPERATURE) |
+            SENSOR_FLAG_ERROR(SENSOR_QUANTITY_GAS),
+            "{\"humidity\":\"45.0\", \"flags\":\"0x0C1000\"}" },
+    };
+    uint32_t mismatches = 0;
+
+    for (size_t idx = 0; idx < sizeof(cases) / sizeof(cases[0]); idx++)
+    {
+        telemetry_sample_t sample = {
+            .eco2 = 800,
+            .tvoc = 120,
+            .temperature = 2250,
+            .humidity = 4500,
+            .iaq = TELEMETRY_IAQ_NONE,
+            .valid = cases[idx].valid,
+            .flags = cases[idx].flags
+        };
+        char message[TELEMETRY_BUFFER_SIZE];
+
+        if ((telemetry_format_sample(&sample, message, sizeof(message)) < 0) ||
+            (strcmp(message, cases[idx].p_expected) != 0))
+        {
+            printf("  case %zu: %s\n", idx, message);
+            mismatches++;
+        }
+    }
+
+    printf("quality flags: %u mismatches: %s\n", mismatches,
+        (mismatches == 0) ? "PASS" : "FAIL");
+
+    return (mismatches == 0);
+}
+
+/**
+ * @brief Trend columns against min and max recomputed over raw readings.
+ */
+static bool
+check_trend(void)
+{
+    enum { READINGS = 4000 };
+    static uint64_t times[READINGS];
+    static uint16_t values[READINGS];
+    const uint32_t span_ms = 2u * 60u * 60u * 1000u;
+    uint32_t rng = 0x2545F491u;
+    uint64_t now_ms = 1000;
+    uint32_t committed = 0;
+    uint32_t mismatches = 0;
+    trend_t trend;
+
+    trend_init(&trend, span_ms);
+    for (uint32_t idx = 0; idx < READINGS; idx++)
+    {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+
+        // 1 to 10 s apart, 40 minutes without readings halfway
+        now_ms += 1000u + rng % 9000u + ((idx == READINGS / 2) ?
+            40u * 60u * 1000u : 0);
+        times[idx] = now_ms;
+        values[idx] = (uint16_t)(400 + rng % 1600);
+        committed += trend_add(&trend, values[idx], now_ms);
+    }
+
+    // Open column ends at open_end_ms, committed ones precede it
+    uint32_t column_ms = span_ms / TREND_COLUMNS;
+    for (uint32_t col = 0; col < TREND_COLUMNS; col++)
+    {
+        uint64_t end_ms = trend.open_end_ms -
+            (uint64_t)(TREND_COLUMNS - col) * column_ms;
+        uint64_t start_ms = end_ms - column_ms;
+        trend_column_t expected = { UINT16_MAX, 0 };
+
+        for (uint32_t idx = 0; idx < READINGS; idx++)
+        {
+            if ((times[idx] >= start_ms) && (times[idx] < end_ms))
+            {
+                expected.min = (values[idx] < expected.min) ?
+                    values[idx] : expected.min;
+                expected.max = (values[idx] > expected.max) ?
+                    values[idx] : expected.max;
+            }
+        }
+
+        const trend_column_t *p_column = trend_get_column(&trend, col);
+        if ((p_column->min != expected.min) || (p_column->max != expected.max))
+        {
+            printf("  column %u: %u..%u, expected %u..%u\n", col,
+                p_column->min, p_column->max, expected.min, expected.max);
+            mismatches++;
+        }
+    }
+
+    // Every column time over is committed, readings span over the graph
+    uint32_t expected_committed = (uint32_t)((trend.open_end_ms - times[0]) /
+        column_ms) - 1;
+    bool b_is_ok = (mismatches == 0) && (committed == expected_committed);
+    printf("trend     %u columns committed, %u mismatches: %s\n", committed,
+        mismatches, b_is_ok ? "PASS" : "FAIL");
+
+    return b_is_ok;
+}
+
+static bool
+check_baseline(void)
+{
+    int fd = mkstemp(g_storage_path);
+    if (fd < 0)
+    {
+        printf("baseline  no storage file: FAIL\n");
+        return false;
+    }
+    close(fd);
+
+    uint64_t uptime_ms;
+    time_t wall_time = BENCH_WALL_TIME;
+    ccs811_baseline_record_t record;
+
+    // Cold start with empty storage, saved once settled and every hour
+    bool b_is_ok = !baseline_restart(&uptime_ms, wall_time);
+    uint32_t cold_s = baseline_run(&uptime_ms, &wall_time, 2 * 3600);
+    b_is_ok &= persist_load(PERSIST_REGION_CCS811_BASELINE, &record,
+        sizeof(record)) && (record.saved_time > BENCH_WALL_TIME);
+
+    // Restart a few minutes later
+    wall_time += 300;
+    b_is_ok &= baseline_restart(&uptime_ms, wall_time);
+    uint32_t restored_s = baseline_run(&uptime_ms, &wall_time, 60);
+
+    // Saved too long ago, wall clock not set, record corrupted
+    bool b_is_stale = baseline_restart(&uptime_ms,
+        wall_time + CCS811_BASELINE_MAX_AGE_S + 3600);
+    bool b_is_unset = baseline_restart(&uptime_ms, 0);
+    fd = Storage_OpenMutableFile();
+    b_is_ok &= (fd >= 0) && (pwrite(fd, "\xFF", 1, PERSIST_REGION_SIZE *
+        PERSIST_REGION_CCS811_BASELINE + 8) == 1);
+    close(fd);
+    bool b_is_corrupt = baseline_restart(&uptime_ms, wall_time);
+
+    Storage_DeleteMutableFile();
+
+    b_is_ok &= (restored_s <= BENCH_CCS811_PERIOD_S) && (cold_s > restored_s) &&
+        !b_is_stale && !b_is_unset && !b_is_corrupt;
+
+    printf("baseline  accurate after %u s from cold start, %u s restored, "
+        "stale %s, unset clock %s, corrupt %s: %s\n", cold_s, restored_s,
+        b_is_stale ? "restored" : "rejected",
+        b_is_unset ? "restored" : "rejected",
+        b_is_corrupt ? "restored" : "rejected", b_is_ok ? "PASS" : "FAIL");
+
+    // Leave the simulated CCS811 settled for the benchmarks
+    baseline_run(&uptime_ms, &wall_time, 2 * 3600);
+
+    return b_is_ok;
+}
+
+bool
+bench_check_accuracy(void)
+{
+    bool b_is_ok = check_conversion();
+    b_is_ok &= check_iaq();
+    b_is_ok &= check_quality();
+    b_is_ok &= check_trend();
+    b_is_ok &= check_baseline();
+
+    return b_is_ok;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,281 @@
+/***************************************************************************//**
+* @file    bench_faults.c
+* @version 1.0.0
+*
+* @brief Fault containment checks of sensor_bench.
+*
+* The sensor registry (sensor_registry.c) runs the sensors of
+* bench_sensors.h on its own event loop while the simulated bus misbehaves:
+*
+*   hotplug    the HDC1000 is unplugged until its circuit breaker isolates
+*              it and plugged in again until it measures, both timed
+*   glitch     one NACKed HDC1000 transfer is absorbed by a retry
+*   breaker    a CCS811 NACKing every transfer is isolated while the HDC1000
+*              keeps sampling, and measures again once the fault is removed
+*   stuck bus  SDA held low by a device is released by the reads of the
+*              reset I2C master (i2c_bus.c), both sensors resume
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "epoll_timerfd_utilities.h"
+#include "event_loop_stats.h"
+#include "i2c_bus.h"
+#include "i2c_sim.h"
+#include "sensor_bench.h"
+#include "sensor_registry.h"
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+#define BENCH_OLED_ADDR     (0x3C)
+#define BENCH_PERIOD_MS     (50)    // Sampling period in bench_sensors.h
+#define BENCH_FAULT_TIMEOUT_MS  (5000)
+
+/*******************************************************************************
+*   Global variables
+*******************************************************************************/
+
+static int g_fd_epoll = -1;
+static uint32_t g_readings[SENSOR_COUNT];   // Readings per sensor
+
+/*******************************************************************************
+*   Function definitions
+*******************************************************************************/
+
+static void
+fault_reading_handler(const sensor_t *p_sensor,
+    const sensor_reading_t *p_reading)
+{
+    (void)p_reading;
+
+    for (size_t idx = 0; idx < SENSOR_COUNT; idx++)
+    {
+        if (p_sensor == sensor_registry_get((sensor_id_t)idx))
+        {
+            g_readings[idx]++;
+        }
+    }
+}
+
+static bool
+bench_bus_recovery(void)
+{
+    // The display answers reads with its status byte
+    i2c_sim_reset_master();
+    return i2c_bus_recover(BENCH_I2C_FD, BENCH_OLED_ADDR);
+}
+
+/**
+ * @brief Start the registry on a new event loop.
+ */
+static bool
+bench_registry_open(void)
+{
+    // HDC1000 NACKs the scan while a conversion of the last run is pending
+    bench_sleep_ms(2 * BENCH_SINGLE_MS);
+
+    memset(g_readings, 0, sizeof(g_readings));
+    sensor_registry_set_bus_recovery(&bench_bus_recovery);
+
+    g_fd_epoll = CreateEpollFd();
+    if ((g_fd_epoll < 0) ||
+        (sensor_registry_init(g_fd_epoll, BENCH_I2C_FD,
+            &fault_reading_handler) != 0))
+    {
+        fprintf(stderr, "Could not set up event loop\n");
+        CloseFdAndPrintError(g_fd_epoll, "Epoll");
+        g_fd_epoll = -1;
+        return false;
+    }
+
+    return true;
+}
+
+static void
+bench_registry_close(void)
+{
+    sensor_registry_close();
+    CloseFdAndPrintError(g_fd_epoll, "Epoll");
+    g_fd_epoll = -1;
+}
+
+/**
+ * @brief Run the event loop until the condition holds or the timeout.
+ *
+ * @return Time it took [us], 0 on timeout.
+ */
+static uint64_t
+bench_run_until(bool (*p_is_done)(void), uint32_t timeout_ms)
+{
+    uint64_t start_us = loop_stats_now_us();
+    uint64_t now_us = start_us;
+
+    while (((p_is_done == NULL) || !p_is_done()) &&
+        (now_us - start_us < (uint64_t)timeout_ms * 1000u) &&
+        (WaitForEventAndCallHandler(g_fd_epoll) == 0))
+    {
+        now_us = loop_stats_now_us();
+    }
+
+    now_us = loop_stats_now_us();
+    return ((p_is_done != NULL) && p_is_done()) ? now_us - start_us : 0;
+}
+
+static bool
+is_hdc1000_isolated(void)
+{
+    return sensor_registry_get(SENSOR_ID_HDC1000)->state ==
+        SENSOR_STATE_ISOLATED;
+}
+
+static bool
+is_ccs811_isolated(void)
+{
+    return sensor_registry_get(SENSOR_ID_CCS811)->state ==
+        SENSOR_STATE_ISOLATED;
+}
+
+static bool
+is_hdc1000_measuring(void)
+{
+    return (g_readings[SENSOR_ID_HDC1000] > 0) &&
+        (sensor_registry_get(SENSOR_ID_HDC1000)->consecutive_errors == 0);
+}
+
+static bool
+is_ccs811_measuring(void)
+{
+    return (g_readings[SENSOR_ID_CCS811] > 0) &&
+        (sensor_registry_get(SENSOR_ID_CCS811)->consecutive_errors == 0);
+}
+
+static bool
+is_all_measuring(void)
+{
+    return is_hdc1000_measuring() && is_ccs811_measuring();
+}
+
+/**
+ * @brief Unplug the HDC1000 under the registry and plug it in again.
+ */
+void
+bench_hotplug(void)
+{
+    if (!bench_registry_open())
+    {
+        return;
+    }
+
+    const sensor_t *p_hdc = sensor_registry_get(SENSOR_ID_HDC1000);
+    bool b_is_found = (p_hdc->state != SENSOR_STATE_ABSENT);
+
+    // Let the sensors settle into their periods
+    bench_run_until(&is_all_measuring, BENCH_FAULT_TIMEOUT_MS);
+
+    i2c_sim_set_present(BENCH_HDC1000_ADDR, false);
+    uint64_t isolate_us = bench_run_until(&is_hdc1000_isolated,
+        BENCH_FAULT_TIMEOUT_MS);
+    uint32_t errors = p_hdc->errors;
+
+    i2c_sim_set_present(BENCH_HDC1000_ADDR, true);
+    g_readings[SENSOR_ID_HDC1000] = 0;
+    uint64_t resume_us = bench_run_until(&is_hdc1000_measuring,
+        BENCH_FAULT_TIMEOUT_MS);
+
+    printf("hotplug   hdc1000 %s at start, unplugged: isolated after %7.1f ms "
+        "(%u errors, %u retries), plugged: measuring after %7.1f ms\n",
+        b_is_found ? "found" : "missing", (double)isolate_us / 1e3, errors,
+        p_hdc->retries, (double)resume_us / 1e3);
+
+    bench_registry_close();
+}
+
+/**
+ * @brief Inject bus faults under the registry and check they are contained.
+ *
+ * @return true if all checks pass.
+ */
+bool
+bench_check_faults(void)
+{
+    const sensor_t *p_hdc = sensor_registry_get(SENSOR_ID_HDC1000);
+    const sensor_t *p_ccs = sensor_registry_get(SENSOR_ID_CCS811);
+    bool b_is_all_ok = true;
+
+    // Transient NACK, absorbed by a retry
+    if (bench_registry_open())
+    {
+        bench_run_until(&is_all_measuring, BENCH_FAULT_TIMEOUT_MS);
+        i2c_sim_fail(BENCH_HDC1000_ADDR, 1);
+        g_readings[SENSOR_ID_HDC1000] = 0;
+        bench_run_until(NULL, 4 * BENCH_PERIOD_MS);
+
+        bool b_is_ok = (p_hdc->errors == 0) && (p_hdc->retries > 0) &&
+            is_all_measuring();
+        printf("fault     glitch: %u retries, %u errors: %s\n",
+            p_hdc->retries, p_hdc->errors, b_is_ok ? "PASS" : "FAIL");
+        b_is_all_ok &= b_is_ok;
+        bench_registry_close();
+    }
+
+    // Failing CCS811 isolated, HDC1000 keeps sampling, then recovers
+    if (bench_registry_open())
+    {
+        bench_run_until(&is_all_measuring, BENCH_FAULT_TIMEOUT_MS);
+        i2c_sim_fail(BENCH_CCS811_ADDR, I2C_SIM_FAIL_ALWAYS);
+        uint64_t isolate_us = bench_run_until(&is_ccs811_isolated,
+            BENCH_FAULT_TIMEOUT_MS);
+
+        g_readings[SENSOR_ID_HDC1000] = 0;
+        bench_run_until(NULL, 4 * BENCH_PERIOD_MS);
+        uint32_t hdc_readings = g_readings[SENSOR_ID_HDC1000];
+
+        i2c_sim_fail(BENCH_CCS811_ADDR, 0);
+        g_readings[SENSOR_ID_CCS811] = 0;
+        uint64_t resume_us = bench_run_until(&is_ccs811_measuring,
+            BENCH_FAULT_TIMEOUT_MS);
+
+        bool b_is_ok = (isolate_us > 0) && (hdc_readings > 0) &&
+            (p_hdc->errors == 0) && (resume_us > 0) &&
+            (sensor_registry_get_bus_recoveries() == 0);
+        printf("fault     breaker: isolated after %7.1f ms, %u hdc1000 "
+            "readings meanwhile, measuring after %7.1f ms: %s\n",
+            (double)isolate_us / 1e3, hdc_readings, (double)resume_us / 1e3,
+            b_is_ok ? "PASS" : "FAIL");
+        b_is_all_ok &= b_is_ok;
+        bench_registry_close();
+    }
+
+    // SDA held low, released by the transfers of the reset master
+    if (bench_registry_open())
+    {
+        bench_run_until(&is_all_measuring, BENCH_FAULT_TIMEOUT_MS);
+        i2c_sim_hold_sda(5);
+        memset(g_readings, 0, sizeof(g_readings));
+        uint64_t resume_us = bench_run_until(&is_all_measuring,
+            BENCH_FAULT_TIMEOUT_MS);
+
+        bool b_is_ok = (resume_us > 0) &&
+            (sensor_registry_get_bus_recoveries() == 1) &&
+            (p_hdc->breaker_opens == 0) && (p_ccs->breaker_opens == 0);
+        printf("fault     stuck bus: %u recoveries, measuring after %7.1f ms: "
+            "%s\n", sensor_registry_get_bus_recoveries(),
+            (double)resume_us / 1e3, b_is_ok ? "PASS" : "FAIL");
+        b_is_all_ok &= b_is_ok;
+        bench_registry_close();
+    }
+
+    return b_is_all_ok;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,541 @@
+/***************************************************************************//**
+* @file    bench_loop.c
+* @version 1.0.0
+*
+* @brief Bus and event loop benchmarks of sensor_bench.
+*
+* HDC1000 samples are acquired over the simulated bus with separate
+* temperature and humidity conversions, each waited for in the caller, and
+* with one combined conversion (hdc1000_regs.c) whose wait is left to the
+* event loop.
+*
+* The event loop code of the application (epoll_timerfd_utilities.c,
+* event_loop_stats.c) then runs with a 2 ms periodic probe event, the stand
+* in for button polling and Azure processing, while the sensors are
+* acquired one of three ways:
+*
+*   blocking  one handler converting and reading both HDC1000 channels,
+*             then compensating and reading the CCS811
+*   two-stage trigger handler, read handler doing HDC1000 read, CCS811
+*             compensation and results read
+*   staged    sensor registry scheduler (sensor_registry.c) with the sensors
+*             of bench_sensors.h, one driver operation per event
+*
+* The CCS811 driver of the staged mode is defined here.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "applibs/i2c.h"
+#include "ccs811_regs.h"
+#include "epoll_timerfd_utilities.h"
+#include "event_loop_stats.h"
+#include "hdc1000_regs.h"
+#include "i2c_scan.h"
+#include "i2c_sim.h"
+#include "latency_histogram.h"
+#include "measurement.h"
+#include "sensor_bench.h"
+#include "sensor_registry.h"
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+#define BENCH_PROBE_NS      (2000000)   // Probe event period
+#define BENCH_TRIGGER_NS    (50000000)  // CCS811 data ready period
+
+/*******************************************************************************
+*   Data types
+*******************************************************************************/
+
+typedef enum
+{
+    BENCH_LOOP_BLOCKING,
+    BENCH_LOOP_TWO_STAGE,
+    BENCH_LOOP_STAGED,
+    BENCH_LOOP_MODE_COUNT
+} bench_loop_mode_t;
+
+/*******************************************************************************
+*   Global variables
+*******************************************************************************/
+
+// Accumulates output so that the compiler keeps the work
+static volatile uint32_t g_sink;
+
+static int g_fd_epoll = -1;
+static int g_fd_probe = -1;
+static int g_fd_trigger = -1;
+static int g_fd_read = -1;
+static uint64_t g_probe_start_ns;   // Probe timer armed
+static uint64_t g_probe_expirations;
+static latency_hist_t g_hist_probe; // Probe event lateness [us]
+static uint32_t g_acquisitions;
+static uint16_t g_raw[2];
+static measurement_env_t g_env;
+static bool gb_is_env_valid;
+
+/*******************************************************************************
+*   Function definitions
+*******************************************************************************/
+
+/**
+ * @brief Acquire temperature and humidity as separate conversions.
+ *
+ * @return Time the caller was blocked [ns], 0 on bus error.
+ */
+static uint64_t
+acquire_separate(uint16_t *p_raw)
+{
+    static const uint8_t regs[2] = {
+        HDC1000_REG_TEMPERATURE, HDC1000_REG_HUMIDITY
+    };
+    uint64_t start_ns = bench_now_ns();
+
+    for (int idx = 0; idx < 2; idx++)
+    {
+        uint8_t data[2];
+        if (I2CMaster_Write(BENCH_I2C_FD, BENCH_HDC1000_ADDR, &regs[idx], 1)
+            != 1)
+        {
+            return 0;
+        }
+        bench_sleep_ms(BENCH_SINGLE_MS);
+        if (I2CMaster_Read(BENCH_I2C_FD, BENCH_HDC1000_ADDR, data, 2) != 2)
+        {
+            return 0;
+        }
+        p_raw[idx] = (uint16_t)((data[0] << 8) | data[1]);
+    }
+
+    return bench_now_ns() - start_ns;
+}
+
+/**
+ * @brief Acquire temperature and humidity in one conversion.
+ *
+ * @param p_max_handler_ns Longest of the start and read handlers [ns].
+ *
+ * @return Time the caller was blocked in both handlers [ns], 0 on bus error.
+ */
+static uint64_t
+acquire_combined(uint16_t *p_raw, uint64_t *p_max_handler_ns)
+{
+    uint64_t start_ns = bench_now_ns();
+    if (!hdc1000_regs_start_conversion(BENCH_I2C_FD, BENCH_HDC1000_ADDR))
+    {
+        return 0;
+    }
+    uint64_t start_handler_ns = bench_now_ns() - start_ns;
+
+    // One shot timer on the device, event loop runs meanwhile
+    bench_sleep_ms(HDC1000_CONVERSION_TIME_MS);
+
+    start_ns = bench_now_ns();
+    if (!hdc1000_regs_read_conversion(BENCH_I2C_FD, BENCH_HDC1000_ADDR,
+        &p_raw[0], &p_raw[1]))
+    {
+        return 0;
+    }
+    uint64_t read_handler_ns = bench_now_ns() - start_ns;
+
+    *p_max_handler_ns = (start_handler_ns > read_handler_ns) ?
+        start_handler_ns : read_handler_ns;
+    return start_handler_ns + read_handler_ns;
+}
+
+void
+bench_bus(uint32_t samples)
+{
+    for (int mode = 0; mode < 2; mode++)
+    {
+        uint64_t blocked_ns = 0;
+        uint64_t max_handler_ns = 0;
+        uint32_t errors = 0;
+        i2c_sim_stats_t stats;
+
+        hdc1000_regs_write(BENCH_I2C_FD, BENCH_HDC1000_ADDR,
+            HDC1000_REG_CONFIGURATION, mode ? HDC1000_CONFIG_MODE : 0);
+        i2c_sim_get_stats(&stats);
+
+        for (uint32_t idx = 0; idx < samples; idx++)
+        {
+            uint16_t raw[2];
+            uint64_t handler_ns = 0;
+            uint64_t sample_ns = mode ? acquire_combined(raw, &handler_ns) :
+                acquire_separate(raw);
+
+            if (sample_ns == 0)
+            {
+                errors++;
+                continue;
+            }
+            if (!mode)
+            {
+                handler_ns = sample_ns;
+            }
+            blocked_ns += sample_ns;
+            if (handler_ns > max_handler_ns)
+            {
+                max_handler_ns = handler_ns;
+            }
+            g_sink += (uint32_t)measurement_temperature_from_hdc1000(raw[0]) +
+                measurement_humidity_from_hdc1000(raw[1]);
+        }
+
+        i2c_sim_get_stats(&stats);
+        printf("%-9s bus %6.1f us/sample, %4.1f transfers/sample, "
+            "loop blocked %7.1f us/sample, longest handler %7.1f us, "
+            "%u errors\n",
+            mode ? "combined" : "separate",
+            (double)stats.bus_ns / 1e3 / samples,
+            (double)stats.transfers / samples,
+            (double)blocked_ns / 1e3 / samples,
+            (double)max_handler_ns / 1e3, errors + stats.nacks);
+    }
+}
+
+/**
+ * @brief Time a scan of the whole address range.
+ */
+void
+bench_scan(void)
+{
+    i2c_scan_map_t map;
+    i2c_sim_stats_t stats;
+
+    memset(&map, 0, sizeof(map));
+    i2c_sim_get_stats(&stats);
+
+    uint64_t start_ns = bench_now_ns();
+    uint32_t found = i2c_scan_range(BENCH_I2C_FD, I2C_SCAN_ADDR_FIRST,
+        I2C_SCAN_ADDR_LAST, &map, NULL);
+    uint64_t elapsed_ns = bench_now_ns() - start_ns;
+
+    i2c_sim_get_stats(&stats);
+    printf("scan      0x%02X-0x%02X in %6.1f ms, bus %6.1f ms, "
+        "%u transfers, %u devices:", I2C_SCAN_ADDR_FIRST, I2C_SCAN_ADDR_LAST,
+        (double)elapsed_ns / 1e6, (double)stats.bus_ns / 1e6,
+        stats.transfers, found);
+    for (uint32_t addr = I2C_SCAN_ADDR_FIRST; addr <= I2C_SCAN_ADDR_LAST;
+        addr++)
+    {
+        if (i2c_scan_is_present(&map, (uint8_t)addr))
+        {
+            printf(" 0x%02X", addr);
+        }
+    }
+    printf("\n");
+}
+
+/**
+ * @brief Probe event, records how late its oldest unserved expiration is.
+ */
+static void
+probe_event_handler(EventData *p_event_data)
+{
+    (void)p_event_data;
+
+    uint64_t expirations = 0;
+    if (read(g_fd_probe, &expirations, sizeof(expirations)) !=
+        sizeof(expirations))
+    {
+        return;
+    }
+
+    uint64_t due_ns = g_probe_start_ns +
+        (g_probe_expirations + 1) * BENCH_PROBE_NS;
+    uint64_t now = bench_now_ns();
+    latency_hist_record(&g_hist_probe,
+        (now > due_ns) ? (uint32_t)((now - due_ns) / 1000) : 0);
+    g_probe_expirations += expirations;
+}
+
+/**
+ * @brief Convert HDC1000 result acquired by the blocking or two-stage mode.
+ */
+static void
+bench_convert(bool b_is_valid)
+{
+    g_env.temperature = measurement_temperature_from_hdc1000(g_raw[0]);
+    g_env.humidity = measurement_humidity_from_hdc1000(g_raw[1]);
+    gb_is_env_valid = b_is_valid;
+}
+
+static void
+bench_compensate(void)
+{
+    uint8_t data[1 + CCS811_ENV_DATA_SIZE] = { CCS811_REG_ENV_DATA };
+
+    if (gb_is_env_valid)
+    {
+        ccs811_regs_encode_env_data(g_env.temperature, g_env.humidity,
+            &data[1]);
+        I2CMaster_Write(BENCH_I2C_FD, BENCH_CCS811_ADDR, data, sizeof(data));
+    }
+}
+
+static bool
+bench_results(void)
+{
+    static const uint8_t reg = CCS811_REG_ALG_RESULT_DATA;
+    uint8_t result[BENCH_ALG_RESULT_SIZE];
+
+    bool b_is_ok = (I2CMaster_WriteThenRead(BENCH_I2C_FD, BENCH_CCS811_ADDR,
+        &reg, 1, result, sizeof(result)) > 0);
+    g_sink += result[0];
+    return b_is_ok;
+}
+
+static void
+bench_publish(void)
+{
+    char text[MEASUREMENT_TEXT_SIZE];
+
+    measurement_format(g_env.temperature, 1, text, sizeof(text));
+    g_sink += (uint32_t)text[0];
+    g_acquisitions++;
+}
+
+/**
+ * @brief CCS811 data ready event, acquires in one blocking handler.
+ */
+static void
+blocking_event_handler(EventData *p_event_data)
+{
+    (void)p_event_data;
+
+    if (ConsumeTimerFdEvent(g_fd_trigger) == 0)
+    {
+        bench_convert(acquire_separate(g_raw) != 0);
+        bench_compensate();
+        bench_results();
+        bench_publish();
+    }
+}
+
+/**
+ * @brief CCS811 data ready event, starts HDC1000 conversion.
+ */
+static void
+two_stage_trigger_event_handler(EventData *p_event_data)
+{
+    (void)p_event_data;
+
+    static const struct timespec conversion_time = {
+        0, HDC1000_CONVERSION_TIME_MS * 1000000L
+    };
+
+    if ((ConsumeTimerFdEvent(g_fd_trigger) == 0) &&
+        hdc1000_regs_start_conversion(BENCH_I2C_FD, BENCH_HDC1000_ADDR))
+    {
+        SetTimerFdToSingleExpiry(g_fd_read, &conversion_time);
+    }
+}
+
+/**
+ * @brief Conversion complete, reads HDC1000, compensates and reads CCS811.
+ */
+static void
+two_stage_read_event_handler(EventData *p_event_data)
+{
+    (void)p_event_data;
+
+    if (ConsumeTimerFdEvent(g_fd_read) == 0)
+    {
+        bench_convert(hdc1000_regs_read_conversion(BENCH_I2C_FD,
+            BENCH_HDC1000_ADDR, &g_raw[0], &g_raw[1]));
+        bench_compensate();
+        bench_results();
+        bench_publish();
+    }
+}
+
+static bool
+bench_ccs811_probe(sensor_t *p_sensor)
+{
+    const uint8_t reg = CCS811_REG_HW_ID;
+    uint8_t hw_id = 0;
+
+    return (I2CMaster_WriteThenRead(p_sensor->fd_i2c, p_sensor->i2c_addr, &reg,
+        1, &hw_id, 1) == (1 + 1)) && (hw_id == CCS811_HW_ID_VALUE);
+}
+
+static int32_t
+bench_ccs811_start(sensor_t *p_sensor, const sensor_reading_t *p_latest)
+{
+    const uint32_t env = SENSOR_QUANTITY_TEMPERATURE | SENSOR_QUANTITY_HUMIDITY;
+
+    (void)p_sensor;
+
+    g_env.temperature = p_latest->temperature;
+    g_env.humidity = p_latest->humidity;
+    gb_is_env_valid = ((p_latest->valid & env) == env);
+    bench_compensate();
+    return 0;
+}
+
+static bool
+bench_ccs811_read(sensor_t *p_sensor, sensor_reading_t *p_reading)
+{
+    (void)p_sensor;
+
+    p_reading->valid = SENSOR_QUANTITY_ECO2 | SENSOR_QUANTITY_TVOC;
+    return bench_results();
+}
+
+const sensor_driver_t bench_ccs811_driver = {
+    .probe = &bench_ccs811_probe,
+    .start = &bench_ccs811_start,
+    .read = &bench_ccs811_read
+};
+
+static void
+bench_reading_handler(const sensor_t *p_sensor,
+    const sensor_reading_t *p_reading)
+{
+    (void)p_sensor;
+
+    // Acquisition completes with CCS811 results
+    if (p_reading->valid & SENSOR_QUANTITY_ECO2)
+    {
+        bench_publish();
+    }
+}
+
+/**
+ * @brief Run the event loop until the given number of acquisitions has
+ *        completed.
+ *
+ * @return false if a sensor NACKed a transfer. The registry rescans of the
+ *         staged mode NACK every address without a device, those are fine.
+ */
+static bool
+bench_loop_run(bench_loop_mode_t mode, uint32_t acquisitions)
+{
+    static const char *p_names[BENCH_LOOP_MODE_COUNT] = {
+        "blocking", "two-stage", "staged"
+    };
+    static const struct timespec probe_period = { 0, BENCH_PROBE_NS };
+    static const struct timespec trigger_period = { 0, BENCH_TRIGGER_NS };
+    static const struct timespec disarmed = { 0, 0 };
+    static EventData probe_event_data = {
+        .eventHandler = &probe_event_handler, .name = "probe"
+    };
+    static EventData trigger_event_data[BENCH_LOOP_MODE_COUNT] = {
+        { .eventHandler = &blocking_event_handler, .name = "blocking" },
+        { .eventHandler = &two_stage_trigger_event_handler, .name = "hdcStart" }
+    };
+    static EventData read_event_data = {
+        .eventHandler = &two_stage_read_event_handler, .name = "hdcReadAll"
+    };
+
+    hdc1000_regs_write(BENCH_I2C_FD, BENCH_HDC1000_ADDR,
+        HDC1000_REG_CONFIGURATION,
+        (mode == BENCH_LOOP_BLOCKING) ? 0 : HDC1000_CONFIG_MODE);
+
+    g_fd_epoll = CreateEpollFd();
+    g_fd_probe = CreateTimerFdAndAddToEpoll(g_fd_epoll, &probe_period,
+        &probe_event_data, EPOLLIN);
+    g_probe_start_ns = bench_now_ns();
+
+    int result = ((g_fd_epoll < 0) || (g_fd_probe < 0)) ? -1 : 0;
+    if ((result == 0) && (mode == BENCH_LOOP_STAGED))
+    {
+        // Sensors sampled by the registry scheduler at their own period
+        result = sensor_registry_init(g_fd_epoll, BENCH_I2C_FD,
+            &bench_reading_handler);
+    }
+    else if (result == 0)
+    {
+        g_fd_trigger = CreateTimerFdAndAddToEpoll(g_fd_epoll, &trigger_period,
+            &trigger_event_data[mode], EPOLLIN);
+        g_fd_read = CreateTimerFdAndAddToEpoll(g_fd_epoll, &disarmed,
+            &read_event_data, EPOLLIN);
+        result = ((g_fd_trigger < 0) || (g_fd_read < 0)) ? -1 : 0;
+    }
+
+    if (result != 0)
+    {
+        fprintf(stderr, "Could not set up event loop\n");
+        return false;
+    }
+
+    g_probe_expirations = 0;
+    g_acquisitions = 0;
+    latency_hist_reset(&g_hist_probe);
+    loop_stats_reset();
+    i2c_sim_stats_t stats;
+    i2c_sim_get_stats(&stats);
+
+    while ((g_acquisitions < acquisitions) &&
+        (WaitForEventAndCallHandler(g_fd_epoll) == 0))
+    {
+    }
+
+    i2c_sim_get_stats(&stats);
+    if (mode == BENCH_LOOP_STAGED)
+    {
+        sensor_registry_close();
+    }
+    CloseFdAndPrintError(g_fd_read, "Read timer");
+    CloseFdAndPrintError(g_fd_trigger, "Trigger timer");
+    CloseFdAndPrintError(g_fd_probe, "Probe timer");
+    CloseFdAndPrintError(g_fd_epoll, "Epoll");
+    g_fd_read = -1;
+    g_fd_trigger = -1;
+
+    // Slowest acquisition handler, by p99 so that host scheduling noise
+    // does not hide the split
+    uint32_t handler_us = 0;
+    const char *p_handler_name = "";
+    const loop_stats_entry_t *p_entry;
+    for (size_t idx = 0; (p_entry = loop_stats_get_entry(idx)) != NULL; idx++)
+    {
+        uint32_t run_us = latency_hist_percentile(&p_entry->run_us, 990);
+        if ((run_us > handler_us) && (p_entry->name != probe_event_data.name))
+        {
+            handler_us = run_us;
+            p_handler_name = p_entry->name;
+        }
+    }
+
+    latency_summary_t probe;
+    latency_hist_summarize(&g_hist_probe, &probe);
+    bool b_is_ok = (stats.nacks == stats.absent_nacks);
+    printf("%-9s probe late p50 %6u us, p99 %6u us, max %6u us, "
+        "slowest handler p99 %6u us (%s), %u nacks, %u of empty addresses: "
+        "%s\n", p_names[mode], probe.p50, probe.p99, probe.max, handler_us,
+        p_handler_name, stats.nacks, stats.absent_nacks,
+        b_is_ok ? "PASS" : "FAIL");
+
+    return b_is_ok;
+}
+
+/**
+ * @return false if a sensor NACKed a transfer in any mode.
+ */
+bool
+bench_loop(uint32_t acquisitions)
+{
+    bool b_is_ok = true;
+
+    for (int mode = 0; mode < BENCH_LOOP_MODE_COUNT; mode++)
+    {
+        b_is_ok &= bench_loop_run((bench_loop_mode_t)mode, acquisitions);
+    }
+
+    return b_is_ok;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,36 @@
+/***************************************************************************//**
+* @file    bench_sensors.h
+* @version 1.0.0
+*
+* @brief Sensor registry configuration of sensor_bench.
+*
+* Selected with -DSENSOR_REGISTRY_CONFIG='"bench_sensors.h"' in place of
+* AirQuality/sensor_config.h. The HDC1000 driver of the application runs on
+* the simulated bus, the CCS811 driver of bench_loop.c stands in for the
+* library based one.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef BENCH_SENSORS_H
+#define BENCH_SENSORS_H
+
+#include "sensor_hdc1000.h"
+
+extern const sensor_driver_t bench_ccs811_driver;
+
+#define SENSOR_REGISTRY(X)                                                    \
+    X(HDC1000, "hdc1000", sensor_hdc1000_driver, 0x40, 0x43, 50, 5)           \
+    X(CCS811, "ccs811", bench_ccs811_driver, 0x5A, 0x5B, 50, 5)
+
+// Short rescan period and breaker cooldowns for the fault scenarios
+#define SENSOR_REGISTRY_RESCAN_MS   (200)
+#define SENSOR_BREAKER_COOLDOWN_MS  (100)
+#define SENSOR_BREAKER_COOLDOWN_MAX_MS  (400)
+
+#endif  // BENCH_SENSORS_H
+
+/* [] END OF FILE */
@@ -0,0 +1,384 @@
+/***************************************************************************//**
+* @file    i2c_sim.c
+* @version 1.0.0
+*
+* @brief Simulated I2C bus with an HDC1000, a CCS811 and an OLED display for
+*        host benchmarks.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include "applibs/i2c.h"
+#include "ccs811_regs.h"
+#include "hdc1000_regs.h"
+#include "i2c_sim.h"
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+
+#define SIM_BUS_SPEED_HZ        (100000)    // I2C_BUS_SPEED_STANDARD
+#define SIM_HDC1000_ADDR        (0x40)
+#define SIM_CCS811_ADDR         (0x5A)
+#define SIM_OLED_ADDR           (0x3C)
+#define SIM_ADDR_NACK_BITS      (2 + 9)     // Start, NACKed address, stop
+#define SIM_BYTE_CLOCKS         (9)         // Data bits and ACK
+#define SIM_HDC1000_MANUFACTURER (0x5449)
+#define SIM_HDC1000_DEVICE      (0x1000)
+#define SIM_TEMPERATURE_NS      (6350000)   // 14 bit conversion times
+#define SIM_HUMIDITY_NS         (6500000)
+
+// CCS811 algorithm: eCO2 and TVOC of clean air once the baseline has settled,
+// the baseline starts offset after power up and settles within 120 results,
+// 20 minutes in 10 s drive mode
+#define SIM_CCS811_ECO2         (400)       // [ppm]
+#define SIM_CCS811_TVOC         (30)        // [ppb]
+#define SIM_CCS811_BASELINE     (0x84A7)
+#define SIM_CCS811_COLD_OFFSET  (1200)
+#define SIM_CCS811_SETTLE_STEP  (10)        // Per result
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+
+static i2c_sim_stats_t g_stats;
+
+static uint8_t g_pointer;
+static uint16_t g_config;
+static uint64_t g_ready_ns;     // Conversion complete
+static uint32_t g_rng = 0x2545F491u;
+
+// Devices plugged in, one bit per address
+#define SIM_PRESENT(addr, word) \
+    (((addr) / 32 == (word)) ? (1u << ((addr) % 32)) : 0)
+#define SIM_PRESENT_WORD(word)  (SIM_PRESENT(SIM_OLED_ADDR, word) | \
+    SIM_PRESENT(SIM_HDC1000_ADDR, word) | SIM_PRESENT(SIM_CCS811_ADDR, word))
+
+static uint32_t g_present[4] = {
+    SIM_PRESENT_WORD(0), SIM_PRESENT_WORD(1),
+    SIM_PRESENT_WORD(2), SIM_PRESENT_WORD(3)
+};
+
+// Injected faults
+static uint32_t g_fail[128];            // Transfers left to NACK
+static uint32_t g_sda_hold_clocks;      // SCL clocks until SDA is released
+static bool gb_is_master_reset;         // Starts transfers on a busy bus
+
+// CCS811 baseline offset from the settled one
+static int32_t g_ccs811_offset;
+
+/*******************************************************************************
+* Function definitions
+*******************************************************************************/
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Occupy the bus for the given number of bit times.
+ */
+static void
+bus_transfer(uint32_t bits)
+{
+    uint64_t duration_ns = (uint64_t)bits * 1000000000u / SIM_BUS_SPEED_HZ;
+    uint64_t end_ns = now_ns() + duration_ns;
+
+    // Busy wait, a sleep would overshoot short transfers
+    while (now_ns() < end_ns)
+    {
+    }
+
+    g_stats.bus_ns += duration_ns;
+    g_stats.transfers++;
+}
+
+/**
+ * @brief Check the addressed device is present, NACK its address otherwise.
+ */
+static bool
+bus_address(I2C_DeviceAddress address)
+{
+    if ((g_sda_hold_clocks > 0) && !gb_is_master_reset)
+    {
+        // No START condition possible
+        g_stats.nacks++;
+        errno = EBUSY;
+        return false;
+    }
+
+    if (g_sda_hold_clocks > 0)
+    {
+        // The holding device shifts out one bit per address clock, the
+        // address is lost
+        g_sda_hold_clocks = (g_sda_hold_clocks > SIM_BYTE_CLOCKS) ?
+            g_sda_hold_clocks - SIM_BYTE_CLOCKS : 0;
+        bus_transfer(SIM_ADDR_NACK_BITS);
+        g_stats.nacks++;
+        errno = EIO;
+        return false;
+    }
+    gb_is_master_reset = false;
+
+    if ((address < 128) &&
+        ((g_present[address / 32] & (1u << (address % 32))) != 0))
+    {
+        if (g_fail[address] == 0)
+        {
+            return true;
+        }
+        if (g_fail[address] != I2C_SIM_FAIL_ALWAYS)
+        {
+            g_fail[address]--;
+        }
+    }
+    else
+    {
+        g_stats.absent_nacks++;
+    }
+
+    bus_transfer(SIM_ADDR_NACK_BITS);
+    g_stats.nacks++;
+    errno = ENXIO;
+    return false;
+}
+
+static uint16_t
+random_raw(uint16_t base)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return (uint16_t)(base + (g_rng & 0x3FF));
+}
+
+ssize_t
+I2CMaster_Write(int fd, I2C_DeviceAddress address, const uint8_t *data,
+    size_t length)
+{
+    (void)fd;
+
+    if (!bus_address(address))
+    {
+        return -1;
+    }
+
+    // Start, address and data bytes with ACK, stop
+    bus_transfer(2 + 9 * (uint32_t)(1 + length));
+
+    if ((address == SIM_CCS811_ADDR) && (length >= 3) &&
+        (data[0] == CCS811_REG_BASELINE))
+    {
+        g_ccs811_offset = (int32_t)(((uint16_t)data[1] << 8) | data[2]) -
+            SIM_CCS811_BASELINE;
+    }
+
+    if (((address == SIM_CCS811_ADDR) || (address == SIM_OLED_ADDR)) &&
+        (length > 0))
+    {
+        return (ssize_t)length;
+    }
+
+    if ((address != SIM_HDC1000_ADDR) || (length == 0))
+    {
+        g_stats.nacks++;
+        errno = ENXIO;
+        return -1;
+    }
+
+    g_pointer = data[0];
+    if ((g_pointer == HDC1000_REG_CONFIGURATION) && (length >= 3))
+    {
+        g_config = (uint16_t)((data[1] << 8) | data[2]);
+    }
+    else if (g_pointer == HDC1000_REG_TEMPERATURE)
+    {
+        g_ready_ns = now_ns() + SIM_TEMPERATURE_NS +
+            ((g_config & HDC1000_CONFIG_MODE) ? SIM_HUMIDITY_NS : 0);
+    }
+    else if (g_pointer == HDC1000_REG_HUMIDITY)
+    {
+        g_ready_ns = now_ns() + SIM_HUMIDITY_NS;
+    }
+
+    return (ssize_t)length;
+}
+
+ssize_t
+I2CMaster_Read(int fd, I2C_DeviceAddress address, uint8_t *buffer,
+    size_t maxLength)
+{
+    (void)fd;
+
+    if (!bus_address(address))
+    {
+        return -1;
+    }
+
+    if ((address == SIM_HDC1000_ADDR) && (now_ns() < g_ready_ns))
+    {
+        // Address byte NACKed during conversion
+        bus_transfer(SIM_ADDR_NACK_BITS);
+        g_stats.nacks++;
+        errno = EIO;
+        return -1;
+    }
+
+    bus_transfer(2 + 9 * (uint32_t)(1 + maxLength));
+
+    if (address != SIM_HDC1000_ADDR)
+    {
+        // Status byte of the other devices
+        memset(buffer, 0, maxLength);
+        return (ssize_t)maxLength;
+    }
+
+    // Around 23 degC and 45 %RH
+    uint16_t values[2] = { random_raw(24800), random_raw(29000) };
+    size_t first = (g_pointer == HDC1000_REG_HUMIDITY) ? 1 : 0;
+    for (size_t idx = 0; idx < maxLength; idx++)
+    {
+        size_t value = first + idx / 2;
+        uint16_t raw = (value < 2) ? values[value] : 0xFFFF;
+        buffer[idx] = (idx % 2) ? (uint8_t)raw : (uint8_t)(raw >> 8);
+    }
+
+    return (ssize_t)maxLength;
+}
+
+ssize_t
+I2CMaster_WriteThenRead(int fd, I2C_DeviceAddress address,
+    const uint8_t *writeData, size_t lenWriteData, uint8_t *readData,
+    size_t lenReadData)
+{
+    (void)fd;
+
+    if (!bus_address(address))
+    {
+        return -1;
+    }
+
+    // Start, address, register, repeated start, address, data, stop
+    bus_transfer(3 + 9 * (uint32_t)(2 + lenWriteData + lenReadData));
+
+    if ((address == SIM_CCS811_ADDR) && (lenWriteData > 0))
+    {
+        memset(readData, 0, lenReadData);
+        if (writeData[0] == CCS811_REG_ALG_RESULT_DATA)
+        {
+            // eCO2 and TVOC read high while the baseline settles, followed
+            // by STATUS with DATA_READY and APP_VALID
+            int32_t offset = (g_ccs811_offset > 0) ? g_ccs811_offset :
+                -g_ccs811_offset;
+            uint16_t eco2 = (uint16_t)(SIM_CCS811_ECO2 + offset / 4);
+            uint16_t tvoc = (uint16_t)(SIM_CCS811_TVOC + offset / 16);
+            uint8_t alg_result[] = {
+                (uint8_t)(eco2 >> 8), (uint8_t)eco2,
+                (uint8_t)(tvoc >> 8), (uint8_t)tvoc, 0x98, 0x00, 0x00, 0x00
+            };
+            memcpy(readData, alg_result, (lenReadData < sizeof(alg_result)) ?
+                lenReadData : sizeof(alg_result));
+
+            g_ccs811_offset = (offset <= SIM_CCS811_SETTLE_STEP) ? 0 :
+                g_ccs811_offset + ((g_ccs811_offset > 0) ?
+                -SIM_CCS811_SETTLE_STEP : SIM_CCS811_SETTLE_STEP);
+        }
+        else if ((writeData[0] == CCS811_REG_BASELINE) && (lenReadData >= 2))
+        {
+            uint16_t baseline = (uint16_t)(SIM_CCS811_BASELINE +
+                g_ccs811_offset);
+            readData[0] = (uint8_t)(baseline >> 8);
+            readData[1] = (uint8_t)baseline;
+        }
+        else if ((writeData[0] == CCS811_REG_HW_ID) && (lenReadData > 0))
+        {
+            readData[0] = CCS811_HW_ID_VALUE;
+        }
+        return (ssize_t)(lenWriteData + lenReadData);
+    }
+
+    if (address != SIM_HDC1000_ADDR)
+    {
+        g_stats.nacks++;
+        errno = ENXIO;
+        return -1;
+    }
+
+    g_pointer = writeData[0];
+    memset(readData, 0, lenReadData);
+    if (lenReadData >= 2)
+    {
+        uint16_t value = (g_pointer == HDC1000_REG_CONFIGURATION) ? g_config :
+            (g_pointer == HDC1000_REG_MANUFACTURER_ID) ? SIM_HDC1000_MANUFACTURER :
+            (g_pointer == HDC1000_REG_DEVICE_ID) ? SIM_HDC1000_DEVICE : 0;
+        readData[0] = (uint8_t)(value >> 8);
+        readData[1] = (uint8_t)value;
+    }
+
+    return (ssize_t)(lenWriteData + lenReadData);
+}
+
+void
+i2c_sim_get_stats(i2c_sim_stats_t *p_stats)
+{
+    *p_stats = g_stats;
+    memset(&g_stats, 0, sizeof(g_stats));
+}
+
+void
+i2c_sim_fail(uint8_t addr, uint32_t count)
+{
+    if (addr < 128)
+    {
+        g_fail[addr] = count;
+    }
+}
+
+void
+i2c_sim_ccs811_power_cycle(void)
+{
+    g_ccs811_offset = SIM_CCS811_COLD_OFFSET;
+}
+
+void
+i2c_sim_hold_sda(uint32_t clocks)
+{
+    g_sda_hold_clocks = clocks;
+}
+
+void
+i2c_sim_reset_master(void)
+{
+    gb_is_master_reset = true;
+}
+
+void
+i2c_sim_set_present(uint8_t addr, bool b_is_present)
+{
+    if (addr >= 128)
+    {
+        return;
+    }
+
+    if (b_is_present)
+    {
+        g_present[addr / 32] |= 1u << (addr % 32);
+    }
+    else
+    {
+        g_present[addr / 32] &= ~(1u << (addr % 32));
+    }
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,96 @@
+/***************************************************************************//**
+* @file    i2c_sim.h
+* @version 1.0.0
+*
+* @brief Simulated I2C bus with an HDC1000, a CCS811 and an OLED display for
+*        host benchmarks.
+*
+* Transfers take the time the bus would need at 100 kHz, measured in bit
+* times including start, repeated start and stop conditions. The HDC1000
+* model follows the datasheet: writing the temperature or humidity register
+* pointer starts a conversion, with HDC1000_CONFIG_MODE set both channels
+* are converted in sequence, and reads before the conversion completes are
+* NACKed. The CCS811 accepts register writes and returns its HW_ID and
+* plausible ALG_RESULT_DATA. The OLED display acknowledges every transfer.
+*
+* Devices can be unplugged and plugged again, an absent device NACKs its
+* address. Faults are injected per address, as NACKed transfers, or for the
+* whole bus, as a device holding SDA low: every transfer then fails until
+* the master has been reset and its transfers have clocked SCL enough times
+* for the device to finish its byte.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef I2C_SIM_H
+#define I2C_SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define I2C_SIM_FAIL_ALWAYS     (UINT32_MAX)
+
+typedef struct
+{
+    uint64_t bus_ns;            // Time the bus was busy
+    uint32_t transfers;
+    uint32_t nacks;
+    uint32_t absent_nacks;      // Of them, addresses without a device
+} i2c_sim_stats_t;
+
+/**
+ * @brief Get and reset bus statistics.
+ */
+void
+i2c_sim_get_stats(i2c_sim_stats_t *p_stats);
+
+/**
+ * @brief Plug or unplug the device at the given address.
+ */
+void
+i2c_sim_set_present(uint8_t addr, bool b_is_present);
+
+/**
+ * @brief NACK the next transfers to the given address.
+ *
+ * @param count Number of transfers, I2C_SIM_FAIL_ALWAYS until called again
+ *              with 0.
+ */
+void
+i2c_sim_fail(uint8_t addr, uint32_t count);
+
+/**
+ * @brief Let a device hold SDA low until SCL is clocked the given number of
+ *        times.
+ */
+void
+i2c_sim_hold_sda(uint32_t clocks);
+
+/**
+ * @brief Reset the master, as closing and opening it does. Its next
+ *        transfers start even while SDA is held low.
+ */
+void
+i2c_sim_reset_master(void);
+
+/**
+ * @brief Power cycle the CCS811, its algorithm starts over with an unsettled
+ *        baseline until the baseline is written or has settled.
+ */
+void
+i2c_sim_ccs811_power_cycle(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // I2C_SIM_H
+
+/* [] END OF FILE */
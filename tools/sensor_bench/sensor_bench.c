@@ -0,0 +1,310 @@
+/***************************************************************************//**
+* @file    sensor_bench.c
+* @version 1.0.0
+*
+* @brief Host side checks and benchmarks of the sensor pipeline.
+*
+* Runs the sensor code of the application on a Linux host, against a
+* simulated 100 kHz I2C bus (i2c_sim.c) with an HDC1000, a CCS811 and the
+* OLED display. The sections run in this order:
+*
+*   accuracy  fixed point conversion, display and telemetry text and
+*             ENV_DATA of every raw HDC1000 value against double precision,
+*             IAQ index, quality flags, trend graph, CCS811 baseline
+*             persistence (bench_accuracy.c)
+*   cost      time to convert and format one sample in double precision and
+*             with measurement.c and ccs811_regs.c, net of the loop and
+*             fastest of five runs; the fixed point way takes about half
+*             the time on an x86 host (this file)
+*   bus       bus and blocked time per HDC1000 sample with separate and
+*             combined conversions, time of a full bus scan (bench_loop.c)
+*   loop      probe event lateness and slowest handler with blocking,
+*             two-stage and staged acquisition (bench_loop.c)
+*   faults    hotplug timing, glitch, breaker and stuck bus containment
+*             under the sensor registry (bench_faults.c)
+*
+* Accuracy and fault lines end in PASS or FAIL. So do the loop lines: a
+* NACK from a sensor fails, NACKs of addresses without a device do not.
+* Those are the registry rescans of the staged mode, every 200 ms in
+* bench_sensors.h, which probe the 109 empty addresses each time.
+*
+* Build on a Linux host from the repository root:
+*
+*   gcc -O2 -std=gnu11 -I tools/sensor_bench -I AirQuality -o sensor_bench \
+*       tools/sensor_bench/sensor_bench.c tools/sensor_bench/i2c_sim.c \
+*       tools/sensor_bench/bench_accuracy.c tools/sensor_bench/bench_loop.c \
+*       tools/sensor_bench/bench_faults.c \
+*       AirQuality/measurement.c AirQuality/ccs811_regs.c \
+*       AirQuality/telemetry.c AirQuality/hdc1000_regs.c \
+*       AirQuality/sensor_registry.c AirQuality/sensor_hdc1000.c \
+*       AirQuality/epoll_timerfd_utilities.c AirQuality/event_loop_stats.c \
+*       AirQuality/latency_histogram.c AirQuality/i2c_scan.c \
+*       AirQuality/i2c_bus.c AirQuality/anomaly.c AirQuality/iaq.c \
+*       AirQuality/ccs811_baseline.c AirQuality/persist.c \
+*       AirQuality/trend.c -DSENSOR_REGISTRY_CONFIG='"bench_sensors.h"' -lm
+*
+* Run with the number of cost samples, of bus samples and of event loop
+* acquisitions, 0 skips the section. Exit status is 1 if any check fails:
+*
+*   ./sensor_bench 1000000 50 100
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_CYCLES
+#endif
+
+#include "ccs811_regs.h"
+#include "measurement.h"
+#include "sensor_bench.h"
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+#define BENCH_RUNS          (5)     // Runs of each way, fastest reported
+
+/*******************************************************************************
+*   Global variables
+*******************************************************************************/
+
+// Accumulates output so that the compiler keeps the work
+static volatile uint32_t g_sink;
+
+/*******************************************************************************
+*   Function definitions
+*******************************************************************************/
+
+uint64_t
+bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+void
+bench_sleep_ms(uint32_t ms)
+{
+    struct timespec wait = { 0, (long)ms * 1000000L };
+    nanosleep(&wait, NULL);
+}
+
+static uint64_t
+now_cycles(void)
+{
+#ifdef BENCH_HAVE_CYCLES
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Sum of the characters of text, keeps the formatting from being
+ *        optimized away.
+ */
+static uint32_t
+text_sum(const char *p_text)
+{
+    uint32_t sum = 0;
+    while (*p_text != '\0')
+    {
+        sum = sum * 31u + (uint8_t)*p_text++;
+    }
+    return sum;
+}
+
+/**
+ * @brief Loop overhead, only consumes the raw values.
+ */
+static uint32_t
+sample_none(uint16_t raw_temperature, uint16_t raw_humidity)
+{
+    return (uint32_t)raw_temperature + raw_humidity;
+}
+
+/**
+ * @brief Conversion and formatting of one sample as done before: double
+ *        conversion, ENV_DATA from float, "%.1f" display and telemetry text.
+ */
+static uint32_t
+sample_double(uint16_t raw_temperature, uint16_t raw_humidity)
+{
+    char display[BENCH_TEXT_SIZE];
+    char temperature_text[BENCH_TEXT_SIZE];
+    char humidity_text[BENCH_TEXT_SIZE];
+
+    double temperature = (double)raw_temperature / 65536.0 * 165.0 - 40.0;
+    double humidity = (double)raw_humidity / 65536.0 * 100.0;
+
+    float temp_f = (float)temperature;
+    float humi_f = (float)humidity;
+    uint16_t humi_reg = (uint16_t)(humi_f * 512.0f + 0.5f);
+    uint16_t temp_reg = (uint16_t)((temp_f + 25.0f) * 512.0f + 0.5f);
+
+    snprintf(display, sizeof(display), "%.1f", humidity);
+    snprintf(temperature_text, sizeof(temperature_text), "%.1f", temperature);
+    snprintf(humidity_text, sizeof(humidity_text), "%.1f", humidity);
+
+    return humi_reg + temp_reg + text_sum(display) +
+        text_sum(temperature_text) + text_sum(humidity_text);
+}
+
+/**
+ * @brief The same through the fixed point code of main.c and telemetry.c.
+ */
+static uint32_t
+sample_fixed(uint16_t raw_temperature, uint16_t raw_humidity)
+{
+    char display[MEASUREMENT_TEXT_SIZE];
+    char temperature_text[MEASUREMENT_TEXT_SIZE];
+    char humidity_text[MEASUREMENT_TEXT_SIZE];
+    uint8_t env[CCS811_ENV_DATA_SIZE];
+
+    int32_t temperature = measurement_temperature_from_hdc1000(raw_temperature);
+    int32_t humidity = measurement_humidity_from_hdc1000(raw_humidity);
+
+    ccs811_regs_encode_env_data(temperature, humidity, env);
+
+    measurement_format(humidity, 1, display, sizeof(display));
+    measurement_format(temperature, 1, temperature_text,
+        sizeof(temperature_text));
+    measurement_format(humidity, 1, humidity_text, sizeof(humidity_text));
+
+    return (uint32_t)((env[0] << 8) | env[1]) + ((env[2] << 8) | env[3]) +
+        text_sum(display) + text_sum(temperature_text) +
+        text_sum(humidity_text);
+}
+
+/**
+ * @brief Time samples through p_sample.
+ *
+ * @return Time per sample [ns].
+ */
+static double
+bench_run(uint32_t (*p_sample)(uint16_t, uint16_t), uint32_t samples,
+    double *p_cycles)
+{
+    uint32_t rng = 0x2545F491u;
+    uint32_t sink = 0;
+
+    uint64_t start_ns = bench_now_ns();
+    uint64_t start_cycles = now_cycles();
+
+    for (uint32_t idx = 0; idx < samples; idx++)
+    {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        // Indoor range, 15 to 35 degC and 20 to 80 %RH
+        uint16_t raw_temperature = (uint16_t)(22238u + (rng & 0x1FFF));
+        uint16_t raw_humidity = (uint16_t)(13107u + ((rng >> 13) % 39322u));
+        sink += p_sample(raw_temperature, raw_humidity);
+    }
+
+    uint64_t cycles = now_cycles() - start_cycles;
+    uint64_t elapsed_ns = bench_now_ns() - start_ns;
+    g_sink += sink;
+
+    *p_cycles = (double)cycles / samples;
+    return (double)elapsed_ns / samples;
+}
+
+/**
+ * @brief Time conversion and formatting both ways, net of the loop overhead.
+ *
+ * Each way is run BENCH_RUNS times interleaved with the other, the fastest
+ * run is reported.
+ */
+static void
+bench(uint32_t samples)
+{
+    static const struct
+    {
+        const char *p_name;
+        uint32_t (*p_sample)(uint16_t, uint16_t);
+    } ways[] = {
+        { "loop", sample_none },
+        { "double", sample_double },
+        { "fixed", sample_fixed }
+    };
+    double best_ns[3] = { 0 };
+    double best_cycles[3] = { 0 };
+
+    for (int run = 0; run < BENCH_RUNS; run++)
+    {
+        for (int way = 0; way < 3; way++)
+        {
+            double cycles;
+            double sample_ns = bench_run(ways[way].p_sample, samples, &cycles);
+            if ((run == 0) || (sample_ns < best_ns[way]))
+            {
+                best_ns[way] = sample_ns;
+                best_cycles[way] = cycles;
+            }
+        }
+    }
+
+    for (int way = 1; way < 3; way++)
+    {
+        printf("%-8s %8.1f ns/sample", ways[way].p_name,
+            best_ns[way] - best_ns[0]);
+#ifdef BENCH_HAVE_CYCLES
+        printf(" %8.0f cycles/sample", best_cycles[way] - best_cycles[0]);
+#else
+        (void)best_cycles;
+#endif
+        printf("\n");
+    }
+}
+
+/*******************************************************************************
+* Main program
+*******************************************************************************/
+
+int
+main(int argc, char *argv[])
+{
+    uint32_t samples = (argc > 1) ?
+        (uint32_t)strtoul(argv[1], NULL, 0) : 1000000;
+    uint32_t bus_samples = (argc > 2) ?
+        (uint32_t)strtoul(argv[2], NULL, 0) : 50;
+    uint32_t acquisitions = (argc > 3) ?
+        (uint32_t)strtoul(argv[3], NULL, 0) : 100;
+
+    bool b_is_ok = bench_check_accuracy();
+
+    if (samples > 0)
+    {
+        bench(samples);
+    }
+
+    if (bus_samples > 0)
+    {
+        bench_bus(bus_samples);
+        bench_scan();
+    }
+
+    if (acquisitions > 0)
+    {
+        b_is_ok &= bench_loop(acquisitions);
+        bench_hotplug();
+        b_is_ok &= bench_check_faults();
+    }
+
+    return b_is_ok ? 0 : 1;
+}
+
+/* [] END OF FILE */
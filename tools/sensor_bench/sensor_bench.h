@@ -0,0 +1,100 @@
+/***************************************************************************//**
+* @file    sensor_bench.h
+* @version 1.0.0
+*
+* @brief Sections of sensor_bench and the helpers they share.
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#ifndef SENSOR_BENCH_H
+#define SENSOR_BENCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+#define BENCH_TEXT_SIZE     (80)
+#define BENCH_I2C_FD        (3)
+#define BENCH_HDC1000_ADDR  (0x40)
+#define BENCH_SINGLE_MS     (7)     // One 14 bit conversion, rounded up
+#define BENCH_CCS811_ADDR   (0x5A)
+#define BENCH_ALG_RESULT_SIZE   (8)
+
+/*******************************************************************************
+*   Function declarations
+*******************************************************************************/
+
+/**
+ * @brief Get monotonic time [ns].
+ */
+uint64_t
+bench_now_ns(void);
+
+void
+bench_sleep_ms(uint32_t ms);
+
+/**
+ * @brief Check conversion, text, IAQ, quality flags, trend and CCS811
+ *        baseline persistence, bench_accuracy.c.
+ *
+ * @return true if all checks pass.
+ */
+bool
+bench_check_accuracy(void);
+
+/**
+ * @brief Time HDC1000 acquisition over the simulated bus, separate and
+ *        combined conversions, bench_loop.c.
+ */
+void
+bench_bus(uint32_t samples);
+
+/**
+ * @brief Time a scan of the whole address range, bench_loop.c.
+ */
+void
+bench_scan(void);
+
+/**
+ * @brief Run the event loop with blocking, two-stage and staged
+ *        acquisition, bench_loop.c.
+ *
+ * @return false if a sensor NACKed a transfer in any mode.
+ */
+bool
+bench_loop(uint32_t acquisitions);
+
+/**
+ * @brief Unplug the HDC1000 under the registry and plug it in again,
+ *        bench_faults.c.
+ */
+void
+bench_hotplug(void);
+
+/**
+ * @brief Inject bus faults under the registry and check they are contained,
+ *        bench_faults.c.
+ *
+ * @return true if all checks pass.
+ */
+bool
+bench_check_faults(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SENSOR_BENCH_H
+
+/* [] END OF FILE */
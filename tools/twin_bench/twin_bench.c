@@ -0,0 +1,523 @@
+/***************************************************************************//**
+* @file    twin_bench.c
+* @version 1.0.0
+*
+* @brief Host side benchmark of the Device Twin and C2D receive paths.
+*
+* Hands large payloads to the receive callbacks of azure_iot_utilities.c
+* through a transport of this file, which captures the transport callbacks
+* of the client instead of talking to a hub:
+*
+*   parsed   TwinUpdateFnType and MessageReceivedFnType: the client copies
+*            the payload into its scratch buffer (scratch_buffer.c) and, for
+*            the twin, builds a parson tree; the consumer reads the items
+*            from the tree, the C2D consumer parses the copy first
+*   buffer   TwinUpdateBufferFnType and MessageReceivedBufferFnType: the
+*            consumer validates the SDK buffer in place and reads the items
+*            with json_scan.c, as device_twin_update_handler() of main.c
+*
+* Both consumers do the same work: the whole payload is validated, the
+* "$version", two number and two string items placed after the filler are
+* read. The items read by both paths are checked against the built payload,
+* the exit status is 1 if they differ.
+*
+* Allocations made by parson are counted through json_set_allocation_
+* functions(). With -f an update runs under memory pressure with the given
+* probability: every allocation made during it fails. The parsed path then
+* skips the update, the buffer path does not allocate.
+*
+* Build on a Linux host from the repository root:
+*
+*   gcc -O2 -std=gnu11 -DAZURE_IOT_FAKE_HUB \
+*       -I tools/fleet_sim -I AirQuality -o twin_bench \
+*       tools/twin_bench/twin_bench.c AirQuality/azure_iot_utilities.c \
+*       AirQuality/fake_hub.c AirQuality/json_scan.c AirQuality/parson.c \
+*       AirQuality/scratch_buffer.c AirQuality/backoff.c \
+*       AirQuality/latency_histogram.c AirQuality/log_ring.c -lm
+*
+* The host replacements of the applibs and SDK headers of tools/fleet_sim
+* are used, the fake hub is only linked in as the default transport.
+*
+* Example, 5000 updates per payload size, 1 % of them under memory
+* pressure:
+*
+*   ./twin_bench -n 5000 -f 10
+*
+* @author Jaroslav Groman
+*
+* @date
+*
+*******************************************************************************/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "azure_iot_transport.h"
+#include "azure_iot_utilities.h"
+#include "json_scan.h"
+#include "parson.h"
+
+/*******************************************************************************
+*   Macros and #define Constants
+*******************************************************************************/
+
+#define BENCH_PAYLOAD_MAX_SIZE  (32 * 1024)     // Below the scratch limit
+#define BENCH_NAME_SIZE         (16)
+
+#define BENCH_VERSION           (42)
+#define BENCH_UPLOAD_PERIOD     (60)
+#define BENCH_REFRESH           (5)
+#define BENCH_MODE              "10s"
+#define BENCH_POWER             "normal"
+
+/*******************************************************************************
+*   Data types
+*******************************************************************************/
+
+typedef enum
+{
+    BENCH_TWIN_PARSED,
+    BENCH_TWIN_BUFFER,
+    BENCH_C2D_PARSED,
+    BENCH_C2D_BUFFER,
+    BENCH_PATH_COUNT
+} bench_path_t;
+
+// Items read by the consumers
+typedef struct
+{
+    double version;
+    double upload_period;
+    double refresh;
+    char mode[BENCH_NAME_SIZE];
+    char power[BENCH_NAME_SIZE];
+} bench_items_t;
+
+typedef struct
+{
+    uint64_t handled;
+    uint64_t mismatches;
+    uint64_t allocations;
+} bench_result_t;
+
+/*******************************************************************************
+*   Forward declarations of private functions
+*******************************************************************************/
+
+static bool
+bench_transport_create(const AzureIoT_TransportCallbacks *p_callbacks);
+
+static void
+bench_transport_destroy(void);
+
+static bool
+bench_transport_send_event(const char *p_payload, const char *p_message_id,
+    void *p_context);
+
+static bool
+bench_transport_send_reported_state(const unsigned char *p_json,
+    size_t size, void *p_context);
+
+static void
+bench_transport_do_work(void);
+
+/*******************************************************************************
+*   Global variables
+*******************************************************************************/
+
+static const char *gp_path_names[BENCH_PATH_COUNT] = {
+    "parsed", "buffer", "parsed", "buffer"
+};
+
+static const AzureIoT_Transport g_bench_transport = {
+    .name = "bench",
+    .create = bench_transport_create,
+    .destroy = bench_transport_destroy,
+    .sendEvent = bench_transport_send_event,
+    .sendReportedState = bench_transport_send_reported_state,
+    .doWork = bench_transport_do_work,
+    .holdConnection = NULL
+};
+
+static const AzureIoT_TransportCallbacks *gp_callbacks = NULL;
+
+static uint32_t g_fail_per_mille = 0;
+static uint32_t g_rng = 0x2545F491u;
+static bool gb_is_under_pressure = false;
+static uint64_t g_allocations = 0;
+static bench_result_t *gp_result = NULL;
+
+/*******************************************************************************
+*   Function definitions
+*******************************************************************************/
+
+static uint32_t
+rng_next(void)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return g_rng;
+}
+
+static void *
+bench_malloc(size_t size)
+{
+    if (gb_is_under_pressure)
+    {
+        return NULL;
+    }
+    g_allocations++;
+    return malloc(size);
+}
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Build a payload of about target_size bytes, the items after the
+ *        filler.
+ *
+ * @param b_is_twin Complete Device Twin document with desired and reported
+ *                  properties, otherwise the bare object of a C2D message.
+ *
+ * @return Length of the payload, not zero terminated.
+ */
+static size_t
+payload_build(char *p_buffer, size_t buffer_size, size_t target_size,
+    bool b_is_twin)
+{
+    size_t len = (size_t)snprintf(p_buffer, buffer_size,
+        "%s\"displayEnabled\":true", b_is_twin ? "{\"desired\":{" : "{");
+
+    for (int idx = 0; len + 260 < target_size; idx++)
+    {
+        len += (size_t)snprintf(p_buffer + len, buffer_size - len,
+            ",\"zone%04d\":{\"name\":\"Meeting room %d\",\"co2Limit\":%d,"
+            "\"tvocLimit\":%d,\"enabled\":%s}",
+            idx, idx, 800 + idx % 400, 200 + idx % 100,
+            (idx % 3) ? "true" : "false");
+    }
+
+    len += (size_t)snprintf(p_buffer + len, buffer_size - len,
+        ",\"uploadPeriodSec\":%d,\"displayMinRefreshSec\":%d,"
+        "\"ccs811Mode\":\"%s\",\"powerMode\":\"%s\",\"$version\":%d}",
+        BENCH_UPLOAD_PERIOD, BENCH_REFRESH, BENCH_MODE, BENCH_POWER,
+        BENCH_VERSION);
+
+    if (b_is_twin)
+    {
+        len += (size_t)snprintf(p_buffer + len, buffer_size - len,
+            ",\"reported\":{\"versionString\":\"1.0.0\",\"$version\":3}}");
+    }
+
+    return len;
+}
+
+static void
+items_check(const bench_items_t *p_items)
+{
+    gp_result->handled++;
+    if ((p_items->version != BENCH_VERSION) ||
+        (p_items->upload_period != BENCH_UPLOAD_PERIOD) ||
+        (p_items->refresh != BENCH_REFRESH) ||
+        (strcmp(p_items->mode, BENCH_MODE) != 0) ||
+        (strcmp(p_items->power, BENCH_POWER) != 0))
+    {
+        gp_result->mismatches++;
+    }
+}
+
+/**
+ * @brief Read the items from a parson tree.
+ */
+static void
+items_from_tree(const JSON_Object *p_object)
+{
+    bench_items_t items;
+    const char *p_mode = json_object_get_string(p_object, "ccs811Mode");
+    const char *p_power = json_object_get_string(p_object, "powerMode");
+
+    memset(&items, 0, sizeof(items));
+    items.version = json_object_get_number(p_object, "$version");
+    items.upload_period = json_object_get_number(p_object,
+        "uploadPeriodSec");
+    items.refresh = json_object_get_number(p_object, "displayMinRefreshSec");
+    snprintf(items.mode, sizeof(items.mode), "%s",
+        (p_mode != NULL) ? p_mode : "");
+    snprintf(items.power, sizeof(items.power), "%s",
+        (p_power != NULL) ? p_power : "");
+
+    items_check(&items);
+}
+
+/**
+ * @brief Read the items of a validated object in one pass over its members.
+ */
+static void
+items_from_buffer(const json_scan_value_t *p_object)
+{
+    bench_items_t items;
+    json_scan_value_t name;
+    json_scan_value_t value;
+    size_t pos = 0;
+
+    memset(&items, 0, sizeof(items));
+    while (json_scan_next_member(p_object, &pos, &name, &value))
+    {
+        if (json_scan_string_equals(&name, "$version"))
+        {
+            json_scan_get_number(&value, &items.version);
+        }
+        else if (json_scan_string_equals(&name, "uploadPeriodSec"))
+        {
+            json_scan_get_number(&value, &items.upload_period);
+        }
+        else if (json_scan_string_equals(&name, "displayMinRefreshSec"))
+        {
+            json_scan_get_number(&value, &items.refresh);
+        }
+        else if (json_scan_string_equals(&name, "ccs811Mode"))
+        {
+            json_scan_get_string(&value, items.mode, sizeof(items.mode));
+        }
+        else if (json_scan_string_equals(&name, "powerMode"))
+        {
+            json_scan_get_string(&value, items.power, sizeof(items.power));
+        }
+    }
+
+    items_check(&items);
+}
+
+static void
+twin_parsed_handler(JSON_Object *p_desired)
+{
+    items_from_tree(p_desired);
+}
+
+static void
+twin_buffer_handler(bool b_is_complete, const unsigned char *p_payload,
+    size_t size)
+{
+    json_scan_value_t root;
+    json_scan_value_t desired;
+
+    if (!json_scan_parse(p_payload, size, &root))
+    {
+        return;
+    }
+    if (!b_is_complete || !json_scan_get_member(&root, "desired", &desired))
+    {
+        desired = root;
+    }
+
+    items_from_buffer(&desired);
+}
+
+static void
+message_parsed_handler(const char *p_payload)
+{
+    JSON_Value *p_root = json_parse_string(p_payload);
+
+    if (p_root != NULL)
+    {
+        items_from_tree(json_value_get_object(p_root));
+        json_value_free(p_root);
+    }
+}
+
+static void
+message_buffer_handler(const unsigned char *p_payload, size_t size)
+{
+    json_scan_value_t root;
+
+    if (json_scan_parse(p_payload, size, &root))
+    {
+        items_from_buffer(&root);
+    }
+}
+
+/**
+ * @brief Register the consumer of one path only.
+ */
+static void
+path_select(bench_path_t path)
+{
+    AzureIoT_SetDeviceTwinUpdateCallback(
+        (path == BENCH_TWIN_PARSED) ? twin_parsed_handler : NULL);
+    AzureIoT_SetDeviceTwinUpdateBufferCallback(
+        (path == BENCH_TWIN_BUFFER) ? twin_buffer_handler : NULL);
+    AzureIoT_SetMessageReceivedCallback(
+        (path == BENCH_C2D_PARSED) ? message_parsed_handler : NULL);
+    AzureIoT_SetMessageReceivedBufferCallback(
+        (path == BENCH_C2D_BUFFER) ? message_buffer_handler : NULL);
+}
+
+static bool
+bench_transport_create(const AzureIoT_TransportCallbacks *p_callbacks)
+{
+    gp_callbacks = p_callbacks;
+    return true;
+}
+
+static void
+bench_transport_destroy(void)
+{
+    gp_callbacks = NULL;
+}
+
+static bool
+bench_transport_send_event(const char *p_payload, const char *p_message_id,
+    void *p_context)
+{
+    (void)p_payload;
+    (void)p_message_id;
+    (void)p_context;
+    return false;
+}
+
+static bool
+bench_transport_send_reported_state(const unsigned char *p_json,
+    size_t size, void *p_context)
+{
+    (void)p_json;
+    (void)size;
+    (void)p_context;
+    return false;
+}
+
+static void
+bench_transport_do_work(void)
+{
+}
+
+static void
+usage(const char *p_name)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -n updates      updates per payload size and path (2000)\n"
+        "  -f per_mille    updates under memory pressure (0)\n",
+        p_name);
+}
+
+/*******************************************************************************
+* Main program
+*******************************************************************************/
+
+int
+main(int argc, char *argv[])
+{
+    static const size_t sizes[] = { 1024, 4096, 16384, 32768 };
+    uint32_t updates = 2000;
+    bool b_is_ok = true;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:f:h")) != -1)
+    {
+        uint32_t value = (optarg != NULL) ?
+            (uint32_t)strtoul(optarg, NULL, 0) : 0;
+        switch (opt)
+        {
+            case 'n': updates = value; break;
+            case 'f': g_fail_per_mille = value; break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (updates == 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    json_set_allocation_functions(bench_malloc, free);
+
+    char *p_payload = malloc(BENCH_PAYLOAD_MAX_SIZE + 256);
+    if ((p_payload == NULL) || !AzureIoT_SetTransport(&g_bench_transport) ||
+        !AzureIoT_SetupClient() || (gp_callbacks == NULL))
+    {
+        fprintf(stderr, "Could not set up the client\n");
+        return 1;
+    }
+
+    printf("%8s %5s %8s %10s %10s %10s %8s %8s\n", "size", "kind", "path",
+        "ns/update", "MB/s", "allocs/upd", "skipped", "mismatch");
+
+    for (int path = 0; path < BENCH_PATH_COUNT; path++)
+    {
+        bool b_is_twin = (path <= BENCH_TWIN_BUFFER);
+
+        path_select((bench_path_t)path);
+
+        for (size_t size_idx = 0; size_idx < sizeof(sizes) / sizeof(sizes[0]);
+            size_idx++)
+        {
+            size_t size = payload_build(p_payload, BENCH_PAYLOAD_MAX_SIZE + 256,
+                sizes[size_idx] - 1, b_is_twin);
+            const unsigned char *p_data = (const unsigned char *)p_payload;
+            bench_result_t result;
+            uint64_t elapsed_ns = 0;
+
+            memset(&result, 0, sizeof(result));
+            gp_result = &result;
+            g_allocations = 0;
+
+            for (uint32_t idx = 0; idx < updates; idx++)
+            {
+                gb_is_under_pressure = (g_fail_per_mille > 0) &&
+                    ((rng_next() % 1000) < g_fail_per_mille);
+
+                uint64_t start_ns = now_ns();
+                if (b_is_twin)
+                {
+                    gp_callbacks->twinUpdate(DEVICE_TWIN_UPDATE_COMPLETE,
+                        p_data, size, NULL);
+                }
+                else
+                {
+                    gp_callbacks->messageReceived(p_data, size);
+                }
+                elapsed_ns += now_ns() - start_ns;
+            }
+            gb_is_under_pressure = false;
+            result.allocations = g_allocations;
+
+            printf("%8zu %5s %8s %10.0f %10.1f %10.1f %8llu %8llu\n",
+                size, b_is_twin ? "twin" : "c2d", gp_path_names[path],
+                (double)elapsed_ns / updates,
+                (double)size * updates / ((double)elapsed_ns / 1e3),
+                (double)result.allocations / updates,
+                (unsigned long long)(updates - result.handled),
+                (unsigned long long)result.mismatches);
+
+            // Only updates under memory pressure may be skipped
+            if ((result.mismatches > 0) || (result.handled == 0) ||
+                ((g_fail_per_mille == 0) && (result.handled != updates)))
+            {
+                b_is_ok = false;
+            }
+        }
+    }
+
+    AzureIoT_DestroyClient();
+    free(p_payload);
+    printf("%s\n", b_is_ok ? "PASS" : "FAIL");
+
+    return b_is_ok ? 0 : 1;
+}
+
+/* [] END OF FILE */